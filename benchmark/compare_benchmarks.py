@@ -0,0 +1,104 @@
+#!/usr/bin/env python3
+"""Flags regressions of render_suite.py results against a baseline.
+
+Usage: compare_benchmarks.py baseline.json results.json [--threshold 0.1]
+
+Prints every compared value per scene and exits with 1 if any of them got
+worse by more than the threshold, or if a scene of the baseline is missing.
+Timings also have to be worse by at least --min-delta-ms, so that noise in
+sub-millisecond sections does not count. Memory has its own, tighter
+threshold since it does not vary between runs.
+"""
+
+import argparse
+import json
+import os
+import sys
+
+# (section, statistic) of timings_ms that are compared
+TIMINGS = [
+    ("cpu_frame", "p50"),
+    ("cpu_frame", "p90"),
+    ("cpu_cull", "p50"),
+    ("cpu_record", "p50"),
+    ("cpu_submit", "p50"),
+    ("gpu_frame", "p50"),
+]
+METRICS = ["device_block_bytes", "device_used_bytes", "host_ring_bytes"]
+
+
+def user_path(path):
+    """Resolves path against where `bazel run` was started."""
+    return os.path.join(os.environ.get("BUILD_WORKING_DIRECTORY", ""), path)
+
+
+def load(path):
+    with open(user_path(path)) as results:
+        data = json.load(results)
+    if data.get("version") != 1:
+        sys.exit("%s: unsupported version %s" % (path, data.get("version")))
+    return data["scenes"]
+
+
+def compare(baseline, current, threshold, min_delta):
+    """Returns (status, change) for one value, lower is better."""
+    if baseline is None or current is None:
+        return "n/a", None
+    delta = current - baseline
+    change = delta / baseline if baseline > 0 else 0.0
+    if change > threshold and delta > min_delta:
+        return "REGRESSION", change
+    if change < -threshold and -delta > min_delta:
+        return "improved", change
+    return "ok", change
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n")[0])
+    parser.add_argument("baseline")
+    parser.add_argument("results")
+    parser.add_argument("--threshold", type=float, default=0.10,
+                        help="relative change of a timing that counts")
+    parser.add_argument("--min-delta-ms", type=float, default=0.05)
+    parser.add_argument("--memory-threshold", type=float, default=0.02)
+    args = parser.parse_args()
+
+    baseline_scenes = load(args.baseline)
+    current_scenes = load(args.results)
+    failed = False
+    print("%-22s %-20s %12s %12s %8s  %s" %
+          ("scene", "value", "baseline", "current", "change", "status"))
+    for scene in sorted(baseline_scenes):
+        if scene not in current_scenes:
+            print("%-22s missing from %s" % (scene, args.results))
+            failed = True
+            continue
+        baseline = baseline_scenes[scene]
+        current = current_scenes[scene]
+        if baseline["parameters"] != current["parameters"]:
+            print("%-22s warning: parameters differ, e.g. another device" %
+                  scene)
+
+        rows = []
+        for section, statistic in TIMINGS:
+            old = baseline["timings_ms"].get(section, {}).get(statistic)
+            new = current["timings_ms"].get(section, {}).get(statistic)
+            rows.append(("%s.%s" % (section, statistic), old, new,
+                         args.threshold, args.min_delta_ms))
+        for metric in METRICS:
+            rows.append((metric, baseline["metrics"].get(metric),
+                         current["metrics"].get(metric),
+                         args.memory_threshold, 0.0))
+        for value, old, new, threshold, min_delta in rows:
+            status, change = compare(old, new, threshold, min_delta)
+            if status == "n/a":
+                continue
+            failed = failed or status == "REGRESSION"
+            print("%-22s %-20s %12.4g %12.4g %+7.1f%%  %s" %
+                  (scene, value, old, new, change * 100.0, status))
+
+    sys.exit(1 if failed else 0)
+
+
+if __name__ == "__main__":
+    main()
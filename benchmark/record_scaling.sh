@@ -0,0 +1,39 @@
+#!/bin/sh
+# Renders the same scene headless with an increasing number of recording
+# threads and prints the mean CPU time spent recording a frame.
+#
+# Usage: record_scaling.sh [vulkan_qt] [max_workers] [extra vulkan_qt args]
+#
+# The scene is drawn without instancing, so there are enough draw calls for
+# the recording to be worth splitting. vulkan_qt still needs a Vulkan
+# capable QPA, run this under xvfb-run on machines without a display.
+
+set -e
+
+binary=${1:-bazel-bin/vulkan_qt}
+max_workers=${2:-$(nproc)}
+[ $# -gt 0 ] && shift
+[ $# -gt 0 ] && shift
+
+scene="--headless --frames 300 --instances 100000 --no-instancing"
+csv=$(mktemp)
+trap 'rm -f "$csv"' EXIT
+
+printf '%8s %12s %12s %9s\n' workers record_ms frame_ms speedup
+baseline=
+workers=0
+while [ "$workers" -le "$max_workers" ]; do
+    "$binary" $scene --workers "$workers" --profile csv \
+        --profile-output "$csv" "$@" 2>/dev/null
+    # mean over all frames but the first few warm-up frames
+    result=$(awk -F, 'NR > 11 { record += $4; frame += $3; n++ }
+        END { printf "%.3f %.3f", record / n, frame / n }' "$csv")
+    record_ms=${result% *}
+    frame_ms=${result#* }
+    [ -z "$baseline" ] && baseline=$record_ms
+    speedup=$(awk -v a="$baseline" -v b="$record_ms" \
+        'BEGIN { printf "%.2f", a / b }')
+    printf '%8s %12s %12s %9s\n' "$workers" "$record_ms" "$frame_ms" \
+        "$speedup"
+    if [ "$workers" -eq 0 ]; then workers=1; else workers=$((workers * 2)); fi
+done
@@ -0,0 +1,155 @@
+#!/usr/bin/env python3
+"""Renders the benchmark scenes headless and collects their reports.
+
+Every scene is one run of vulkan_qt --headless --benchmark-json. The reports
+are merged into one JSON file, keyed by scene, which compare_benchmarks.py
+checks against a stored baseline.
+
+Usage: render_suite.py [--binary vulkan_qt] [--output results.json]
+                       [--mesh-converter mesh_converter]
+                       [--lavapipe] [--frames n] [--scenes a,b,...]
+
+The scenes scale one thing each: triangles, draw calls, instances, how
+often the uniforms change and the number of simulated particles. Two more
+stream a mesh file written by mesh_converter --grid, on the transfer queue
+and on the graphics queue, to compare their frame time p99. With
+--lavapipe the runs use Mesa's software driver, which gives comparable
+numbers on machines without a GPU (CI).
+vulkan_qt still needs a Vulkan capable QPA, run this under xvfb-run on
+machines without a display.
+"""
+
+import argparse
+import glob
+import json
+import os
+import subprocess
+import sys
+import tempfile
+
+# name: vulkan_qt arguments on top of --headless, MESH is replaced with the
+# path of the streamed mesh
+MESH = "{mesh}"
+# about 50 MiB, streamed during the first 50 frames at 1 MiB per frame
+STREAMED_GRID = "1024"
+SCENES = {
+    # static geometry, 64k and 1M triangles
+    "triangles_64k": ["--mesh-subdivisions", "256"],
+    "triangles_1m": ["--mesh-subdivisions", "1024"],
+    # one draw call per instance
+    "draws_1k": ["--instances", "1000", "--no-instancing"],
+    "draws_10k": ["--instances", "10000", "--no-instancing"],
+    # a single instanced draw
+    "instances_10k": ["--instances", "10000"],
+    "instances_100k": ["--instances", "100000"],
+    # the same scene, with new uniforms never and every frame
+    "uniforms_static": ["--instances", "1000"],
+    "uniforms_every_frame": ["--instances", "1000", "--orbit-every", "1"],
+    # a compute step and a point draw per frame, 1M and 10M particles
+    "particles_1m": ["--particles", "1000000"],
+    "particles_10m": ["--particles", "10000000"],
+    # a streamed mesh, its copies on the transfer queue and on the
+    # graphics queue
+    "stream_transfer_queue": ["--mesh", MESH, "--stream-budget", "1"],
+    "stream_graphics_queue": ["--mesh", MESH, "--stream-budget", "1",
+                              "--no-transfer-queue"],
+}
+
+LAVAPIPE_ICD_PATTERNS = [
+    "/usr/share/vulkan/icd.d/lvp_icd*.json",
+    "/usr/local/share/vulkan/icd.d/lvp_icd*.json",
+    "/etc/vulkan/icd.d/lvp_icd*.json",
+]
+
+
+def user_path(path):
+    """Resolves path against where `bazel run` was started."""
+    return os.path.join(os.environ.get("BUILD_WORKING_DIRECTORY", ""), path)
+
+
+def lavapipe_environment():
+    for pattern in LAVAPIPE_ICD_PATTERNS:
+        icds = sorted(glob.glob(pattern))
+        if icds:
+            environment = dict(os.environ)
+            # the loader reads VK_DRIVER_FILES, older ones VK_ICD_FILENAMES
+            environment["VK_DRIVER_FILES"] = icds[0]
+            environment["VK_ICD_FILENAMES"] = icds[0]
+            return environment
+    sys.exit("lavapipe not found, install Mesa's Vulkan drivers")
+
+
+def run_scene(binary, name, arguments, frames, size, environment):
+    with tempfile.TemporaryDirectory() as directory:
+        report_path = os.path.join(directory, "report.json")
+        command = [binary, "--headless", "--frames", str(frames), "--size",
+                   size, "--benchmark-json", report_path] + arguments
+        result = subprocess.run(command, env=environment,
+                                stdout=subprocess.DEVNULL,
+                                stderr=subprocess.PIPE,
+                                universal_newlines=True)
+        if result.returncode != 0 or not os.path.exists(report_path):
+            sys.stderr.write(result.stderr)
+            sys.exit("scene %s failed: %s" % (name, " ".join(command)))
+        with open(report_path) as report:
+            return json.load(report)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n")[0])
+    parser.add_argument("--binary", default="bazel-bin/vulkan_qt")
+    parser.add_argument("--mesh-converter",
+                        default="bazel-bin/tools/mesh_converter",
+                        help="writes the mesh of the stream scenes")
+    parser.add_argument("--output", default="benchmark_results.json")
+    parser.add_argument("--frames", type=int, default=300)
+    parser.add_argument("--size", default="640x360")
+    parser.add_argument("--lavapipe", action="store_true",
+                        help="render on Mesa's software Vulkan driver")
+    parser.add_argument("--scenes",
+                        help="comma separated subset of: " +
+                        ", ".join(SCENES))
+    args = parser.parse_args()
+
+    names = args.scenes.split(",") if args.scenes else list(SCENES)
+    for name in names:
+        if name not in SCENES:
+            sys.exit("unknown scene %s" % name)
+    environment = lavapipe_environment() if args.lavapipe else None
+
+    with tempfile.TemporaryDirectory() as mesh_directory:
+        mesh_path = os.path.join(mesh_directory, "grid.vqm")
+        if any(MESH in SCENES[name] for name in names):
+            subprocess.run([args.mesh_converter, "--grid", STREAMED_GRID,
+                            mesh_path], stdout=subprocess.DEVNULL, check=True)
+
+        scenes = {}
+        for name in names:
+            arguments = [mesh_path if argument == MESH else argument
+                         for argument in SCENES[name]]
+            report = run_scene(args.binary, name, arguments, args.frames,
+                               args.size, environment)
+            if report["frames"] == 0:
+                sys.exit("--frames %d leaves no frames after the %d warm-up "
+                         "frames" % (args.frames, report["warmup_frames"]))
+            timings = report["timings_ms"]
+            frame = timings["cpu_frame"]
+            line = ("%-22s frame p50 %8.3f ms  p99 %8.3f ms  "
+                    "record p50 %8.3f ms" % (name, frame["p50"], frame["p99"],
+                                             timings["cpu_record"]["p50"]))
+            # the whole GPU frame, so an upper bound of the simulation cost
+            particles = int(report["parameters"].get("particles", "0"))
+            if particles and timings.get("gpu_frame", {}).get("p50"):
+                line += "  %8.1f Mparticles/s" % (
+                    particles / timings["gpu_frame"]["p50"] / 1e3)
+            print(line)
+            scenes[name] = report
+
+    with open(user_path(args.output), "w") as output:
+        json.dump({"version": 1, "scenes": scenes}, output, indent=2,
+                  sort_keys=True)
+        output.write("\n")
+
+
+if __name__ == "__main__":
+    main()
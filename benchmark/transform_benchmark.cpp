@@ -0,0 +1,96 @@
+// Compares per-object GetMVPMatrix calls with the batched transform kernels.
+//
+// Usage: transform_benchmark [object_count] [iterations]
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <glm/mat4x4.hpp>
+#include <vector>
+
+#include "graphics.h"
+#include "transform_batch.h"
+
+namespace
+{
+constexpr float aspect{16.0f / 9.0f};
+constexpr float translate_z{4.0f};
+constexpr float rotate_x{0.3f};
+constexpr float rotate_y{1.1f};
+
+// Best of iterations runs, in nanoseconds per object.
+double Measure(const char* name, std::size_t count, int iterations,
+               const std::function<void()>& run)
+{
+    double best_ns{0.0};
+    for (int i = 0; i < iterations; ++i)
+    {
+        const auto start = std::chrono::steady_clock::now();
+        run();
+        const std::chrono::duration<double, std::nano> elapsed =
+            std::chrono::steady_clock::now() - start;
+        if (i == 0 || elapsed.count() < best_ns) best_ns = elapsed.count();
+    }
+    const double per_object = best_ns / static_cast<double>(count);
+    std::printf("%-22s %8.2f ns/object\n", name, per_object);
+    return per_object;
+}
+}  // namespace
+
+int main(int argc, char* argv[])
+{
+    const std::size_t count = argc > 1 ? std::strtoul(argv[1], nullptr, 10)
+                                       : 10000;
+    const int iterations = argc > 2 ? std::atoi(argv[2]) : 50;
+    if (count == 0 || iterations <= 0)
+    {
+        std::fprintf(stderr, "usage: %s [object_count] [iterations]\n",
+                     argv[0]);
+        return 1;
+    }
+
+    MatrixBatch models(count);
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        glm::mat4 model(1.0f);
+        model[3][0] = static_cast<float>(i % 100) * 0.1f;
+        model[3][1] = static_cast<float>(i / 100) * 0.1f;
+        models.Set(i, model);
+    }
+    std::vector<glm::mat4> mvps(count);
+    TransformBatch transforms;
+    transforms.SetCamera(aspect, translate_z, rotate_x, rotate_y);
+
+    std::printf("%zu objects, best of %d runs, detected %s\n", count,
+                iterations, SimdLevelName(DetectSimdLevel()));
+    const double baseline =
+        Measure("GetMVPMatrix per object", count, iterations, [&] {
+            for (std::size_t i = 0; i < count; ++i)
+            {
+                mvps[i] = GetMVPMatrix(aspect, translate_z, rotate_x,
+                                       rotate_y) *
+                          models.Get(i);
+            }
+        });
+    Measure("glm, cached camera", count, iterations, [&] {
+        const glm::mat4& view_projection = transforms.view_projection();
+        for (std::size_t i = 0; i < count; ++i)
+            mvps[i] = view_projection * models.Get(i);
+    });
+    for (const SimdLevel level :
+         {SimdLevel::kScalar, SimdLevel::kSse, SimdLevel::kAvx2})
+    {
+        if (!IsSimdLevelSupported(level)) continue;
+        const double per_object =
+            Measure(SimdLevelName(level), count, iterations,
+                    [&] { transforms.Compute(models, mvps.data(), level); });
+        std::printf("%-22s %8.1fx\n", "  speedup", baseline / per_object);
+    }
+
+    // keep the results alive
+    float checksum{0.0f};
+    for (const glm::mat4& mvp : mvps) checksum += mvp[3][3];
+    std::printf("checksum %f\n", checksum);
+    return 0;
+}
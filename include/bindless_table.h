@@ -0,0 +1,76 @@
+#ifndef VULKAN_QT_INCLUDE_BINDLESS_TABLE_H
+#define VULKAN_QT_INCLUDE_BINDLESS_TABLE_H
+
+#include <QtGui/QVulkanFunctions>
+#include <cstdint>
+#include <vector>
+
+// One descriptor set with all storage buffers (binding 0) and textures
+// (binding 1, combined image samplers) of the scene, which shaders index
+// instead of having a set bound per material.
+//
+// With VK_EXT_descriptor_indexing the arrays are update-after-bind and
+// partially bound: slots can be filled while the set is in use by pending
+// command buffers, empty slots are fine as long as nothing reads them, and
+// the set is bound once per command buffer. Draws pick their resources by
+// index, e.g. from a push constant.
+//
+// Without the extension it falls back to one ordinary set per texture, each
+// with all buffers and only that texture, at index 0. Draws then bind the
+// set of their texture whenever it changes.
+class BindlessTable
+{
+  public:
+    BindlessTable();
+
+    void Create(QVulkanDeviceFunctions* device_functions, VkDevice device,
+                bool descriptor_indexing, std::uint32_t buffer_capacity,
+                std::uint32_t texture_capacity, VkShaderStageFlags stages);
+    void Release();
+
+    // Fill the next free slot and return its index. The resources have to
+    // outlive the table.
+    std::uint32_t AddBuffer(VkBuffer buffer, VkDeviceSize offset,
+                            VkDeviceSize range);
+    std::uint32_t AddTexture(VkImageView view, VkSampler sampler);
+
+    // Binds the table as set for draws that sample texture, unless *bound
+    // (the texture the command buffer was last bound for, initially
+    // unbound_texture) says it already is.
+    void Bind(VkCommandBuffer command_buffer, VkPipelineLayout layout,
+              std::uint32_t set, std::uint32_t texture,
+              std::uint32_t* bound) const;
+    static constexpr std::uint32_t unbound_texture{UINT32_MAX};
+
+    bool bindless() const { return bindless_; }
+    VkDescriptorSetLayout layout() const { return layout_; }
+    // The size of the texture array in the shaders: the capacity, or 1 in
+    // the fallback.
+    std::uint32_t shader_texture_count() const
+    {
+        return bindless_ ? texture_capacity_ : 1;
+    }
+    std::uint32_t texture_count() const
+    {
+        return static_cast<std::uint32_t>(textures_.size());
+    }
+
+  private:
+    void WriteBuffer(VkDescriptorSet set, std::uint32_t slot) const;
+    void WriteTexture(VkDescriptorSet set, std::uint32_t element,
+                      std::uint32_t slot) const;
+
+    QVulkanDeviceFunctions* device_functions_;
+    VkDevice device_;
+    bool bindless_;
+    std::uint32_t buffer_capacity_;
+    std::uint32_t texture_capacity_;
+    VkDescriptorPool pool_;
+    VkDescriptorSetLayout layout_;
+    // the table, or one per texture in the fallback
+    std::vector<VkDescriptorSet> sets_;
+    std::vector<VkDescriptorBufferInfo> buffers_;
+    std::vector<VkDescriptorImageInfo> textures_;
+};
+
+#endif  // VULKAN_QT_INCLUDE_BINDLESS_TABLE_H
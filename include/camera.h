@@ -0,0 +1,79 @@
+#ifndef VULKAN_QT_INCLUDE_CAMERA_H
+#define VULKAN_QT_INCLUDE_CAMERA_H
+
+#include <cstdint>
+#include <glm/mat4x4.hpp>
+
+enum class CameraMode
+{
+    kOrbit,  // circles the origin, like GetViewMatrix
+    kFly,    // moves freely, turning in place
+};
+
+// The scene camera, driven by mouse and keyboard input. Projection and view
+// are cached separately behind dirty flags: the projection is only rebuilt
+// when the viewport changes, the view only when input moved the camera, and
+// Update() does nothing at all while the camera is still.
+//
+// The projection includes the Vulkan clip space correction (y down, depth
+// in [0, 1]).
+class Camera
+{
+  public:
+    Camera();
+
+    void SetViewport(int width, int height);
+    // Switching to fly mode starts from the orbit camera's pose, switching
+    // back returns to the orbit.
+    void SetMode(CameraMode mode);
+    // Back to the initial orbit.
+    void Reset();
+
+    // Mouse drag, in radians. Orbits around the origin, or turns the camera
+    // in fly mode. Pitch stays short of straight up or down.
+    void Rotate(float yaw, float pitch);
+    // Mouse wheel steps: towards or away from the origin, or forwards and
+    // backwards in fly mode.
+    void Zoom(float steps);
+    // Held movement keys in fly mode, each -1, 0 or 1, applied by Advance().
+    void SetMoveDirection(float right, float up, float forward);
+    // Moves the fly camera for the elapsed time.
+    void Advance(float seconds);
+    bool moving() const;
+
+    // Rebuilds whatever input changed. Returns whether the view-projection
+    // changed since the last call.
+    bool Update();
+
+    const glm::mat4& projection() const { return projection_; }
+    const glm::mat4& view() const { return view_; }
+    const glm::mat4& view_projection() const { return view_projection_; }
+    CameraMode mode() const { return mode_; }
+    // How often each matrix was rebuilt.
+    std::uint64_t projection_builds() const { return projection_builds_; }
+    std::uint64_t view_builds() const { return view_builds_; }
+
+  private:
+    CameraMode mode_;
+    float aspect_;
+    // orbit, the arguments of GetViewMatrix
+    float distance_;
+    float rotate_x_;
+    float rotate_y_;
+    // fly
+    float position_[3];
+    float yaw_;
+    float pitch_;
+    float move_[3];  // right, up, forward
+    float speed_;    // units per second
+
+    bool projection_dirty_;
+    bool view_dirty_;
+    glm::mat4 projection_;
+    glm::mat4 view_;
+    glm::mat4 view_projection_;
+    std::uint64_t projection_builds_;
+    std::uint64_t view_builds_;
+};
+
+#endif  // VULKAN_QT_INCLUDE_CAMERA_H
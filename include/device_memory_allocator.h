@@ -0,0 +1,198 @@
+#ifndef VULKAN_QT_INCLUDE_DEVICE_MEMORY_ALLOCATOR_H
+#define VULKAN_QT_INCLUDE_DEVICE_MEMORY_ALLOCATOR_H
+
+#include <QtGui/QVulkanFunctions>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "offset_allocator.h"
+
+constexpr VkDeviceSize default_memory_block_size{64 * 1024 * 1024};
+
+// Buffers and linear images may not share a bufferImageGranularity page with
+// optimal-tiling images, so each kind gets blocks of its own.
+enum class ResourceKind
+{
+    kLinear,
+    kOptimal
+};
+
+// A range of a VkDeviceMemory block, or a dedicated VkDeviceMemory.
+struct MemoryAllocation
+{
+    VkDeviceMemory memory{VK_NULL_HANDLE};
+    VkDeviceSize offset{0};
+    VkDeviceSize size{0};
+    VkDeviceSize alignment{1};  // of block ranges, for defragmentation
+    quint8* mapped{nullptr};  // at offset, for host-visible memory
+    std::uint32_t memory_type{UINT32_MAX};
+    ResourceKind kind{ResourceKind::kLinear};
+    std::int32_t block{-1};  // -1: dedicated
+};
+
+struct MemoryStats
+{
+    std::size_t block_count{0};
+    std::size_t dedicated_count{0};
+    std::size_t allocation_count{0};
+    VkDeviceSize block_bytes{0};
+    VkDeviceSize dedicated_bytes{0};
+    VkDeviceSize used_bytes{0};  // in blocks
+    VkDeviceSize largest_free_range{0};
+    // 0 if the free space of every block is one range, towards 1 the more
+    // it is split up
+    double fragmentation{0.0};
+};
+
+// Moves an allocation to a reserved destination, see PlanDefragmentation.
+struct DefragmentationMove
+{
+    MemoryAllocation* allocation;
+    MemoryAllocation destination;
+};
+
+// Sub-allocates VkDeviceMemory: a few large blocks per memory type, split
+// up by a TlsfAllocator each, instead of one vkAllocateMemory per resource,
+// which is slow and runs into maxMemoryAllocationCount. Allocations larger
+// than half a block get dedicated memory. Host-visible blocks stay mapped.
+// Not thread-safe.
+class DeviceMemoryAllocator
+{
+  public:
+    DeviceMemoryAllocator();
+
+    void Create(QVulkanDeviceFunctions* device_functions, VkDevice device,
+                const VkPhysicalDeviceProperties& device_properties,
+                const VkPhysicalDeviceMemoryProperties& memory_properties,
+                VkDeviceSize block_size = default_memory_block_size);
+    // Frees all blocks. Every allocation has to be freed before.
+    void Release();
+
+    // Memory for requirements, of preferred_type if allowed, otherwise of
+    // the first allowed type with the required flags. Returns false if
+    // there is no such type or the device is out of memory.
+    bool Allocate(const VkMemoryRequirements& requirements,
+                  std::uint32_t preferred_type,
+                  VkMemoryPropertyFlags required, ResourceKind kind,
+                  MemoryAllocation* allocation);
+    void Free(MemoryAllocation* allocation);
+
+    // A buffer bound to a new allocation, which is aligned for use as a
+    // dynamic descriptor offset of any of the usage's descriptor types.
+    // With more than one queue family, the buffer is shared concurrently
+    // between them.
+    void CreateBuffer(VkDeviceSize size, VkBufferUsageFlags usage,
+                      std::uint32_t preferred_type,
+                      VkMemoryPropertyFlags required, VkBuffer* buffer,
+                      MemoryAllocation* allocation,
+                      const std::vector<std::uint32_t>& queue_families = {});
+    void DestroyBuffer(VkBuffer* buffer, MemoryAllocation* allocation);
+    // The same for an optimal-tiling image.
+    void CreateImage(const VkImageCreateInfo& image_info,
+                     std::uint32_t preferred_type,
+                     VkMemoryPropertyFlags required, VkImage* image,
+                     MemoryAllocation* allocation);
+    void DestroyImage(VkImage* image, MemoryAllocation* allocation);
+
+    // Makes host writes to [offset, offset + size) of a host-visible
+    // allocation visible to the device. Does nothing for coherent memory.
+    void Flush(const MemoryAllocation& allocation, VkDeviceSize offset,
+               VkDeviceSize size) const;
+
+    // Plans moving candidates out of the least used block of each pool into
+    // the free space of its other blocks, at most max_bytes in total, and
+    // reserves the destinations. The caller recreates each resource at its
+    // destination and copies the contents over (e.g. vkCmdCopyBuffer from
+    // the old buffer), then calls CommitDefragmentation once the copies have
+    // completed.
+    std::vector<DefragmentationMove> PlanDefragmentation(
+        const std::vector<MemoryAllocation*>& candidates,
+        VkDeviceSize max_bytes);
+    // Frees the sources of the moves, points their allocations at the
+    // destinations and releases the blocks that became empty.
+    void CommitDefragmentation(const std::vector<DefragmentationMove>& moves);
+
+    MemoryStats Stats() const;
+    void LogStats(const char* label) const;
+
+    VkDeviceSize BufferAlignment(VkBufferUsageFlags usage) const;
+
+  private:
+    struct Block
+    {
+        VkDeviceMemory memory;
+        quint8* mapped;
+        std::unique_ptr<TlsfAllocator> ranges;
+        std::uint32_t memory_type;
+        ResourceKind kind;
+    };
+
+    // Smaller than block_size_ on small heaps, so they are not used up by
+    // a single block.
+    VkDeviceSize BlockSize(std::uint32_t memory_type) const;
+    bool AllocateDedicated(VkDeviceSize size, std::uint32_t memory_type,
+                           MemoryAllocation* allocation);
+    // Allocates from an existing block of the pool.
+    bool AllocateFromBlocks(VkDeviceSize size, VkDeviceSize alignment,
+                            std::uint32_t memory_type, ResourceKind kind,
+                            MemoryAllocation* allocation);
+    // Points allocation at the range of the block at offset.
+    void AssignBlockRange(std::int32_t block, VkDeviceSize offset,
+                          VkDeviceSize size, VkDeviceSize alignment,
+                          MemoryAllocation* allocation) const;
+    // Returns the new block's index, or -1 when out of memory.
+    std::int32_t CreateBlock(std::uint32_t memory_type, ResourceKind kind);
+    void FreeBlock(std::int32_t index);
+    // Whether other blocks of the same pool are left.
+    bool HasSiblingBlock(std::int32_t index) const;
+    bool IsCoherent(std::uint32_t memory_type) const;
+
+    QVulkanDeviceFunctions* device_functions_;
+    VkDevice device_;
+    VkPhysicalDeviceLimits limits_;
+    VkPhysicalDeviceMemoryProperties memory_properties_;
+    VkDeviceSize block_size_;
+    std::vector<Block> blocks_;  // freed blocks stay as empty entries
+    std::size_t dedicated_count_;
+    VkDeviceSize dedicated_bytes_;
+};
+
+// Per-frame transient data: a host-visible buffer with one region per
+// frame in flight, handed out by a LinearAllocator that starts over when the
+// frame's slot comes around again. No per-object bookkeeping, nothing to
+// free.
+class FrameArena
+{
+  public:
+    FrameArena();
+
+    void Create(DeviceMemoryAllocator* allocator, VkBufferUsageFlags usage,
+                std::uint32_t preferred_type, VkDeviceSize frame_size,
+                int frame_count);
+    void Release();
+
+    // Starts the frame's region over. Its previous contents must no longer
+    // be in use by the device.
+    void BeginFrame(int frame);
+    // Offset into buffer() of size bytes in the current frame's region,
+    // aligned for the buffer's usage, or invalid_offset if the region is
+    // full. *data points at them.
+    VkDeviceSize Allocate(VkDeviceSize size, void** data);
+    // Makes everything allocated in the current frame visible to the device.
+    void Flush() const;
+
+    VkBuffer buffer() const { return buffer_; }
+    VkDeviceSize used_bytes() const { return arena_.used_bytes(); }
+
+  private:
+    DeviceMemoryAllocator* allocator_;
+    VkBuffer buffer_;
+    MemoryAllocation allocation_;
+    VkDeviceSize alignment_;
+    VkDeviceSize region_stride_;
+    VkDeviceSize region_offset_;
+    LinearAllocator arena_;
+};
+
+#endif  // VULKAN_QT_INCLUDE_DEVICE_MEMORY_ALLOCATOR_H
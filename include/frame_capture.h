@@ -0,0 +1,62 @@
+#ifndef VULKAN_QT_INCLUDE_FRAME_CAPTURE_H
+#define VULKAN_QT_INCLUDE_FRAME_CAPTURE_H
+
+#include <QtCore/QSize>
+#include <QtGui/QImage>
+#include <QtGui/QVulkanFunctions>
+#include <vector>
+
+#include "frame_writer.h"
+#include "mapped_ring_buffer.h"
+
+// Captures the frames of a window (--output) without stalling it: every
+// frame's image is copied into its own slot of a host-visible ring behind
+// the render pass, and the slot is only read when the frame slot comes
+// around again, after QVulkanWindow has waited for that frame's fence.
+// The pixels then go to a FrameWriter that encodes them on its own thread;
+// frames it has no room for are dropped and counted, never waited for.
+class FrameCapture
+{
+  public:
+    FrameCapture();
+
+    // Images of size in format, with one readback slot per frame in
+    // flight. Returns false for formats other than 8-bit RGBA/BGRA, in
+    // which case nothing is captured.
+    bool Create(QVulkanDeviceFunctions* device_functions, VkDevice device,
+                const VkPhysicalDeviceProperties& device_properties,
+                std::uint32_t host_visible_index,
+                VkMemoryPropertyFlags host_visible_flags, int frame_count,
+                const QSize& size, VkFormat format, FrameWriter* writer);
+    // The device has to be idle. Hands the outstanding frames to the
+    // writer, oldest first.
+    void Release();
+
+    bool enabled() const { return writer_ != nullptr; }
+
+    // Hands the frame captured in this slot last time around to the writer.
+    // The slot's previous submission has to be complete.
+    void Collect(int frame);
+    // Records the copy of image, which the render pass left in layout, into
+    // the frame's slot. Returns it to that layout afterwards. Outside of a
+    // render pass.
+    void Record(VkCommandBuffer command_buffer, int frame, VkImage image,
+                VkImageLayout layout);
+
+    // host-visible memory of the ring
+    VkDeviceSize ring_bytes() const
+    {
+        return readback_ring_.slot_stride() * readback_ring_.slot_count();
+    }
+
+  private:
+    QVulkanDeviceFunctions* device_functions_;
+    QSize size_;
+    QImage::Format image_format_;
+    FrameWriter* writer_;
+    MappedRingBuffer readback_ring_;
+    std::vector<int> pending_;  // frame number in each slot, or -1
+    int frame_number_;
+};
+
+#endif  // VULKAN_QT_INCLUDE_FRAME_CAPTURE_H
@@ -0,0 +1,109 @@
+#ifndef VULKAN_QT_INCLUDE_FRAME_PROFILER_H
+#define VULKAN_QT_INCLUDE_FRAME_PROFILER_H
+
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QString>
+#include <QtGui/QVulkanFunctions>
+#include <fstream>
+#include <memory>
+#include <vector>
+
+#include "frame_stats.h"
+#include "renderer_options.h"
+
+// Per-frame CPU section timers and GPU timestamps around the render pass.
+// Every concurrent frame has its own pair of timestamp queries. They are
+// read without waiting when the frame slot is recorded again, at which
+// point its previous submission has already completed, so profiling never
+// stalls the GPU. Frame time percentiles are kept over a rolling window and
+// the timings go to the log, a CSV file or a Chrome trace.
+class FrameProfiler
+{
+  public:
+    enum class Section
+    {
+        kCull,
+        kRecord,
+        kSubmit
+    };
+
+    // Adds the time until it goes out of scope to a section of the frame.
+    class ScopedTimer
+    {
+      public:
+        ScopedTimer(FrameProfiler* profiler, Section section);
+        ~ScopedTimer();
+
+      private:
+        FrameProfiler* profiler_;
+        Section section_;
+        QElapsedTimer timer_;
+    };
+
+    FrameProfiler();
+    ~FrameProfiler();
+
+    void Create(QVulkanFunctions* functions,
+                QVulkanDeviceFunctions* device_functions,
+                VkPhysicalDevice physical_device, VkDevice device,
+                const VkPhysicalDeviceProperties& device_properties,
+                int frame_count, ProfileOutput output, const QString& path);
+    // The device has to be idle. Reports the remaining frames and a summary.
+    void Release();
+
+    bool enabled() const { return output_ != ProfileOutput::kNone; }
+
+    // Starts the CPU timings of the frame, before anything is recorded.
+    void BeginFrame(int frame);
+    // Records the start timestamp right before the render pass, so compute
+    // work recorded ahead of it (culling, particles) is not part of gpu_ms.
+    void BeginRenderPass(VkCommandBuffer command_buffer, int frame);
+    // Records the end timestamp, right after the render pass.
+    void EndFrame(VkCommandBuffer command_buffer, int frame);
+
+    // How many of the current frame's objects passed culling.
+    void SetVisibility(std::size_t visible, std::size_t total);
+
+    // Also passes every reported frame to sink, which is not owned, until
+    // Release.
+    void SetReportSink(TimingSink* sink) { report_sink_ = sink; }
+
+    const RollingPercentiles& frame_times() const { return frame_times_; }
+    const RollingPercentiles& gpu_times() const { return gpu_times_; }
+
+  private:
+    struct Slot
+    {
+        FrameTimings timings;
+        bool pending;  // recorded but not reported yet
+        bool has_queries;
+    };
+
+    void AddTime(Section section, double ms);
+    void Report(Slot* slot);
+    void LogSummary(const char* prefix) const;
+
+    QVulkanDeviceFunctions* device_functions_;
+    VkDevice device_;
+    ProfileOutput output_;
+    VkQueryPool query_pool_;
+    double timestamp_period_ns_;
+    std::uint64_t timestamp_mask_;
+
+    std::vector<Slot> slots_;
+    int current_slot_;
+    std::int64_t frame_number_;
+    QElapsedTimer clock_;
+    double last_begin_us_;
+    double last_log_us_;
+
+    RollingPercentiles frame_times_;
+    RollingPercentiles gpu_times_;
+    RollingPercentiles cull_times_;
+    double visible_ratio_;  // of the last reported frame, negative if none
+    std::ofstream file_;
+    std::unique_ptr<TimingSink> sink_;
+    TimingSink* report_sink_;
+};
+
+#endif  // VULKAN_QT_INCLUDE_FRAME_PROFILER_H
@@ -0,0 +1,111 @@
+#ifndef VULKAN_QT_INCLUDE_FRAME_STATS_H
+#define VULKAN_QT_INCLUDE_FRAME_STATS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// CPU and GPU timings of one frame. GPU times are only known once the
+// frame's slot is reused, so a frame is reported a few frames late.
+struct FrameTimings
+{
+    std::int64_t frame{0};
+    double begin_us{0.0};   // CPU frame start since the profiler started
+    double frame_ms{0.0};   // CPU time since the previous frame started
+    double record_ms{0.0};  // recording the command buffer
+    double submit_ms{0.0};  // frameReady(), i.e. submit (and present)
+    double gpu_ms{-1.0};    // render pass on the GPU, negative if unknown
+    double cull_ms{0.0};    // frustum culling and LOD selection
+    // fraction of the objects that passed culling, negative if not culled
+    double visible_ratio{-1.0};
+};
+
+// Percentiles over the last window_size values.
+class RollingPercentiles
+{
+  public:
+    explicit RollingPercentiles(std::size_t window_size);
+
+    void Add(double value);
+    // Nearest-rank percentile, percent in [0, 100]. 0 if empty.
+    double Percentile(double percent) const;
+    std::size_t size() const { return values_.size(); }
+
+  private:
+    std::vector<double> values_;
+    std::size_t window_size_;
+    std::size_t next_;
+};
+
+// Receives the timings of every profiled frame.
+class TimingSink
+{
+  public:
+    virtual ~TimingSink() = default;
+    virtual void Add(const FrameTimings& timings) = 0;
+};
+
+// One CSV row per frame, with a header row.
+class CsvTimingSink : public TimingSink
+{
+  public:
+    explicit CsvTimingSink(std::ostream* out);
+    void Add(const FrameTimings& timings) override;
+
+  private:
+    std::ostream* out_;
+};
+
+// Chrome trace event JSON (chrome://tracing, Perfetto). CPU sections go on
+// one track and GPU render passes on another, placed at their frame's
+// submit since CPU and GPU clocks are not correlated.
+class ChromeTraceSink : public TimingSink
+{
+  public:
+    explicit ChromeTraceSink(std::ostream* out);
+    // Closes the JSON array.
+    ~ChromeTraceSink() override;
+    void Add(const FrameTimings& timings) override;
+
+  private:
+    void AddEvent(const char* name, int track, double begin_us,
+                  double duration_us, std::int64_t frame);
+
+    std::ostream* out_;
+    bool first_event_;
+};
+
+// Summary of a benchmark run as JSON (see benchmark/render_suite.py): mean,
+// nearest-rank percentiles and maximum of every timing over all frames but
+// the first warmup_frames (also written, so readers can tell why a short
+// run has no timings), plus the parameters of the scene and other metrics
+// such as memory usage. Keys come in a fixed order, timings with
+// a fixed precision and metrics as integers, so reports of the same scene
+// diff cleanly.
+class BenchmarkReport : public TimingSink
+{
+  public:
+    explicit BenchmarkReport(std::int64_t warmup_frames);
+    void Add(const FrameTimings& timings) override;
+
+    void SetParameter(const std::string& name, const std::string& value);
+    void SetMetric(const std::string& name, std::uint64_t value);
+    std::size_t frame_count() const { return frame_ms_.size(); }
+
+    void Write(std::ostream* out) const;
+
+  private:
+    std::int64_t warmup_frames_;
+    std::vector<double> frame_ms_;
+    std::vector<double> gpu_ms_;
+    std::vector<double> record_ms_;
+    std::vector<double> submit_ms_;
+    std::vector<double> cull_ms_;
+    std::map<std::string, std::string> parameters_;
+    std::map<std::string, std::uint64_t> metrics_;
+};
+
+#endif  // VULKAN_QT_INCLUDE_FRAME_STATS_H
@@ -0,0 +1,69 @@
+#ifndef VULKAN_QT_INCLUDE_FRAME_WRITER_H
+#define VULKAN_QT_INCLUDE_FRAME_WRITER_H
+
+#include <QtCore/QFile>
+#include <QtCore/QSize>
+#include <QtCore/QString>
+#include <QtGui/QImage>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// Writes frames as numbered image files (frame_00000.ppm, ...), or into one
+// raw video file (video.y4m), on a background thread, so the render loop
+// only pays for queueing them.
+class FrameWriter
+{
+  public:
+    // format is "y4m" or anything QImageWriter supports, e.g. "ppm" or
+    // "png". At most max_queued frames wait for the writer thread.
+    // frame_rate only goes into the y4m header.
+    FrameWriter(const QString& directory, const QString& format,
+                int max_queued, int frame_rate = 60);
+    // Writes all queued frames before returning, and logs how many were
+    // written and dropped.
+    ~FrameWriter();
+
+    FrameWriter(const FrameWriter&) = delete;
+    FrameWriter& operator=(const FrameWriter&) = delete;
+
+    // Blocks while the queue is full.
+    void Write(int index, QImage image);
+    // Never blocks: drops the frame and returns false while the queue is
+    // full. image may point into memory that is only valid for the call, it
+    // is only copied once the frame is accepted.
+    bool TryWrite(int index, const QImage& image);
+
+    int dropped() const;
+
+  private:
+    void Run();
+    // Appends a frame to the video, starting a new file (video_1.y4m, ...)
+    // whenever the size changes, since y4m cannot.
+    void WriteY4m(const QImage& image);
+
+    const QString directory_;
+    const QString format_;
+    const std::size_t max_queued_;
+    const int frame_rate_;
+
+    // writer thread only
+    QFile video_;
+    QSize video_size_;
+    int video_segment_;
+    std::vector<std::uint8_t> video_frame_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable queue_changed_;
+    std::deque<std::pair<int, QImage>> queue_;
+    int queued_;
+    int dropped_;
+    bool stopping_;
+    std::thread thread_;
+};
+
+#endif  // VULKAN_QT_INCLUDE_FRAME_WRITER_H
@@ -0,0 +1,67 @@
+#ifndef VULKAN_QT_INCLUDE_GEOMETRY_H
+#define VULKAN_QT_INCLUDE_GEOMETRY_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Number of floats per vertex: position (x, y, z), normal (nx, ny, nz) and
+// color (r, g, b).
+constexpr std::size_t vertex_float_count{9};
+constexpr std::size_t vertex_normal_offset{3};
+constexpr std::size_t vertex_color_offset{6};
+
+struct MeshData
+{
+    std::vector<float> vertices;  // vertex_float_count floats per vertex
+    std::vector<std::uint32_t> indices;
+
+    std::size_t VertexBytes() const { return vertices.size() * sizeof(float); }
+    std::size_t IndexBytes() const
+    {
+        return indices.size() * sizeof(std::uint32_t);
+    }
+};
+
+// Index range of one level of detail, when all LODs of a mesh share one
+// vertex and one index buffer.
+struct MeshLod
+{
+    std::uint32_t first_index;
+    std::uint32_t index_count;
+    std::int32_t vertex_offset;
+};
+
+// Sphere around the axis-aligned bounds of vertex_count vertices, which are
+// laid out like MeshData::vertices.
+struct BoundingSphere
+{
+    float center[3];
+    float radius;
+};
+BoundingSphere ComputeBoundingSphere(const float* vertices,
+                                     std::size_t vertex_count);
+
+// Upper bound of CreateTriangleGrid's subdivisions: 3 * 2^30 indices and
+// about 2^29 vertices, both still addressable with 32 bits (and the index
+// count with vkCmdDrawIndexed's uint32 indexCount).
+constexpr int max_grid_subdivisions{32768};
+
+// The RGB triangle split into subdivisions^2 smaller triangles, with the
+// colors interpolated across it. subdivisions = 1 gives the plain triangle,
+// it is clamped to [1, max_grid_subdivisions].
+MeshData CreateTriangleGrid(int subdivisions);
+
+// Per-instance vertex attributes, read at VK_VERTEX_INPUT_RATE_INSTANCE.
+struct InstanceData
+{
+    float model[16];  // column-major model matrix
+    float color[4];   // multiplied with the vertex color
+};
+
+// count copies of the mesh scaled down onto a square grid that covers the
+// area of the plain triangle, each with its own tint. A single instance is
+// the untransformed, untinted mesh.
+std::vector<InstanceData> CreateInstanceGrid(int count);
+
+#endif  // VULKAN_QT_INCLUDE_GEOMETRY_H
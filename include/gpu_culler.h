@@ -0,0 +1,140 @@
+#ifndef VULKAN_QT_INCLUDE_GPU_CULLER_H
+#define VULKAN_QT_INCLUDE_GPU_CULLER_H
+
+#include <QtGui/QVulkanFunctions>
+#include <QtGui/QVulkanInstance>
+#include <cstdint>
+#include <glm/mat4x4.hpp>
+#include <vector>
+
+#include "geometry.h"
+#include "mapped_ring_buffer.h"
+#include "visibility.h"
+
+// GPU-driven drawing: a compute shader (shaders/cull.comp) culls the object
+// bounding spheres against the frustum, picks their LODs and writes one
+// VkDrawIndexedIndirectCommand per object into a device-local buffer, which
+// the render pass draws with a single indirect call. The CPU cost no longer
+// grows with the number of objects.
+//
+// With VK_KHR_draw_indirect_count the commands of visible objects are
+// compacted and counted on the GPU. Without it every object keeps its
+// command, with no instances when culled. Without multiDrawIndirect the
+// commands are drawn one call each, which is correct but not fast.
+//
+// With verification, every frame's commands are copied back and compared
+// against VisibilityCuller on the same input once the frame slot comes
+// around again, so it never stalls the GPU.
+class GpuCuller
+{
+  public:
+    GpuCuller();
+
+    // object_count objects, drawn at lods (finest first, at most 4) with
+    // firstInstance = object index. Returns false if the compute pipeline
+    // cannot be created, in which case the culler stays disabled.
+    bool Create(QVulkanInstance* instance, VkPhysicalDevice physical_device,
+                VkDevice device,
+                const VkPhysicalDeviceProperties& device_properties,
+                std::uint32_t host_visible_index,
+                std::uint32_t device_local_index, int frame_count,
+                std::size_t object_count, const std::vector<MeshLod>& lods,
+                bool draw_indirect_count, bool multi_draw_indirect,
+                bool verify, VkShaderModule shader,
+                VkPipelineCache pipeline_cache);
+    // The device has to be idle. Checks the outstanding verifications.
+    void Release();
+
+    bool enabled() const { return pipeline_ != VK_NULL_HANDLE; }
+
+    // Replaces the bounding spheres, which have to keep their count. Copied
+    // into each frame's slot when that frame is recorded next.
+    void SetBounds(const BoundingSpheres& spheres);
+    // Replaces the LOD index ranges, e.g. as a streamed mesh grows.
+    void SetLods(const std::vector<MeshLod>& lods);
+
+    // Records the culling dispatch for a frame. Outside of a render pass.
+    void Record(VkCommandBuffer command_buffer, int frame,
+                const glm::mat4& view_projection,
+                const CullSettings& settings);
+    // Records the indirect draws of the frame's commands, inside the render
+    // pass with the graphics pipeline and vertex/index buffers bound.
+    void Draw(VkCommandBuffer command_buffer, int frame);
+
+    std::uint64_t verified_frames() const { return verified_frames_; }
+    std::uint64_t mismatched_frames() const { return mismatched_frames_; }
+
+  private:
+    // Uniform block of cull.comp in std140 layout.
+    struct Params
+    {
+        float planes[6][4];
+        float w_row[4];
+        float lod_pixels[4];
+        std::uint32_t lods[4][4];  // first_index, index_count, vertex_offset
+        float row1_length;
+        float viewport_height;
+        float min_pixels;
+        std::uint32_t object_count;
+        std::uint32_t lod_count;
+        std::uint32_t compact;
+        std::uint32_t padding[2];
+    };
+
+    // What a frame was culled with, to recompute it on the CPU.
+    struct Verification
+    {
+        bool pending;
+        glm::mat4 view_projection;
+        CullSettings settings;
+        std::uint64_t bounds_version;
+    };
+
+    void CreateDescriptors();
+    void CreatePipeline(VkShaderModule shader, VkPipelineCache cache);
+    void CreateDrawBuffer(const VkPhysicalDeviceMemoryProperties& memory,
+                          std::uint32_t device_local_index);
+    // Compares the frame's read back commands with the CPU reference.
+    void Verify(int frame);
+
+    QVulkanDeviceFunctions* device_functions_;
+    VkDevice device_;
+    PFN_vkCmdDrawIndexedIndirectCountKHR draw_indexed_indirect_count_;
+    bool multi_draw_indirect_;
+    std::uint32_t max_draw_count_;  // per indirect call
+    bool compact_;
+
+    std::size_t object_count_;
+    std::vector<MeshLod> lods_;
+
+    // per-frame parameters and bounds (center, radius) in host-visible
+    // rings, the commands in one device-local buffer with a region per frame
+    MappedRingBuffer params_ring_;
+    MappedRingBuffer bounds_ring_;
+    std::vector<float> bounds_;
+    std::uint32_t bounds_dirty_frames_;  // bit i: slot i needs bounds_
+    std::uint64_t bounds_version_;
+    VkBuffer draw_buffer_;
+    VkDeviceMemory draw_memory_;
+    VkDeviceSize draw_region_size_;
+    VkDeviceSize draw_region_stride_;
+
+    VkDescriptorPool descriptor_pool_;
+    VkDescriptorSetLayout descriptor_set_layout_;
+    VkDescriptorSet descriptor_set_;
+    VkPipelineLayout pipeline_layout_;
+    VkPipeline pipeline_;
+
+    // verification: readback slots and the CPU reference
+    bool verify_;
+    MappedRingBuffer readback_ring_;
+    std::vector<Verification> verifications_;
+    BoundingSpheres spheres_;
+    VisibilityCuller reference_culler_;
+    std::vector<VisibleObject> expected_;
+    std::vector<VisibleObject> actual_;
+    std::uint64_t verified_frames_;
+    std::uint64_t mismatched_frames_;
+};
+
+#endif  // VULKAN_QT_INCLUDE_GPU_CULLER_H
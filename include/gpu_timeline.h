@@ -0,0 +1,75 @@
+#ifndef VULKAN_QT_INCLUDE_GPU_TIMELINE_H
+#define VULKAN_QT_INCLUDE_GPU_TIMELINE_H
+
+#include <QtGui/QVulkanFunctions>
+#include <QtGui/QVulkanInstance>
+#include <deque>
+#include <vector>
+
+// Tracks the completion of the submissions to a queue as a value that grows
+// by one with every submission. A resource remembers the value of the last
+// submission that used it and can be reused once that value is complete,
+// without a fence per resource.
+//
+// With VK_KHR_timeline_semaphore every submission signals its value on a
+// timeline semaphore, which submissions to other queues can wait for.
+// Without it every submission gets a fence from a pool instead, and waits
+// for other timelines happen on the CPU before submitting.
+class GpuTimeline
+{
+  public:
+    // Makes a submission wait for value on timeline before stage.
+    struct Wait
+    {
+        GpuTimeline* timeline;
+        std::uint64_t value;
+        VkPipelineStageFlags stage;
+    };
+
+    GpuTimeline();
+
+    // timeline_semaphore: VK_KHR_timeline_semaphore is enabled on device.
+    void Create(QVulkanInstance* instance, VkDevice device,
+                bool timeline_semaphore);
+    // Waits for all submissions.
+    void Release();
+
+    // Submits the command buffers after the waits, returns the value that
+    // is complete once they are.
+    std::uint64_t Submit(VkQueue queue, const VkCommandBuffer* command_buffers,
+                         std::uint32_t command_buffer_count,
+                         const std::vector<Wait>& waits = {});
+
+    // Highest value whose submission (and all before it) completed.
+    std::uint64_t CompletedValue();
+    bool IsComplete(std::uint64_t value) { return value <= CompletedValue(); }
+    // Blocks until value is complete.
+    void WaitFor(std::uint64_t value);
+
+    bool timeline_semaphore() const { return semaphore_ != VK_NULL_HANDLE; }
+    std::uint64_t submitted_value() const { return submitted_value_; }
+
+  private:
+    struct FencedSubmission
+    {
+        std::uint64_t value;
+        VkFence fence;
+    };
+
+    // Fence fallback: retires the submissions whose fences signaled, or
+    // waits for the ones up to value.
+    void RetireFences(std::uint64_t wait_value);
+    VkFence AcquireFence();
+
+    QVulkanDeviceFunctions* device_functions_;
+    VkDevice device_;
+    VkSemaphore semaphore_;
+    PFN_vkGetSemaphoreCounterValueKHR get_semaphore_counter_value_;
+    PFN_vkWaitSemaphoresKHR wait_semaphores_;
+    std::uint64_t submitted_value_;
+    std::uint64_t completed_value_;  // as of the last query
+    std::deque<FencedSubmission> in_flight_;
+    std::vector<VkFence> free_fences_;
+};
+
+#endif  // VULKAN_QT_INCLUDE_GPU_TIMELINE_H
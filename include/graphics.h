@@ -3,7 +3,12 @@
 
 #include <glm/mat4x4.hpp>
 
+glm::mat4 GetProjectionMatrix(const float aspect);
+
+glm::mat4 GetViewMatrix(const float translate_z, const float rotate_x,
+                        const float rotate_y);
+
 glm::mat4 GetMVPMatrix(const float aspect, const float translate_z,
                        const float rotate_x, const float rotate_y);
 
-#endif  // VULKAN_QT_INCLUDE_GRAPHICS_H
\ No newline at end of file
+#endif  // VULKAN_QT_INCLUDE_GRAPHICS_H
@@ -0,0 +1,55 @@
+#ifndef VULKAN_QT_INCLUDE_MAPPED_RING_BUFFER_H
+#define VULKAN_QT_INCLUDE_MAPPED_RING_BUFFER_H
+
+#include <QtGui/QVulkanFunctions>
+
+// A host-visible buffer split into slot_count equally sized slots, one per
+// frame in flight, that stays mapped for its whole lifetime. Slots are
+// aligned for use as dynamic uniform/storage buffer offsets and to the
+// non-coherent atom size, so a slot can be flushed on its own when the
+// memory type is not host-coherent.
+class MappedRingBuffer
+{
+  public:
+    MappedRingBuffer();
+
+    void Create(QVulkanDeviceFunctions* device_functions, VkDevice device,
+                const VkPhysicalDeviceProperties& device_properties,
+                std::uint32_t memory_index, VkMemoryPropertyFlags memory_flags,
+                VkBufferUsageFlags usage, VkDeviceSize slot_size,
+                int slot_count);
+    void Release();
+
+    quint8* Slot(int slot) const { return mapped_ + SlotOffset(slot); }
+    VkDeviceSize SlotOffset(int slot) const { return slot * slot_stride_; }
+
+    // Makes host writes to [offset, offset + size) of the slot visible to
+    // the device. Does nothing for coherent memory.
+    void Flush(int slot, VkDeviceSize offset, VkDeviceSize size) const;
+    // Makes device writes to [offset, offset + size) of the slot visible to
+    // the host, for readbacks. Does nothing for coherent memory.
+    void Invalidate(int slot, VkDeviceSize offset, VkDeviceSize size) const;
+
+    VkBuffer buffer() const { return buffer_; }
+    VkDeviceSize slot_size() const { return slot_size_; }
+    VkDeviceSize slot_stride() const { return slot_stride_; }
+    int slot_count() const { return slot_count_; }
+
+  private:
+    // [offset, offset + size) of the slot, rounded out to whole atoms
+    VkMappedMemoryRange AtomRange(int slot, VkDeviceSize offset,
+                                  VkDeviceSize size) const;
+
+    QVulkanDeviceFunctions* device_functions_;
+    VkDevice device_;
+    VkBuffer buffer_;
+    VkDeviceMemory memory_;
+    quint8* mapped_;
+    bool coherent_;
+    VkDeviceSize atom_size_;
+    VkDeviceSize slot_size_;
+    VkDeviceSize slot_stride_;
+    int slot_count_;
+};
+
+#endif  // VULKAN_QT_INCLUDE_MAPPED_RING_BUFFER_H
@@ -0,0 +1,35 @@
+#ifndef VULKAN_QT_INCLUDE_MATERIALS_H
+#define VULKAN_QT_INCLUDE_MATERIALS_H
+
+#include <cstdint>
+#include <vector>
+
+// One entry of the material table, laid out like the std430 struct the
+// fragment shader reads.
+struct MaterialData
+{
+    float tint[4];          // multiplied with the texture
+    std::uint32_t texture;  // slot in the bindless texture table
+    std::uint32_t padding[3];
+};
+
+// Material textures are small RGBA8 squares.
+constexpr int material_texture_size{16};
+constexpr int max_material_textures{256};
+
+// count materials over texture_count textures, each with its own tint.
+// Material 0 is untinted and uses texture 0, which is plain white, so a
+// scene with a single material looks the same as without materials.
+std::vector<MaterialData> CreateMaterials(int count, int texture_count);
+
+// The material_texture_size^2 RGBA8 texels of texture index: white for 0,
+// checkerboards of varying cell size and contrast otherwise.
+std::vector<std::uint8_t> CreateMaterialTexture(int index);
+
+// Instances get their materials in contiguous runs of this many, so that
+// instance i uses material i / InstancesPerMaterial(...) and instanced
+// draws only have to be split where the material changes.
+std::uint32_t InstancesPerMaterial(std::uint32_t instance_count,
+                                   std::uint32_t material_count);
+
+#endif  // VULKAN_QT_INCLUDE_MATERIALS_H
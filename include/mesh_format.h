@@ -0,0 +1,90 @@
+#ifndef VULKAN_QT_INCLUDE_MESH_FORMAT_H
+#define VULKAN_QT_INCLUDE_MESH_FORMAT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "geometry.h"
+
+// Binary mesh file, little-endian:
+//
+//   MeshFileHeader
+//   vertices  vertex_count * vertex_stride bytes, see geometry.h
+//   indices   index_count * uint32, absolute vertex indices
+//   meshlets  meshlet_count * Meshlet
+//
+// Every section starts at a multiple of mesh_section_alignment, so the
+// sections of a memory-mapped file can be used in place. Meshlets are
+// stored in file order and each one only references its own vertex range,
+// so any prefix of the meshlets can be drawn with one indexed draw of the
+// matching prefix of the index section.
+constexpr std::uint32_t mesh_file_magic{0x464d5156};  // "VQMF"
+constexpr std::uint32_t mesh_file_version{1};
+constexpr std::size_t mesh_section_alignment{256};
+
+// Meshlet limits used by the writer.
+constexpr std::uint32_t meshlet_max_vertices{64};
+constexpr std::uint32_t meshlet_max_triangles{124};
+
+struct MeshFileHeader
+{
+    std::uint32_t magic;
+    std::uint32_t version;
+    std::uint32_t vertex_stride;  // bytes per vertex
+    std::uint32_t meshlet_count;
+    std::uint64_t vertex_count;
+    std::uint64_t index_count;
+    std::uint64_t vertex_offset;  // byte offsets from the start of the file
+    std::uint64_t index_offset;
+    std::uint64_t meshlet_offset;
+    float bounds_min[3];
+    float bounds_max[3];
+};
+static_assert(sizeof(MeshFileHeader) == 80, "MeshFileHeader is on disk");
+
+struct Meshlet
+{
+    std::uint32_t first_vertex;
+    std::uint32_t vertex_count;
+    std::uint32_t first_index;
+    std::uint32_t index_count;
+    float center[3];  // bounding sphere
+    float radius;
+};
+static_assert(sizeof(Meshlet) == 32, "Meshlet is on disk");
+
+// The sections of a mesh file in memory, pointing into the file data.
+struct MeshFileView
+{
+    const MeshFileHeader* header{nullptr};
+    const float* vertices{nullptr};
+    const std::uint32_t* indices{nullptr};
+    const Meshlet* meshlets{nullptr};
+};
+
+// Checks the header and that all sections lie within the size bytes at
+// data, which has to be aligned like a memory mapping, and that the
+// meshlets tile them in order. On failure returns false and describes the
+// problem in error.
+bool ParseMeshFile(const void* data, std::size_t size, MeshFileView* view,
+                   std::string* error);
+// Checks that the indices of one meshlet of a parsed file only reference
+// its own vertices, so its draws never fetch outside the vertex buffer.
+// Left out of ParseMeshFile to only touch the indices as they stream.
+bool CheckMeshletIndices(const MeshFileView& view, std::uint32_t meshlet,
+                         std::string* error);
+
+// Splits mesh into meshlets of at most meshlet_max_vertices vertices and
+// meshlet_max_triangles triangles, in index order. Vertices are reordered
+// and duplicated where meshlets share them, so each meshlet owns a
+// contiguous vertex range.
+std::vector<Meshlet> BuildMeshlets(MeshData* mesh);
+
+// Writes mesh and the meshlets built for it by BuildMeshlets.
+bool WriteMeshFile(const MeshData& mesh, const std::vector<Meshlet>& meshlets,
+                   std::ostream* out);
+
+#endif  // VULKAN_QT_INCLUDE_MESH_FORMAT_H
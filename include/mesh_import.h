@@ -0,0 +1,27 @@
+#ifndef VULKAN_QT_INCLUDE_MESH_IMPORT_H
+#define VULKAN_QT_INCLUDE_MESH_IMPORT_H
+
+#include <istream>
+#include <string>
+
+#include "geometry.h"
+
+// Readers for the mesh converter. Polygons are triangulated as fans.
+// Missing normals are computed by averaging the adjacent face normals,
+// missing colors are white. On failure they return false and describe the
+// problem in error.
+
+// Wavefront OBJ: v (with the common "v x y z r g b" color extension), vn
+// and f. Texture coordinates are ignored.
+bool LoadObj(std::istream& in, MeshData* mesh, std::string* error);
+
+// PLY, ascii or binary_little_endian: x, y, z, optionally nx, ny, nz and
+// red, green, blue of the vertex element, and the vertex_indices (or
+// vertex_index) list of the face element. Other elements are skipped.
+bool LoadPly(std::istream& in, MeshData* mesh, std::string* error);
+
+// Centers the mesh on the origin and scales it uniformly to fit into
+// [-0.5, 0.5]^3, the extent of the built-in triangle.
+void NormalizeMesh(MeshData* mesh);
+
+#endif  // VULKAN_QT_INCLUDE_MESH_IMPORT_H
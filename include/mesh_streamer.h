@@ -0,0 +1,62 @@
+#ifndef VULKAN_QT_INCLUDE_MESH_STREAMER_H
+#define VULKAN_QT_INCLUDE_MESH_STREAMER_H
+
+#include <QtCore/QFile>
+#include <QtGui/QVulkanFunctions>
+
+#include "mesh_format.h"
+#include "staging_uploader.h"
+
+// Streams a mesh file into device-local vertex and index buffers. The file
+// is memory-mapped and each chunk of meshlets is copied straight from the
+// mapping into the staging ring, so the mesh is never read into ordinary
+// memory. Meshlets become resident in file order, and since they only
+// reference their own vertices, the resident prefix of the index buffer can
+// be drawn while the rest is still streaming.
+class MeshStreamer
+{
+  public:
+    MeshStreamer();
+
+    // Maps and validates the file, warns and returns false on failure.
+    bool Open(const QString& path);
+    // Unmaps the file. The uploaded data stays valid.
+    void Close();
+    bool is_open() const { return mapped_ != nullptr; }
+
+    // Stages the next meshlets, at least one and otherwise up to budget
+    // bytes, for upload to the same offsets in vertex_buffer and
+    // index_buffer. The uploader still has to be flushed. Returns the
+    // number of bytes staged. If a meshlet of the chunk references vertices
+    // outside of it, warns, stages nothing and closes the file; the
+    // meshlets already resident stay drawable.
+    VkDeviceSize StreamNext(StagingUploader* uploader, VkBuffer vertex_buffer,
+                            VkBuffer index_buffer, VkDeviceSize budget);
+
+    // Only while the file is open.
+    const MeshFileHeader& header() const { return *view_.header; }
+    VkDeviceSize VertexBytes() const;
+    VkDeviceSize IndexBytes() const;
+
+    bool complete() const { return resident_meshlets_ == meshlet_count_; }
+    // StreamNext stopped at an invalid meshlet.
+    bool failed() const { return failed_; }
+    std::uint32_t meshlet_count() const { return meshlet_count_; }
+    std::uint32_t resident_meshlets() const { return resident_meshlets_; }
+    // Indices of the resident meshlets, all at the start of the buffer.
+    std::uint32_t resident_index_count() const
+    {
+        return resident_index_count_;
+    }
+
+  private:
+    QFile file_;
+    uchar* mapped_;
+    MeshFileView view_;
+    std::uint32_t meshlet_count_;
+    std::uint32_t resident_meshlets_;
+    std::uint32_t resident_index_count_;
+    bool failed_;
+};
+
+#endif  // VULKAN_QT_INCLUDE_MESH_STREAMER_H
@@ -0,0 +1,209 @@
+#ifndef VULKAN_QT_INCLUDE_OFFSCREEN_RENDER_TARGET_H
+#define VULKAN_QT_INCLUDE_OFFSCREEN_RENDER_TARGET_H
+
+#include <QtGui/QImage>
+#include <functional>
+#include <vector>
+
+#include "render_target.h"
+
+// Renders into offscreen images on its own device, without a window or a
+// swap chain. Every concurrent frame has its own color/depth images and a
+// host-visible readback buffer. Readback is asynchronous: the copy is
+// recorded behind the render pass, and the pixels are only picked up when
+// the frame slot comes around again and its submission has already
+// completed on the graphics timeline.
+//
+// Unlike QVulkanWindow, it keeps up to max_frames_in_flight frames in
+// flight, enables VK_KHR_timeline_semaphore where supported and, with it,
+// a transfer queue from a family without graphics.
+class OffscreenRenderTarget : public RenderTarget
+{
+  public:
+    // Receives the frame number and its pixels.
+    using FrameCallback = std::function<void(int, QImage)>;
+
+    // Without allow_timeline_semaphore the frames are tracked with fences
+    // and uploads stay on the graphics queue; allow_transfer_queue alone
+    // keeps them there. Both exist to compare the paths.
+    OffscreenRenderTarget(QVulkanInstance* instance, const QSize& size,
+                          int concurrent_frames,
+                          bool allow_timeline_semaphore = true,
+                          bool allow_transfer_queue = true);
+    ~OffscreenRenderTarget() override;
+
+    OffscreenRenderTarget(const OffscreenRenderTarget&) = delete;
+    OffscreenRenderTarget& operator=(const OffscreenRenderTarget&) = delete;
+
+    // Picks the physical device and creates the device, render pass and
+    // per-frame resources. Returns false if no usable device was found.
+    bool Create();
+    void Release();
+
+    // If set, every frame is read back and handed to the callback.
+    void SetFrameCallback(FrameCallback callback);
+
+    // Makes the next frame slot current and begins its command buffer.
+    void BeginFrame();
+    // Waits for all frames in flight and delivers their readbacks.
+    void Finish();
+
+    QVulkanInstance* vulkanInstance() const override { return instance_; }
+    VkPhysicalDevice physicalDevice() const override
+    {
+        return physical_device_;
+    }
+    const VkPhysicalDeviceProperties* physicalDeviceProperties() const override
+    {
+        return &physical_device_properties_;
+    }
+    VkDevice device() const override { return device_; }
+    VkQueue graphicsQueue() const override { return graphics_queue_; }
+    std::uint32_t graphicsQueueFamilyIndex() const override
+    {
+        return graphics_queue_family_;
+    }
+    VkCommandPool graphicsCommandPool() const override
+    {
+        return command_pool_;
+    }
+    std::uint32_t hostVisibleMemoryIndex() const override
+    {
+        return host_visible_memory_index_;
+    }
+    std::uint32_t deviceLocalMemoryIndex() const override
+    {
+        return device_local_memory_index_;
+    }
+    VkRenderPass defaultRenderPass() const override { return render_pass_; }
+    bool drawIndirectCountEnabled() const override
+    {
+        return draw_indirect_count_;
+    }
+    bool multiDrawIndirectEnabled() const override
+    {
+        return multi_draw_indirect_;
+    }
+    bool descriptorIndexingEnabled() const override
+    {
+        return descriptor_indexing_;
+    }
+    bool timelineSemaphoreEnabled() const override
+    {
+        return timeline_semaphore_;
+    }
+
+    VkQueue transferQueue() const override { return transfer_queue_; }
+    std::uint32_t transferQueueFamilyIndex() const override
+    {
+        return transfer_queue_family_;
+    }
+    VkCommandPool transferCommandPool() const override
+    {
+        return transfer_command_pool_;
+    }
+    void addFrameWait(const GpuTimeline::Wait& wait) override;
+
+    int concurrentFrameCount() const override
+    {
+        return static_cast<int>(frames_.size());
+    }
+    int currentFrame() const override { return current_frame_; }
+    VkCommandBuffer currentCommandBuffer() const override
+    {
+        return frames_[current_frame_].command_buffer;
+    }
+    VkFramebuffer currentFramebuffer() const override
+    {
+        return frames_[current_frame_].framebuffer;
+    }
+    QSize swapChainImageSize() const override { return size_; }
+    VkImage currentColorImage() const override
+    {
+        return frames_[current_frame_].color.image;
+    }
+    VkFormat colorFormat() const override { return color_format_; }
+    VkImageLayout colorImageLayout() const override
+    {
+        // for the readback behind the render pass
+        return VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    }
+
+    void frameReady() override;
+    void requestUpdate() override {}
+
+  private:
+    struct Image
+    {
+        VkImage image;
+        VkDeviceMemory memory;
+        VkImageView view;
+    };
+
+    struct Frame
+    {
+        Image color;
+        Image depth;
+        VkFramebuffer framebuffer;
+        VkBuffer readback_buffer;
+        VkDeviceMemory readback_memory;
+        const uchar* readback_data;
+        VkCommandBuffer command_buffer;
+        std::uint64_t submitted_value;  // on graphics_timeline_
+        int pending_readback;  // frame number in the buffer, or -1
+    };
+
+    bool PickPhysicalDevice();
+    void CreateDevice();
+    void CreateRenderPass();
+    void CreateFrame(Frame* frame);
+    void ReleaseFrame(Frame* frame);
+    Image CreateImage(VkFormat format, VkImageUsageFlags usage,
+                      VkImageAspectFlags aspect);
+    void ReleaseImage(Image* image);
+    void CollectReadback(Frame* frame);
+    std::uint32_t FindMemoryIndex(std::uint32_t type_bits,
+                                  VkMemoryPropertyFlags required,
+                                  VkMemoryPropertyFlags preferred) const;
+
+    QVulkanInstance* instance_;
+    QVulkanDeviceFunctions* device_functions_;
+    const QSize size_;
+    const int requested_frame_count_;
+    const bool allow_timeline_semaphore_;
+    const bool allow_transfer_queue_;
+
+    VkPhysicalDevice physical_device_;
+    VkPhysicalDeviceProperties physical_device_properties_;
+    VkPhysicalDeviceMemoryProperties memory_properties_;
+    std::uint32_t graphics_queue_family_;
+    VkDevice device_;
+    VkQueue graphics_queue_;
+    VkCommandPool command_pool_;
+    std::uint32_t host_visible_memory_index_;
+    std::uint32_t device_local_memory_index_;
+    bool readback_coherent_;
+    bool draw_indirect_count_;
+    bool multi_draw_indirect_;
+    bool descriptor_indexing_;
+    bool timeline_semaphore_;
+    // dedicated transfer queue, VK_NULL_HANDLE without one
+    std::uint32_t transfer_queue_family_;
+    VkQueue transfer_queue_;
+    VkCommandPool transfer_command_pool_;
+
+    // completion of the frames' submissions, which wait for frame_waits_
+    GpuTimeline graphics_timeline_;
+    std::vector<GpuTimeline::Wait> frame_waits_;
+
+    VkFormat color_format_;
+    VkFormat depth_format_;
+    VkRenderPass render_pass_;
+
+    std::vector<Frame> frames_;
+    int current_frame_;
+    int frame_number_;
+    FrameCallback frame_callback_;
+};
+
+#endif  // VULKAN_QT_INCLUDE_OFFSCREEN_RENDER_TARGET_H
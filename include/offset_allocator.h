@@ -0,0 +1,123 @@
+#ifndef VULKAN_QT_INCLUDE_OFFSET_ALLOCATOR_H
+#define VULKAN_QT_INCLUDE_OFFSET_ALLOCATOR_H
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+// Returned when an allocation does not fit.
+constexpr std::uint64_t invalid_offset{UINT64_MAX};
+
+// Two-level segregated fit (TLSF) allocator of ranges in [0, size). Only
+// offsets are handed out, the memory itself lives elsewhere, e.g. in a
+// VkDeviceMemory block. Free ranges are kept in lists binned by a power of
+// two and 16 linear steps within it, with bitmaps of the non-empty lists, so
+// both Allocate() and Free() run in constant time. Neighbouring free ranges
+// are merged right away.
+class TlsfAllocator
+{
+  public:
+    explicit TlsfAllocator(std::uint64_t size);
+
+    // Offset of size bytes aligned to alignment, a power of two, or
+    // invalid_offset if there is no free range large enough.
+    std::uint64_t Allocate(std::uint64_t size, std::uint64_t alignment = 1);
+    // Frees the allocation at offset, which Allocate() returned.
+    void Free(std::uint64_t offset);
+    // Size of the allocation at offset, 0 if there is none.
+    std::uint64_t AllocationSize(std::uint64_t offset) const;
+
+    std::uint64_t size() const { return size_; }
+    std::uint64_t used_bytes() const { return used_bytes_; }
+    std::uint64_t free_bytes() const { return size_ - used_bytes_; }
+    std::size_t allocation_count() const { return allocations_.size(); }
+    std::uint64_t LargestFreeRange() const;
+    // 0 if all free space is one range, towards 1 the more it is split up.
+    double Fragmentation() const;
+
+  private:
+    static constexpr int sl_count{16};
+    static constexpr int fl_count{61};
+    static constexpr std::uint32_t none{UINT32_MAX};
+
+    struct Range
+    {
+        std::uint64_t offset;
+        std::uint64_t size;
+        // neighbours in memory and in the free list, none if there is none
+        std::uint32_t previous;
+        std::uint32_t next;
+        std::uint32_t previous_free;
+        std::uint32_t next_free;
+        bool free;
+    };
+
+    std::uint32_t NewRange(std::uint64_t offset, std::uint64_t size);
+    void DeleteRange(std::uint32_t index);
+    void InsertFree(std::uint32_t index);
+    void RemoveFree(std::uint32_t index);
+    // Splits size bytes off the front of a range, returns the new range
+    // holding the rest.
+    std::uint32_t Split(std::uint32_t index, std::uint64_t size);
+    // Appends the next range in memory to index, and deletes it.
+    void Merge(std::uint32_t index, std::uint32_t next);
+
+    std::uint64_t size_;
+    std::uint64_t used_bytes_;
+    std::vector<Range> ranges_;
+    std::vector<std::uint32_t> unused_ranges_;
+    std::uint64_t fl_bitmap_;
+    std::uint32_t sl_bitmaps_[fl_count];
+    std::uint32_t heads_[fl_count][sl_count];
+    std::unordered_map<std::uint64_t, std::uint32_t> allocations_;
+};
+
+// Bump allocator of ranges in [0, size) that are all freed at once, for
+// data that only lives for one frame.
+class LinearAllocator
+{
+  public:
+    explicit LinearAllocator(std::uint64_t size = 0) : size_(size), top_(0)
+    {
+    }
+
+    // Offset of size bytes aligned to alignment, a power of two, or
+    // invalid_offset if the rest of the range is too small.
+    std::uint64_t Allocate(std::uint64_t size, std::uint64_t alignment = 1);
+    void Reset() { top_ = 0; }
+
+    std::uint64_t size() const { return size_; }
+    std::uint64_t used_bytes() const { return top_; }
+
+  private:
+    std::uint64_t size_;
+    std::uint64_t top_;
+};
+
+// An allocation of one of several TlsfAllocators, e.g. the blocks of a
+// memory pool, that PlanRangeMoves may move.
+struct MovableRange
+{
+    std::size_t block;  // index into the blocks
+    std::uint64_t size;
+    std::uint64_t alignment;
+};
+
+// Where PlanRangeMoves moves candidates[candidate].
+struct RangeMove
+{
+    std::size_t candidate;
+    std::size_t block;
+    std::uint64_t offset;
+};
+
+// Plans emptying the least used of blocks (null entries are skipped) into
+// the free space of the others: the candidates in it move, in order, until
+// max_bytes are planned, and their destinations are allocated. Candidates
+// in other blocks or without room elsewhere stay. The sources are left to
+// the caller to free once the contents have been copied over.
+std::vector<RangeMove> PlanRangeMoves(
+    const std::vector<TlsfAllocator*>& blocks,
+    const std::vector<MovableRange>& candidates, std::uint64_t max_bytes);
+
+#endif  // VULKAN_QT_INCLUDE_OFFSET_ALLOCATOR_H
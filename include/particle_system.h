@@ -0,0 +1,94 @@
+#ifndef VULKAN_QT_INCLUDE_PARTICLE_SYSTEM_H
+#define VULKAN_QT_INCLUDE_PARTICLE_SYSTEM_H
+
+#include <QtGui/QVulkanFunctions>
+#include <QtGui/QVulkanInstance>
+#include <cstdint>
+#include <vector>
+
+#include "device_memory_allocator.h"
+#include "mapped_ring_buffer.h"
+#include "particles.h"
+#include "staging_uploader.h"
+
+// Simulated particles (--particles) that never leave the GPU: a compute
+// shader (shaders/particles.comp) steps them in place in one device-local
+// buffer, which the render pass then binds as the vertex buffer of a point
+// list. Only the initial state is uploaded.
+//
+// Each frame's step waits for the previous frame's vertex fetches and
+// writes, and its writes are made visible to this frame's vertex input
+// stage, all with one buffer barrier on either side of the dispatch.
+//
+// With verification, a sample of the particles is copied back before and
+// after every step and compared against StepParticles once the frame slot
+// comes around again, so it never stalls the GPU.
+class ParticleSystem
+{
+  public:
+    ParticleSystem();
+
+    // count particles, seeded with SeedParticles and uploaded through
+    // uploader. Fewer if the device cannot address or dispatch that many.
+    // Returns false if the compute pipeline cannot be created, in which
+    // case the system stays disabled.
+    bool Create(QVulkanInstance* instance, VkDevice device,
+                const VkPhysicalDeviceProperties& device_properties,
+                DeviceMemoryAllocator* allocator, StagingUploader* uploader,
+                std::uint32_t device_local_index,
+                std::uint32_t host_visible_index,
+                VkMemoryPropertyFlags host_visible_flags, int frame_count,
+                std::size_t count, bool verify, VkShaderModule shader,
+                VkPipelineCache pipeline_cache);
+    // The device has to be idle. Checks the outstanding verifications.
+    void Release();
+
+    bool enabled() const { return pipeline_ != VK_NULL_HANDLE; }
+    std::size_t count() const { return count_; }
+
+    // Vertex input of the particle pipeline: binding 0 per vertex,
+    // position at location 0 and velocity at location 1.
+    static std::vector<VkVertexInputBindingDescription> VertexBindings();
+    static std::vector<VkVertexInputAttributeDescription> VertexAttributes();
+
+    // Records one step for a frame. Outside of a render pass.
+    void Record(VkCommandBuffer command_buffer, int frame);
+    // Draws the particles, inside the render pass with the particle
+    // pipeline bound.
+    void Draw(VkCommandBuffer command_buffer);
+
+    std::uint64_t verified_steps() const { return verified_steps_; }
+    std::uint64_t mismatched_steps() const { return mismatched_steps_; }
+
+  private:
+    void CreateDescriptors();
+    void CreatePipeline(VkShaderModule shader, VkPipelineCache cache);
+    // Compares the frame's read back sample with the CPU reference.
+    void Verify(int frame);
+
+    QVulkanDeviceFunctions* device_functions_;
+    VkDevice device_;
+    DeviceMemoryAllocator* allocator_;
+    std::size_t count_;
+    ParticleStep step_;
+
+    VkBuffer buffer_;
+    MemoryAllocation memory_;
+
+    VkDescriptorPool descriptor_pool_;
+    VkDescriptorSetLayout descriptor_set_layout_;
+    VkDescriptorSet descriptor_set_;
+    VkPipelineLayout pipeline_layout_;
+    VkPipeline pipeline_;
+
+    // verification: the first sample_count_ particles before and after the
+    // step, one readback slot per frame
+    bool verify_;
+    std::size_t sample_count_;
+    MappedRingBuffer readback_ring_;
+    std::vector<bool> pending_;
+    std::uint64_t verified_steps_;
+    std::uint64_t mismatched_steps_;
+};
+
+#endif  // VULKAN_QT_INCLUDE_PARTICLE_SYSTEM_H
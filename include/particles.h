@@ -0,0 +1,52 @@
+#ifndef VULKAN_QT_INCLUDE_PARTICLES_H
+#define VULKAN_QT_INCLUDE_PARTICLES_H
+
+#include <cstddef>
+#include <cstdint>
+
+// One particle of --particles in std430 layout. shaders/particles.comp
+// integrates them in place in a storage buffer, which particle.vert reads as
+// its vertex buffer: position at location 0, velocity at location 1.
+struct Particle
+{
+    float position[4];  // w unused
+    float velocity[4];  // w unused
+};
+
+// One simulation step, the push constants of particles.comp. Every particle
+// is pulled towards the attractor, its velocity damped, and it bounces off
+// the faces of the cube [-bound, bound]^3.
+struct ParticleStep
+{
+    float attractor[4];  // xyz, w: strength
+    float time_step;     // seconds
+    float damping;       // velocity factor per step
+    float softening;     // added to the squared distance to the attractor
+    float bound;
+    std::uint32_t count;
+    std::uint32_t padding[3];
+};
+
+// The defaults of the renderer, a fixed step so runs are repeatable.
+ParticleStep DefaultParticleStep(std::uint32_t count);
+
+// Particles first to first + count of a disc around the y axis, orbiting
+// the attractor of DefaultParticleStep. Particle i only depends on seed and
+// i, so any range can be generated on its own.
+void SeedParticles(std::uint32_t seed, std::size_t first, std::size_t count,
+                   Particle* particles);
+
+// One step of particles.comp on the CPU, the reference to validate it.
+void StepParticles(const ParticleStep& step, Particle* particles,
+                   std::size_t count);
+
+// Number of particles of actual that differ from one step of before by
+// more than tolerance (relative to the magnitude of the values). Particles
+// that end up within tolerance of a face are not counted, the GPU may
+// round them to the other side and bounce them.
+std::size_t CountParticleMismatches(const ParticleStep& step,
+                                    const Particle* before,
+                                    const Particle* actual, std::size_t count,
+                                    float tolerance);
+
+#endif  // VULKAN_QT_INCLUDE_PARTICLES_H
@@ -0,0 +1,39 @@
+#ifndef VULKAN_QT_INCLUDE_PIPELINE_CACHE_H
+#define VULKAN_QT_INCLUDE_PIPELINE_CACHE_H
+
+#include <QtCore/QByteArray>
+#include <QtCore/QString>
+#include <QtGui/QVulkanInstance>
+
+// Disk-backed storage for VkPipelineCache data. A blob is only handed back
+// if its header matches the physical device it is loaded for, so a cache
+// written by another GPU or driver build is dropped instead of being passed
+// on to vkCreatePipelineCache.
+class PipelineCacheStore
+{
+  public:
+    explicit PipelineCacheStore(const QString& path = DefaultPath());
+
+    // $VULKAN_QT_PIPELINE_CACHE if set, otherwise a file in the per-user
+    // cache directory.
+    static QString DefaultPath();
+
+    // Checks the VkPipelineCacheHeaderVersionOne header of the blob against
+    // the vendor, device and pipeline cache UUID of the device.
+    static bool IsCompatible(const QByteArray& data,
+                             const VkPhysicalDeviceProperties& properties);
+
+    // Returns the stored blob, or an empty array if there is none or it is
+    // corrupt or stale.
+    QByteArray Load(const VkPhysicalDeviceProperties& properties) const;
+
+    // Atomically replaces the stored blob.
+    bool Save(const QByteArray& data) const;
+
+    const QString& path() const { return path_; }
+
+  private:
+    QString path_;
+};
+
+#endif  // VULKAN_QT_INCLUDE_PIPELINE_CACHE_H
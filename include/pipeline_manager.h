@@ -0,0 +1,109 @@
+#ifndef VULKAN_QT_INCLUDE_PIPELINE_MANAGER_H
+#define VULKAN_QT_INCLUDE_PIPELINE_MANAGER_H
+
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QString>
+#include <QtGui/QVulkanFunctions>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "worker_pool.h"
+
+// What differs between the graphics pipelines of the renderer. The rest of
+// the state is fixed: depth test and write, no blending, dynamic viewport
+// and scissor.
+struct GraphicsPipelineDesc
+{
+    QString name;  // for the log
+    // SPIR-V files
+    QString vertex_shader;
+    QString fragment_shader;
+    // value of specialization constant i, in both stages
+    std::vector<std::uint32_t> specialization;
+    std::vector<VkVertexInputBindingDescription> bindings;
+    std::vector<VkVertexInputAttributeDescription> attributes;
+    VkPrimitiveTopology topology{VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST};
+    VkCullModeFlags cull_mode{VK_CULL_MODE_NONE};
+    VkPipelineLayout layout{VK_NULL_HANDLE};
+    VkRenderPass render_pass{VK_NULL_HANDLE};
+};
+
+// Compiles graphics pipelines in the background, so startup does not block
+// on shader I/O or the driver's compiler. A loader thread reads the SPIR-V
+// and creates the shader modules, then compiles every batch of requests on
+// a worker pool, all threads sharing one VkPipelineCache (which is
+// internally synchronized). Callers poll for finished pipelines and draw
+// with a fallback until the one they want is ready.
+class PipelineManager
+{
+  public:
+    PipelineManager();
+    ~PipelineManager();
+
+    PipelineManager(const PipelineManager&) = delete;
+    PipelineManager& operator=(const PipelineManager&) = delete;
+
+    // thread_count threads compile, the loader thread included.
+    void Create(QVulkanDeviceFunctions* device_functions, VkDevice device,
+                VkPipelineCache pipeline_cache, int thread_count);
+    // Waits for the outstanding requests, logs the latencies and destroys
+    // all pipelines and shader modules. The device must not use them
+    // anymore.
+    void Release();
+
+    // Queues a pipeline and returns its handle. Requests are started in
+    // order, so earlier ones (e.g. fallbacks) tend to be ready first.
+    int Request(GraphicsPipelineDesc desc);
+    // The pipeline, or VK_NULL_HANDLE while it compiles or if it failed.
+    // Never blocks.
+    VkPipeline Get(int handle) const;
+    // Whether all requests so far are done. Never blocks.
+    bool idle() const;
+    // Blocks until all requests so far are done.
+    void WaitIdle();
+
+  private:
+    struct Entry
+    {
+        GraphicsPipelineDesc desc;
+        VkShaderModule vertex_shader;
+        VkShaderModule fragment_shader;
+        std::atomic<VkPipeline> pipeline;
+        qint64 requested_ns;  // on timer_
+        double compile_ms;
+        double ready_ms;  // from the request to the pipeline
+    };
+
+    void Run();
+    // Reads and creates the module once per file, on the loader thread.
+    VkShaderModule LoadShader(const QString& path);
+    void Compile(Entry* entry);
+    void LogLatencies() const;
+
+    QVulkanDeviceFunctions* device_functions_;
+    VkDevice device_;
+    VkPipelineCache pipeline_cache_;
+    std::unique_ptr<WorkerPool> pool_;
+    std::thread thread_;
+    QElapsedTimer timer_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable work_ready_;
+    std::condition_variable work_done_;
+    // stable addresses, the pool works on entries while others are added
+    std::vector<std::unique_ptr<Entry>> entries_;
+    std::size_t next_entry_;  // first one not started yet
+    std::size_t done_count_;
+    bool stopping_;
+
+    // loader thread only
+    std::map<QString, VkShaderModule> shaders_;
+};
+
+#endif  // VULKAN_QT_INCLUDE_PIPELINE_MANAGER_H
@@ -0,0 +1,61 @@
+#ifndef VULKAN_QT_INCLUDE_REDRAW_CONTROLLER_H
+#define VULKAN_QT_INCLUDE_REDRAW_CONTROLLER_H
+
+#include <cstdint>
+
+enum class RedrawMode
+{
+    kContinuous,  // frames back to back
+    kOnDemand,    // frames only when something changed
+};
+
+// Decides when the window renders its next frame. In continuous mode that
+// is right after the previous one. In on-demand mode it is only after
+// Invalidate() or while the scene animates on its own, so an unchanging
+// scene costs no CPU or GPU time at all.
+//
+// Both modes are capped at max_fps if it is positive. A positive idle_fps
+// is the low-power policy: in on-demand mode an unchanged scene is still
+// rendered at that rate, as a heartbeat, and in continuous mode the rate
+// drops to it once nothing changed for idle_after_ms.
+//
+// Times are in milliseconds on any monotonic clock.
+class RedrawController
+{
+  public:
+    explicit RedrawController(RedrawMode mode = RedrawMode::kContinuous,
+                              double max_fps = 0.0, double idle_fps = 0.0,
+                              double idle_after_ms = 1000.0);
+
+    // The scene, camera or window size changed, the next frame shows it.
+    void Invalidate() { invalidated_ = true; }
+    // While set, the scene keeps changing by itself, e.g. while a mesh
+    // streams in, and every frame counts as a change.
+    void SetAnimating(bool animating) { animating_ = animating; }
+
+    // A frame was rendered. It shows everything up to now.
+    void FrameRendered(double now_ms);
+
+    // Delay from now_ms until the next frame is due: 0 for right away,
+    // negative if none is, until the next Invalidate() or SetAnimating().
+    double NextFrameDelay(double now_ms) const;
+
+    // No change for idle_after_ms.
+    bool idle(double now_ms) const;
+    std::uint64_t frame_count() const { return frame_count_; }
+    RedrawMode mode() const { return mode_; }
+
+  private:
+    RedrawMode mode_;
+    double min_interval_ms_;   // from max_fps, 0 if uncapped
+    double idle_interval_ms_;  // from idle_fps, 0 if none
+    double idle_after_ms_;
+    bool invalidated_;
+    bool animating_;
+    bool has_frame_;
+    double last_frame_ms_;
+    double last_change_ms_;
+    std::uint64_t frame_count_;
+};
+
+#endif  // VULKAN_QT_INCLUDE_REDRAW_CONTROLLER_H
@@ -0,0 +1,207 @@
+#ifndef VULKAN_QT_INCLUDE_RENDER_TARGET_H
+#define VULKAN_QT_INCLUDE_RENDER_TARGET_H
+
+#include <QtCore/QSize>
+#include <QtCore/QtGlobal>
+#include <QtGui/QVulkanInstance>
+#include <QtGui/QVulkanWindow>
+#include <vector>
+
+#include "gpu_timeline.h"
+
+// Upper bound of --frames-in-flight for targets that own their frames.
+// QVulkanWindow stops at QVulkanWindow::MAX_CONCURRENT_FRAME_COUNT.
+constexpr int max_frames_in_flight{8};
+
+// Everything VulkanRenderer needs from what it draws into. The functions
+// mirror the QVulkanWindow API, so the same renderer can draw into a window
+// or into offscreen images.
+class RenderTarget
+{
+  public:
+    virtual ~RenderTarget() = default;
+
+    virtual QVulkanInstance* vulkanInstance() const = 0;
+    virtual VkPhysicalDevice physicalDevice() const = 0;
+    virtual const VkPhysicalDeviceProperties* physicalDeviceProperties()
+        const = 0;
+    virtual VkDevice device() const = 0;
+    virtual VkQueue graphicsQueue() const = 0;
+    virtual std::uint32_t graphicsQueueFamilyIndex() const = 0;
+    virtual VkCommandPool graphicsCommandPool() const = 0;
+    virtual std::uint32_t hostVisibleMemoryIndex() const = 0;
+    virtual std::uint32_t deviceLocalMemoryIndex() const = 0;
+    virtual VkRenderPass defaultRenderPass() const = 0;
+    // Optional device capabilities: VK_KHR_draw_indirect_count, the
+    // multiDrawIndirect feature and VK_EXT_descriptor_indexing with the
+    // features bindless resources need (see BindlessTable).
+    virtual bool drawIndirectCountEnabled() const = 0;
+    virtual bool multiDrawIndirectEnabled() const = 0;
+    virtual bool descriptorIndexingEnabled() const = 0;
+    // VK_KHR_timeline_semaphore, for GpuTimeline.
+    virtual bool timelineSemaphoreEnabled() const = 0;
+
+    // A queue without graphics for uploads that overlap rendering, from a
+    // family of its own. VK_NULL_HANDLE if there is none, then everything
+    // goes through the graphics queue.
+    virtual VkQueue transferQueue() const = 0;
+    virtual std::uint32_t transferQueueFamilyIndex() const = 0;
+    virtual VkCommandPool transferCommandPool() const = 0;
+    // Makes the submission of the next frameReady() wait for a value on a
+    // timeline, e.g. for uploads on the transfer queue.
+    virtual void addFrameWait(const GpuTimeline::Wait& wait) = 0;
+
+    virtual int concurrentFrameCount() const = 0;
+    virtual int currentFrame() const = 0;
+    virtual VkCommandBuffer currentCommandBuffer() const = 0;
+    virtual VkFramebuffer currentFramebuffer() const = 0;
+    virtual QSize swapChainImageSize() const = 0;
+    // For copying frames out: the image the current frame renders into, its
+    // format, and the layout the default render pass leaves it in.
+    // VK_NULL_HANDLE if it cannot be a transfer source.
+    virtual VkImage currentColorImage() const = 0;
+    virtual VkFormat colorFormat() const = 0;
+    virtual VkImageLayout colorImageLayout() const = 0;
+
+    // Called by the renderer when the current command buffer is recorded.
+    virtual void frameReady() = 0;
+    // Called by the renderer when it wants another frame.
+    virtual void requestUpdate() = 0;
+};
+
+// Forwards to the QVulkanWindow that owns the renderer.
+class WindowRenderTarget : public RenderTarget
+{
+  public:
+    explicit WindowRenderTarget(QVulkanWindow& window) : window_(window) {}
+
+    QVulkanInstance* vulkanInstance() const override
+    {
+        return window_.vulkanInstance();
+    }
+    VkPhysicalDevice physicalDevice() const override
+    {
+        return window_.physicalDevice();
+    }
+    const VkPhysicalDeviceProperties* physicalDeviceProperties() const override
+    {
+        return window_.physicalDeviceProperties();
+    }
+    VkDevice device() const override { return window_.device(); }
+    VkQueue graphicsQueue() const override { return window_.graphicsQueue(); }
+    std::uint32_t graphicsQueueFamilyIndex() const override
+    {
+#if QT_VERSION >= QT_VERSION_CHECK(5, 15, 0)
+        return window_.graphicsQueueFamilyIndex();
+#else
+        // Older Qt does not expose it, repeat QVulkanWindow's choice: the
+        // first graphics family that can present, else the first graphics
+        // family.
+        QVulkanInstance* instance = window_.vulkanInstance();
+        std::uint32_t count{0};
+        instance->functions()->vkGetPhysicalDeviceQueueFamilyProperties(
+            window_.physicalDevice(), &count, nullptr);
+        std::vector<VkQueueFamilyProperties> families(count);
+        instance->functions()->vkGetPhysicalDeviceQueueFamilyProperties(
+            window_.physicalDevice(), &count, families.data());
+        std::uint32_t graphics_family{UINT32_MAX};
+        for (std::uint32_t i = 0; i < count; ++i)
+        {
+            if (!(families[i].queueFlags & VK_QUEUE_GRAPHICS_BIT)) continue;
+            if (graphics_family == UINT32_MAX) graphics_family = i;
+            if (instance->supportsPresent(window_.physicalDevice(), i,
+                                          &window_))
+                return i;
+        }
+        return graphics_family;
+#endif
+    }
+    VkCommandPool graphicsCommandPool() const override
+    {
+        return window_.graphicsCommandPool();
+    }
+    std::uint32_t hostVisibleMemoryIndex() const override
+    {
+        return window_.hostVisibleMemoryIndex();
+    }
+    std::uint32_t deviceLocalMemoryIndex() const override
+    {
+        return window_.deviceLocalMemoryIndex();
+    }
+    VkRenderPass defaultRenderPass() const override
+    {
+        return window_.defaultRenderPass();
+    }
+    bool drawIndirectCountEnabled() const override
+    {
+        // requested by VulkanWindow, enabled whenever it is supported
+        return window_.supportedDeviceExtensions().contains(
+            VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+    }
+    bool multiDrawIndirectEnabled() const override
+    {
+        // QVulkanWindow does not enable any device features
+        return false;
+    }
+    bool descriptorIndexingEnabled() const override
+    {
+        // nor can it chain the extension's feature struct
+        return false;
+    }
+    bool timelineSemaphoreEnabled() const override { return false; }
+
+    // QVulkanWindow creates a graphics queue only, and submits the frames
+    // itself. Waits happen on the CPU, but without a transfer queue nothing
+    // asks for them.
+    VkQueue transferQueue() const override { return VK_NULL_HANDLE; }
+    std::uint32_t transferQueueFamilyIndex() const override
+    {
+        return graphicsQueueFamilyIndex();
+    }
+    VkCommandPool transferCommandPool() const override
+    {
+        return VK_NULL_HANDLE;
+    }
+    void addFrameWait(const GpuTimeline::Wait& wait) override
+    {
+        wait.timeline->WaitFor(wait.value);
+    }
+
+    int concurrentFrameCount() const override
+    {
+        return window_.concurrentFrameCount();
+    }
+    int currentFrame() const override { return window_.currentFrame(); }
+    VkCommandBuffer currentCommandBuffer() const override
+    {
+        return window_.currentCommandBuffer();
+    }
+    VkFramebuffer currentFramebuffer() const override
+    {
+        return window_.currentFramebuffer();
+    }
+    QSize swapChainImageSize() const override
+    {
+        return window_.swapChainImageSize();
+    }
+    VkImage currentColorImage() const override
+    {
+        // QVulkanWindow only adds TRANSFER_SRC to the swap chain's usage
+        // where the surface allows it, which is what grab() needs as well
+        if (!window_.supportsGrab()) return VK_NULL_HANDLE;
+        return window_.swapChainImage(window_.currentSwapChainImageIndex());
+    }
+    VkFormat colorFormat() const override { return window_.colorFormat(); }
+    VkImageLayout colorImageLayout() const override
+    {
+        return VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+    }
+
+    void frameReady() override { window_.frameReady(); }
+    void requestUpdate() override { window_.requestUpdate(); }
+
+  private:
+    QVulkanWindow& window_;
+};
+
+#endif  // VULKAN_QT_INCLUDE_RENDER_TARGET_H
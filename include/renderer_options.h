@@ -0,0 +1,104 @@
+#ifndef VULKAN_QT_INCLUDE_RENDERER_OPTIONS_H
+#define VULKAN_QT_INCLUDE_RENDERER_OPTIONS_H
+
+#include <QtCore/QSize>
+#include <QtCore/QString>
+#include <QtCore/QStringList>
+
+#include "redraw_controller.h"
+
+// Where frame timings are reported.
+enum class ProfileOutput
+{
+    kNone,
+    kLog,    // periodic percentile summary in the log
+    kCsv,    // one row per frame
+    kTrace,  // Chrome trace event JSON
+};
+
+// Knobs for the renderer, set from the command line.
+struct RendererOptions
+{
+    // The triangle is split into mesh_subdivisions^2 triangles, used to
+    // scale the amount of static geometry that gets uploaded. At most
+    // max_grid_subdivisions.
+    int mesh_subdivisions{1};
+    // If set, the mesh is streamed from this file (see mesh_format.h)
+    // instead, at most stream_budget_mib MiB per frame.
+    QString mesh_path;
+    int stream_budget_mib{8};
+    // Store the generated mesh in 16 instead of 36 bytes per vertex (see
+    // vertex_quantization.h), decoded in the vertex shader.
+    bool quantized_vertices{false};
+
+    // Number of copies of the mesh in the scene. They are drawn with one
+    // instanced draw call, or with one draw call each without instancing.
+    int instances{1};
+    bool instancing{true};
+    // Materials spread over the instances in contiguous runs, each with its
+    // own tint and one of up to max_material_textures textures. Thousands
+    // of them stress the per-draw material switches.
+    int materials{1};
+    // Frustum culling and LOD selection of the instances on the CPU. Without
+    // it every instance is drawn at full detail.
+    bool culling{true};
+    // Cull on the GPU with a compute shader that writes indirect draws
+    // instead, optionally checking every frame against the CPU culler. A
+    // verification that never ran (e.g. with --no-culling) fails the run.
+    bool gpu_culling{false};
+    bool verify_gpu_culling{false};
+    // Points simulated by a compute shader and drawn from its buffer, see
+    // ParticleSystem, optionally checking every step against the CPU. A
+    // verification that never ran fails the run, as with GPU culling.
+    int particles{0};
+    bool verify_particles{false};
+    // Threads recording the draws into secondary command buffers, 0 records
+    // them inline into the primary command buffer.
+    int workers{0};
+    // Frames the CPU may record ahead of the GPU. The window caps it at
+    // QVulkanWindow::MAX_CONCURRENT_FRAME_COUNT, headless runs at
+    // max_frames_in_flight.
+    int frames_in_flight{3};
+    // Threads compiling the graphics pipelines in the background, and the
+    // number of extra permutations of the scene pipeline compiled along
+    // with it, to see how startup scales with many materials.
+    int pipeline_threads{2};
+    int pipeline_variants{0};
+
+    // When the window renders frames, see RedrawController. Rates of 0 are
+    // uncapped and no idle frames, respectively. With log_usage, the frame
+    // rate and CPU (and with --profile, GPU) load are logged every 5 s.
+    RedrawMode redraw{RedrawMode::kContinuous};
+    double max_fps{0.0};
+    double idle_fps{0.0};
+    bool log_usage{false};
+
+    // Render offscreen without a window, e.g. in CI or on render nodes.
+    bool headless{false};
+    int frames{100};
+    QSize size{1280, 720};
+    // Headless runs track the frames with timeline semaphores and stream on
+    // a dedicated transfer queue where the device allows; these turn either
+    // off to compare the fence and graphics queue paths.
+    bool timeline_semaphore{true};
+    bool transfer_queue{true};
+    // If set, frames are written there as frame_NNNNN.<format>, or as
+    // video.y4m. Headless runs wait for the writer, windows drop frames.
+    QString output_directory;
+    QString output_format{"ppm"};
+
+    ProfileOutput profile{ProfileOutput::kNone};
+    // File for the csv and trace outputs.
+    QString profile_path;
+    // If set, a BenchmarkReport of the run is written there on exit. It
+    // needs the profiler, which then defaults to the log output.
+    QString benchmark_json;
+    // Turn the camera every orbit_every frames, 0 never, so benchmarks can
+    // change the uniforms (and what gets culled) at a fixed rate.
+    int orbit_every{0};
+};
+
+// Parses the command line, exits with a usage message on invalid input.
+RendererOptions ParseRendererOptions(const QStringList& arguments);
+
+#endif  // VULKAN_QT_INCLUDE_RENDERER_OPTIONS_H
@@ -0,0 +1,17 @@
+#ifndef VULKAN_QT_INCLUDE_SIMD_LEVEL_H
+#define VULKAN_QT_INCLUDE_SIMD_LEVEL_H
+
+// Instruction sets the SIMD kernels are written for, in increasing order.
+enum class SimdLevel
+{
+    kScalar,
+    kSse,
+    kAvx2,
+};
+
+// Best level supported by the CPU the program runs on.
+SimdLevel DetectSimdLevel();
+bool IsSimdLevelSupported(SimdLevel level);
+const char* SimdLevelName(SimdLevel level);
+
+#endif  // VULKAN_QT_INCLUDE_SIMD_LEVEL_H
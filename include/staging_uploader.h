@@ -0,0 +1,121 @@
+#ifndef VULKAN_QT_INCLUDE_STAGING_UPLOADER_H
+#define VULKAN_QT_INCLUDE_STAGING_UPLOADER_H
+
+#include <QtGui/QVulkanFunctions>
+#include <QtGui/QVulkanInstance>
+#include <deque>
+#include <vector>
+
+#include "gpu_timeline.h"
+
+// Copies data into device-local buffers through a persistently mapped,
+// host-visible staging ring. Uploads are batched: each Flush() records all
+// pending copies into one command buffer followed by the barriers that make
+// them visible to their consumers, and submits it without waiting. Later
+// submissions to the same queue are ordered after the copies by those
+// barriers, so the caller only has to wait when it needs to measure.
+//
+// On a dedicated transfer queue there are no consumer barriers (the
+// consumers' stages do not exist there). Consumers on other queues wait for
+// the value Flush() returns on timeline() instead, e.g. with
+// RenderTarget::addFrameWait, and the destination buffers have to be shared
+// between the queue families. Images cannot be uploaded there.
+//
+// Staging space is reclaimed once the submission that used it is complete
+// on the uploader's timeline, so the ring can be reused for streaming
+// uploads.
+class StagingUploader
+{
+  public:
+    StagingUploader();
+
+    // timeline_semaphore: VK_KHR_timeline_semaphore is enabled on device,
+    // see GpuTimeline.
+    void Create(QVulkanInstance* instance, VkDevice device,
+                const VkPhysicalDeviceProperties& device_properties,
+                std::uint32_t memory_index, VkMemoryPropertyFlags memory_flags,
+                VkQueue queue, VkCommandPool command_pool,
+                VkDeviceSize ring_size, bool timeline_semaphore,
+                bool transfer_queue = false);
+    void Release();
+
+    // Copies size bytes from data to dst at dst_offset. The data is staged
+    // right away, so it does not need to outlive the call. dst_stage and
+    // dst_access describe how the destination is read after the upload.
+    void Upload(VkBuffer dst, VkDeviceSize dst_offset, const void* data,
+                VkDeviceSize size,
+                VkPipelineStageFlags dst_stage =
+                    VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+                VkAccessFlags dst_access = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT |
+                                           VK_ACCESS_INDEX_READ_BIT);
+
+    // Copies tightly packed texels into mip level 0 of a 2D color image,
+    // which ends up in VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL for
+    // dst_stage. The previous contents are discarded. The data has to fit
+    // into half the ring.
+    void UploadImage(VkImage dst, std::uint32_t width, std::uint32_t height,
+                     const void* data, VkDeviceSize size,
+                     VkPipelineStageFlags dst_stage =
+                         VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+
+    // Submits all pending copies in one batch. Returns the value on
+    // timeline() that completes with them, and with all earlier uploads.
+    std::uint64_t Flush();
+
+    // Submits pending copies and blocks until all uploads have completed.
+    void WaitIdle();
+
+    VkDeviceSize ring_size() const { return size_; }
+    GpuTimeline* timeline() { return &timeline_; }
+
+  private:
+    struct PendingCopy
+    {
+        VkBuffer dst;
+        VkBufferCopy region;
+        VkPipelineStageFlags dst_stage;
+        VkAccessFlags dst_access;
+    };
+
+    struct PendingImageCopy
+    {
+        VkImage dst;
+        VkBufferImageCopy region;
+        VkPipelineStageFlags dst_stage;
+    };
+
+    struct Submission
+    {
+        VkCommandBuffer command_buffer;
+        std::uint64_t value;    // on timeline_
+        VkDeviceSize ring_end;  // staging memory up to here is in use
+    };
+
+    // Transitions, copies and barriers of the pending image uploads.
+    void RecordImageCopies(VkCommandBuffer command_buffer);
+    bool TryAllocate(VkDeviceSize size, VkDeviceSize* offset);
+    // Returns false if nothing was reclaimed.
+    bool ReclaimOldest(bool wait);
+
+    QVulkanDeviceFunctions* device_functions_;
+    VkDevice device_;
+    VkQueue queue_;
+    VkCommandPool command_pool_;
+    GpuTimeline timeline_;
+    bool consumer_barriers_;
+
+    VkBuffer buffer_;
+    VkDeviceMemory memory_;
+    quint8* mapped_;
+    bool coherent_;
+    VkDeviceSize size_;
+    VkDeviceSize alignment_;
+    VkDeviceSize head_;  // next free byte
+    VkDeviceSize tail_;  // oldest byte still in use
+
+    std::vector<PendingCopy> pending_copies_;
+    std::vector<PendingImageCopy> pending_image_copies_;
+    std::deque<Submission> in_flight_;
+};
+
+#endif  // VULKAN_QT_INCLUDE_STAGING_UPLOADER_H
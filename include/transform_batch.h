@@ -0,0 +1,68 @@
+#ifndef VULKAN_QT_INCLUDE_TRANSFORM_BATCH_H
+#define VULKAN_QT_INCLUDE_TRANSFORM_BATCH_H
+
+#include <cstddef>
+#include <glm/mat4x4.hpp>
+#include <vector>
+
+#include "simd_level.h"
+
+// Model matrices in structure-of-arrays layout: element e of every matrix
+// (column-major, e = 4 * column + row) is stored contiguously, so one SIMD
+// register holds the same element of consecutive objects.
+class MatrixBatch
+{
+  public:
+    MatrixBatch() = default;
+    explicit MatrixBatch(std::size_t size);
+
+    // New matrices are zero.
+    void Resize(std::size_t size);
+    std::size_t size() const { return size_; }
+
+    void Set(std::size_t index, const glm::mat4& matrix);
+    glm::mat4 Get(std::size_t index) const;
+
+    // The size() values of element e, 0 <= e < 16.
+    const float* Element(int e) const { return data_.data() + e * size_; }
+    float* Element(int e) { return data_.data() + e * size_; }
+
+  private:
+    std::vector<float> data_;
+    std::size_t size_{0};
+};
+
+// Computes view_projection * model for whole batches of model matrices.
+// The view-projection is built once and cached, so each object only costs
+// one matrix product instead of rebuilding the camera per call like
+// GetMVPMatrix does.
+class TransformBatch
+{
+  public:
+    // Identity view-projection, kernels for DetectSimdLevel().
+    TransformBatch();
+
+    void SetViewProjection(const glm::mat4& view_projection);
+    // The camera of GetMVPMatrix. Nothing is rebuilt if it did not change.
+    void SetCamera(float aspect, float translate_z, float rotate_x,
+                   float rotate_y);
+    const glm::mat4& view_projection() const { return view_projection_; }
+
+    // Writes models.size() matrices to mvps, which are in the usual glm
+    // layout and can be copied to a uniform or instance buffer as they are.
+    void Compute(const MatrixBatch& models, glm::mat4* mvps) const;
+    // Same with the kernels of the given level, for tests and benchmarks.
+    // Falls back to the best supported level below it.
+    void Compute(const MatrixBatch& models, glm::mat4* mvps,
+                 SimdLevel level) const;
+
+    SimdLevel simd_level() const { return simd_level_; }
+
+  private:
+    glm::mat4 view_projection_;
+    float camera_[4];
+    bool camera_valid_;
+    SimdLevel simd_level_;
+};
+
+#endif  // VULKAN_QT_INCLUDE_TRANSFORM_BATCH_H
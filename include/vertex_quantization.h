@@ -0,0 +1,62 @@
+#ifndef VULKAN_QT_INCLUDE_VERTEX_QUANTIZATION_H
+#define VULKAN_QT_INCLUDE_VERTEX_QUANTIZATION_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Compact vertex layout, 16 instead of the 36 bytes of the float layout in
+// MeshData, decoded by the vertex input stage and shader.vert:
+// - position: VK_FORMAT_R16G16B16A16_SNORM, relative to the mesh bounds
+//   (see PositionDequantization), w unused
+// - normal: VK_FORMAT_R16G16_SNORM, octahedral encoding
+// - color: VK_FORMAT_R8G8B8A8_UNORM, alpha unused
+struct QuantizedVertex
+{
+    std::int16_t position[4];
+    std::int16_t normal[2];
+    std::uint8_t color[4];
+};
+
+// Maps decoded SNORM positions in [-1, 1] back into the mesh:
+// position = offset + scale * snorm.
+struct PositionDequantization
+{
+    float offset[3];
+    float scale[3];
+};
+
+// The largest differences between the input and the decoded vertices.
+struct QuantizationError
+{
+    float position;  // per axis, in mesh units
+    float normal;    // angle in radians
+    float color;     // per channel, in [0, 1]
+};
+
+// The worst case for the positions, half a step of the scale's longest
+// axis, and for colors, half an 8-bit step, each plus float rounding.
+// Octahedral normals with 16 bits per component are within
+// octahedral_normal_error radians.
+QuantizationError QuantizationErrorBound(
+    const PositionDequantization& dequantization);
+constexpr float octahedral_normal_error{1e-4f};
+
+// Quantizes vertex_count vertices laid out like MeshData::vertices, with
+// positions relative to their bounding box. The measured error is returned
+// in error, if given.
+std::vector<QuantizedVertex> QuantizeVertices(
+    const float* vertices, std::size_t vertex_count,
+    PositionDequantization* dequantization,
+    QuantizationError* error = nullptr);
+
+// The float layout of a quantized vertex again, like shader.vert decodes it.
+void DequantizeVertex(const QuantizedVertex& vertex,
+                      const PositionDequantization& dequantization,
+                      float* out);
+
+// Unit vector <-> octahedral map in [-1, 1]^2, stored as SNORM16.
+void EncodeOctahedral(const float* normal, std::int16_t* encoded);
+void DecodeOctahedral(const std::int16_t* encoded, float* normal);
+
+#endif  // VULKAN_QT_INCLUDE_VERTEX_QUANTIZATION_H
@@ -0,0 +1,116 @@
+#ifndef VULKAN_QT_INCLUDE_VISIBILITY_H
+#define VULKAN_QT_INCLUDE_VISIBILITY_H
+
+#include <cstddef>
+#include <cstdint>
+#include <glm/mat4x4.hpp>
+#include <vector>
+
+#include "simd_level.h"
+#include "worker_pool.h"
+
+// World-space bounding spheres in structure-of-arrays layout, so one SIMD
+// register holds the same coordinate of consecutive objects.
+class BoundingSpheres
+{
+  public:
+    void Resize(std::size_t size);
+    std::size_t size() const { return radius_.size(); }
+
+    void Set(std::size_t index, float x, float y, float z, float radius);
+
+    const float* x() const { return x_.data(); }
+    const float* y() const { return y_.data(); }
+    const float* z() const { return z_.data(); }
+    const float* radius() const { return radius_.data(); }
+
+  private:
+    std::vector<float> x_;
+    std::vector<float> y_;
+    std::vector<float> z_;
+    std::vector<float> radius_;
+};
+
+// Planes (a, b, c, d) with unit normals pointing inwards: a point is on the
+// inner side of a plane when a * x + b * y + c * z + d >= 0.
+struct Frustum
+{
+    enum Plane
+    {
+        kLeft,
+        kRight,
+        kBottom,
+        kTop,
+        kNear,
+        kFar,
+    };
+    float planes[6][4];
+};
+
+// The planes of a view-projection matrix, with the near plane at clip depth
+// -1 so that it holds for both depth conventions.
+Frustum ExtractFrustum(const glm::mat4& view_projection);
+
+struct CullSettings
+{
+    // Viewport height in pixels, which projected sizes are measured in.
+    float viewport_height{1.0f};
+    // Objects whose projected diameter is below lod_pixels[i] use LOD i + 1
+    // or coarser. Sorted in descending order; empty keeps everything at LOD
+    // 0.
+    std::vector<float> lod_pixels;
+    // Objects with a projected diameter below this are culled as well.
+    float min_pixels{0.0f};
+};
+
+struct VisibleObject
+{
+    std::uint32_t index;
+    std::uint32_t lod;
+};
+
+// Tests bounding spheres against the view frustum and picks a LOD for each
+// sphere that passes. The spheres are split into fixed-size chunks, which
+// run on the worker pool when one is set.
+class VisibilityCuller
+{
+  public:
+    VisibilityCuller();
+
+    // The pool is not owned and may be null to cull on the calling thread.
+    void set_worker_pool(WorkerPool* pool) { worker_pool_ = pool; }
+
+    // Replaces the contents of visible with the objects that intersect the
+    // frustum, in index order.
+    void Cull(const glm::mat4& view_projection, const CullSettings& settings,
+              const BoundingSpheres& spheres,
+              std::vector<VisibleObject>* visible);
+    // Same with the plane tests forced to the given SIMD level, which falls
+    // back to the best supported one. For benchmarks and tests.
+    void Cull(const glm::mat4& view_projection, const CullSettings& settings,
+              const BoundingSpheres& spheres,
+              std::vector<VisibleObject>* visible, SimdLevel level);
+
+    SimdLevel simd_level() const { return simd_level_; }
+
+  private:
+    WorkerPool* worker_pool_;
+    SimdLevel simd_level_;
+    // per chunk results, kept to reuse their memory across frames
+    std::vector<std::vector<VisibleObject>> chunk_visible_;
+};
+
+// Number of objects on which two results of culling the same spheres
+// disagree, either visible in only one of them or at different LODs. Objects
+// within tolerance (relative to their radius, or to the LOD threshold) of a
+// plane or LOD boundary are not counted, since a different evaluation order
+// (e.g. on the GPU) may round them either way. Both lists have to be sorted
+// by index.
+std::size_t CountVisibilityMismatches(const glm::mat4& view_projection,
+                                      const CullSettings& settings,
+                                      const BoundingSpheres& spheres,
+                                      const std::vector<VisibleObject>& a,
+                                      const std::vector<VisibleObject>& b,
+                                      float tolerance);
+
+#endif  // VULKAN_QT_INCLUDE_VISIBILITY_H
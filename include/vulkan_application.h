@@ -1,123 +1,406 @@
 #ifndef VULKAN_APPLICATION_H
 #define VULKAN_APPLICATION_H
 
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QTimer>
 #include <QtGui/QGuiApplication>
+#include <QtGui/QKeyEvent>
+#include <QtGui/QMouseEvent>
 #include <QtGui/QVulkanFunctions>
 #include <QtGui/QVulkanInstance>
 #include <QtGui/QVulkanWindow>
 #include <QtGui/QVulkanWindowRenderer>
+#include <QtGui/QWheelEvent>
+#include <algorithm>
+#include <ctime>
+#include <deque>
 #include <iostream>
+#include <memory>
+#include <vector>
 
+#include "bindless_table.h"
+#include "camera.h"
+#include "device_memory_allocator.h"
+#include "frame_capture.h"
+#include "frame_profiler.h"
+#include "frame_writer.h"
+#include "geometry.h"
+#include "gpu_culler.h"
 #include "graphics.h"
+#include "mapped_ring_buffer.h"
+#include "materials.h"
+#include "mesh_streamer.h"
+#include "particle_system.h"
+#include "pipeline_cache.h"
+#include "pipeline_manager.h"
+#include "redraw_controller.h"
+#include "render_target.h"
+#include "renderer_options.h"
+#include "staging_uploader.h"
+#include "vertex_quantization.h"
+#include "visibility.h"
+#include "worker_pool.h"
 
-static constexpr inline VkDeviceSize aligned(VkDeviceSize v,
-                                             VkDeviceSize byte_align)
-{
-    return (v + byte_align - 1) & ~(byte_align - 1);
-}
-
+// Draws the scene into a RenderTarget. Owned by a VulkanWindow through
+// QVulkanWindowRenderer, or driven directly by the headless render loop.
 class VulkanRenderer : public QVulkanWindowRenderer
 {
   public:
-    VulkanRenderer(QVulkanWindow& window)
-        : window_(window),
+    VulkanRenderer(RenderTarget& target, const RendererOptions& options)
+        : target_(target),
+          options_(options),
           device_functions_{nullptr},
-          buffer_{nullptr},
-          device_memory_{nullptr},
+          memory_properties_{},
           uniform_buffer_info_{},
+          uniform_offset_{0},
+          mvp_{1.0F},
+          vertex_buffer_{nullptr},
+          index_buffer_{nullptr},
+          mesh_bounds_{},
+          quantized_vertices_{false},
+          position_dequantization_{{0.0f, 0.0f, 0.0f}, {1.0f, 1.0f, 1.0f}},
+          transfer_streaming_{false},
+          stream_wait_value_{0},
+          material_buffer_{nullptr},
+          texture_sampler_{nullptr},
+          instances_per_material_{1},
+          instance_dirty_frames_{0},
+          partition_count_{0},
           descriptor_pool_{nullptr},
           descriptor_set_layout_{nullptr},
-          descriptor_set_{},
+          descriptor_set_{nullptr},
           pipeline_cache_{nullptr},
           pipeline_layout_{nullptr},
-          pipeline_{nullptr}
+          fallback_pipeline_{-1},
+          scene_pipeline_{-1},
+          particle_pipeline_{-1},
+          frame_pipeline_{nullptr},
+          pipeline_cache_warm_{false},
+          redraw_(options.redraw, options.max_fps, options.idle_fps),
+          usage_cpu_start_{0},
+          usage_wall_start_ns_{0},
+          usage_frames_start_{0},
+          camera_time_ms_{0.0},
+          orbit_frame_{0}
     {
+        clear_values_[0].color = {{0.0F, 0.0F, 0.0F, 1.0F}};
+        clear_values_[1].depthStencil = {1.0F, 0};
+        redraw_clock_.start();
+        redraw_timer_.setSingleShot(true);
+        QObject::connect(&redraw_timer_, &QTimer::timeout,
+                         [this] { target_.requestUpdate(); });
+        QObject::connect(&usage_timer_, &QTimer::timeout,
+                         [this] { LogUsage(); });
     }
 
-    void startNextFrame() override
+    void startNextFrame() override;
+    void initResources() override;
+    void releaseResources() override;
+
+    void initSwapChainResources() override
     {
-        const auto command_buffer = window_.currentCommandBuffer();
-        const auto render_pass_info = GetRenderPassBeginInfo();
+        // the only place the projection changes
+        const QSize size = target_.swapChainImageSize();
+        camera_.SetViewport(size.width(), size.height());
+        CreateCapture();
+        RequestRedraw();
+    }
+    void releaseSwapChainResources() override { capture_.Release(); }
 
-        // begin render pass
-        device_functions_->vkCmdBeginRenderPass(
-            command_buffer, &render_pass_info, VK_SUBPASS_CONTENTS_INLINE);
+    // Takes effect from the next recorded frame on, without touching the
+    // slots of frames that are still in flight. Overrides the camera until
+    // it moves again.
+    void SetModelViewProjection(const glm::mat4& mvp);
 
-        // set viewport and scissor
-        const auto [viewport, scissor] = GetViewportAndScissor();
-        device_functions_->vkCmdSetViewport(command_buffer, 0, 1, &viewport);
-        device_functions_->vkCmdSetScissor(command_buffer, 0, 1, &scissor);
+    // Driven by the window's input. Call RequestRedraw() after changing it.
+    Camera& camera() { return camera_; }
 
-        // @todo Draw everything here
+    // Replaces the per-instance data, which has to keep its size. Like the
+    // matrix, it is copied into each frame's slot when that frame is
+    // recorded next.
+    void SetInstances(std::vector<InstanceData> instances);
 
-        // end render pass
-        device_functions_->vkCmdEndRenderPass(command_buffer);
-        window_.frameReady();
-        window_.requestUpdate();
-    }
+    // The scene changed outside of the renderer, e.g. through window input,
+    // and needs a new frame in on-demand mode.
+    void RequestRedraw();
 
-    void initResources() override
-    {
-        // get device functions
-        const auto& device = window_.device();
-        const auto& vulkan_instance = window_.vulkanInstance();
-        device_functions_ = vulkan_instance->deviceFunctions(device);
-
-        CreateMemoryBuffer(device);
-        const auto vertex_input_info = CreateVertexInputs(device);
-        CreateGraphicsPipeline(device, vertex_input_info);
-    }
+    // Blocks until the pipelines requested at startup are compiled, so the
+    // first frames do not fall back.
+    void WaitForPipelines() { pipeline_manager_.WaitIdle(); }
 
-    void initSwapChainResources() override
-    {
-        // @todo Init projection matrix etc. depending on window size here
-    }
+    // Whether --verify-gpu-culling or --verify-particles found results that
+    // differ from the CPU, or, having been requested, never checked any.
+    // Warns about the reason.
+    bool verification_failed() const;
 
   private:
+    // One vkCmdDrawIndexed of a consecutive range of instances, all at the
+    // same LOD and with the same material.
+    struct DrawCommand
+    {
+        std::uint32_t lod;
+        std::uint32_t first_instance;
+        std::uint32_t instance_count;
+        std::uint32_t material;
+    };
+
     VkRenderPassBeginInfo GetRenderPassBeginInfo();
     std::pair<VkViewport, VkRect2D> GetViewportAndScissor();
-    void CreateMemoryBuffer(const VkDevice& device);
+    void CreateUniformBuffer(const VkDevice& device);
+    void UpdateUniforms(int frame);
+    // Bit i set for every frame slot i, see the *_dirty_frames_ masks.
+    std::uint32_t AllFramesMask() const
+    {
+        return (1u << target_.concurrentFrameCount()) - 1;
+    }
+    // Uploads the material table and textures and fills the resource
+    // table with them.
+    void CreateMaterialTable(const VkDevice& device);
+    void ReleaseMaterialTable(const VkDevice& device);
+    void CreateInstanceBuffer(const VkDevice& device);
+    void UpdateInstances(int frame);
+    // Moves the mesh bounding sphere into world space for every instance.
+    void UpdateInstanceBounds();
+    void CreateGpuCulling(const VkDevice& device);
+    // Seeds and uploads the --particles.
+    void CreateParticles(const VkDevice& device);
+    // --output in a window: a readback ring for the swap chain's size.
+    void CreateCapture();
+    // Culls the instances against mvp_ and rebuilds the draw list, or
+    // records the GPU culling dispatch.
+    void CullInstances(VkCommandBuffer command_buffer, int frame);
+    // Turns visible_ into draws_, merging runs of consecutive instances at
+    // the same LOD and with the same material into one draw when
+    // instancing.
+    void BuildDraws();
+    void CreateRecordingResources(const VkDevice& device);
+    void ReleaseRecordingResources(const VkDevice& device);
+    // Records draws_[begin, end) with all the state they need, into either
+    // the primary or a secondary command buffer.
+    void RecordDraws(VkCommandBuffer command_buffer, int frame,
+                     std::size_t begin, std::size_t end);
+    // Draws the particles with their own pipeline, once their pipeline is
+    // ready. After the last of the draws_, inline or in the last secondary.
+    void RecordParticles(VkCommandBuffer command_buffer);
+    // Records the draw list on the worker pool, returns the non-empty
+    // secondary command buffers.
+    std::vector<VkCommandBuffer> RecordSecondaries(int frame);
+    void CreateDeviceLocalBuffer(
+        VkDeviceSize size, VkBufferUsageFlags usage, VkBuffer* buffer,
+        MemoryAllocation* allocation,
+        const std::vector<std::uint32_t>& queue_families = {});
+    void CreateGeometry(const VkDevice& device);
+    void CreateStreamedGeometry(const VkDevice& device);
+    // Uploads the next part of a streamed mesh, if any is left.
+    void StreamGeometry();
     VkPipelineVertexInputStateCreateInfo CreateVertexInputs(
         const VkDevice& device);
-    void CreateGraphicsPipeline(
+    // Creates the pipeline layout and queues the pipelines for background
+    // compilation.
+    void RequestGraphicsPipelines(
         const VkDevice& device,
-        const VkPipelineVertexInputStateCreateInfo vertex_input_info);
+        const VkPipelineVertexInputStateCreateInfo& vertex_input_info);
     VkShaderModule CreateShader(const QString& name);
+    // Requests the next frame when the redraw controller wants it: right
+    // away, after a delay, or not until something changes.
+    void ScheduleNextFrame();
+    void LogUsage();
+    // Moves the camera and takes its matrix into mvp_, if it changed.
+    void UpdateCamera();
+    // Starts the --benchmark-json report with the scene's parameters.
+    void CreateBenchmarkReport();
+    // Adds the memory usage, which has to happen before the memory is
+    // released, and writes the report once the profiler has flushed the
+    // last frames into it.
+    void AddBenchmarkMemoryUsage();
+    void WriteBenchmarkReport();
+    void CreatePipelineCache(const VkDevice& device);
+    void SavePipelineCache(const VkDevice& device);
 
-    QVulkanWindow& window_;
+    RenderTarget& target_;
+    const RendererOptions options_;
     QVulkanDeviceFunctions* device_functions_;
 
-    const VkClearValue clear_values_{{{0.0F, 0.0F, 0.0F, 1.0F}}};
-    VkBuffer buffer_;
-    VkDeviceMemory device_memory_;
+    // color and depth-stencil attachment of the default render pass
+    VkClearValue clear_values_[2];
+
+    VkPhysicalDeviceMemoryProperties memory_properties_;
+    // device-local buffers are sub-allocated from large blocks
+    DeviceMemoryAllocator memory_allocator_;
+
+    // per-frame uniforms, written into the frame's region of the arena
+    // every frame and picked with a dynamic offset
+    FrameArena uniform_arena_;
+    VkDescriptorBufferInfo uniform_buffer_info_;
+    std::uint32_t uniform_offset_;  // of the frame being recorded
+    glm::mat4 mvp_;
+
+    // device-local static geometry, filled through the staging uploader
+    StagingUploader uploader_;
+    VkBuffer vertex_buffer_;
+    MemoryAllocation vertex_memory_;
+    VkBuffer index_buffer_;
+    MemoryAllocation index_memory_;
+    std::vector<MeshLod> lods_;  // finest first, counts grow while streaming
+    BoundingSphere mesh_bounds_;
+    // With --quantized-vertices the vertex buffer holds QuantizedVertex
+    // entries, decoded with position_dequantization_ (a push constant).
+    // Float meshes keep the identity.
+    bool quantized_vertices_;
+    PositionDequantization position_dequantization_;
+    MeshStreamer mesh_streamer_;
+    QElapsedTimer stream_timer_;
+    // With a transfer queue (and timeline semaphores), streamed meshlets
+    // are copied there while the frames render. A batch is drawn once its
+    // value on transfer_uploader_'s timeline completed, and every frame
+    // after that waits for stream_wait_value_ on the GPU, which costs
+    // nothing once it is reached but makes the copies visible.
+    struct StreamBatch
+    {
+        std::uint64_t value;
+        std::uint32_t index_count;  // resident with this batch
+    };
+    StagingUploader transfer_uploader_;
+    bool transfer_streaming_;
+    std::deque<StreamBatch> stream_batches_;
+    std::uint64_t stream_wait_value_;
+
+    // Materials of the scene (--materials): a storage buffer with one
+    // MaterialData per material and their textures, all in one resource
+    // table that the shaders index by the material of the draw, a push
+    // constant. Instance i uses material i / instances_per_material_.
+    BindlessTable resource_table_;
+    std::vector<MaterialData> materials_;
+    VkBuffer material_buffer_;
+    MemoryAllocation material_memory_;
+    std::vector<VkImage> textures_;
+    std::vector<MemoryAllocation> texture_memory_;
+    std::vector<VkImageView> texture_views_;
+    VkSampler texture_sampler_;
+    std::uint32_t instances_per_material_;
+
+    // per-instance attributes, one slot per frame so they can change every
+    // frame without waiting for the GPU
+    MappedRingBuffer instance_ring_;
+    std::vector<InstanceData> instances_;
+    std::uint32_t instance_dirty_frames_;  // bit i: slot i needs instances_
+    std::vector<DrawCommand> draws_;
+
+    // CPU visibility: the world-space bounding sphere of every instance is
+    // tested against the frustum each frame, and the instances that pass
+    // get a LOD by their projected size.
+    BoundingSpheres instance_bounds_;
+    VisibilityCuller culler_;
+    CullSettings cull_settings_;
+    std::vector<VisibleObject> visible_;
+    // with --gpu-culling, draws_ holds a single placeholder entry that
+    // stands for the indirect draws
+    GpuCuller gpu_culler_;
+    // --particles, drawn after the instances with particle_pipeline_
+    ParticleSystem particles_;
+    // --output in a window, headless targets read their frames back
+    // themselves
+    std::unique_ptr<FrameWriter> capture_writer_;
+    FrameCapture capture_;
+
+    // Parallel recording with --workers: the draw list is split into one
+    // partition per worker, each recorded into a secondary command buffer
+    // from its own pool per frame, indexed frame * partition_count_ + p.
+    std::unique_ptr<WorkerPool> worker_pool_;
+    int partition_count_;
+    std::vector<VkCommandPool> record_pools_;
+    std::vector<VkCommandBuffer> secondary_buffers_;
 
-    VkDescriptorBufferInfo
-        uniform_buffer_info_[QVulkanWindow::MAX_CONCURRENT_FRAME_COUNT];
     VkDescriptorPool descriptor_pool_;
     VkDescriptorSetLayout descriptor_set_layout_;
-    VkDescriptorSet descriptor_set_[QVulkanWindow::MAX_CONCURRENT_FRAME_COUNT];
+    VkDescriptorSet descriptor_set_;
+
+    FrameProfiler profiler_;
+    // with --benchmark-json, fed by the profiler and written on release
+    std::unique_ptr<BenchmarkReport> benchmark_report_;
 
+    PipelineCacheStore pipeline_cache_store_;
     VkPipelineCache pipeline_cache_;
     VkPipelineLayout pipeline_layout_;
-    VkPipeline pipeline_;
+    // Compiled in the background. Frames are drawn with the unlit fallback
+    // until the scene pipeline is ready, and not at all before that.
+    // --pipeline-variants adds permutations that are only compiled.
+    PipelineManager pipeline_manager_;
+    int fallback_pipeline_;
+    int scene_pipeline_;
+    int particle_pipeline_;
+    VkPipeline frame_pipeline_;  // picked at the start of every frame
+    bool pipeline_cache_warm_;
+
+    // Frame pacing of the window, see --redraw. The timer requests delayed
+    // frames, the usage timer logs the load with --log-usage.
+    RedrawController redraw_;
+    QElapsedTimer redraw_clock_;
+    QTimer redraw_timer_;
+    QTimer usage_timer_;
+    std::clock_t usage_cpu_start_;
+    qint64 usage_wall_start_ns_;
+    std::uint64_t usage_frames_start_;
+
+    // feeds mvp_, which stays untouched while the camera is still
+    Camera camera_;
+    double camera_time_ms_;  // on redraw_clock_, of the last update
+    std::int64_t orbit_frame_;  // frames since the last --orbit-every turn
 };
 
 class VulkanWindow : public QVulkanWindow
 {
   public:
+    explicit VulkanWindow(const RendererOptions& options)
+        : options_(options), render_target_(*this), renderer_{nullptr},
+          move_keys_{0}
+    {
+        // for GPU culling, only enabled if the device supports it
+        setDeviceExtensions(QByteArrayList()
+                            << VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+        if (options.frames_in_flight > MAX_CONCURRENT_FRAME_COUNT)
+        {
+            qWarning("--frames-in-flight: the window renders at most %d",
+                     MAX_CONCURRENT_FRAME_COUNT);
+        }
+        setPreferredConcurrentFrameCount(std::min<int>(
+            options.frames_in_flight, MAX_CONCURRENT_FRAME_COUNT));
+    }
+
     QVulkanWindowRenderer* createRenderer() override
     {
-        return new VulkanRenderer(*this);
+        renderer_ = new VulkanRenderer(render_target_, options_);
+        return renderer_;
     }
 
   protected:
-    void keyPressEvent(QKeyEvent*) override { close(); }
+    // Left drag orbits (or looks around in fly mode), the wheel zooms. Keys:
+    // Tab switches between orbit and fly mode, R resets the camera, W/A/S/D
+    // and Q/E move in fly mode, Escape closes the window.
+    void mousePressEvent(QMouseEvent* event) override;
+    void mouseMoveEvent(QMouseEvent* event) override;
+    void wheelEvent(QWheelEvent* event) override;
+    void keyPressEvent(QKeyEvent* event) override;
+    void keyReleaseEvent(QKeyEvent* event) override;
+
+  private:
+    // Bit of a held movement key, 0 for other keys.
+    static int MoveKey(int key);
+    void UpdateMoveDirection();
+
+    const RendererOptions options_;
+    WindowRenderTarget render_target_;
+    VulkanRenderer* renderer_;  // owned by QVulkanWindow
+    QPoint last_mouse_position_;
+    int move_keys_;  // MoveKey() bits of the keys held down
 };
 
 class VulkanApplication : public QGuiApplication
 {
   public:
-    VulkanApplication(int& argc, char**& argv) : QGuiApplication(argc, argv)
+    VulkanApplication(int& argc, char**& argv)
+        : QGuiApplication(argc, argv),
+          options_(ParseRendererOptions(arguments()))
     {
         // Enable validation layer, if supported. Messages go to qDebug by
         // default.
@@ -130,18 +413,33 @@ class VulkanApplication : public QGuiApplication
                                    << "VK_LAYER_LUNARG_image"
                                    << "VK_LAYER_LUNARG_swapchain"
                                    << "VK_LAYER_GOOGLE_unique_objects");
+        // to query optional device features, ignored where unsupported
+        vulkan_instance_.setExtensions(
+            QByteArrayList()
+            << VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME);
         if (!vulkan_instance_.create())
         {
             qFatal("Failed to create vulkan instance: %d",
                    vulkan_instance_.errorCode());
         }
-        vulkan_window_.setVulkanInstance(&vulkan_instance_);
-        vulkan_window_.showMaximized();
+        if (!options_.headless)
+        {
+            vulkan_window_ = std::make_unique<VulkanWindow>(options_);
+            vulkan_window_->setVulkanInstance(&vulkan_instance_);
+            vulkan_window_->showMaximized();
+        }
     }
 
+    // Runs the event loop, or the headless render loop with --headless.
+    int Run();
+
   private:
+    // Renders options_.frames frames offscreen as fast as possible.
+    int RunHeadless();
+
+    const RendererOptions options_;
     QVulkanInstance vulkan_instance_;
-    VulkanWindow vulkan_window_;
+    std::unique_ptr<VulkanWindow> vulkan_window_;
 };
 
 #endif  // VULKAN_APPLICATION_H
@@ -0,0 +1,34 @@
+#ifndef VULKAN_QT_INCLUDE_VULKAN_UTILS_H
+#define VULKAN_QT_INCLUDE_VULKAN_UTILS_H
+
+#include <QtGui/QVulkanInstance>
+#include <cstdint>
+
+// Rounds v up to a multiple of byte_align, which must be a power of two.
+static constexpr inline VkDeviceSize aligned(VkDeviceSize v,
+                                             VkDeviceSize byte_align)
+{
+    return (v + byte_align - 1) & ~(byte_align - 1);
+}
+
+// Returns preferred_index if it is allowed by type_bits, otherwise the first
+// allowed memory type that has all of the required flags, or UINT32_MAX.
+inline std::uint32_t FindMemoryType(
+    const VkPhysicalDeviceMemoryProperties& memory_properties,
+    std::uint32_t type_bits, std::uint32_t preferred_index,
+    VkMemoryPropertyFlags required)
+{
+    if (preferred_index < memory_properties.memoryTypeCount &&
+        (type_bits & (1u << preferred_index)))
+        return preferred_index;
+    for (std::uint32_t i = 0; i < memory_properties.memoryTypeCount; ++i)
+    {
+        if ((type_bits & (1u << i)) &&
+            (memory_properties.memoryTypes[i].propertyFlags & required) ==
+                required)
+            return i;
+    }
+    return UINT32_MAX;
+}
+
+#endif  // VULKAN_QT_INCLUDE_VULKAN_UTILS_H
@@ -0,0 +1,51 @@
+#ifndef VULKAN_QT_INCLUDE_WORKER_POOL_H
+#define VULKAN_QT_INCLUDE_WORKER_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// A fixed set of threads for fork-join loops. The thread calling
+// ParallelFor works on the loop as well, so a pool of thread_count threads
+// starts thread_count - 1 of its own.
+class WorkerPool
+{
+  public:
+    explicit WorkerPool(int thread_count);
+    // Waits for the threads to exit. Must not be called during ParallelFor.
+    ~WorkerPool();
+
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    // Calls task(index) once for every index in [0, count), spread over all
+    // threads, and returns when all calls have returned. Indices are handed
+    // out one at a time, so any thread may run any index.
+    void ParallelFor(int count, const std::function<void(int)>& task);
+
+    int thread_count() const { return static_cast<int>(threads_.size()) + 1; }
+
+  private:
+    void Run();
+    void RunTasks();
+
+    std::vector<std::thread> threads_;
+
+    std::mutex mutex_;
+    std::condition_variable work_ready_;
+    std::condition_variable work_done_;
+    std::uint64_t generation_;  // incremented for every ParallelFor
+    int busy_threads_;          // pool threads still in the current loop
+    bool stopping_;
+
+    // the current loop, set before generation_ is incremented
+    const std::function<void(int)>* task_;
+    int count_;
+    std::atomic<int> next_index_;
+};
+
+#endif  // VULKAN_QT_INCLUDE_WORKER_POOL_H
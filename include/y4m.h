@@ -0,0 +1,27 @@
+#ifndef VULKAN_QT_INCLUDE_Y4M_H
+#define VULKAN_QT_INCLUDE_Y4M_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Raw YUV4MPEG2 video (--output-format y4m), which players and encoders
+// like ffmpeg read directly: one stream header, then every frame as
+// "FRAME\n" followed by its Y, U and V planes. Frames are 4:2:0 with the
+// chroma planes half the size, rounded up, in each direction.
+
+// Stream header for frames of width x height at frame_rate frames/s,
+// including the trailing newline.
+std::string Y4mHeader(int width, int height, int frame_rate);
+
+// Bytes of the three planes of one frame, without the "FRAME\n" line.
+std::size_t Y4mFrameSize(int width, int height);
+
+// Converts rows of RGBA (or RGBX) pixels, stride bytes apart, into the
+// planes of one frame at out, Y4mFrameSize() bytes. BT.601 with video
+// range (Y 16-235), what players assume for untagged YUV. Every chroma
+// sample is the average of the 2x2 pixels it covers, fewer at odd edges.
+void RgbaToI420(const std::uint8_t* rgba, int width, int height,
+                std::size_t stride, std::uint8_t* out);
+
+#endif  // VULKAN_QT_INCLUDE_Y4M_H
@@ -0,0 +1,25 @@
+#version 440
+
+// Particles straight from the storage buffer of particles.comp, drawn as
+// points colored by their speed.
+layout(location = 0) in vec4 position;
+layout(location = 1) in vec4 velocity;
+
+layout(location = 0) out vec3 vertex_color;
+
+layout(std140, binding = 0) uniform buf {
+    mat4 mvp;
+} ubuf;
+
+out gl_PerVertex {
+    vec4 gl_Position;
+    float gl_PointSize;
+};
+
+void main()
+{
+    float speed = clamp(length(velocity.xyz), 0.0, 1.0);
+    vertex_color = mix(vec3(0.2, 0.4, 1.0), vec3(1.0, 0.8, 0.3), speed);
+    gl_Position = ubuf.mvp * vec4(position.xyz, 1.0);
+    gl_PointSize = 1.0;
+}
@@ -1,10 +1,36 @@
 #version 440
 
 layout(location = 0) in vec3 vertex_color;
+layout(location = 1) in vec2 vertex_uv;
+layout(location = 2) flat in uint vertex_material;
 
 layout(location = 0) out vec4 fragment_color;
 
+// Permutation index of --pipeline-variants, 0 for the scene. The others
+// rotate the color channels a little, so they compile to different code.
+layout(constant_id = 1) const uint variant = 0u;
+
+// The resource table (see BindlessTable): the material table in buffer slot
+// 0 and all textures. Without descriptor indexing there is only one texture,
+// the one of the bound set, and texture_count is 1.
+layout(constant_id = 2) const uint texture_count = 1u;
+
+struct Material {
+    vec4 tint;
+    uint texture;
+};
+
+layout(std430, set = 1, binding = 0) readonly buffer Materials {
+    Material materials[];
+};
+layout(set = 1, binding = 1) uniform sampler2D textures[texture_count];
+
 void main()
 {
-    fragment_color = vec4(vertex_color, 1.0);
+    Material material = materials[vertex_material];
+    uint slot = texture_count > 1u ? material.texture : 0u;
+    vec3 color = vertex_color * material.tint.rgb *
+                 texture(textures[slot], vertex_uv).rgb;
+    if (variant > 0u) color = mix(color, color.gbr, float(variant % 4u) / 4.0);
+    fragment_color = vec4(color, 1.0);
 }
\ No newline at end of file
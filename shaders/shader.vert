@@ -1,18 +1,61 @@
 #version 440
 
+// Float vertices, or quantized ones (see vertex_quantization.h): positions
+// in [-1, 1] relative to the mesh bounds and octahedral normals in xy.
 layout(location = 0) in vec4 position;
 layout(location = 1) in vec3 color;
+layout(location = 7) in vec3 normal;
+
+// per instance, locations 2-5 hold the columns of the matrix
+layout(location = 2) in mat4 instance_model;
+layout(location = 6) in vec4 instance_color;
 
 layout(location = 0) out vec3 vertex_color;
+layout(location = 1) out vec2 vertex_uv;
+layout(location = 2) flat out uint vertex_material;
+
+// 0 for the fallback pipeline, which skips the shading
+layout(constant_id = 0) const bool lit = true;
+layout(constant_id = 3) const bool quantized = false;
 
 layout(std140, binding = 0) uniform buf {
     mat4 mvp;
 } ubuf;
 
+// The material of the draw, an index into the material table. Draws that
+// leave it at ~0u (the GPU-culled ones) take the one of their instance,
+// instances get materials in runs of instances_per_material. Positions are
+// position_offset + position_scale * position, the identity for floats.
+layout(push_constant) uniform Draw {
+    uint material;
+    uint instances_per_material;
+    vec4 position_offset;
+    vec4 position_scale;
+} draw;
+
 out gl_PerVertex { vec4 gl_Position; };
 
+vec3 DecodeOctahedral(vec2 encoded)
+{
+    vec3 n = vec3(encoded, 1.0 - abs(encoded.x) - abs(encoded.y));
+    float t = max(-n.z, 0.0);
+    n.xy += mix(vec2(t), vec2(-t), greaterThanEqual(n.xy, vec2(0.0)));
+    return n;
+}
+
 void main()
 {
-    vertex_color = color;
-    gl_Position = ubuf.mvp * position;
-}
\ No newline at end of file
+    vec4 model_position = vec4(
+        draw.position_offset.xyz + draw.position_scale.xyz * position.xyz,
+        1.0);
+    vec3 model_normal = quantized ? DecodeOctahedral(normal.xy) : normal;
+    // Simple two-sided shading in model space, faces toward +-z (like the
+    // built-in triangle) keep their full color.
+    float shade = lit ? 0.3 + 0.7 * abs(normalize(model_normal).z) : 1.0;
+    vertex_color = color * instance_color.rgb * shade;
+    vertex_uv = model_position.xy + 0.5;
+    vertex_material = draw.material != 0xffffffffu
+        ? draw.material
+        : uint(gl_InstanceIndex) / draw.instances_per_material;
+    gl_Position = ubuf.mvp * instance_model * model_position;
+}
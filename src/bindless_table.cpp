@@ -0,0 +1,190 @@
+#include "bindless_table.h"
+
+BindlessTable::BindlessTable()
+    : device_functions_{nullptr},
+      device_{VK_NULL_HANDLE},
+      bindless_{false},
+      buffer_capacity_{0},
+      texture_capacity_{0},
+      pool_{VK_NULL_HANDLE},
+      layout_{VK_NULL_HANDLE}
+{
+}
+
+void BindlessTable::Create(QVulkanDeviceFunctions* device_functions,
+                           VkDevice device, bool descriptor_indexing,
+                           std::uint32_t buffer_capacity,
+                           std::uint32_t texture_capacity,
+                           VkShaderStageFlags stages)
+{
+    device_functions_ = device_functions;
+    device_ = device;
+    bindless_ = descriptor_indexing;
+    buffer_capacity_ = buffer_capacity;
+    texture_capacity_ = texture_capacity;
+
+    const VkDescriptorSetLayoutBinding bindings[] = {
+        {0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, buffer_capacity, stages,
+         nullptr},
+        {1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+         bindless_ ? texture_capacity : 1, stages, nullptr}};
+    VkDescriptorSetLayoutCreateInfo layout_info{};
+    layout_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layout_info.bindingCount = 2;
+    layout_info.pBindings = bindings;
+
+    VkDescriptorPoolCreateInfo pool_info{};
+    pool_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    VkDescriptorPoolSize pool_sizes[2];
+    const VkDescriptorBindingFlagsEXT binding_flags[] = {
+        VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT_EXT |
+            VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT_EXT,
+        VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT_EXT |
+            VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT_EXT};
+    VkDescriptorSetLayoutBindingFlagsCreateInfoEXT flags_info{};
+    if (bindless_)
+    {
+        flags_info.sType =
+            VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO_EXT;
+        flags_info.bindingCount = 2;
+        flags_info.pBindingFlags = binding_flags;
+        layout_info.pNext = &flags_info;
+        layout_info.flags =
+            VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT_EXT;
+        pool_info.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT_EXT;
+        pool_info.maxSets = 1;
+        pool_sizes[0] = {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, buffer_capacity};
+        pool_sizes[1] = {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                         texture_capacity};
+    }
+    else
+    {
+        pool_info.maxSets = texture_capacity;
+        pool_sizes[0] = {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                         buffer_capacity * texture_capacity};
+        pool_sizes[1] = {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                         texture_capacity};
+    }
+    pool_info.poolSizeCount = 2;
+    pool_info.pPoolSizes = pool_sizes;
+
+    auto err = device_functions_->vkCreateDescriptorSetLayout(
+        device_, &layout_info, nullptr, &layout_);
+    if (err != VK_SUCCESS)
+        qFatal("Failed to create bindless set layout: %d", err);
+    err = device_functions_->vkCreateDescriptorPool(device_, &pool_info,
+                                                    nullptr, &pool_);
+    if (err != VK_SUCCESS) qFatal("Failed to create bindless pool: %d", err);
+
+    if (bindless_)
+    {
+        const VkDescriptorSetAllocateInfo allocate_info = {
+            VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO, nullptr, pool_, 1,
+            &layout_};
+        sets_.resize(1);
+        err = device_functions_->vkAllocateDescriptorSets(
+            device_, &allocate_info, sets_.data());
+        if (err != VK_SUCCESS)
+            qFatal("Failed to allocate bindless set: %d", err);
+    }
+    qDebug("resource table: %s, %u buffers, %u textures",
+           bindless_ ? "bindless" : "one set per texture", buffer_capacity,
+           texture_capacity);
+}
+
+void BindlessTable::Release()
+{
+    if (!device_functions_) return;
+    // destroying the pool frees the sets
+    if (pool_)
+        device_functions_->vkDestroyDescriptorPool(device_, pool_, nullptr);
+    if (layout_)
+    {
+        device_functions_->vkDestroyDescriptorSetLayout(device_, layout_,
+                                                        nullptr);
+    }
+    pool_ = VK_NULL_HANDLE;
+    layout_ = VK_NULL_HANDLE;
+    sets_.clear();
+    buffers_.clear();
+    textures_.clear();
+    device_functions_ = nullptr;
+}
+
+std::uint32_t BindlessTable::AddBuffer(VkBuffer buffer, VkDeviceSize offset,
+                                       VkDeviceSize range)
+{
+    const auto slot = static_cast<std::uint32_t>(buffers_.size());
+    if (slot == buffer_capacity_) qFatal("Resource table is out of buffers");
+    buffers_.push_back({buffer, offset, range});
+    for (VkDescriptorSet set : sets_) WriteBuffer(set, slot);
+    return slot;
+}
+
+std::uint32_t BindlessTable::AddTexture(VkImageView view, VkSampler sampler)
+{
+    const auto slot = static_cast<std::uint32_t>(textures_.size());
+    if (slot == texture_capacity_) qFatal("Resource table is out of textures");
+    textures_.push_back(
+        {sampler, view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL});
+    if (bindless_)
+    {
+        WriteTexture(sets_[0], slot, slot);
+        return slot;
+    }
+
+    // a set of its own, with all buffers
+    VkDescriptorSet set{};
+    const VkDescriptorSetAllocateInfo allocate_info = {
+        VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO, nullptr, pool_, 1,
+        &layout_};
+    const auto err =
+        device_functions_->vkAllocateDescriptorSets(device_, &allocate_info,
+                                                    &set);
+    if (err != VK_SUCCESS) qFatal("Failed to allocate texture set: %d", err);
+    sets_.push_back(set);
+    for (std::uint32_t buffer = 0; buffer < buffers_.size(); ++buffer)
+        WriteBuffer(set, buffer);
+    WriteTexture(set, 0, slot);
+    return slot;
+}
+
+void BindlessTable::Bind(VkCommandBuffer command_buffer,
+                         VkPipelineLayout layout, std::uint32_t set,
+                         std::uint32_t texture, std::uint32_t* bound) const
+{
+    // the bindless set serves every texture
+    if (bindless_) texture = 0;
+    if (*bound == texture || texture >= sets_.size()) return;
+    device_functions_->vkCmdBindDescriptorSets(
+        command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, layout, set, 1,
+        &sets_[texture], 0, nullptr);
+    *bound = texture;
+}
+
+void BindlessTable::WriteBuffer(VkDescriptorSet set, std::uint32_t slot) const
+{
+    VkWriteDescriptorSet write{};
+    write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    write.dstSet = set;
+    write.dstBinding = 0;
+    write.dstArrayElement = slot;
+    write.descriptorCount = 1;
+    write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    write.pBufferInfo = &buffers_[slot];
+    device_functions_->vkUpdateDescriptorSets(device_, 1, &write, 0, nullptr);
+}
+
+void BindlessTable::WriteTexture(VkDescriptorSet set, std::uint32_t element,
+                                 std::uint32_t slot) const
+{
+    VkWriteDescriptorSet write{};
+    write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    write.dstSet = set;
+    write.dstBinding = 1;
+    write.dstArrayElement = element;
+    write.descriptorCount = 1;
+    write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    write.pImageInfo = &textures_[slot];
+    device_functions_->vkUpdateDescriptorSets(device_, 1, &write, 0, nullptr);
+}
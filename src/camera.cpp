@@ -0,0 +1,177 @@
+#include "camera.h"
+
+#include <algorithm>
+#include <cmath>
+#include <glm/ext/matrix_transform.hpp>  // glm::translate, glm::rotate
+#include <glm/vec3.hpp>
+
+#include "graphics.h"
+
+namespace
+{
+constexpr float initial_distance{2.0f};
+constexpr float min_distance{0.2f};
+constexpr float max_distance{50.0f};
+constexpr float max_pitch{1.55f};  // just short of 90 degrees
+constexpr float zoom_step{0.9f};   // distance factor per wheel step
+constexpr float fly_step{0.1f};    // units per wheel step in fly mode
+
+// Flips y and maps depth from [-1, 1] to [0, 1], like
+// QVulkanWindow::clipCorrectionMatrix().
+glm::mat4 ClipCorrection()
+{
+    glm::mat4 correction(1.0f);
+    correction[1][1] = -1.0f;
+    correction[2][2] = 0.5f;
+    correction[3][2] = 0.5f;
+    return correction;
+}
+}  // namespace
+
+Camera::Camera()
+    : mode_{CameraMode::kOrbit},
+      aspect_{1.0f},
+      distance_{initial_distance},
+      rotate_x_{0.0f},
+      rotate_y_{0.0f},
+      position_{0.0f, 0.0f, initial_distance},
+      yaw_{0.0f},
+      pitch_{0.0f},
+      move_{0.0f, 0.0f, 0.0f},
+      speed_{1.0f},
+      projection_dirty_{true},
+      view_dirty_{true},
+      projection_(1.0f),
+      view_(1.0f),
+      view_projection_(1.0f),
+      projection_builds_{0},
+      view_builds_{0}
+{
+}
+
+void Camera::SetViewport(int width, int height)
+{
+    const float aspect =
+        height > 0 ? static_cast<float>(width) / height : 1.0f;
+    if (aspect == aspect_) return;
+    aspect_ = aspect;
+    projection_dirty_ = true;
+}
+
+void Camera::SetMode(CameraMode mode)
+{
+    if (mode == mode_) return;
+    if (mode == CameraMode::kFly)
+    {
+        // the fly pose with the same view as the orbit
+        const float cos_x = std::cos(rotate_x_);
+        position_[0] = -distance_ * cos_x * std::sin(rotate_y_);
+        position_[1] = -distance_ * std::sin(rotate_x_);
+        position_[2] = distance_ * cos_x * std::cos(rotate_y_);
+        yaw_ = -rotate_y_;
+        pitch_ = rotate_x_;
+    }
+    std::fill(move_, move_ + 3, 0.0f);
+    mode_ = mode;
+    view_dirty_ = true;
+}
+
+void Camera::Reset()
+{
+    mode_ = CameraMode::kOrbit;
+    distance_ = initial_distance;
+    rotate_x_ = rotate_y_ = 0.0f;
+    std::fill(move_, move_ + 3, 0.0f);
+    view_dirty_ = true;
+}
+
+void Camera::Rotate(float yaw, float pitch)
+{
+    if (mode_ == CameraMode::kOrbit)
+    {
+        rotate_y_ += yaw;
+        rotate_x_ = std::clamp(rotate_x_ + pitch, -max_pitch, max_pitch);
+    }
+    else
+    {
+        yaw_ += yaw;
+        pitch_ = std::clamp(pitch_ + pitch, -max_pitch, max_pitch);
+    }
+    view_dirty_ = true;
+}
+
+void Camera::Zoom(float steps)
+{
+    if (mode_ == CameraMode::kOrbit)
+    {
+        distance_ = std::clamp(distance_ * std::pow(zoom_step, steps),
+                               min_distance, max_distance);
+        view_dirty_ = true;
+        return;
+    }
+    const float forward = move_[2];
+    move_[2] = 1.0f;
+    Advance(steps * fly_step / speed_);
+    move_[2] = forward;
+}
+
+void Camera::SetMoveDirection(float right, float up, float forward)
+{
+    move_[0] = right;
+    move_[1] = up;
+    move_[2] = forward;
+}
+
+void Camera::Advance(float seconds)
+{
+    if (!moving() || seconds == 0.0f) return;
+    // forward is -z turned by pitch and yaw, right is +x turned by yaw
+    const float cos_pitch = std::cos(pitch_);
+    const float forward[3] = {-std::sin(yaw_) * cos_pitch, std::sin(pitch_),
+                              -std::cos(yaw_) * cos_pitch};
+    const float right[3] = {std::cos(yaw_), 0.0f, -std::sin(yaw_)};
+    const float up[3] = {0.0f, 1.0f, 0.0f};
+    const float step = speed_ * seconds;
+    for (int k = 0; k < 3; ++k)
+    {
+        position_[k] += step * (move_[0] * right[k] + move_[1] * up[k] +
+                                move_[2] * forward[k]);
+    }
+    view_dirty_ = true;
+}
+
+bool Camera::moving() const
+{
+    return mode_ == CameraMode::kFly &&
+           (move_[0] != 0.0f || move_[1] != 0.0f || move_[2] != 0.0f);
+}
+
+bool Camera::Update()
+{
+    if (!projection_dirty_ && !view_dirty_) return false;
+    if (projection_dirty_)
+    {
+        projection_ = ClipCorrection() * GetProjectionMatrix(aspect_);
+        projection_dirty_ = false;
+        ++projection_builds_;
+    }
+    if (view_dirty_)
+    {
+        if (mode_ == CameraMode::kOrbit)
+        {
+            view_ = GetViewMatrix(distance_, rotate_x_, rotate_y_);
+        }
+        else
+        {
+            view_ = glm::rotate(glm::mat4(1.0f), -pitch_,
+                                glm::vec3(1.0f, 0.0f, 0.0f));
+            view_ = glm::rotate(view_, -yaw_, glm::vec3(0.0f, 1.0f, 0.0f));
+            view_ = glm::translate(
+                view_, glm::vec3(-position_[0], -position_[1], -position_[2]));
+        }
+        view_dirty_ = false;
+        ++view_builds_;
+    }
+    view_projection_ = projection_ * view_;
+    return true;
+}
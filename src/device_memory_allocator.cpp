@@ -0,0 +1,503 @@
+#include "device_memory_allocator.h"
+
+#include <algorithm>
+#include <map>
+#include <utility>
+
+#include "vulkan_utils.h"
+
+DeviceMemoryAllocator::DeviceMemoryAllocator()
+    : device_functions_{nullptr},
+      device_{VK_NULL_HANDLE},
+      limits_{},
+      memory_properties_{},
+      block_size_{0},
+      dedicated_count_{0},
+      dedicated_bytes_{0}
+{
+}
+
+void DeviceMemoryAllocator::Create(
+    QVulkanDeviceFunctions* device_functions, VkDevice device,
+    const VkPhysicalDeviceProperties& device_properties,
+    const VkPhysicalDeviceMemoryProperties& memory_properties,
+    VkDeviceSize block_size)
+{
+    device_functions_ = device_functions;
+    device_ = device;
+    limits_ = device_properties.limits;
+    memory_properties_ = memory_properties;
+    block_size_ = block_size;
+}
+
+void DeviceMemoryAllocator::Release()
+{
+    if (!device_functions_) return;
+    const MemoryStats stats = Stats();
+    if (stats.allocation_count > 0 || dedicated_count_ > 0)
+    {
+        qWarning("Releasing the memory allocator with %zu allocation(s) left",
+                 stats.allocation_count + dedicated_count_);
+    }
+    for (std::size_t i = 0; i < blocks_.size(); ++i)
+        FreeBlock(static_cast<std::int32_t>(i));
+    blocks_.clear();
+    device_functions_ = nullptr;
+}
+
+bool DeviceMemoryAllocator::Allocate(const VkMemoryRequirements& requirements,
+                                     std::uint32_t preferred_type,
+                                     VkMemoryPropertyFlags required,
+                                     ResourceKind kind,
+                                     MemoryAllocation* allocation)
+{
+    const std::uint32_t memory_type =
+        FindMemoryType(memory_properties_, requirements.memoryTypeBits,
+                       preferred_type, required);
+    if (memory_type == UINT32_MAX) return false;
+
+    VkDeviceSize size = requirements.size;
+    VkDeviceSize alignment = std::max<VkDeviceSize>(requirements.alignment, 1);
+    if (!IsCoherent(memory_type))
+    {
+        // whole atoms, so flushing one allocation never touches another
+        const VkDeviceSize atom_size =
+            std::max<VkDeviceSize>(limits_.nonCoherentAtomSize, 1);
+        alignment = std::max(alignment, atom_size);
+        size = aligned(size, atom_size);
+    }
+
+    if (size > BlockSize(memory_type) / 2)
+        return AllocateDedicated(size, memory_type, allocation);
+    if (AllocateFromBlocks(size, alignment, memory_type, kind, allocation))
+        return true;
+    if (CreateBlock(memory_type, kind) < 0) return false;
+    return AllocateFromBlocks(size, alignment, memory_type, kind, allocation);
+}
+
+void DeviceMemoryAllocator::Free(MemoryAllocation* allocation)
+{
+    if (!allocation->memory) return;
+    if (allocation->block < 0)
+    {
+        device_functions_->vkFreeMemory(device_, allocation->memory, nullptr);
+        --dedicated_count_;
+        dedicated_bytes_ -= allocation->size;
+    }
+    else
+    {
+        Block& block = blocks_[allocation->block];
+        block.ranges->Free(allocation->offset);
+        // keep the last block of a pool around, it is likely needed again
+        if (block.ranges->allocation_count() == 0 &&
+            HasSiblingBlock(allocation->block))
+            FreeBlock(allocation->block);
+    }
+    *allocation = MemoryAllocation{};
+}
+
+void DeviceMemoryAllocator::CreateBuffer(
+    VkDeviceSize size, VkBufferUsageFlags usage, std::uint32_t preferred_type,
+    VkMemoryPropertyFlags required, VkBuffer* buffer,
+    MemoryAllocation* allocation,
+    const std::vector<std::uint32_t>& queue_families)
+{
+    VkBufferCreateInfo buffer_info{};
+    buffer_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    buffer_info.size = size;
+    buffer_info.usage = usage;
+    if (queue_families.size() > 1)
+    {
+        buffer_info.sharingMode = VK_SHARING_MODE_CONCURRENT;
+        buffer_info.queueFamilyIndexCount =
+            static_cast<std::uint32_t>(queue_families.size());
+        buffer_info.pQueueFamilyIndices = queue_families.data();
+    }
+    auto err = device_functions_->vkCreateBuffer(device_, &buffer_info,
+                                                 nullptr, buffer);
+    if (err != VK_SUCCESS) qFatal("Failed to create buffer: %d", err);
+
+    VkMemoryRequirements memory_requirements{};
+    device_functions_->vkGetBufferMemoryRequirements(device_, *buffer,
+                                                     &memory_requirements);
+    memory_requirements.alignment =
+        std::max(memory_requirements.alignment, BufferAlignment(usage));
+    if (!Allocate(memory_requirements, preferred_type, required,
+                  ResourceKind::kLinear, allocation))
+        qFatal("Failed to allocate %llu bytes of buffer memory",
+               static_cast<unsigned long long>(memory_requirements.size));
+
+    err = device_functions_->vkBindBufferMemory(
+        device_, *buffer, allocation->memory, allocation->offset);
+    if (err != VK_SUCCESS) qFatal("Failed to bind buffer memory: %d", err);
+}
+
+void DeviceMemoryAllocator::DestroyBuffer(VkBuffer* buffer,
+                                          MemoryAllocation* allocation)
+{
+    if (*buffer) device_functions_->vkDestroyBuffer(device_, *buffer, nullptr);
+    *buffer = VK_NULL_HANDLE;
+    Free(allocation);
+}
+
+void DeviceMemoryAllocator::CreateImage(const VkImageCreateInfo& image_info,
+                                        std::uint32_t preferred_type,
+                                        VkMemoryPropertyFlags required,
+                                        VkImage* image,
+                                        MemoryAllocation* allocation)
+{
+    auto err =
+        device_functions_->vkCreateImage(device_, &image_info, nullptr, image);
+    if (err != VK_SUCCESS) qFatal("Failed to create image: %d", err);
+
+    VkMemoryRequirements memory_requirements{};
+    device_functions_->vkGetImageMemoryRequirements(device_, *image,
+                                                    &memory_requirements);
+    if (!Allocate(memory_requirements, preferred_type, required,
+                  ResourceKind::kOptimal, allocation))
+        qFatal("Failed to allocate %llu bytes of image memory",
+               static_cast<unsigned long long>(memory_requirements.size));
+
+    err = device_functions_->vkBindImageMemory(
+        device_, *image, allocation->memory, allocation->offset);
+    if (err != VK_SUCCESS) qFatal("Failed to bind image memory: %d", err);
+}
+
+void DeviceMemoryAllocator::DestroyImage(VkImage* image,
+                                         MemoryAllocation* allocation)
+{
+    if (*image) device_functions_->vkDestroyImage(device_, *image, nullptr);
+    *image = VK_NULL_HANDLE;
+    Free(allocation);
+}
+
+void DeviceMemoryAllocator::Flush(const MemoryAllocation& allocation,
+                                  VkDeviceSize offset, VkDeviceSize size) const
+{
+    if (size == 0 || IsCoherent(allocation.memory_type)) return;
+    // Non-coherent allocations start and end on atom boundaries, so
+    // rounding outwards stays inside of them.
+    const VkDeviceSize atom_size =
+        std::max<VkDeviceSize>(limits_.nonCoherentAtomSize, 1);
+    const VkDeviceSize begin = offset / atom_size * atom_size;
+    const VkDeviceSize end =
+        std::min(aligned(offset + size, atom_size), allocation.size);
+    const VkMappedMemoryRange range = {
+        VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE, nullptr, allocation.memory,
+        allocation.offset + begin, end - begin};
+    const auto err =
+        device_functions_->vkFlushMappedMemoryRanges(device_, 1, &range);
+    if (err != VK_SUCCESS) qWarning("Failed to flush mapped memory: %d", err);
+}
+
+std::vector<DefragmentationMove> DeviceMemoryAllocator::PlanDefragmentation(
+    const std::vector<MemoryAllocation*>& candidates, VkDeviceSize max_bytes)
+{
+    // the blocks and candidates of every pool, which are planned one by one
+    struct Pool
+    {
+        std::vector<std::int32_t> block_indices;
+        std::vector<TlsfAllocator*> blocks;
+        std::vector<MemoryAllocation*> allocations;
+        std::vector<MovableRange> ranges;
+    };
+    std::map<std::pair<std::uint32_t, ResourceKind>, Pool> pools;
+    std::map<std::int32_t, std::size_t> pool_blocks;  // index in its pool
+    for (std::size_t i = 0; i < blocks_.size(); ++i)
+    {
+        const Block& block = blocks_[i];
+        if (!block.memory) continue;
+        Pool& pool = pools[std::make_pair(block.memory_type, block.kind)];
+        pool_blocks[static_cast<std::int32_t>(i)] = pool.blocks.size();
+        pool.block_indices.push_back(static_cast<std::int32_t>(i));
+        pool.blocks.push_back(block.ranges.get());
+    }
+    for (MemoryAllocation* allocation : candidates)
+    {
+        if (allocation->block < 0) continue;
+        Pool& pool = pools[std::make_pair(allocation->memory_type,
+                                          allocation->kind)];
+        pool.allocations.push_back(allocation);
+        pool.ranges.push_back({pool_blocks[allocation->block],
+                               allocation->size, allocation->alignment});
+    }
+
+    std::vector<DefragmentationMove> moves;
+    VkDeviceSize moved_bytes = 0;
+    for (const auto& entry : pools)
+    {
+        const Pool& pool = entry.second;
+        for (const RangeMove& range_move :
+             PlanRangeMoves(pool.blocks, pool.ranges, max_bytes - moved_bytes))
+        {
+            MemoryAllocation* allocation =
+                pool.allocations[range_move.candidate];
+            DefragmentationMove move{allocation, {}};
+            AssignBlockRange(pool.block_indices[range_move.block],
+                             range_move.offset, allocation->size,
+                             allocation->alignment, &move.destination);
+            moved_bytes += allocation->size;
+            moves.push_back(move);
+        }
+    }
+    return moves;
+}
+
+void DeviceMemoryAllocator::CommitDefragmentation(
+    const std::vector<DefragmentationMove>& moves)
+{
+    for (const DefragmentationMove& move : moves)
+    {
+        Free(move.allocation);
+        *move.allocation = move.destination;
+    }
+}
+
+MemoryStats DeviceMemoryAllocator::Stats() const
+{
+    MemoryStats stats;
+    stats.dedicated_count = dedicated_count_;
+    stats.dedicated_bytes = dedicated_bytes_;
+    VkDeviceSize free_bytes = 0;
+    VkDeviceSize largest_free_bytes = 0;  // summed over the blocks
+    for (const Block& block : blocks_)
+    {
+        if (!block.memory) continue;
+        ++stats.block_count;
+        stats.allocation_count += block.ranges->allocation_count();
+        stats.block_bytes += block.ranges->size();
+        stats.used_bytes += block.ranges->used_bytes();
+        const VkDeviceSize largest = block.ranges->LargestFreeRange();
+        stats.largest_free_range = std::max(stats.largest_free_range, largest);
+        free_bytes += block.ranges->free_bytes();
+        largest_free_bytes += largest;
+    }
+    if (free_bytes > 0)
+    {
+        stats.fragmentation =
+            1.0 - static_cast<double>(largest_free_bytes) / free_bytes;
+    }
+    return stats;
+}
+
+void DeviceMemoryAllocator::LogStats(const char* label) const
+{
+    const MemoryStats stats = Stats();
+    constexpr double mib = 1024.0 * 1024.0;
+    qDebug("%s: %zu allocation(s) in %zu block(s) of %.2f MiB, %.2f MiB "
+           "used, largest free range %.2f MiB, fragmentation %.2f; %zu "
+           "dedicated allocation(s) of %.2f MiB",
+           label, stats.allocation_count, stats.block_count,
+           stats.block_bytes / mib, stats.used_bytes / mib,
+           stats.largest_free_range / mib, stats.fragmentation,
+           stats.dedicated_count, stats.dedicated_bytes / mib);
+}
+
+VkDeviceSize DeviceMemoryAllocator::BufferAlignment(
+    VkBufferUsageFlags usage) const
+{
+    VkDeviceSize alignment = 1;
+    if (usage & VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT)
+        alignment =
+            std::max(alignment, limits_.minUniformBufferOffsetAlignment);
+    if (usage & VK_BUFFER_USAGE_STORAGE_BUFFER_BIT)
+        alignment =
+            std::max(alignment, limits_.minStorageBufferOffsetAlignment);
+    if (usage & (VK_BUFFER_USAGE_UNIFORM_TEXEL_BUFFER_BIT |
+                 VK_BUFFER_USAGE_STORAGE_TEXEL_BUFFER_BIT))
+        alignment =
+            std::max(alignment, limits_.minTexelBufferOffsetAlignment);
+    return alignment;
+}
+
+VkDeviceSize DeviceMemoryAllocator::BlockSize(std::uint32_t memory_type) const
+{
+    const VkDeviceSize heap_size =
+        memory_properties_
+            .memoryHeaps[memory_properties_.memoryTypes[memory_type].heapIndex]
+            .size;
+    return std::min(block_size_, aligned(heap_size / 8, 4096));
+}
+
+bool DeviceMemoryAllocator::AllocateDedicated(VkDeviceSize size,
+                                              std::uint32_t memory_type,
+                                              MemoryAllocation* allocation)
+{
+    VkMemoryAllocateInfo allocate_info = {
+        VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO, nullptr, size, memory_type};
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    auto err = device_functions_->vkAllocateMemory(device_, &allocate_info,
+                                                   nullptr, &memory);
+    if (err != VK_SUCCESS)
+    {
+        qWarning("Failed to allocate memory: %d", err);
+        return false;
+    }
+
+    void* mapped = nullptr;
+    if (memory_properties_.memoryTypes[memory_type].propertyFlags &
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
+    {
+        err = device_functions_->vkMapMemory(device_, memory, 0, VK_WHOLE_SIZE,
+                                             0, &mapped);
+        if (err != VK_SUCCESS) qFatal("Failed to map memory: %d", err);
+    }
+    *allocation = MemoryAllocation{};
+    allocation->memory = memory;
+    allocation->size = size;
+    allocation->mapped = static_cast<quint8*>(mapped);
+    allocation->memory_type = memory_type;
+    ++dedicated_count_;
+    dedicated_bytes_ += size;
+    return true;
+}
+
+bool DeviceMemoryAllocator::AllocateFromBlocks(
+    VkDeviceSize size, VkDeviceSize alignment, std::uint32_t memory_type,
+    ResourceKind kind, MemoryAllocation* allocation)
+{
+    for (std::size_t i = 0; i < blocks_.size(); ++i)
+    {
+        Block& block = blocks_[i];
+        if (!block.memory || block.memory_type != memory_type ||
+            block.kind != kind)
+            continue;
+        const std::uint64_t offset = block.ranges->Allocate(size, alignment);
+        if (offset == invalid_offset) continue;
+        AssignBlockRange(static_cast<std::int32_t>(i), offset, size, alignment,
+                         allocation);
+        return true;
+    }
+    return false;
+}
+
+void DeviceMemoryAllocator::AssignBlockRange(
+    std::int32_t block, VkDeviceSize offset, VkDeviceSize size,
+    VkDeviceSize alignment, MemoryAllocation* allocation) const
+{
+    const Block& source = blocks_[block];
+    allocation->memory = source.memory;
+    allocation->offset = offset;
+    allocation->size = size;
+    allocation->alignment = alignment;
+    allocation->mapped = source.mapped ? source.mapped + offset : nullptr;
+    allocation->memory_type = source.memory_type;
+    allocation->kind = source.kind;
+    allocation->block = block;
+}
+
+std::int32_t DeviceMemoryAllocator::CreateBlock(std::uint32_t memory_type,
+                                                ResourceKind kind)
+{
+    const VkDeviceSize size = BlockSize(memory_type);
+    VkMemoryAllocateInfo allocate_info = {
+        VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO, nullptr, size, memory_type};
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    auto err = device_functions_->vkAllocateMemory(device_, &allocate_info,
+                                                   nullptr, &memory);
+    if (err != VK_SUCCESS)
+    {
+        qWarning("Failed to allocate a memory block: %d", err);
+        return -1;
+    }
+
+    void* mapped = nullptr;
+    if (memory_properties_.memoryTypes[memory_type].propertyFlags &
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
+    {
+        err = device_functions_->vkMapMemory(device_, memory, 0, VK_WHOLE_SIZE,
+                                             0, &mapped);
+        if (err != VK_SUCCESS) qFatal("Failed to map memory: %d", err);
+    }
+
+    Block block{memory, static_cast<quint8*>(mapped),
+                std::make_unique<TlsfAllocator>(size), memory_type, kind};
+    // reuse the entry of a freed block, allocations refer to blocks by index
+    for (std::size_t i = 0; i < blocks_.size(); ++i)
+    {
+        if (blocks_[i].memory) continue;
+        blocks_[i] = std::move(block);
+        return static_cast<std::int32_t>(i);
+    }
+    blocks_.push_back(std::move(block));
+    return static_cast<std::int32_t>(blocks_.size() - 1);
+}
+
+void DeviceMemoryAllocator::FreeBlock(std::int32_t index)
+{
+    Block& block = blocks_[index];
+    if (!block.memory) return;
+    // freeing mapped memory unmaps it
+    device_functions_->vkFreeMemory(device_, block.memory, nullptr);
+    block.memory = VK_NULL_HANDLE;
+    block.mapped = nullptr;
+    block.ranges.reset();
+}
+
+bool DeviceMemoryAllocator::HasSiblingBlock(std::int32_t index) const
+{
+    const Block& block = blocks_[index];
+    for (std::size_t i = 0; i < blocks_.size(); ++i)
+    {
+        if (static_cast<std::int32_t>(i) != index && blocks_[i].memory &&
+            blocks_[i].memory_type == block.memory_type &&
+            blocks_[i].kind == block.kind)
+            return true;
+    }
+    return false;
+}
+
+bool DeviceMemoryAllocator::IsCoherent(std::uint32_t memory_type) const
+{
+    return (memory_properties_.memoryTypes[memory_type].propertyFlags &
+            VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) != 0;
+}
+
+FrameArena::FrameArena()
+    : allocator_{nullptr},
+      buffer_{VK_NULL_HANDLE},
+      alignment_{1},
+      region_stride_{0},
+      region_offset_{0}
+{
+}
+
+void FrameArena::Create(DeviceMemoryAllocator* allocator,
+                        VkBufferUsageFlags usage, std::uint32_t preferred_type,
+                        VkDeviceSize frame_size, int frame_count)
+{
+    allocator_ = allocator;
+    alignment_ = allocator_->BufferAlignment(usage);
+    region_stride_ = aligned(frame_size, alignment_);
+    allocator_->CreateBuffer(region_stride_ * frame_count, usage,
+                             preferred_type,
+                             VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, &buffer_,
+                             &allocation_);
+    arena_ = LinearAllocator(frame_size);
+}
+
+void FrameArena::Release()
+{
+    if (!allocator_) return;
+    allocator_->DestroyBuffer(&buffer_, &allocation_);
+    allocator_ = nullptr;
+}
+
+void FrameArena::BeginFrame(int frame)
+{
+    region_offset_ = frame * region_stride_;
+    arena_.Reset();
+}
+
+VkDeviceSize FrameArena::Allocate(VkDeviceSize size, void** data)
+{
+    const std::uint64_t offset = arena_.Allocate(size, alignment_);
+    if (offset == invalid_offset) return invalid_offset;
+    *data = allocation_.mapped + region_offset_ + offset;
+    return region_offset_ + offset;
+}
+
+void FrameArena::Flush() const
+{
+    allocator_->Flush(allocation_, region_offset_, arena_.used_bytes());
+}
@@ -0,0 +1,130 @@
+#include "frame_capture.h"
+
+#include <algorithm>
+#include <numeric>
+
+FrameCapture::FrameCapture()
+    : device_functions_{nullptr},
+      image_format_{QImage::Format_Invalid},
+      writer_{nullptr},
+      frame_number_{0}
+{
+}
+
+bool FrameCapture::Create(QVulkanDeviceFunctions* device_functions,
+                          VkDevice device,
+                          const VkPhysicalDeviceProperties& device_properties,
+                          std::uint32_t host_visible_index,
+                          VkMemoryPropertyFlags host_visible_flags,
+                          int frame_count, const QSize& size, VkFormat format,
+                          FrameWriter* writer)
+{
+    // Bytes as they are in memory. Alpha is left out, swap chains do not
+    // have to keep it.
+    switch (format)
+    {
+        case VK_FORMAT_R8G8B8A8_UNORM:
+        case VK_FORMAT_R8G8B8A8_SRGB:
+            image_format_ = QImage::Format_RGBX8888;
+            break;
+        case VK_FORMAT_B8G8R8A8_UNORM:
+        case VK_FORMAT_B8G8R8A8_SRGB:
+            image_format_ = QImage::Format_RGB32;
+            break;
+        default:
+            qWarning("Cannot capture frames of format %d", format);
+            return false;
+    }
+    device_functions_ = device_functions;
+    size_ = size;
+    writer_ = writer;
+    readback_ring_.Create(device_functions_, device, device_properties,
+                          host_visible_index, host_visible_flags,
+                          VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                          4 * static_cast<VkDeviceSize>(size_.width()) *
+                              size_.height(),
+                          frame_count);
+    pending_.assign(frame_count, -1);
+    frame_number_ = 0;
+    return true;
+}
+
+void FrameCapture::Release()
+{
+    if (!writer_) return;
+    std::vector<int> slots(pending_.size());
+    std::iota(slots.begin(), slots.end(), 0);
+    std::sort(slots.begin(), slots.end(),
+              [this](int a, int b) { return pending_[a] < pending_[b]; });
+    for (const int slot : slots) Collect(slot);
+    readback_ring_.Release();
+    pending_.clear();
+    writer_ = nullptr;
+}
+
+void FrameCapture::Collect(int frame)
+{
+    if (!writer_ || pending_[frame] < 0) return;
+    readback_ring_.Invalidate(frame, 0, readback_ring_.slot_size());
+    // Wraps the mapped slot, the writer only copies frames it accepts.
+    const QImage image(readback_ring_.Slot(frame), size_.width(),
+                       size_.height(), 4 * size_.width(), image_format_);
+    writer_->TryWrite(pending_[frame], image);
+    pending_[frame] = -1;
+}
+
+void FrameCapture::Record(VkCommandBuffer command_buffer, int frame,
+                          VkImage image, VkImageLayout layout)
+{
+    if (!writer_) return;
+    const bool transition = layout != VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    VkImageMemoryBarrier image_barrier{};
+    image_barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    image_barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    image_barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    image_barrier.image = image;
+    image_barrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+    if (transition)
+    {
+        image_barrier.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+        image_barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+        image_barrier.oldLayout = layout;
+        image_barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+        device_functions_->vkCmdPipelineBarrier(
+            command_buffer, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+            VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1,
+            &image_barrier);
+    }
+
+    VkBufferImageCopy region{};
+    region.bufferOffset = readback_ring_.SlotOffset(frame);
+    region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    region.imageSubresource.layerCount = 1;
+    region.imageExtent.width = size_.width();
+    region.imageExtent.height = size_.height();
+    region.imageExtent.depth = 1;
+    device_functions_->vkCmdCopyImageToBuffer(
+        command_buffer, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+        readback_ring_.buffer(), 1, &region);
+
+    VkBufferMemoryBarrier buffer_barrier{};
+    buffer_barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    buffer_barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    buffer_barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+    buffer_barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    buffer_barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    buffer_barrier.buffer = readback_ring_.buffer();
+    buffer_barrier.offset = region.bufferOffset;
+    buffer_barrier.size = readback_ring_.slot_size();
+    // back to the layout presentation (or the next render pass) expects,
+    // the copy only read the image
+    image_barrier.srcAccessMask = 0;
+    image_barrier.dstAccessMask = 0;
+    image_barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    image_barrier.newLayout = layout;
+    device_functions_->vkCmdPipelineBarrier(
+        command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+        VK_PIPELINE_STAGE_HOST_BIT | VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0,
+        0, nullptr, 1, &buffer_barrier, transition ? 1 : 0, &image_barrier);
+    pending_[frame] = frame_number_++;
+}
@@ -0,0 +1,263 @@
+#include "frame_profiler.h"
+
+#include <algorithm>
+
+namespace
+{
+// number of frames the rolling percentiles are computed over
+constexpr std::size_t percentile_window{1000};
+// how often the log output prints a summary
+constexpr double log_interval_us{1e6};
+}  // namespace
+
+FrameProfiler::ScopedTimer::ScopedTimer(FrameProfiler* profiler,
+                                        Section section)
+    : profiler_(profiler), section_(section)
+{
+    if (profiler_->enabled()) timer_.start();
+}
+
+FrameProfiler::ScopedTimer::~ScopedTimer()
+{
+    if (profiler_->enabled())
+        profiler_->AddTime(section_, timer_.nsecsElapsed() / 1e6);
+}
+
+FrameProfiler::FrameProfiler()
+    : device_functions_{nullptr},
+      device_{VK_NULL_HANDLE},
+      output_{ProfileOutput::kNone},
+      query_pool_{VK_NULL_HANDLE},
+      timestamp_period_ns_{1.0},
+      timestamp_mask_{~std::uint64_t{0}},
+      current_slot_{0},
+      frame_number_{0},
+      last_begin_us_{-1.0},
+      last_log_us_{0.0},
+      frame_times_(percentile_window),
+      gpu_times_(percentile_window),
+      cull_times_(percentile_window),
+      visible_ratio_{-1.0},
+      report_sink_{nullptr}
+{
+}
+
+FrameProfiler::~FrameProfiler() = default;
+
+void FrameProfiler::Create(QVulkanFunctions* functions,
+                           QVulkanDeviceFunctions* device_functions,
+                           VkPhysicalDevice physical_device, VkDevice device,
+                           const VkPhysicalDeviceProperties& device_properties,
+                           int frame_count, ProfileOutput output,
+                           const QString& path)
+{
+    output_ = output;
+    if (!enabled()) return;
+    device_functions_ = device_functions;
+    device_ = device;
+    slots_.assign(frame_count, Slot{});
+    frame_number_ = 0;
+    last_begin_us_ = -1.0;
+    last_log_us_ = 0.0;
+    clock_.start();
+
+    // GPU timestamps need support on the graphics queue.
+    std::uint32_t family_count{0};
+    functions->vkGetPhysicalDeviceQueueFamilyProperties(
+        physical_device, &family_count, nullptr);
+    std::vector<VkQueueFamilyProperties> families(family_count);
+    functions->vkGetPhysicalDeviceQueueFamilyProperties(
+        physical_device, &family_count, families.data());
+    std::uint32_t valid_bits{0};
+    for (const auto& family : families)
+    {
+        if (family.queueFlags & VK_QUEUE_GRAPHICS_BIT)
+        {
+            valid_bits = family.timestampValidBits;
+            break;
+        }
+    }
+    if (valid_bits == 0)
+    {
+        qWarning("GPU timestamps not supported, profiling the CPU only");
+    }
+    else
+    {
+        timestamp_period_ns_ = device_properties.limits.timestampPeriod;
+        timestamp_mask_ = valid_bits >= 64
+                              ? ~std::uint64_t{0}
+                              : (std::uint64_t{1} << valid_bits) - 1;
+        VkQueryPoolCreateInfo pool_info{};
+        pool_info.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+        pool_info.queryType = VK_QUERY_TYPE_TIMESTAMP;
+        pool_info.queryCount = 2 * static_cast<std::uint32_t>(frame_count);
+        const auto err = device_functions_->vkCreateQueryPool(
+            device_, &pool_info, nullptr, &query_pool_);
+        if (err != VK_SUCCESS)
+            qFatal("Failed to create timestamp query pool: %d", err);
+    }
+
+    if (output_ == ProfileOutput::kCsv || output_ == ProfileOutput::kTrace)
+    {
+        file_.open(path.toStdString());
+        if (!file_)
+        {
+            qWarning("Failed to open %s, logging frame times instead",
+                     qPrintable(path));
+            output_ = ProfileOutput::kLog;
+        }
+        else if (output_ == ProfileOutput::kCsv)
+        {
+            sink_ = std::make_unique<CsvTimingSink>(&file_);
+        }
+        else
+        {
+            sink_ = std::make_unique<ChromeTraceSink>(&file_);
+        }
+    }
+}
+
+void FrameProfiler::Release()
+{
+    if (!enabled()) return;
+
+    // Report what is still outstanding, oldest frame first.
+    std::vector<Slot*> pending;
+    for (Slot& slot : slots_)
+        if (slot.pending) pending.push_back(&slot);
+    std::sort(pending.begin(), pending.end(), [](Slot* a, Slot* b) {
+        return a->timings.frame < b->timings.frame;
+    });
+    for (Slot* slot : pending) Report(slot);
+    LogSummary("total");
+
+    sink_.reset();
+    report_sink_ = nullptr;
+    if (file_.is_open()) file_.close();
+    if (query_pool_)
+    {
+        device_functions_->vkDestroyQueryPool(device_, query_pool_, nullptr);
+        query_pool_ = VK_NULL_HANDLE;
+    }
+    slots_.clear();
+}
+
+void FrameProfiler::BeginFrame(int frame)
+{
+    if (!enabled()) return;
+    current_slot_ = frame;
+    Slot& slot = slots_[frame];
+    // The previous submission of this slot has completed by now.
+    if (slot.pending) Report(&slot);
+
+    const double now_us = clock_.nsecsElapsed() / 1e3;
+    slot.timings = FrameTimings{};
+    slot.timings.frame = frame_number_++;
+    slot.timings.begin_us = now_us;
+    slot.timings.frame_ms =
+        last_begin_us_ < 0.0 ? 0.0 : (now_us - last_begin_us_) / 1e3;
+    last_begin_us_ = now_us;
+    slot.pending = true;
+    slot.has_queries = query_pool_ != VK_NULL_HANDLE;
+}
+
+void FrameProfiler::BeginRenderPass(VkCommandBuffer command_buffer, int frame)
+{
+    if (!enabled() || !slots_[frame].has_queries) return;
+    const auto first_query = 2 * static_cast<std::uint32_t>(frame);
+    device_functions_->vkCmdResetQueryPool(command_buffer, query_pool_,
+                                           first_query, 2);
+    device_functions_->vkCmdWriteTimestamp(command_buffer,
+                                           VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                                           query_pool_, first_query);
+}
+
+void FrameProfiler::EndFrame(VkCommandBuffer command_buffer, int frame)
+{
+    if (!enabled() || !slots_[frame].has_queries) return;
+    device_functions_->vkCmdWriteTimestamp(
+        command_buffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, query_pool_,
+        2 * static_cast<std::uint32_t>(frame) + 1);
+}
+
+void FrameProfiler::AddTime(Section section, double ms)
+{
+    FrameTimings& timings = slots_[current_slot_].timings;
+    switch (section)
+    {
+        case Section::kCull:
+            timings.cull_ms += ms;
+            break;
+        case Section::kRecord:
+            timings.record_ms += ms;
+            break;
+        case Section::kSubmit:
+            timings.submit_ms += ms;
+            break;
+    }
+}
+
+void FrameProfiler::SetVisibility(std::size_t visible, std::size_t total)
+{
+    if (!enabled() || total == 0) return;
+    slots_[current_slot_].timings.visible_ratio =
+        static_cast<double>(visible) / static_cast<double>(total);
+}
+
+void FrameProfiler::Report(Slot* slot)
+{
+    FrameTimings& timings = slot->timings;
+    if (slot->has_queries)
+    {
+        // No VK_QUERY_RESULT_WAIT_BIT: if the results are not there yet
+        // the frame is reported without GPU time instead of stalling.
+        std::uint64_t timestamps[2]{};
+        const auto first_query =
+            2 * static_cast<std::uint32_t>(slot - slots_.data());
+        const auto err = device_functions_->vkGetQueryPoolResults(
+            device_, query_pool_, first_query, 2, sizeof(timestamps),
+            timestamps, sizeof(std::uint64_t), VK_QUERY_RESULT_64_BIT);
+        if (err == VK_SUCCESS)
+        {
+            const std::uint64_t ticks =
+                ((timestamps[1] & timestamp_mask_) -
+                 (timestamps[0] & timestamp_mask_)) &
+                timestamp_mask_;
+            timings.gpu_ms = ticks * timestamp_period_ns_ / 1e6;
+            gpu_times_.Add(timings.gpu_ms);
+        }
+    }
+    if (timings.frame > 0) frame_times_.Add(timings.frame_ms);
+    if (timings.visible_ratio >= 0.0)
+    {
+        cull_times_.Add(timings.cull_ms);
+        visible_ratio_ = timings.visible_ratio;
+    }
+    if (sink_) sink_->Add(timings);
+    if (report_sink_) report_sink_->Add(timings);
+    slot->pending = false;
+
+    if (output_ == ProfileOutput::kLog &&
+        timings.begin_us - last_log_us_ >= log_interval_us)
+    {
+        last_log_us_ = timings.begin_us;
+        LogSummary("frame");
+    }
+}
+
+void FrameProfiler::LogSummary(const char* prefix) const
+{
+    qDebug("%s %lld: frame ms p50 %.3f p95 %.3f p99 %.3f | gpu ms p50 %.3f "
+           "p95 %.3f p99 %.3f",
+           prefix, static_cast<long long>(frame_number_),
+           frame_times_.Percentile(50), frame_times_.Percentile(95),
+           frame_times_.Percentile(99), gpu_times_.Percentile(50),
+           gpu_times_.Percentile(95), gpu_times_.Percentile(99));
+    if (visible_ratio_ >= 0.0)
+    {
+        qDebug("%s %lld: cull ms p50 %.3f p95 %.3f | visible %.1f%%", prefix,
+               static_cast<long long>(frame_number_),
+               cull_times_.Percentile(50), cull_times_.Percentile(95),
+               visible_ratio_ * 100.0);
+    }
+}
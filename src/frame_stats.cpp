@@ -0,0 +1,220 @@
+#include "frame_stats.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <ios>
+
+namespace
+{
+void WriteJsonString(std::ostream* out, const std::string& value)
+{
+    *out << '"';
+    for (const char c : value)
+    {
+        if (c == '"' || c == '\\')
+        {
+            *out << '\\' << c;
+        }
+        else if (static_cast<unsigned char>(c) < 0x20)
+        {
+            char escaped[8];
+            std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+            *out << escaped;
+        }
+        else
+        {
+            *out << c;
+        }
+    }
+    *out << '"';
+}
+
+// Timings always with 4 decimals, whole milliseconds included.
+void WriteJsonNumber(std::ostream* out, double value)
+{
+    char text[32];
+    std::snprintf(text, sizeof(text), "%.4f", value);
+    *out << text;
+}
+
+// "name": {"mean": .., "p50": .., "p90": .., "p99": .., "max": ..}
+void WriteJsonSummary(std::ostream* out, const char* name,
+                      std::vector<double> values, bool* first)
+{
+    if (values.empty()) return;
+    std::sort(values.begin(), values.end());
+    double sum{0.0};
+    for (const double value : values) sum += value;
+    const auto percentile = [&values](double percent) {
+        const auto rank = static_cast<std::size_t>(
+            std::ceil(percent / 100.0 * static_cast<double>(values.size())));
+        return values[rank == 0 ? 0 : rank - 1];
+    };
+
+    *out << (*first ? "\n" : ",\n") << "    \"" << name << "\": {\"mean\": ";
+    *first = false;
+    WriteJsonNumber(out, sum / static_cast<double>(values.size()));
+    const double percents[] = {50.0, 90.0, 99.0};
+    for (const double percent : percents)
+    {
+        *out << ", \"p" << static_cast<int>(percent) << "\": ";
+        WriteJsonNumber(out, percentile(percent));
+    }
+    *out << ", \"max\": ";
+    WriteJsonNumber(out, values.back());
+    *out << '}';
+}
+}  // namespace
+
+RollingPercentiles::RollingPercentiles(std::size_t window_size)
+    : window_size_(std::max<std::size_t>(window_size, 1)), next_{0}
+{
+    values_.reserve(window_size_);
+}
+
+void RollingPercentiles::Add(double value)
+{
+    if (values_.size() < window_size_)
+    {
+        values_.push_back(value);
+        return;
+    }
+    values_[next_] = value;
+    next_ = (next_ + 1) % window_size_;
+}
+
+double RollingPercentiles::Percentile(double percent) const
+{
+    if (values_.empty()) return 0.0;
+    const double clamped = std::min(std::max(percent, 0.0), 100.0);
+    const auto rank = static_cast<std::size_t>(
+        std::ceil(clamped / 100.0 * static_cast<double>(values_.size())));
+    const std::size_t index = rank == 0 ? 0 : rank - 1;
+
+    std::vector<double> sorted = values_;
+    std::nth_element(sorted.begin(), sorted.begin() + index, sorted.end());
+    return sorted[index];
+}
+
+CsvTimingSink::CsvTimingSink(std::ostream* out) : out_(out)
+{
+    *out_ << std::fixed;
+    out_->precision(3);
+    *out_ << "frame,begin_us,frame_ms,record_ms,submit_ms,gpu_ms,cull_ms,"
+             "visible\n";
+}
+
+void CsvTimingSink::Add(const FrameTimings& timings)
+{
+    *out_ << timings.frame << ',' << timings.begin_us << ','
+          << timings.frame_ms << ',' << timings.record_ms << ','
+          << timings.submit_ms << ',';
+    if (timings.gpu_ms >= 0.0) *out_ << timings.gpu_ms;
+    *out_ << ',' << timings.cull_ms << ',';
+    if (timings.visible_ratio >= 0.0) *out_ << timings.visible_ratio;
+    *out_ << '\n';
+}
+
+ChromeTraceSink::ChromeTraceSink(std::ostream* out)
+    : out_(out), first_event_{true}
+{
+    *out_ << std::fixed;
+    out_->precision(3);
+    *out_ << "[\n";
+}
+
+ChromeTraceSink::~ChromeTraceSink() { *out_ << "\n]\n"; }
+
+void ChromeTraceSink::Add(const FrameTimings& timings)
+{
+    const double cull_us = timings.cull_ms * 1e3;
+    const double record_us = timings.record_ms * 1e3;
+    const double submit_us = timings.submit_ms * 1e3;
+    const double record_begin_us = timings.begin_us + cull_us;
+    if (timings.visible_ratio >= 0.0)
+        AddEvent("cull", 1, timings.begin_us, cull_us, timings.frame);
+    AddEvent("record", 1, record_begin_us, record_us, timings.frame);
+    AddEvent("submit", 1, record_begin_us + record_us, submit_us,
+             timings.frame);
+    if (timings.gpu_ms >= 0.0)
+        AddEvent("render pass", 2, record_begin_us + record_us,
+                 timings.gpu_ms * 1e3, timings.frame);
+}
+
+void ChromeTraceSink::AddEvent(const char* name, int track, double begin_us,
+                               double duration_us, std::int64_t frame)
+{
+    if (!first_event_) *out_ << ",\n";
+    first_event_ = false;
+    *out_ << "{\"name\":\"" << name << "\",\"ph\":\"X\",\"pid\":1,\"tid\":"
+          << track << ",\"ts\":" << begin_us << ",\"dur\":" << duration_us
+          << ",\"args\":{\"frame\":" << frame << "}}";
+}
+
+BenchmarkReport::BenchmarkReport(std::int64_t warmup_frames)
+    : warmup_frames_(std::max<std::int64_t>(warmup_frames, 1))
+{
+}
+
+void BenchmarkReport::Add(const FrameTimings& timings)
+{
+    // frame 0 has no frame time, the first few also pay for warming up
+    // caches and pipelines
+    if (timings.frame < warmup_frames_) return;
+    frame_ms_.push_back(timings.frame_ms);
+    record_ms_.push_back(timings.record_ms);
+    submit_ms_.push_back(timings.submit_ms);
+    if (timings.gpu_ms >= 0.0) gpu_ms_.push_back(timings.gpu_ms);
+    if (timings.visible_ratio >= 0.0) cull_ms_.push_back(timings.cull_ms);
+}
+
+void BenchmarkReport::SetParameter(const std::string& name,
+                                   const std::string& value)
+{
+    parameters_[name] = value;
+}
+
+void BenchmarkReport::SetMetric(const std::string& name,
+                                std::uint64_t value)
+{
+    metrics_[name] = value;
+}
+
+void BenchmarkReport::Write(std::ostream* out) const
+{
+    *out << "{\n  \"version\": 1,\n  \"parameters\": {";
+    bool first{true};
+    for (const auto& parameter : parameters_)
+    {
+        *out << (first ? "\n    " : ",\n    ");
+        first = false;
+        WriteJsonString(out, parameter.first);
+        *out << ": ";
+        WriteJsonString(out, parameter.second);
+    }
+    *out << (first ? "},\n" : "\n  },\n");
+
+    *out << "  \"frames\": " << frame_ms_.size()
+         << ",\n  \"warmup_frames\": " << warmup_frames_
+         << ",\n  \"timings_ms\": {";
+    first = true;
+    WriteJsonSummary(out, "cpu_frame", frame_ms_, &first);
+    WriteJsonSummary(out, "cpu_cull", cull_ms_, &first);
+    WriteJsonSummary(out, "cpu_record", record_ms_, &first);
+    WriteJsonSummary(out, "cpu_submit", submit_ms_, &first);
+    WriteJsonSummary(out, "gpu_frame", gpu_ms_, &first);
+    *out << (first ? "},\n" : "\n  },\n");
+
+    *out << "  \"metrics\": {";
+    first = true;
+    for (const auto& metric : metrics_)
+    {
+        *out << (first ? "\n    " : ",\n    ");
+        first = false;
+        WriteJsonString(out, metric.first);
+        *out << ": ";
+        *out << metric.second;
+    }
+    *out << (first ? "}\n}\n" : "\n  }\n}\n");
+}
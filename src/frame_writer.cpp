@@ -0,0 +1,141 @@
+#include "frame_writer.h"
+
+#include <QtCore/QDir>
+
+#include "y4m.h"
+
+FrameWriter::FrameWriter(const QString& directory, const QString& format,
+                         int max_queued, int frame_rate)
+    : directory_(directory),
+      format_(format),
+      max_queued_(max_queued < 1 ? 1 : max_queued),
+      frame_rate_(frame_rate < 1 ? 1 : frame_rate),
+      video_segment_{0},
+      queued_{0},
+      dropped_{0},
+      stopping_{false}
+{
+    if (!QDir().mkpath(directory_))
+        qWarning("Failed to create output directory %s",
+                 qPrintable(directory_));
+    thread_ = std::thread(&FrameWriter::Run, this);
+}
+
+FrameWriter::~FrameWriter()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    queue_changed_.notify_all();
+    thread_.join();
+    if (queued_ + dropped_ > 0)
+    {
+        qDebug("output: %d frame(s) written to %s, %d dropped (%.1f%%)",
+               queued_, qPrintable(directory_), dropped_,
+               100.0 * dropped_ / (queued_ + dropped_));
+    }
+}
+
+void FrameWriter::Write(int index, QImage image)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    queue_changed_.wait(lock, [this] { return queue_.size() < max_queued_; });
+    queue_.emplace_back(index, std::move(image));
+    ++queued_;
+    lock.unlock();
+    queue_changed_.notify_all();
+}
+
+bool FrameWriter::TryWrite(int index, const QImage& image)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (queue_.size() >= max_queued_)
+    {
+        if (dropped_++ == 0)
+            qWarning("output: the writer falls behind, dropping frames");
+        return false;
+    }
+    // Only the caller adds frames, so there is still room after the copy.
+    lock.unlock();
+    QImage copy = image.copy();
+    lock.lock();
+    queue_.emplace_back(index, std::move(copy));
+    ++queued_;
+    lock.unlock();
+    queue_changed_.notify_all();
+    return true;
+}
+
+int FrameWriter::dropped() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return dropped_;
+}
+
+void FrameWriter::Run()
+{
+    for (;;)
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        queue_changed_.wait(lock,
+                            [this] { return stopping_ || !queue_.empty(); });
+        if (queue_.empty()) return;  // stopping and drained
+        auto [index, image] = std::move(queue_.front());
+        queue_.pop_front();
+        lock.unlock();
+        queue_changed_.notify_all();
+
+        if (format_ == QLatin1String("y4m"))
+        {
+            WriteY4m(image);
+            continue;
+        }
+        const QString path = QStringLiteral("%1/frame_%2.%3")
+                                 .arg(directory_)
+                                 .arg(index, 5, 10, QLatin1Char('0'))
+                                 .arg(format_);
+        if (!image.save(path, qPrintable(format_)))
+            qWarning("Failed to write %s", qPrintable(path));
+    }
+}
+
+void FrameWriter::WriteY4m(const QImage& image)
+{
+    if (image.size() != video_size_)
+    {
+        const QString path =
+            video_segment_ == 0
+                ? QStringLiteral("%1/video.y4m").arg(directory_)
+                : QStringLiteral("%1/video_%2.y4m")
+                      .arg(directory_)
+                      .arg(video_segment_);
+        ++video_segment_;
+        video_.close();
+        video_.setFileName(path);
+        video_size_ = image.size();
+        if (!video_.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        {
+            qWarning("Failed to write %s", qPrintable(path));
+            return;
+        }
+        const std::string header = Y4mHeader(
+            video_size_.width(), video_size_.height(), frame_rate_);
+        video_.write(header.data(), static_cast<qint64>(header.size()));
+        video_frame_.resize(
+            Y4mFrameSize(video_size_.width(), video_size_.height()));
+    }
+    if (!video_.isOpen()) return;
+
+    // sets alpha for the RGBA readbacks, swizzles BGRA swap chain images
+    const QImage rgba = image.convertToFormat(QImage::Format_RGBX8888);
+    RgbaToI420(rgba.constBits(), rgba.width(), rgba.height(),
+               static_cast<std::size_t>(rgba.bytesPerLine()),
+               video_frame_.data());
+    video_.write("FRAME\n", 6);
+    if (video_.write(reinterpret_cast<const char*>(video_frame_.data()),
+                     static_cast<qint64>(video_frame_.size())) < 0)
+    {
+        qWarning("Failed to write %s", qPrintable(video_.fileName()));
+    }
+}
@@ -0,0 +1,135 @@
+#include "geometry.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+// clang-format off
+// corner vertices as (x, y, z, nx, ny, nz, r, g, b) tuples
+constexpr float corners[3][vertex_float_count] = { // Y down, front = CCW
+    { 0.0f,   0.5f, 0.0f,   0.0f, 0.0f, 1.0f,   1.0f, 0.0f, 0.0f},
+    {-0.5f,  -0.5f, 0.0f,   0.0f, 0.0f, 1.0f,   0.0f, 1.0f, 0.0f},
+    { 0.5f,  -0.5f, 0.0f,   0.0f, 0.0f, 1.0f,   0.0f, 0.0f, 1.0f}
+};
+// clang-format on
+
+// Index of grid point (row, column), rows grow from the top corner down.
+std::uint32_t GridIndex(int row, int column)
+{
+    const auto r = static_cast<std::size_t>(row);
+    return static_cast<std::uint32_t>(r * (r + 1) / 2 + column);
+}
+}  // namespace
+
+BoundingSphere ComputeBoundingSphere(const float* vertices,
+                                     std::size_t vertex_count)
+{
+    float low[3] = {INFINITY, INFINITY, INFINITY};
+    float high[3] = {-INFINITY, -INFINITY, -INFINITY};
+    for (std::size_t v = 0; v < vertex_count; ++v)
+    {
+        const float* position = vertices + v * vertex_float_count;
+        for (int k = 0; k < 3; ++k)
+        {
+            low[k] = std::min(low[k], position[k]);
+            high[k] = std::max(high[k], position[k]);
+        }
+    }
+    BoundingSphere sphere{};
+    if (vertex_count == 0) return sphere;
+    for (int k = 0; k < 3; ++k) sphere.center[k] = 0.5f * (low[k] + high[k]);
+
+    float radius_squared{0.0f};
+    for (std::size_t v = 0; v < vertex_count; ++v)
+    {
+        const float* position = vertices + v * vertex_float_count;
+        float distance_squared{0.0f};
+        for (int k = 0; k < 3; ++k)
+        {
+            const float d = position[k] - sphere.center[k];
+            distance_squared += d * d;
+        }
+        radius_squared = std::max(radius_squared, distance_squared);
+    }
+    sphere.radius = std::sqrt(radius_squared);
+    return sphere;
+}
+
+MeshData CreateTriangleGrid(int subdivisions)
+{
+    const int n = std::clamp(subdivisions, 1, max_grid_subdivisions);
+    const auto size = static_cast<std::size_t>(n);
+    MeshData mesh;
+    mesh.vertices.reserve(vertex_float_count * (size + 1) * (size + 2) / 2);
+    mesh.indices.reserve(3 * size * size);
+
+    for (int row = 0; row <= n; ++row)
+    {
+        for (int column = 0; column <= row; ++column)
+        {
+            // barycentric weights of the three corners
+            const float w1 = static_cast<float>(row - column) / n;
+            const float w2 = static_cast<float>(column) / n;
+            const float w0 = 1.0f - w1 - w2;
+            for (std::size_t k = 0; k < vertex_float_count; ++k)
+            {
+                mesh.vertices.push_back(w0 * corners[0][k] +
+                                        w1 * corners[1][k] +
+                                        w2 * corners[2][k]);
+            }
+        }
+    }
+
+    for (int row = 0; row < n; ++row)
+    {
+        for (int column = 0; column <= row; ++column)
+        {
+            mesh.indices.push_back(GridIndex(row, column));
+            mesh.indices.push_back(GridIndex(row + 1, column));
+            mesh.indices.push_back(GridIndex(row + 1, column + 1));
+            if (column < row)
+            {
+                mesh.indices.push_back(GridIndex(row, column));
+                mesh.indices.push_back(GridIndex(row + 1, column + 1));
+                mesh.indices.push_back(GridIndex(row, column + 1));
+            }
+        }
+    }
+    return mesh;
+}
+
+std::vector<InstanceData> CreateInstanceGrid(int count)
+{
+    const int n = count < 1 ? 1 : count;
+    const int columns = static_cast<int>(std::ceil(std::sqrt(n)));
+    const float scale = 1.0f / columns;
+
+    std::vector<InstanceData> instances(n);
+    for (int i = 0; i < n; ++i)
+    {
+        // cell centers in [0, 1], the grid is centered on the origin
+        const float u = (i % columns + 0.5f) * scale;
+        const float v = (i / columns + 0.5f) * scale;
+        InstanceData& instance = instances[i];
+        instance = {};
+        instance.model[0] = scale;
+        instance.model[5] = scale;
+        instance.model[10] = 1.0f;
+        instance.model[12] = u - 0.5f;
+        instance.model[13] = v - 0.5f;
+        instance.model[15] = 1.0f;
+        if (n == 1)
+        {
+            instance.color[0] = instance.color[1] = instance.color[2] = 1.0f;
+        }
+        else
+        {
+            instance.color[0] = 0.5f + 0.5f * u;
+            instance.color[1] = 0.5f + 0.5f * v;
+            instance.color[2] = 1.0f - 0.5f * u;
+        }
+        instance.color[3] = 1.0f;
+    }
+    return instances;
+}
@@ -0,0 +1,498 @@
+#include "gpu_culler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "vulkan_utils.h"
+
+namespace
+{
+// cull.comp's local size
+constexpr std::uint32_t workgroup_size{64};
+constexpr std::size_t max_lod_count{4};
+// the command array follows the count, padded to 16 bytes
+constexpr VkDeviceSize draw_commands_offset{16};
+constexpr VkDeviceSize draw_command_size{
+    sizeof(VkDrawIndexedIndirectCommand)};
+// relative distance to a plane or LOD threshold within which the GPU and
+// CPU results may differ by rounding
+constexpr float verify_tolerance{1e-4f};
+
+static_assert(sizeof(VkDrawIndexedIndirectCommand) == 20,
+              "cull.comp writes 20-byte commands");
+}  // namespace
+
+GpuCuller::GpuCuller()
+    : device_functions_{nullptr},
+      device_{VK_NULL_HANDLE},
+      draw_indexed_indirect_count_{nullptr},
+      multi_draw_indirect_{false},
+      max_draw_count_{1},
+      compact_{false},
+      object_count_{0},
+      bounds_dirty_frames_{0},
+      bounds_version_{0},
+      draw_buffer_{VK_NULL_HANDLE},
+      draw_memory_{VK_NULL_HANDLE},
+      draw_region_size_{0},
+      draw_region_stride_{0},
+      descriptor_pool_{VK_NULL_HANDLE},
+      descriptor_set_layout_{VK_NULL_HANDLE},
+      descriptor_set_{VK_NULL_HANDLE},
+      pipeline_layout_{VK_NULL_HANDLE},
+      pipeline_{VK_NULL_HANDLE},
+      verify_{false},
+      verified_frames_{0},
+      mismatched_frames_{0}
+{
+}
+
+bool GpuCuller::Create(QVulkanInstance* instance,
+                       VkPhysicalDevice physical_device, VkDevice device,
+                       const VkPhysicalDeviceProperties& device_properties,
+                       std::uint32_t host_visible_index,
+                       std::uint32_t device_local_index, int frame_count,
+                       std::size_t object_count,
+                       const std::vector<MeshLod>& lods,
+                       bool draw_indirect_count, bool multi_draw_indirect,
+                       bool verify, VkShaderModule shader,
+                       VkPipelineCache pipeline_cache)
+{
+    if (shader == VK_NULL_HANDLE || object_count == 0 || lods.empty() ||
+        lods.size() > max_lod_count)
+        return false;
+    device_functions_ = instance->deviceFunctions(device);
+    device_ = device;
+    object_count_ = object_count;
+    lods_ = lods;
+    verify_ = verify;
+
+    const std::uint32_t limit = device_properties.limits.maxDrawIndirectCount;
+    multi_draw_indirect_ = multi_draw_indirect;
+    max_draw_count_ = multi_draw_indirect_ ? std::max(limit, 1u) : 1u;
+    if (draw_indirect_count && object_count_ <= limit)
+    {
+        // Not in QVulkanDeviceFunctions, which only covers Vulkan 1.0.
+        const auto get_device_proc_addr =
+            reinterpret_cast<PFN_vkGetDeviceProcAddr>(
+                instance->getInstanceProcAddr("vkGetDeviceProcAddr"));
+        if (get_device_proc_addr)
+        {
+            draw_indexed_indirect_count_ =
+                reinterpret_cast<PFN_vkCmdDrawIndexedIndirectCountKHR>(
+                    get_device_proc_addr(
+                        device, "vkCmdDrawIndexedIndirectCountKHR"));
+        }
+    }
+    compact_ = draw_indexed_indirect_count_ != nullptr;
+
+    VkPhysicalDeviceMemoryProperties memory_properties{};
+    instance->functions()->vkGetPhysicalDeviceMemoryProperties(
+        physical_device, &memory_properties);
+    const VkMemoryPropertyFlags host_visible_flags =
+        memory_properties.memoryTypes[host_visible_index].propertyFlags;
+    params_ring_.Create(device_functions_, device_, device_properties,
+                        host_visible_index, host_visible_flags,
+                        VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, sizeof(Params),
+                        frame_count);
+    bounds_ring_.Create(device_functions_, device_, device_properties,
+                        host_visible_index, host_visible_flags,
+                        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                        4 * sizeof(float) * object_count_, frame_count);
+    bounds_.assign(4 * object_count_, 0.0f);
+    bounds_dirty_frames_ = (1u << frame_count) - 1;
+
+    draw_region_size_ =
+        draw_commands_offset + draw_command_size * object_count_;
+    draw_region_stride_ = aligned(
+        draw_region_size_,
+        std::max<VkDeviceSize>(
+            device_properties.limits.minStorageBufferOffsetAlignment, 16));
+    CreateDrawBuffer(memory_properties, device_local_index);
+    if (verify_)
+    {
+        readback_ring_.Create(device_functions_, device_, device_properties,
+                              host_visible_index, host_visible_flags,
+                              VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                              draw_region_size_, frame_count);
+        verifications_.assign(frame_count, Verification{});
+    }
+
+    CreateDescriptors();
+    CreatePipeline(shader, pipeline_cache);
+    qDebug("culling %zu objects on the GPU (%s%s)", object_count_,
+           compact_ ? "indirect count" : "indirect",
+           multi_draw_indirect_ ? ", multi-draw" : "");
+    return true;
+}
+
+void GpuCuller::Release()
+{
+    if (!device_functions_) return;
+    if (verify_)
+    {
+        for (int frame = 0; frame < static_cast<int>(verifications_.size());
+             ++frame)
+            Verify(frame);
+        qDebug("GPU culling verified on %llu frames, %llu mismatched",
+               static_cast<unsigned long long>(verified_frames_),
+               static_cast<unsigned long long>(mismatched_frames_));
+    }
+
+    if (pipeline_)
+        device_functions_->vkDestroyPipeline(device_, pipeline_, nullptr);
+    if (pipeline_layout_)
+    {
+        device_functions_->vkDestroyPipelineLayout(device_, pipeline_layout_,
+                                                   nullptr);
+    }
+    if (descriptor_set_layout_)
+    {
+        device_functions_->vkDestroyDescriptorSetLayout(
+            device_, descriptor_set_layout_, nullptr);
+    }
+    if (descriptor_pool_)
+    {
+        device_functions_->vkDestroyDescriptorPool(device_, descriptor_pool_,
+                                                   nullptr);
+    }
+    if (draw_buffer_)
+        device_functions_->vkDestroyBuffer(device_, draw_buffer_, nullptr);
+    if (draw_memory_)
+        device_functions_->vkFreeMemory(device_, draw_memory_, nullptr);
+    pipeline_ = VK_NULL_HANDLE;
+    pipeline_layout_ = VK_NULL_HANDLE;
+    descriptor_set_layout_ = VK_NULL_HANDLE;
+    descriptor_pool_ = VK_NULL_HANDLE;
+    descriptor_set_ = VK_NULL_HANDLE;
+    draw_buffer_ = VK_NULL_HANDLE;
+    draw_memory_ = VK_NULL_HANDLE;
+    params_ring_.Release();
+    bounds_ring_.Release();
+    readback_ring_.Release();
+    verifications_.clear();
+    draw_indexed_indirect_count_ = nullptr;
+    device_functions_ = nullptr;
+}
+
+void GpuCuller::SetBounds(const BoundingSpheres& spheres)
+{
+    if (spheres.size() != object_count_)
+    {
+        qWarning("GpuCuller::SetBounds: expected %zu spheres, got %zu",
+                 object_count_, spheres.size());
+        return;
+    }
+    for (std::size_t i = 0; i < object_count_; ++i)
+    {
+        bounds_[4 * i + 0] = spheres.x()[i];
+        bounds_[4 * i + 1] = spheres.y()[i];
+        bounds_[4 * i + 2] = spheres.z()[i];
+        bounds_[4 * i + 3] = spheres.radius()[i];
+    }
+    bounds_dirty_frames_ = (1u << bounds_ring_.slot_count()) - 1;
+    ++bounds_version_;
+    if (verify_) spheres_ = spheres;
+}
+
+void GpuCuller::SetLods(const std::vector<MeshLod>& lods)
+{
+    if (lods.size() != lods_.size())
+    {
+        qWarning("GpuCuller::SetLods: expected %zu LODs, got %zu",
+                 lods_.size(), lods.size());
+        return;
+    }
+    lods_ = lods;
+}
+
+void GpuCuller::Record(VkCommandBuffer command_buffer, int frame,
+                       const glm::mat4& view_projection,
+                       const CullSettings& settings)
+{
+    // The frame's previous submission has completed, so has its readback.
+    if (verify_) Verify(frame);
+
+    const std::uint32_t frame_bit = 1u << frame;
+    if (bounds_dirty_frames_ & frame_bit)
+    {
+        const VkDeviceSize size = bounds_.size() * sizeof(float);
+        std::memcpy(bounds_ring_.Slot(frame), bounds_.data(), size);
+        bounds_ring_.Flush(frame, 0, size);
+        bounds_dirty_frames_ &= ~frame_bit;
+    }
+
+    const Frustum frustum = ExtractFrustum(view_projection);
+    Params params{};
+    std::memcpy(params.planes, frustum.planes, sizeof(params.planes));
+    for (int k = 0; k < 4; ++k) params.w_row[k] = view_projection[k][3];
+    for (std::size_t i = 0; i + 1 < lods_.size(); ++i)
+    {
+        params.lod_pixels[i] =
+            i < settings.lod_pixels.size() ? settings.lod_pixels[i] : 0.0f;
+    }
+    for (std::size_t i = 0; i < lods_.size(); ++i)
+    {
+        params.lods[i][0] = lods_[i].first_index;
+        params.lods[i][1] = lods_[i].index_count;
+        params.lods[i][2] = static_cast<std::uint32_t>(lods_[i].vertex_offset);
+    }
+    float row1_squared{0.0f};
+    for (int k = 0; k < 3; ++k)
+        row1_squared += view_projection[k][1] * view_projection[k][1];
+    params.row1_length = std::sqrt(row1_squared);
+    params.viewport_height = settings.viewport_height;
+    params.min_pixels = settings.min_pixels;
+    params.object_count = static_cast<std::uint32_t>(object_count_);
+    // LODs beyond the thresholds are never picked, like on the CPU
+    params.lod_count = static_cast<std::uint32_t>(
+        std::min(lods_.size(), settings.lod_pixels.size() + 1));
+    params.compact = compact_ ? 1 : 0;
+    std::memcpy(params_ring_.Slot(frame), &params, sizeof(params));
+    params_ring_.Flush(frame, 0, sizeof(params));
+
+    const VkDeviceSize region = frame * draw_region_stride_;
+    VkBufferMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.buffer = draw_buffer_;
+    barrier.offset = region;
+    barrier.size = draw_region_size_;
+    if (compact_)
+    {
+        device_functions_->vkCmdFillBuffer(command_buffer, draw_buffer_,
+                                           region, sizeof(std::uint32_t), 0);
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask =
+            VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+        device_functions_->vkCmdPipelineBarrier(
+            command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 1, &barrier,
+            0, nullptr);
+    }
+
+    const std::uint32_t offsets[] = {
+        static_cast<std::uint32_t>(params_ring_.SlotOffset(frame)),
+        static_cast<std::uint32_t>(bounds_ring_.SlotOffset(frame)),
+        static_cast<std::uint32_t>(region)};
+    device_functions_->vkCmdBindPipeline(
+        command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline_);
+    device_functions_->vkCmdBindDescriptorSets(
+        command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline_layout_, 0, 1,
+        &descriptor_set_, 3, offsets);
+    const auto group_count = static_cast<std::uint32_t>(
+        (object_count_ + workgroup_size - 1) / workgroup_size);
+    device_functions_->vkCmdDispatch(command_buffer, group_count, 1, 1);
+
+    // the commands are read by the draw, and by the readback copy
+    barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+    VkPipelineStageFlags dst_stages = VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT;
+    if (verify_)
+    {
+        barrier.dstAccessMask |= VK_ACCESS_TRANSFER_READ_BIT;
+        dst_stages |= VK_PIPELINE_STAGE_TRANSFER_BIT;
+    }
+    device_functions_->vkCmdPipelineBarrier(
+        command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, dst_stages, 0,
+        0, nullptr, 1, &barrier, 0, nullptr);
+    if (!verify_) return;
+
+    const VkBufferCopy copy = {region, readback_ring_.SlotOffset(frame),
+                               draw_region_size_};
+    device_functions_->vkCmdCopyBuffer(command_buffer, draw_buffer_,
+                                       readback_ring_.buffer(), 1, &copy);
+    VkBufferMemoryBarrier host_barrier = barrier;
+    host_barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    host_barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+    host_barrier.buffer = readback_ring_.buffer();
+    host_barrier.offset = copy.dstOffset;
+    device_functions_->vkCmdPipelineBarrier(
+        command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+        VK_PIPELINE_STAGE_HOST_BIT, 0, 0, nullptr, 1, &host_barrier, 0,
+        nullptr);
+    verifications_[frame] = {true, view_projection, settings,
+                             bounds_version_};
+}
+
+void GpuCuller::Draw(VkCommandBuffer command_buffer, int frame)
+{
+    const VkDeviceSize region = frame * draw_region_stride_;
+    const VkDeviceSize commands = region + draw_commands_offset;
+    const auto stride = static_cast<std::uint32_t>(draw_command_size);
+    if (compact_)
+    {
+        draw_indexed_indirect_count_(
+            command_buffer, draw_buffer_, commands, draw_buffer_, region,
+            static_cast<std::uint32_t>(object_count_), stride);
+        return;
+    }
+    for (std::size_t first = 0; first < object_count_;
+         first += max_draw_count_)
+    {
+        const auto count = static_cast<std::uint32_t>(
+            std::min<std::size_t>(max_draw_count_, object_count_ - first));
+        device_functions_->vkCmdDrawIndexedIndirect(
+            command_buffer, draw_buffer_, commands + first * draw_command_size,
+            count, stride);
+    }
+}
+
+void GpuCuller::CreateDescriptors()
+{
+    const VkDescriptorPoolSize pool_sizes[] = {
+        {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1},
+        {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, 2}};
+    VkDescriptorPoolCreateInfo pool_info{};
+    pool_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    pool_info.maxSets = 1;
+    pool_info.poolSizeCount = 2;
+    pool_info.pPoolSizes = pool_sizes;
+    auto err = device_functions_->vkCreateDescriptorPool(
+        device_, &pool_info, nullptr, &descriptor_pool_);
+    if (err != VK_SUCCESS) qFatal("Failed to create descriptor pool: %d", err);
+
+    const VkDescriptorSetLayoutBinding bindings[] = {
+        {0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1,
+         VK_SHADER_STAGE_COMPUTE_BIT, nullptr},
+        {1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, 1,
+         VK_SHADER_STAGE_COMPUTE_BIT, nullptr},
+        {2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, 1,
+         VK_SHADER_STAGE_COMPUTE_BIT, nullptr}};
+    const VkDescriptorSetLayoutCreateInfo layout_info = {
+        VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO, nullptr, 0, 3,
+        bindings};
+    err = device_functions_->vkCreateDescriptorSetLayout(
+        device_, &layout_info, nullptr, &descriptor_set_layout_);
+    if (err != VK_SUCCESS)
+        qFatal("Failed to create descriptor set layout: %d", err);
+
+    const VkDescriptorSetAllocateInfo allocate_info = {
+        VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO, nullptr,
+        descriptor_pool_, 1, &descriptor_set_layout_};
+    err = device_functions_->vkAllocateDescriptorSets(device_, &allocate_info,
+                                                      &descriptor_set_);
+    if (err != VK_SUCCESS) qFatal("Failed to allocate descriptor set: %d", err);
+
+    // each binding covers one slot, the dynamic offsets pick the frame
+    const VkDescriptorBufferInfo buffer_infos[] = {
+        {params_ring_.buffer(), 0, sizeof(Params)},
+        {bounds_ring_.buffer(), 0, bounds_ring_.slot_size()},
+        {draw_buffer_, 0, draw_region_size_}};
+    VkWriteDescriptorSet writes[3]{};
+    for (std::uint32_t i = 0; i < 3; ++i)
+    {
+        writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        writes[i].dstSet = descriptor_set_;
+        writes[i].dstBinding = i;
+        writes[i].descriptorCount = 1;
+        writes[i].descriptorType = bindings[i].descriptorType;
+        writes[i].pBufferInfo = &buffer_infos[i];
+    }
+    device_functions_->vkUpdateDescriptorSets(device_, 3, writes, 0, nullptr);
+}
+
+void GpuCuller::CreatePipeline(VkShaderModule shader, VkPipelineCache cache)
+{
+    VkPipelineLayoutCreateInfo layout_info{};
+    layout_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    layout_info.setLayoutCount = 1;
+    layout_info.pSetLayouts = &descriptor_set_layout_;
+    auto err = device_functions_->vkCreatePipelineLayout(
+        device_, &layout_info, nullptr, &pipeline_layout_);
+    if (err != VK_SUCCESS) qFatal("Failed to create pipeline layout: %d", err);
+
+    VkComputePipelineCreateInfo pipeline_info{};
+    pipeline_info.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipeline_info.stage.sType =
+        VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    pipeline_info.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    pipeline_info.stage.module = shader;
+    pipeline_info.stage.pName = "main";
+    pipeline_info.layout = pipeline_layout_;
+    err = device_functions_->vkCreateComputePipelines(
+        device_, cache, 1, &pipeline_info, nullptr, &pipeline_);
+    if (err != VK_SUCCESS) qFatal("Failed to create compute pipeline: %d", err);
+}
+
+void GpuCuller::CreateDrawBuffer(
+    const VkPhysicalDeviceMemoryProperties& memory,
+    std::uint32_t device_local_index)
+{
+    const int frame_count = params_ring_.slot_count();
+    VkBufferCreateInfo buffer_info{};
+    buffer_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    buffer_info.size = draw_region_stride_ * frame_count;
+    buffer_info.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                        VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT |
+                        VK_BUFFER_USAGE_TRANSFER_DST_BIT |
+                        VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+    auto err = device_functions_->vkCreateBuffer(device_, &buffer_info,
+                                                 nullptr, &draw_buffer_);
+    if (err != VK_SUCCESS) qFatal("Failed to create buffer: %d", err);
+
+    VkMemoryRequirements requirements{};
+    device_functions_->vkGetBufferMemoryRequirements(device_, draw_buffer_,
+                                                     &requirements);
+    const std::uint32_t memory_index =
+        FindMemoryType(memory, requirements.memoryTypeBits, device_local_index,
+                       VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    if (memory_index == UINT32_MAX) qFatal("No device-local memory type");
+    const VkMemoryAllocateInfo allocate_info = {
+        VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO, nullptr, requirements.size,
+        memory_index};
+    err = device_functions_->vkAllocateMemory(device_, &allocate_info,
+                                              nullptr, &draw_memory_);
+    if (err != VK_SUCCESS) qFatal("Failed to allocate memory: %d", err);
+    err = device_functions_->vkBindBufferMemory(device_, draw_buffer_,
+                                                draw_memory_, 0);
+    if (err != VK_SUCCESS) qFatal("Failed to bind buffer memory: %d", err);
+}
+
+void GpuCuller::Verify(int frame)
+{
+    Verification& verification = verifications_[frame];
+    if (!verification.pending) return;
+    verification.pending = false;
+    // the spheres changed since, there is nothing to compare against
+    if (verification.bounds_version != bounds_version_) return;
+
+    readback_ring_.Invalidate(frame, 0, draw_region_size_);
+    const quint8* data = readback_ring_.Slot(frame);
+    std::uint32_t count = static_cast<std::uint32_t>(object_count_);
+    if (compact_) std::memcpy(&count, data, sizeof(count));
+    actual_.clear();
+    for (std::uint32_t i = 0; i < std::min<std::size_t>(count, object_count_);
+         ++i)
+    {
+        VkDrawIndexedIndirectCommand command;
+        std::memcpy(&command,
+                    data + draw_commands_offset + i * draw_command_size,
+                    sizeof(command));
+        if (command.instanceCount == 0) continue;
+        std::uint32_t lod{0};
+        while (lod + 1 < lods_.size() &&
+               lods_[lod].first_index != command.firstIndex)
+            ++lod;
+        actual_.push_back({command.firstInstance, lod});
+    }
+    // compacted commands are in whatever order the invocations ran
+    std::sort(actual_.begin(), actual_.end(),
+              [](const VisibleObject& a, const VisibleObject& b) {
+                  return a.index < b.index;
+              });
+
+    reference_culler_.Cull(verification.view_projection,
+                           verification.settings, spheres_, &expected_);
+    const std::size_t mismatches = CountVisibilityMismatches(
+        verification.view_projection, verification.settings, spheres_,
+        expected_, actual_, verify_tolerance);
+    ++verified_frames_;
+    if (mismatches == 0) return;
+    ++mismatched_frames_;
+    qWarning("GPU culling: %zu objects differ from the CPU reference (%zu "
+             "visible on the GPU, %zu on the CPU)",
+             mismatches, actual_.size(), expected_.size());
+}
@@ -0,0 +1,207 @@
+#include "gpu_timeline.h"
+
+#include <algorithm>
+
+GpuTimeline::GpuTimeline()
+    : device_functions_{nullptr},
+      device_{VK_NULL_HANDLE},
+      semaphore_{VK_NULL_HANDLE},
+      get_semaphore_counter_value_{nullptr},
+      wait_semaphores_{nullptr},
+      submitted_value_{0},
+      completed_value_{0}
+{
+}
+
+void GpuTimeline::Create(QVulkanInstance* instance, VkDevice device,
+                         bool timeline_semaphore)
+{
+    device_functions_ = instance->deviceFunctions(device);
+    device_ = device;
+    submitted_value_ = completed_value_ = 0;
+    if (!timeline_semaphore) return;
+
+    // Not in QVulkanDeviceFunctions, which only covers Vulkan 1.0.
+    const auto get_device_proc_addr =
+        reinterpret_cast<PFN_vkGetDeviceProcAddr>(
+            instance->getInstanceProcAddr("vkGetDeviceProcAddr"));
+    if (get_device_proc_addr)
+    {
+        get_semaphore_counter_value_ =
+            reinterpret_cast<PFN_vkGetSemaphoreCounterValueKHR>(
+                get_device_proc_addr(device,
+                                     "vkGetSemaphoreCounterValueKHR"));
+        wait_semaphores_ = reinterpret_cast<PFN_vkWaitSemaphoresKHR>(
+            get_device_proc_addr(device, "vkWaitSemaphoresKHR"));
+    }
+    if (!get_semaphore_counter_value_ || !wait_semaphores_)
+    {
+        qWarning("vkGetSemaphoreCounterValueKHR missing, using fences");
+        return;
+    }
+
+    VkSemaphoreTypeCreateInfoKHR type_info{};
+    type_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO_KHR;
+    type_info.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE_KHR;
+    type_info.initialValue = 0;
+    VkSemaphoreCreateInfo semaphore_info{};
+    semaphore_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+    semaphore_info.pNext = &type_info;
+    const auto err = device_functions_->vkCreateSemaphore(
+        device_, &semaphore_info, nullptr, &semaphore_);
+    if (err != VK_SUCCESS)
+        qFatal("Failed to create timeline semaphore: %d", err);
+}
+
+void GpuTimeline::Release()
+{
+    if (!device_functions_) return;
+    WaitFor(submitted_value_);
+    for (VkFence fence : free_fences_)
+        device_functions_->vkDestroyFence(device_, fence, nullptr);
+    free_fences_.clear();
+    if (semaphore_)
+    {
+        device_functions_->vkDestroySemaphore(device_, semaphore_, nullptr);
+        semaphore_ = VK_NULL_HANDLE;
+    }
+    device_functions_ = nullptr;
+}
+
+std::uint64_t GpuTimeline::Submit(VkQueue queue,
+                                  const VkCommandBuffer* command_buffers,
+                                  std::uint32_t command_buffer_count,
+                                  const std::vector<Wait>& waits)
+{
+    std::vector<VkSemaphore> wait_semaphores;
+    std::vector<std::uint64_t> wait_values;
+    std::vector<VkPipelineStageFlags> wait_stages;
+    for (const Wait& wait : waits)
+    {
+        if (timeline_semaphore() && wait.timeline->timeline_semaphore())
+        {
+            wait_semaphores.push_back(wait.timeline->semaphore_);
+            wait_values.push_back(wait.value);
+            wait_stages.push_back(wait.stage);
+        }
+        else
+        {
+            wait.timeline->WaitFor(wait.value);
+        }
+    }
+
+    const std::uint64_t value = submitted_value_ + 1;
+    VkSubmitInfo submit_info{};
+    submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submit_info.waitSemaphoreCount =
+        static_cast<std::uint32_t>(wait_semaphores.size());
+    submit_info.pWaitSemaphores = wait_semaphores.data();
+    submit_info.pWaitDstStageMask = wait_stages.data();
+    submit_info.commandBufferCount = command_buffer_count;
+    submit_info.pCommandBuffers = command_buffers;
+    VkTimelineSemaphoreSubmitInfoKHR timeline_info{};
+    VkFence fence{VK_NULL_HANDLE};
+    if (timeline_semaphore())
+    {
+        timeline_info.sType =
+            VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO_KHR;
+        timeline_info.waitSemaphoreValueCount =
+            static_cast<std::uint32_t>(wait_values.size());
+        timeline_info.pWaitSemaphoreValues = wait_values.data();
+        timeline_info.signalSemaphoreValueCount = 1;
+        timeline_info.pSignalSemaphoreValues = &value;
+        submit_info.pNext = &timeline_info;
+        submit_info.signalSemaphoreCount = 1;
+        submit_info.pSignalSemaphores = &semaphore_;
+    }
+    else
+    {
+        fence = AcquireFence();
+    }
+    const auto err =
+        device_functions_->vkQueueSubmit(queue, 1, &submit_info, fence);
+    if (err != VK_SUCCESS) qFatal("Failed to submit: %d", err);
+
+    submitted_value_ = value;
+    if (fence) in_flight_.push_back({value, fence});
+    return value;
+}
+
+std::uint64_t GpuTimeline::CompletedValue()
+{
+    if (completed_value_ == submitted_value_) return completed_value_;
+    if (timeline_semaphore())
+    {
+        const auto err = get_semaphore_counter_value_(device_, semaphore_,
+                                                      &completed_value_);
+        if (err != VK_SUCCESS)
+            qFatal("Failed to read timeline semaphore: %d", err);
+    }
+    else
+    {
+        RetireFences(0);
+    }
+    return completed_value_;
+}
+
+void GpuTimeline::WaitFor(std::uint64_t value)
+{
+    value = std::min(value, submitted_value_);
+    if (value <= completed_value_) return;
+    if (timeline_semaphore())
+    {
+        VkSemaphoreWaitInfoKHR wait_info{};
+        wait_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO_KHR;
+        wait_info.semaphoreCount = 1;
+        wait_info.pSemaphores = &semaphore_;
+        wait_info.pValues = &value;
+        const auto err = wait_semaphores_(device_, &wait_info, UINT64_MAX);
+        if (err != VK_SUCCESS)
+            qFatal("Failed to wait for timeline semaphore: %d", err);
+        completed_value_ = std::max(completed_value_, value);
+    }
+    else
+    {
+        RetireFences(value);
+    }
+}
+
+void GpuTimeline::RetireFences(std::uint64_t wait_value)
+{
+    while (!in_flight_.empty())
+    {
+        FencedSubmission& oldest = in_flight_.front();
+        if (oldest.value <= wait_value)
+        {
+            const auto err = device_functions_->vkWaitForFences(
+                device_, 1, &oldest.fence, VK_TRUE, UINT64_MAX);
+            if (err != VK_SUCCESS) qFatal("Failed to wait for fence: %d", err);
+        }
+        else if (device_functions_->vkGetFenceStatus(device_, oldest.fence) !=
+                 VK_SUCCESS)
+        {
+            break;
+        }
+        device_functions_->vkResetFences(device_, 1, &oldest.fence);
+        free_fences_.push_back(oldest.fence);
+        completed_value_ = oldest.value;
+        in_flight_.pop_front();
+    }
+}
+
+VkFence GpuTimeline::AcquireFence()
+{
+    if (!free_fences_.empty())
+    {
+        const VkFence fence = free_fences_.back();
+        free_fences_.pop_back();
+        return fence;
+    }
+    VkFenceCreateInfo fence_info{};
+    fence_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+    VkFence fence{};
+    const auto err =
+        device_functions_->vkCreateFence(device_, &fence_info, nullptr, &fence);
+    if (err != VK_SUCCESS) qFatal("Failed to create fence: %d", err);
+    return fence;
+}
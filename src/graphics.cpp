@@ -6,15 +6,26 @@
 #include <glm/vec3.hpp>                  // glm::vec3
 #include <glm/vec4.hpp>                  // glm::vec4
 
-glm::mat4 GetMVPMatrix(const float aspect, const float translate_z,
-                       const float rotate_x, const float rotate_y)
+glm::mat4 GetProjectionMatrix(const float aspect)
+{
+    return glm::perspective(glm::pi<float>() * 0.25f, aspect, 0.1f, 100.f);
+}
+
+glm::mat4 GetViewMatrix(const float translate_z, const float rotate_x,
+                        const float rotate_y)
 {
-    const glm::mat4 projection =
-        glm::perspective(glm::pi<float>() * 0.25f, aspect, 0.1f, 100.f);
     glm::mat4 view =
         glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.0f, -translate_z));
     view = glm::rotate(view, rotate_x, glm::vec3(-1.0f, 0.0f, 0.0f));
     view = glm::rotate(view, rotate_y, glm::vec3(0.0f, 1.0f, 0.0f));
+    return view;
+}
+
+glm::mat4 GetMVPMatrix(const float aspect, const float translate_z,
+                       const float rotate_x, const float rotate_y)
+{
+    const glm::mat4 projection = GetProjectionMatrix(aspect);
+    const glm::mat4 view = GetViewMatrix(translate_z, rotate_x, rotate_y);
     constexpr glm::mat4 model = glm::identity<glm::mat4>();
     return projection * view * model;
-}
\ No newline at end of file
+}
@@ -3,5 +3,5 @@
 int main(int argc, char* argv[])
 {
     VulkanApplication app(argc, argv);
-    return app.exec();
+    return app.Run();
 }
\ No newline at end of file
@@ -0,0 +1,121 @@
+#include "mapped_ring_buffer.h"
+
+#include <algorithm>
+
+#include "vulkan_utils.h"
+
+MappedRingBuffer::MappedRingBuffer()
+    : device_functions_{nullptr},
+      device_{VK_NULL_HANDLE},
+      buffer_{VK_NULL_HANDLE},
+      memory_{VK_NULL_HANDLE},
+      mapped_{nullptr},
+      coherent_{true},
+      atom_size_{1},
+      slot_size_{0},
+      slot_stride_{0},
+      slot_count_{0}
+{
+}
+
+void MappedRingBuffer::Create(
+    QVulkanDeviceFunctions* device_functions, VkDevice device,
+    const VkPhysicalDeviceProperties& device_properties,
+    std::uint32_t memory_index, VkMemoryPropertyFlags memory_flags,
+    VkBufferUsageFlags usage, VkDeviceSize slot_size, int slot_count)
+{
+    device_functions_ = device_functions;
+    device_ = device;
+    coherent_ = (memory_flags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) != 0;
+    slot_size_ = slot_size;
+    slot_count_ = slot_count;
+
+    const VkPhysicalDeviceLimits& limits = device_properties.limits;
+    atom_size_ = std::max<VkDeviceSize>(limits.nonCoherentAtomSize, 1);
+    VkDeviceSize slot_align = atom_size_;
+    if (usage & VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT)
+        slot_align =
+            std::max(slot_align, limits.minUniformBufferOffsetAlignment);
+    if (usage & VK_BUFFER_USAGE_STORAGE_BUFFER_BIT)
+        slot_align =
+            std::max(slot_align, limits.minStorageBufferOffsetAlignment);
+    slot_stride_ = aligned(slot_size_, slot_align);
+
+    VkBufferCreateInfo buffer_info{};
+    buffer_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    buffer_info.size = slot_count_ * slot_stride_;
+    buffer_info.usage = usage;
+    auto err = device_functions_->vkCreateBuffer(device_, &buffer_info,
+                                                 nullptr, &buffer_);
+    if (err != VK_SUCCESS) qFatal("Failed to create buffer: %d", err);
+
+    VkMemoryRequirements memory_requirements{};
+    device_functions_->vkGetBufferMemoryRequirements(device_, buffer_,
+                                                     &memory_requirements);
+    VkMemoryAllocateInfo allocate_info = {
+        VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO, nullptr,
+        memory_requirements.size, memory_index};
+    err = device_functions_->vkAllocateMemory(device_, &allocate_info, nullptr,
+                                              &memory_);
+    if (err != VK_SUCCESS) qFatal("Failed to allocate memory: %d", err);
+
+    err = device_functions_->vkBindBufferMemory(device_, buffer_, memory_, 0);
+    if (err != VK_SUCCESS) qFatal("Failed to bind buffer memory: %d", err);
+
+    err = device_functions_->vkMapMemory(device_, memory_, 0, VK_WHOLE_SIZE, 0,
+                                         reinterpret_cast<void**>(&mapped_));
+    if (err != VK_SUCCESS) qFatal("Failed to map memory: %d", err);
+}
+
+void MappedRingBuffer::Release()
+{
+    if (!device_functions_) return;
+    if (memory_)
+    {
+        device_functions_->vkUnmapMemory(device_, memory_);
+        device_functions_->vkFreeMemory(device_, memory_, nullptr);
+        memory_ = VK_NULL_HANDLE;
+        mapped_ = nullptr;
+    }
+    if (buffer_)
+    {
+        device_functions_->vkDestroyBuffer(device_, buffer_, nullptr);
+        buffer_ = VK_NULL_HANDLE;
+    }
+    device_functions_ = nullptr;
+}
+
+void MappedRingBuffer::Flush(int slot, VkDeviceSize offset,
+                             VkDeviceSize size) const
+{
+    if (coherent_ || size == 0) return;
+    const VkMappedMemoryRange range = AtomRange(slot, offset, size);
+    const auto err =
+        device_functions_->vkFlushMappedMemoryRanges(device_, 1, &range);
+    if (err != VK_SUCCESS) qWarning("Failed to flush mapped memory: %d", err);
+}
+
+void MappedRingBuffer::Invalidate(int slot, VkDeviceSize offset,
+                                  VkDeviceSize size) const
+{
+    if (coherent_ || size == 0) return;
+    const VkMappedMemoryRange range = AtomRange(slot, offset, size);
+    const auto err =
+        device_functions_->vkInvalidateMappedMemoryRanges(device_, 1, &range);
+    if (err != VK_SUCCESS)
+        qWarning("Failed to invalidate mapped memory: %d", err);
+}
+
+VkMappedMemoryRange MappedRingBuffer::AtomRange(int slot, VkDeviceSize offset,
+                                                VkDeviceSize size) const
+{
+    // The range has to start and end on atom boundaries. Slots are atom
+    // aligned, so rounding outwards never touches a neighbouring slot.
+    const VkDeviceSize slot_offset = SlotOffset(slot);
+    const VkDeviceSize begin = slot_offset + offset / atom_size_ * atom_size_;
+    const VkDeviceSize end =
+        slot_offset +
+        std::min(aligned(offset + size, atom_size_), slot_stride_);
+    return {VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE, nullptr, memory_, begin,
+            end - begin};
+}
@@ -0,0 +1,58 @@
+#include "materials.h"
+
+#include <algorithm>
+#include <cmath>
+
+std::vector<MaterialData> CreateMaterials(int count, int texture_count)
+{
+    std::vector<MaterialData> materials(std::max(count, 1));
+    texture_count = std::max(texture_count, 1);
+    for (std::size_t i = 0; i < materials.size(); ++i)
+    {
+        MaterialData& material = materials[i];
+        material.texture = static_cast<std::uint32_t>(i % texture_count);
+        material.tint[3] = 1.0f;
+        if (i == 0)
+        {
+            std::fill(material.tint, material.tint + 3, 1.0f);
+            continue;
+        }
+        // hues spread by the golden ratio, so neighbours differ
+        const float hue = std::fmod(i * 0.618034f, 1.0f);
+        for (int k = 0; k < 3; ++k)
+        {
+            material.tint[k] =
+                0.6f + 0.4f * std::cos(6.2831853f * (hue + k / 3.0f));
+        }
+    }
+    return materials;
+}
+
+std::vector<std::uint8_t> CreateMaterialTexture(int index)
+{
+    std::vector<std::uint8_t> texels(
+        material_texture_size * material_texture_size * 4, 255);
+    if (index == 0) return texels;
+
+    const int cell_size = 2 << (index % 3);  // 2, 4 or 8 texels
+    const auto dark = static_cast<std::uint8_t>(64 + (index * 37) % 128);
+    for (int y = 0; y < material_texture_size; ++y)
+    {
+        for (int x = 0; x < material_texture_size; ++x)
+        {
+            if ((x / cell_size + y / cell_size) % 2 == 0) continue;
+            std::uint8_t* texel =
+                texels.data() + 4 * (y * material_texture_size + x);
+            std::fill(texel, texel + 3, dark);
+        }
+    }
+    return texels;
+}
+
+std::uint32_t InstancesPerMaterial(std::uint32_t instance_count,
+                                   std::uint32_t material_count)
+{
+    material_count = std::max(material_count, 1u);
+    return std::max((instance_count + material_count - 1) / material_count,
+                    1u);
+}
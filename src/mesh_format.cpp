@@ -0,0 +1,251 @@
+#include "mesh_format.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <unordered_map>
+
+namespace
+{
+std::uint64_t AlignedOffset(std::uint64_t offset)
+{
+    return (offset + mesh_section_alignment - 1) / mesh_section_alignment *
+           mesh_section_alignment;
+}
+
+// Whether [offset, offset + count * element_size) lies within size bytes,
+// without overflowing.
+bool SectionFits(std::uint64_t offset, std::uint64_t count,
+                 std::uint64_t element_size, std::size_t size)
+{
+    if (offset % mesh_section_alignment != 0 || offset > size) return false;
+    return count <= (size - offset) / element_size;
+}
+
+void WritePadding(std::uint64_t* position, std::ostream* out)
+{
+    static const char zeros[mesh_section_alignment] = {};
+    const std::uint64_t aligned = AlignedOffset(*position);
+    out->write(zeros, static_cast<std::streamsize>(aligned - *position));
+    *position = aligned;
+}
+
+void WriteBytes(const void* data, std::uint64_t size, std::uint64_t* position,
+                std::ostream* out)
+{
+    out->write(static_cast<const char*>(data),
+               static_cast<std::streamsize>(size));
+    *position += size;
+}
+
+void ComputeBounds(const MeshData& mesh, Meshlet* meshlet)
+{
+    const BoundingSphere sphere = ComputeBoundingSphere(
+        &mesh.vertices[meshlet->first_vertex * vertex_float_count],
+        meshlet->vertex_count);
+    for (int k = 0; k < 3; ++k) meshlet->center[k] = sphere.center[k];
+    meshlet->radius = sphere.radius;
+}
+}  // namespace
+
+bool ParseMeshFile(const void* data, std::size_t size, MeshFileView* view,
+                   std::string* error)
+{
+    if (size < sizeof(MeshFileHeader))
+    {
+        *error = "file is smaller than the header";
+        return false;
+    }
+    const auto* bytes = static_cast<const unsigned char*>(data);
+    const auto* header = reinterpret_cast<const MeshFileHeader*>(bytes);
+    if (header->magic != mesh_file_magic)
+    {
+        *error = "not a mesh file";
+        return false;
+    }
+    if (header->version != mesh_file_version)
+    {
+        *error = "unsupported version " + std::to_string(header->version);
+        return false;
+    }
+    if (header->vertex_stride != vertex_float_count * sizeof(float))
+    {
+        *error = "unsupported vertex stride " +
+                 std::to_string(header->vertex_stride);
+        return false;
+    }
+    if (header->vertex_count > UINT32_MAX || header->index_count > UINT32_MAX)
+    {
+        *error = "more than 2^32 vertices or indices";
+        return false;
+    }
+    if (!SectionFits(header->vertex_offset, header->vertex_count,
+                     header->vertex_stride, size) ||
+        !SectionFits(header->index_offset, header->index_count,
+                     sizeof(std::uint32_t), size) ||
+        !SectionFits(header->meshlet_offset, header->meshlet_count,
+                     sizeof(Meshlet), size))
+    {
+        *error = "section out of bounds or misaligned";
+        return false;
+    }
+
+    view->header = header;
+    view->vertices =
+        reinterpret_cast<const float*>(bytes + header->vertex_offset);
+    view->indices =
+        reinterpret_cast<const std::uint32_t*>(bytes + header->index_offset);
+    view->meshlets =
+        reinterpret_cast<const Meshlet*>(bytes + header->meshlet_offset);
+
+    // Meshlets have to tile both sections in order for prefixes to work.
+    // Their indices are left to CheckMeshletIndices, reading them all here
+    // would page in the whole index section before anything streams.
+    std::uint64_t next_vertex{0};
+    std::uint64_t next_index{0};
+    for (std::uint32_t i = 0; i < header->meshlet_count; ++i)
+    {
+        const Meshlet& meshlet = view->meshlets[i];
+        if (meshlet.first_vertex != next_vertex ||
+            meshlet.first_index != next_index)
+        {
+            *error = "meshlet " + std::to_string(i) + " is out of order";
+            return false;
+        }
+        next_vertex += meshlet.vertex_count;
+        next_index += meshlet.index_count;
+        if (next_vertex > header->vertex_count ||
+            next_index > header->index_count)
+        {
+            *error = "meshlets do not cover the mesh";
+            return false;
+        }
+    }
+    if (next_vertex != header->vertex_count ||
+        next_index != header->index_count)
+    {
+        *error = "meshlets do not cover the mesh";
+        return false;
+    }
+    return true;
+}
+
+bool CheckMeshletIndices(const MeshFileView& view, std::uint32_t meshlet,
+                         std::string* error)
+{
+    const Meshlet& checked = view.meshlets[meshlet];
+    const std::uint32_t* indices = view.indices + checked.first_index;
+    for (std::uint32_t k = 0; k < checked.index_count; ++k)
+    {
+        if (indices[k] < checked.first_vertex ||
+            indices[k] - checked.first_vertex >= checked.vertex_count)
+        {
+            *error = "meshlet " + std::to_string(meshlet) +
+                     " references vertex " + std::to_string(indices[k]) +
+                     " outside of it";
+            return false;
+        }
+    }
+    return true;
+}
+
+std::vector<Meshlet> BuildMeshlets(MeshData* mesh)
+{
+    MeshData output;
+    output.vertices.reserve(mesh->vertices.size());
+    output.indices.reserve(mesh->indices.size());
+    std::vector<Meshlet> meshlets;
+
+    // original vertex index -> index in output, for the current meshlet
+    std::unordered_map<std::uint32_t, std::uint32_t> remap;
+    Meshlet meshlet{};
+    const auto close_meshlet = [&] {
+        if (meshlet.index_count == 0) return;
+        ComputeBounds(output, &meshlet);
+        meshlets.push_back(meshlet);
+        meshlet = {};
+        meshlet.first_vertex =
+            static_cast<std::uint32_t>(output.vertices.size() /
+                                       vertex_float_count);
+        meshlet.first_index = static_cast<std::uint32_t>(output.indices.size());
+        remap.clear();
+    };
+
+    for (std::size_t t = 0; t + 2 < mesh->indices.size(); t += 3)
+    {
+        std::uint32_t new_vertices{0};
+        for (int k = 0; k < 3; ++k)
+            new_vertices += remap.count(mesh->indices[t + k]) == 0 ? 1 : 0;
+        if (meshlet.vertex_count + new_vertices > meshlet_max_vertices ||
+            meshlet.index_count / 3 + 1 > meshlet_max_triangles)
+        {
+            close_meshlet();
+        }
+
+        for (int k = 0; k < 3; ++k)
+        {
+            const std::uint32_t original = mesh->indices[t + k];
+            auto [it, inserted] = remap.emplace(
+                original, static_cast<std::uint32_t>(output.vertices.size() /
+                                                     vertex_float_count));
+            if (inserted)
+            {
+                const auto source =
+                    mesh->vertices.begin() + original * vertex_float_count;
+                output.vertices.insert(output.vertices.end(), source,
+                                       source + vertex_float_count);
+                ++meshlet.vertex_count;
+            }
+            output.indices.push_back(it->second);
+            ++meshlet.index_count;
+        }
+    }
+    close_meshlet();
+
+    *mesh = std::move(output);
+    return meshlets;
+}
+
+bool WriteMeshFile(const MeshData& mesh, const std::vector<Meshlet>& meshlets,
+                   std::ostream* out)
+{
+    MeshFileHeader header{};
+    header.magic = mesh_file_magic;
+    header.version = mesh_file_version;
+    header.vertex_stride = vertex_float_count * sizeof(float);
+    header.meshlet_count = static_cast<std::uint32_t>(meshlets.size());
+    header.vertex_count = mesh.vertices.size() / vertex_float_count;
+    header.index_count = mesh.indices.size();
+    header.vertex_offset = AlignedOffset(sizeof(MeshFileHeader));
+    header.index_offset =
+        AlignedOffset(header.vertex_offset + mesh.VertexBytes());
+    header.meshlet_offset =
+        AlignedOffset(header.index_offset + mesh.IndexBytes());
+
+    for (int k = 0; k < 3; ++k)
+    {
+        header.bounds_min[k] = INFINITY;
+        header.bounds_max[k] = -INFINITY;
+    }
+    for (std::size_t v = 0; v < mesh.vertices.size(); v += vertex_float_count)
+    {
+        for (int k = 0; k < 3; ++k)
+        {
+            header.bounds_min[k] =
+                std::min(header.bounds_min[k], mesh.vertices[v + k]);
+            header.bounds_max[k] =
+                std::max(header.bounds_max[k], mesh.vertices[v + k]);
+        }
+    }
+
+    std::uint64_t position{0};
+    WriteBytes(&header, sizeof(header), &position, out);
+    WritePadding(&position, out);
+    WriteBytes(mesh.vertices.data(), mesh.VertexBytes(), &position, out);
+    WritePadding(&position, out);
+    WriteBytes(mesh.indices.data(), mesh.IndexBytes(), &position, out);
+    WritePadding(&position, out);
+    WriteBytes(meshlets.data(), meshlets.size() * sizeof(Meshlet), &position,
+               out);
+    return static_cast<bool>(*out);
+}
@@ -0,0 +1,465 @@
+#include "mesh_import.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <sstream>
+#include <unordered_map>
+#include <vector>
+
+namespace
+{
+float* Position(MeshData* mesh, std::uint32_t vertex)
+{
+    return &mesh->vertices[vertex * vertex_float_count];
+}
+
+void AddVertex(const float* position, const float* normal, const float* color,
+               MeshData* mesh)
+{
+    mesh->vertices.insert(mesh->vertices.end(), position, position + 3);
+    mesh->vertices.insert(mesh->vertices.end(), normal, normal + 3);
+    mesh->vertices.insert(mesh->vertices.end(), color, color + 3);
+}
+
+// Appends the fan triangulation of a polygon.
+void AddPolygon(const std::vector<std::uint32_t>& polygon, MeshData* mesh)
+{
+    for (std::size_t k = 2; k < polygon.size(); ++k)
+    {
+        mesh->indices.push_back(polygon[0]);
+        mesh->indices.push_back(polygon[k - 1]);
+        mesh->indices.push_back(polygon[k]);
+    }
+}
+
+// Area weighted average of the adjacent face normals.
+void ComputeNormals(MeshData* mesh)
+{
+    const std::size_t vertex_count = mesh->vertices.size() / vertex_float_count;
+    std::vector<float> normals(3 * vertex_count, 0.0f);
+    for (std::size_t t = 0; t + 2 < mesh->indices.size(); t += 3)
+    {
+        const float* a = Position(mesh, mesh->indices[t]);
+        const float* b = Position(mesh, mesh->indices[t + 1]);
+        const float* c = Position(mesh, mesh->indices[t + 2]);
+        const float u[3] = {b[0] - a[0], b[1] - a[1], b[2] - a[2]};
+        const float v[3] = {c[0] - a[0], c[1] - a[1], c[2] - a[2]};
+        const float n[3] = {u[1] * v[2] - u[2] * v[1],
+                            u[2] * v[0] - u[0] * v[2],
+                            u[0] * v[1] - u[1] * v[0]};
+        for (int k = 0; k < 3; ++k)
+        {
+            for (int j = 0; j < 3; ++j)
+                normals[3 * mesh->indices[t + k] + j] += n[j];
+        }
+    }
+    for (std::size_t v = 0; v < vertex_count; ++v)
+    {
+        const float* n = &normals[3 * v];
+        const float length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+        float* normal = &mesh->vertices[v * vertex_float_count +
+                                        vertex_normal_offset];
+        if (length > 0.0f)
+        {
+            for (int j = 0; j < 3; ++j) normal[j] = n[j] / length;
+        }
+        else
+        {
+            normal[0] = normal[1] = 0.0f;
+            normal[2] = 1.0f;
+        }
+    }
+}
+
+// OBJ indices are 1-based, negative ones count back from the last element.
+bool ObjIndex(const std::string& token, std::size_t count, std::uint32_t* index)
+{
+    if (token.empty()) return false;
+    char* end{nullptr};
+    const long value = std::strtol(token.c_str(), &end, 10);
+    if (*end != '\0' || value == 0) return false;
+    const long resolved =
+        value > 0 ? value - 1 : static_cast<long>(count) + value;
+    if (resolved < 0 || resolved >= static_cast<long>(count)) return false;
+    *index = static_cast<std::uint32_t>(resolved);
+    return true;
+}
+
+enum class PlyType
+{
+    kInt8,
+    kUint8,
+    kInt16,
+    kUint16,
+    kInt32,
+    kUint32,
+    kFloat32,
+    kFloat64,
+    kInvalid,
+};
+
+PlyType ParsePlyType(const std::string& name)
+{
+    if (name == "char" || name == "int8") return PlyType::kInt8;
+    if (name == "uchar" || name == "uint8") return PlyType::kUint8;
+    if (name == "short" || name == "int16") return PlyType::kInt16;
+    if (name == "ushort" || name == "uint16") return PlyType::kUint16;
+    if (name == "int" || name == "int32") return PlyType::kInt32;
+    if (name == "uint" || name == "uint32") return PlyType::kUint32;
+    if (name == "float" || name == "float32") return PlyType::kFloat32;
+    if (name == "double" || name == "float64") return PlyType::kFloat64;
+    return PlyType::kInvalid;
+}
+
+template <typename T>
+bool ReadBinary(std::istream& in, double* value)
+{
+    T raw{};
+    char bytes[sizeof(T)];
+    if (!in.read(bytes, sizeof(T))) return false;
+    std::memcpy(&raw, bytes, sizeof(T));  // the host is little-endian
+    *value = static_cast<double>(raw);
+    return true;
+}
+
+bool ReadPlyValue(std::istream& in, PlyType type, bool binary, double* value)
+{
+    if (!binary) return static_cast<bool>(in >> *value);
+    switch (type)
+    {
+        case PlyType::kInt8:
+            return ReadBinary<std::int8_t>(in, value);
+        case PlyType::kUint8:
+            return ReadBinary<std::uint8_t>(in, value);
+        case PlyType::kInt16:
+            return ReadBinary<std::int16_t>(in, value);
+        case PlyType::kUint16:
+            return ReadBinary<std::uint16_t>(in, value);
+        case PlyType::kInt32:
+            return ReadBinary<std::int32_t>(in, value);
+        case PlyType::kUint32:
+            return ReadBinary<std::uint32_t>(in, value);
+        case PlyType::kFloat32:
+            return ReadBinary<float>(in, value);
+        case PlyType::kFloat64:
+            return ReadBinary<double>(in, value);
+        case PlyType::kInvalid:
+            break;
+    }
+    return false;
+}
+
+struct PlyProperty
+{
+    std::string name;
+    PlyType type;
+    bool is_list;
+    PlyType count_type;
+};
+
+struct PlyElement
+{
+    std::string name;
+    std::size_t count;
+    std::vector<PlyProperty> properties;
+};
+
+int FindProperty(const PlyElement& element, const char* name)
+{
+    for (std::size_t i = 0; i < element.properties.size(); ++i)
+    {
+        if (element.properties[i].name == name) return static_cast<int>(i);
+    }
+    return -1;
+}
+}  // namespace
+
+bool LoadObj(std::istream& in, MeshData* mesh, std::string* error)
+{
+    std::vector<float> positions;
+    std::vector<float> colors;
+    std::vector<float> normals;
+    // (position, normal + 1) -> vertex, normal 0 means none
+    std::unordered_map<std::uint64_t, std::uint32_t> vertices;
+    bool all_normals{true};
+    *mesh = {};
+
+    std::string line;
+    std::vector<std::uint32_t> polygon;
+    for (int line_number = 1; std::getline(in, line); ++line_number)
+    {
+        std::istringstream tokens(line);
+        std::string keyword;
+        tokens >> keyword;
+        if (keyword == "v")
+        {
+            float values[6] = {0.0f, 0.0f, 0.0f, 1.0f, 1.0f, 1.0f};
+            int count{0};
+            while (count < 6 && tokens >> values[count]) ++count;
+            if (count < 3 || count == 5)
+            {
+                *error = "line " + std::to_string(line_number) +
+                         ": expected 3 or 6 vertex values";
+                return false;
+            }
+            // x y z w has no color
+            if (count == 4) values[3] = 1.0f;
+            positions.insert(positions.end(), values, values + 3);
+            colors.insert(colors.end(), values + 3, values + 6);
+        }
+        else if (keyword == "vn")
+        {
+            float normal[3] = {};
+            if (!(tokens >> normal[0] >> normal[1] >> normal[2]))
+            {
+                *error = "line " + std::to_string(line_number) +
+                         ": expected 3 normal values";
+                return false;
+            }
+            normals.insert(normals.end(), normal, normal + 3);
+        }
+        else if (keyword == "f")
+        {
+            polygon.clear();
+            std::string corner;
+            while (tokens >> corner)
+            {
+                // v, v/vt, v//vn or v/vt/vn
+                const std::size_t slash = corner.find('/');
+                const std::size_t second_slash =
+                    slash == std::string::npos ? std::string::npos
+                                               : corner.find('/', slash + 1);
+                std::uint32_t position{0};
+                std::uint32_t normal{0};
+                const bool has_normal = second_slash != std::string::npos;
+                if (!ObjIndex(corner.substr(0, slash), positions.size() / 3,
+                              &position) ||
+                    (has_normal &&
+                     !ObjIndex(corner.substr(second_slash + 1),
+                               normals.size() / 3, &normal)))
+                {
+                    *error = "line " + std::to_string(line_number) +
+                             ": invalid face index " + corner;
+                    return false;
+                }
+                all_normals = all_normals && has_normal;
+
+                const std::uint64_t key =
+                    (std::uint64_t{position} << 32) |
+                    (has_normal ? normal + std::uint64_t{1} : 0);
+                auto [it, inserted] = vertices.emplace(
+                    key, static_cast<std::uint32_t>(mesh->vertices.size() /
+                                                    vertex_float_count));
+                if (inserted)
+                {
+                    static const float no_normal[3] = {0.0f, 0.0f, 1.0f};
+                    AddVertex(&positions[3 * position],
+                              has_normal ? &normals[3 * normal] : no_normal,
+                              &colors[3 * position], mesh);
+                }
+                polygon.push_back(it->second);
+            }
+            AddPolygon(polygon, mesh);
+        }
+    }
+    if (mesh->indices.empty())
+    {
+        *error = "no faces";
+        return false;
+    }
+    if (!all_normals) ComputeNormals(mesh);
+    return true;
+}
+
+bool LoadPly(std::istream& in, MeshData* mesh, std::string* error)
+{
+    std::string line;
+    if (!std::getline(in, line) || line.rfind("ply", 0) != 0)
+    {
+        *error = "not a PLY file";
+        return false;
+    }
+
+    bool binary{false};
+    std::vector<PlyElement> elements;
+    while (std::getline(in, line))
+    {
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        std::istringstream tokens(line);
+        std::string keyword;
+        tokens >> keyword;
+        if (keyword == "end_header") break;
+        if (keyword == "format")
+        {
+            std::string format;
+            tokens >> format;
+            if (format == "binary_little_endian")
+            {
+                binary = true;
+            }
+            else if (format != "ascii")
+            {
+                *error = "unsupported PLY format " + format;
+                return false;
+            }
+        }
+        else if (keyword == "element")
+        {
+            PlyElement element{};
+            tokens >> element.name >> element.count;
+            elements.push_back(element);
+        }
+        else if (keyword == "property" && !elements.empty())
+        {
+            PlyProperty property{};
+            std::string type;
+            tokens >> type;
+            if (type == "list")
+            {
+                std::string count_type;
+                tokens >> count_type >> type;
+                property.is_list = true;
+                property.count_type = ParsePlyType(count_type);
+            }
+            property.type = ParsePlyType(type);
+            tokens >> property.name;
+            if (property.type == PlyType::kInvalid ||
+                (property.is_list && property.count_type == PlyType::kInvalid))
+            {
+                *error = "unsupported PLY property: " + line;
+                return false;
+            }
+            elements.back().properties.push_back(property);
+        }
+    }
+
+    *mesh = {};
+    std::vector<double> values;
+    std::vector<std::uint32_t> polygon;
+    bool has_normals{false};
+    for (const PlyElement& element : elements)
+    {
+        // property of each vertex float, or -1
+        static const char* vertex_names[vertex_float_count] = {
+            "x", "y", "z", "nx", "ny", "nz", "red", "green", "blue"};
+        int vertex_properties[vertex_float_count];
+        for (std::size_t k = 0; k < vertex_float_count; ++k)
+            vertex_properties[k] = FindProperty(element, vertex_names[k]);
+        const int x = vertex_properties[0];
+        const int nx = vertex_properties[vertex_normal_offset];
+        int face = FindProperty(element, "vertex_indices");
+        if (face < 0) face = FindProperty(element, "vertex_index");
+        const bool is_vertex = element.name == "vertex" && x >= 0;
+        const bool is_face = element.name == "face" && face >= 0;
+        if (is_vertex)
+        {
+            has_normals = nx >= 0;
+            mesh->vertices.reserve(element.count * vertex_float_count);
+        }
+
+        values.resize(element.properties.size());
+        for (std::size_t i = 0; i < element.count; ++i)
+        {
+            polygon.clear();
+            for (std::size_t p = 0; p < element.properties.size(); ++p)
+            {
+                const PlyProperty& property = element.properties[p];
+                if (!property.is_list)
+                {
+                    if (!ReadPlyValue(in, property.type, binary, &values[p]))
+                    {
+                        *error = "unexpected end of " + element.name + " data";
+                        return false;
+                    }
+                    continue;
+                }
+                double count{0.0};
+                if (!ReadPlyValue(in, property.count_type, binary, &count))
+                {
+                    *error = "unexpected end of " + element.name + " data";
+                    return false;
+                }
+                for (int k = 0; k < static_cast<int>(count); ++k)
+                {
+                    double index{0.0};
+                    if (!ReadPlyValue(in, property.type, binary, &index))
+                    {
+                        *error = "unexpected end of " + element.name + " data";
+                        return false;
+                    }
+                    if (static_cast<int>(p) == face)
+                        polygon.push_back(static_cast<std::uint32_t>(index));
+                }
+            }
+
+            if (is_vertex)
+            {
+                float vertex[vertex_float_count] = {
+                    0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 1.0f, 1.0f, 1.0f};
+                for (std::size_t k = 0; k < vertex_float_count; ++k)
+                {
+                    const int property = vertex_properties[k];
+                    if (property < 0) continue;
+                    vertex[k] = static_cast<float>(values[property]);
+                    // integer colors are 0-255
+                    const PlyType type = element.properties[property].type;
+                    if (k >= vertex_color_offset && type != PlyType::kFloat32 &&
+                        type != PlyType::kFloat64)
+                        vertex[k] /= 255.0f;
+                }
+                AddVertex(vertex, vertex + vertex_normal_offset,
+                          vertex + vertex_color_offset, mesh);
+            }
+            else if (is_face)
+            {
+                AddPolygon(polygon, mesh);
+            }
+        }
+    }
+
+    const std::size_t vertex_count = mesh->vertices.size() / vertex_float_count;
+    for (const std::uint32_t index : mesh->indices)
+    {
+        if (index >= vertex_count)
+        {
+            *error = "face index " + std::to_string(index) + " out of range";
+            return false;
+        }
+    }
+    if (mesh->indices.empty())
+    {
+        *error = "no faces";
+        return false;
+    }
+    if (!has_normals) ComputeNormals(mesh);
+    return true;
+}
+
+void NormalizeMesh(MeshData* mesh)
+{
+    float low[3] = {INFINITY, INFINITY, INFINITY};
+    float high[3] = {-INFINITY, -INFINITY, -INFINITY};
+    for (std::size_t v = 0; v < mesh->vertices.size(); v += vertex_float_count)
+    {
+        for (int k = 0; k < 3; ++k)
+        {
+            low[k] = std::min(low[k], mesh->vertices[v + k]);
+            high[k] = std::max(high[k], mesh->vertices[v + k]);
+        }
+    }
+    const float extent = std::max(
+        {high[0] - low[0], high[1] - low[1], high[2] - low[2]});
+    if (!(extent > 0.0f)) return;
+
+    const float scale = 1.0f / extent;
+    for (std::size_t v = 0; v < mesh->vertices.size(); v += vertex_float_count)
+    {
+        for (int k = 0; k < 3; ++k)
+        {
+            const float center = 0.5f * (low[k] + high[k]);
+            mesh->vertices[v + k] = (mesh->vertices[v + k] - center) * scale;
+        }
+    }
+}
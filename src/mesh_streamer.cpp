@@ -0,0 +1,121 @@
+#include "mesh_streamer.h"
+
+#include <string>
+
+MeshStreamer::MeshStreamer()
+    : mapped_{nullptr},
+      meshlet_count_{0},
+      resident_meshlets_{0},
+      resident_index_count_{0},
+      failed_{false}
+{
+}
+
+bool MeshStreamer::Open(const QString& path)
+{
+    Close();
+    file_.setFileName(path);
+    if (!file_.open(QIODevice::ReadOnly))
+    {
+        qWarning("Failed to open mesh %s", qPrintable(path));
+        return false;
+    }
+    mapped_ = file_.map(0, file_.size());
+    if (!mapped_)
+    {
+        qWarning("Failed to map mesh %s", qPrintable(path));
+        file_.close();
+        return false;
+    }
+
+    std::string error;
+    if (!ParseMeshFile(mapped_, static_cast<std::size_t>(file_.size()), &view_,
+                       &error))
+    {
+        qWarning("Invalid mesh %s: %s", qPrintable(path), error.c_str());
+        Close();
+        return false;
+    }
+    meshlet_count_ = view_.header->meshlet_count;
+    resident_meshlets_ = 0;
+    resident_index_count_ = 0;
+    failed_ = false;
+    return true;
+}
+
+void MeshStreamer::Close()
+{
+    if (mapped_) file_.unmap(mapped_);
+    mapped_ = nullptr;
+    if (file_.isOpen()) file_.close();
+}
+
+VkDeviceSize MeshStreamer::StreamNext(StagingUploader* uploader,
+                                      VkBuffer vertex_buffer,
+                                      VkBuffer index_buffer,
+                                      VkDeviceSize budget)
+{
+    const MeshFileHeader& file_header = header();
+    const std::uint32_t first = resident_meshlets_;
+    std::uint32_t end = first;
+    VkDeviceSize bytes{0};
+    while (end < file_header.meshlet_count && (end == first || bytes < budget))
+    {
+        const Meshlet& meshlet = view_.meshlets[end];
+        bytes += meshlet.vertex_count * file_header.vertex_stride +
+                 meshlet.index_count * sizeof(std::uint32_t);
+        ++end;
+    }
+    if (end == first) return 0;
+
+    // Only the chunk's indices are checked, and only now, so the rest of
+    // the file does not have to be read before the first meshlets draw.
+    for (std::uint32_t i = first; i < end; ++i)
+    {
+        std::string error;
+        if (!CheckMeshletIndices(view_, i, &error))
+        {
+            qWarning("Invalid mesh %s: %s, streaming stops after %u of %u "
+                     "meshlets",
+                     qPrintable(file_.fileName()), error.c_str(), first,
+                     meshlet_count_);
+            failed_ = true;
+            Close();
+            return 0;
+        }
+    }
+
+    // The meshlets are contiguous in both sections, so the whole chunk is
+    // one vertex and one index copy.
+    const Meshlet& first_meshlet = view_.meshlets[first];
+    const Meshlet& last_meshlet = view_.meshlets[end - 1];
+    const VkDeviceSize vertex_begin =
+        VkDeviceSize{first_meshlet.first_vertex} * file_header.vertex_stride;
+    const VkDeviceSize vertex_end =
+        VkDeviceSize{last_meshlet.first_vertex + last_meshlet.vertex_count} *
+        file_header.vertex_stride;
+    const VkDeviceSize index_begin =
+        VkDeviceSize{first_meshlet.first_index} * sizeof(std::uint32_t);
+    const VkDeviceSize index_end =
+        VkDeviceSize{last_meshlet.first_index + last_meshlet.index_count} *
+        sizeof(std::uint32_t);
+    uploader->Upload(vertex_buffer, vertex_begin,
+                     mapped_ + file_header.vertex_offset + vertex_begin,
+                     vertex_end - vertex_begin);
+    uploader->Upload(index_buffer, index_begin,
+                     mapped_ + file_header.index_offset + index_begin,
+                     index_end - index_begin);
+    resident_meshlets_ = end;
+    resident_index_count_ = last_meshlet.first_index + last_meshlet.index_count;
+    return bytes;
+}
+
+VkDeviceSize MeshStreamer::VertexBytes() const
+{
+    return header().vertex_count * header().vertex_stride;
+}
+
+VkDeviceSize MeshStreamer::IndexBytes() const
+{
+    return header().index_count * sizeof(std::uint32_t);
+}
@@ -0,0 +1,660 @@
+#include "offscreen_render_target.h"
+
+#include <QtGui/QVulkanFunctions>
+#include <cstring>
+#include <utility>
+
+#include "vulkan_utils.h"
+
+OffscreenRenderTarget::OffscreenRenderTarget(QVulkanInstance* instance,
+                                             const QSize& size,
+                                             int concurrent_frames,
+                                             bool allow_timeline_semaphore,
+                                             bool allow_transfer_queue)
+    : instance_(instance),
+      device_functions_{nullptr},
+      size_(size),
+      requested_frame_count_(concurrent_frames),
+      allow_timeline_semaphore_{allow_timeline_semaphore},
+      allow_transfer_queue_{allow_transfer_queue},
+      physical_device_{VK_NULL_HANDLE},
+      physical_device_properties_{},
+      memory_properties_{},
+      graphics_queue_family_{0},
+      device_{VK_NULL_HANDLE},
+      graphics_queue_{VK_NULL_HANDLE},
+      command_pool_{VK_NULL_HANDLE},
+      host_visible_memory_index_{0},
+      device_local_memory_index_{0},
+      readback_coherent_{true},
+      draw_indirect_count_{false},
+      multi_draw_indirect_{false},
+      descriptor_indexing_{false},
+      timeline_semaphore_{false},
+      transfer_queue_family_{UINT32_MAX},
+      transfer_queue_{VK_NULL_HANDLE},
+      transfer_command_pool_{VK_NULL_HANDLE},
+      color_format_{VK_FORMAT_R8G8B8A8_UNORM},
+      depth_format_{VK_FORMAT_UNDEFINED},
+      render_pass_{VK_NULL_HANDLE},
+      current_frame_{0},
+      frame_number_{0}
+{
+}
+
+OffscreenRenderTarget::~OffscreenRenderTarget() { Release(); }
+
+bool OffscreenRenderTarget::Create()
+{
+    if (!PickPhysicalDevice()) return false;
+    CreateDevice();
+    CreateRenderPass();
+    graphics_timeline_.Create(instance_, device_, timeline_semaphore_);
+
+    if (requested_frame_count_ > max_frames_in_flight)
+    {
+        qWarning("--frames-in-flight: rendering at most %d frames ahead",
+                 max_frames_in_flight);
+    }
+    frames_.resize(qBound(1, requested_frame_count_, max_frames_in_flight));
+    for (Frame& frame : frames_) CreateFrame(&frame);
+    current_frame_ = 0;
+    frame_number_ = 0;
+    return true;
+}
+
+void OffscreenRenderTarget::Release()
+{
+    if (!device_) return;
+    device_functions_->vkDeviceWaitIdle(device_);
+    graphics_timeline_.Release();
+    frame_waits_.clear();
+    for (Frame& frame : frames_) ReleaseFrame(&frame);
+    frames_.clear();
+    if (render_pass_)
+    {
+        device_functions_->vkDestroyRenderPass(device_, render_pass_, nullptr);
+        render_pass_ = VK_NULL_HANDLE;
+    }
+    if (command_pool_)
+    {
+        device_functions_->vkDestroyCommandPool(device_, command_pool_,
+                                                nullptr);
+        command_pool_ = VK_NULL_HANDLE;
+    }
+    if (transfer_command_pool_)
+    {
+        device_functions_->vkDestroyCommandPool(
+            device_, transfer_command_pool_, nullptr);
+        transfer_command_pool_ = VK_NULL_HANDLE;
+    }
+    transfer_queue_ = VK_NULL_HANDLE;
+    device_functions_->vkDestroyDevice(device_, nullptr);
+    instance_->resetDeviceFunctions(device_);
+    device_functions_ = nullptr;
+    device_ = VK_NULL_HANDLE;
+}
+
+void OffscreenRenderTarget::SetFrameCallback(FrameCallback callback)
+{
+    frame_callback_ = std::move(callback);
+}
+
+void OffscreenRenderTarget::BeginFrame()
+{
+    current_frame_ = frame_number_ % static_cast<int>(frames_.size());
+    Frame& frame = frames_[current_frame_];
+
+    // Only blocks if the GPU is a whole ring of frames behind.
+    graphics_timeline_.WaitFor(frame.submitted_value);
+    CollectReadback(&frame);
+
+    device_functions_->vkResetCommandBuffer(frame.command_buffer, 0);
+    VkCommandBufferBeginInfo begin_info{};
+    begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    const auto err = device_functions_->vkBeginCommandBuffer(
+        frame.command_buffer, &begin_info);
+    if (err != VK_SUCCESS) qFatal("Failed to begin command buffer: %d", err);
+}
+
+void OffscreenRenderTarget::frameReady()
+{
+    Frame& frame = frames_[current_frame_];
+
+    if (frame_callback_)
+    {
+        // The render pass leaves the color image in TRANSFER_SRC_OPTIMAL.
+        VkBufferImageCopy region{};
+        region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        region.imageSubresource.layerCount = 1;
+        region.imageExtent.width = size_.width();
+        region.imageExtent.height = size_.height();
+        region.imageExtent.depth = 1;
+        device_functions_->vkCmdCopyImageToBuffer(
+            frame.command_buffer, frame.color.image,
+            VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, frame.readback_buffer, 1,
+            &region);
+
+        VkBufferMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.buffer = frame.readback_buffer;
+        barrier.size = VK_WHOLE_SIZE;
+        device_functions_->vkCmdPipelineBarrier(
+            frame.command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+            VK_PIPELINE_STAGE_HOST_BIT, 0, 0, nullptr, 1, &barrier, 0,
+            nullptr);
+        frame.pending_readback = frame_number_;
+    }
+
+    auto err = device_functions_->vkEndCommandBuffer(frame.command_buffer);
+    if (err != VK_SUCCESS) qFatal("Failed to end command buffer: %d", err);
+
+    frame.submitted_value = graphics_timeline_.Submit(
+        graphics_queue_, &frame.command_buffer, 1, frame_waits_);
+    frame_waits_.clear();
+    ++frame_number_;
+}
+
+void OffscreenRenderTarget::addFrameWait(const GpuTimeline::Wait& wait)
+{
+    frame_waits_.push_back(wait);
+}
+
+void OffscreenRenderTarget::Finish()
+{
+    // Deliver in submission order, starting with the oldest frame.
+    const int frame_count = static_cast<int>(frames_.size());
+    for (int i = 0; i < frame_count; ++i)
+    {
+        Frame& frame = frames_[(frame_number_ + i) % frame_count];
+        graphics_timeline_.WaitFor(frame.submitted_value);
+        CollectReadback(&frame);
+    }
+}
+
+bool OffscreenRenderTarget::PickPhysicalDevice()
+{
+    QVulkanFunctions* functions = instance_->functions();
+    std::uint32_t count{0};
+    functions->vkEnumeratePhysicalDevices(instance_->vkInstance(), &count,
+                                          nullptr);
+    std::vector<VkPhysicalDevice> devices(count);
+    functions->vkEnumeratePhysicalDevices(instance_->vkInstance(), &count,
+                                          devices.data());
+    if (devices.empty())
+    {
+        qWarning("No Vulkan physical devices");
+        return false;
+    }
+
+    // same override as QVulkanWindow
+    const int index = qBound(
+        0, qEnvironmentVariableIntValue("QT_VK_PHYSICAL_DEVICE_INDEX"),
+        static_cast<int>(devices.size()) - 1);
+    physical_device_ = devices[index];
+    functions->vkGetPhysicalDeviceProperties(physical_device_,
+                                             &physical_device_properties_);
+    functions->vkGetPhysicalDeviceMemoryProperties(physical_device_,
+                                                   &memory_properties_);
+    qDebug("headless rendering on %s", physical_device_properties_.deviceName);
+
+    functions->vkGetPhysicalDeviceQueueFamilyProperties(physical_device_,
+                                                        &count, nullptr);
+    std::vector<VkQueueFamilyProperties> families(count);
+    functions->vkGetPhysicalDeviceQueueFamilyProperties(
+        physical_device_, &count, families.data());
+    for (std::uint32_t i = 0; i < count; ++i)
+    {
+        if (families[i].queueFlags & VK_QUEUE_GRAPHICS_BIT)
+        {
+            graphics_queue_family_ = i;
+            break;
+        }
+        if (i + 1 == count)
+        {
+            qWarning("No graphics queue on %s",
+                     physical_device_properties_.deviceName);
+            return false;
+        }
+    }
+
+    // Uploads go to a transfer queue of another family if there is one,
+    // preferably a copy engine that cannot compute either.
+    for (std::uint32_t i = 0; allow_transfer_queue_ && i < count; ++i)
+    {
+        const VkQueueFlags flags = families[i].queueFlags;
+        if (!(flags & VK_QUEUE_TRANSFER_BIT) || (flags & VK_QUEUE_GRAPHICS_BIT))
+            continue;
+        if (transfer_queue_family_ == UINT32_MAX ||
+            !(flags & VK_QUEUE_COMPUTE_BIT))
+            transfer_queue_family_ = i;
+    }
+
+    // Same depth-stencil preference order as QVulkanWindow.
+    for (VkFormat format :
+         {VK_FORMAT_D24_UNORM_S8_UINT, VK_FORMAT_D32_SFLOAT_S8_UINT,
+          VK_FORMAT_D16_UNORM_S8_UINT})
+    {
+        VkFormatProperties format_properties{};
+        functions->vkGetPhysicalDeviceFormatProperties(
+            physical_device_, format, &format_properties);
+        if (format_properties.optimalTilingFeatures &
+            VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT)
+        {
+            depth_format_ = format;
+            break;
+        }
+    }
+    if (depth_format_ == VK_FORMAT_UNDEFINED)
+    {
+        qWarning("No depth-stencil format");
+        return false;
+    }
+    return true;
+}
+
+void OffscreenRenderTarget::CreateDevice()
+{
+    const float priority{1.0F};
+    VkDeviceQueueCreateInfo queue_infos[2]{};
+    for (VkDeviceQueueCreateInfo& queue_info : queue_infos)
+    {
+        queue_info.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+        queue_info.queueCount = 1;
+        queue_info.pQueuePriorities = &priority;
+    }
+    queue_infos[0].queueFamilyIndex = graphics_queue_family_;
+    queue_infos[1].queueFamilyIndex = transfer_queue_family_;
+
+    // Enable what GPU-driven drawing can use, where supported.
+    VkPhysicalDeviceFeatures supported_features{};
+    instance_->functions()->vkGetPhysicalDeviceFeatures(physical_device_,
+                                                        &supported_features);
+    VkPhysicalDeviceFeatures features{};
+    features.multiDrawIndirect = supported_features.multiDrawIndirect;
+    multi_draw_indirect_ = features.multiDrawIndirect == VK_TRUE;
+
+    std::uint32_t extension_count{0};
+    instance_->functions()->vkEnumerateDeviceExtensionProperties(
+        physical_device_, nullptr, &extension_count, nullptr);
+    std::vector<VkExtensionProperties> extensions(extension_count);
+    instance_->functions()->vkEnumerateDeviceExtensionProperties(
+        physical_device_, nullptr, &extension_count, extensions.data());
+    std::vector<const char*> enabled_extensions;
+    bool has_descriptor_indexing{false};
+    bool has_maintenance3{false};
+    bool has_timeline_semaphore{false};
+    for (const auto& extension : extensions)
+    {
+        if (std::strcmp(extension.extensionName,
+                        VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME) == 0)
+        {
+            enabled_extensions.push_back(
+                VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+            draw_indirect_count_ = true;
+        }
+        has_descriptor_indexing |=
+            std::strcmp(extension.extensionName,
+                        VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME) == 0;
+        has_maintenance3 |=
+            std::strcmp(extension.extensionName,
+                        VK_KHR_MAINTENANCE3_EXTENSION_NAME) == 0;
+        has_timeline_semaphore |=
+            std::strcmp(extension.extensionName,
+                        VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME) == 0;
+    }
+
+    // Bindless resources: update-after-bind, partially bound arrays of
+    // storage buffers and sampled images, indexed dynamically. Timeline
+    // semaphores for GpuTimeline. The features are queried through
+    // VK_KHR_get_physical_device_properties2, which the application requests
+    // on the instance.
+    VkPhysicalDeviceDescriptorIndexingFeaturesEXT indexing_features{};
+    indexing_features.sType =
+        VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+    VkPhysicalDeviceTimelineSemaphoreFeaturesKHR timeline_features{};
+    timeline_features.sType =
+        VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES_KHR;
+    timeline_features.pNext = &indexing_features;
+    const auto get_features2 =
+        reinterpret_cast<PFN_vkGetPhysicalDeviceFeatures2KHR>(
+            instance_->getInstanceProcAddr("vkGetPhysicalDeviceFeatures2KHR"));
+    if (get_features2 &&
+        instance_->extensions().contains(
+            VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME))
+    {
+        VkPhysicalDeviceFeatures2KHR features2{};
+        features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2_KHR;
+        features2.pNext = &timeline_features;
+        get_features2(physical_device_, &features2);
+        descriptor_indexing_ =
+            has_descriptor_indexing && has_maintenance3 &&
+            supported_features.shaderSampledImageArrayDynamicIndexing &&
+            indexing_features.descriptorBindingPartiallyBound &&
+            indexing_features.descriptorBindingSampledImageUpdateAfterBind &&
+            indexing_features.descriptorBindingStorageBufferUpdateAfterBind;
+        timeline_semaphore_ = allow_timeline_semaphore_ &&
+                              has_timeline_semaphore &&
+                              timeline_features.timelineSemaphore == VK_TRUE;
+    }
+    // The transfer queue is only worth it with timeline semaphores, which
+    // let the frames wait for the uploads on the GPU.
+    if (!timeline_semaphore_) transfer_queue_family_ = UINT32_MAX;
+
+    // Only what is used is enabled, chained as timeline -> indexing.
+    void* enabled_features{nullptr};
+    if (descriptor_indexing_)
+    {
+        enabled_extensions.push_back(VK_KHR_MAINTENANCE3_EXTENSION_NAME);
+        enabled_extensions.push_back(
+            VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME);
+        features.shaderSampledImageArrayDynamicIndexing = VK_TRUE;
+        // only what BindlessTable uses
+        VkPhysicalDeviceDescriptorIndexingFeaturesEXT enabled{};
+        enabled.sType = indexing_features.sType;
+        enabled.descriptorBindingPartiallyBound = VK_TRUE;
+        enabled.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+        enabled.descriptorBindingStorageBufferUpdateAfterBind = VK_TRUE;
+        indexing_features = enabled;
+        enabled_features = &indexing_features;
+    }
+    if (timeline_semaphore_)
+    {
+        enabled_extensions.push_back(
+            VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME);
+        timeline_features.timelineSemaphore = VK_TRUE;
+        timeline_features.pNext = enabled_features;
+        enabled_features = &timeline_features;
+    }
+
+    VkDeviceCreateInfo device_info{};
+    device_info.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+    device_info.queueCreateInfoCount =
+        transfer_queue_family_ == UINT32_MAX ? 1 : 2;
+    device_info.pQueueCreateInfos = queue_infos;
+    device_info.enabledExtensionCount =
+        static_cast<std::uint32_t>(enabled_extensions.size());
+    device_info.ppEnabledExtensionNames = enabled_extensions.data();
+    device_info.pEnabledFeatures = &features;
+    device_info.pNext = enabled_features;
+    auto err = instance_->functions()->vkCreateDevice(
+        physical_device_, &device_info, nullptr, &device_);
+    if (err != VK_SUCCESS) qFatal("Failed to create device: %d", err);
+    device_functions_ = instance_->deviceFunctions(device_);
+    device_functions_->vkGetDeviceQueue(device_, graphics_queue_family_, 0,
+                                        &graphics_queue_);
+
+    VkCommandPoolCreateInfo pool_info{};
+    pool_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    pool_info.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+    pool_info.queueFamilyIndex = graphics_queue_family_;
+    err = device_functions_->vkCreateCommandPool(device_, &pool_info, nullptr,
+                                                 &command_pool_);
+    if (err != VK_SUCCESS) qFatal("Failed to create command pool: %d", err);
+    if (transfer_queue_family_ != UINT32_MAX)
+    {
+        device_functions_->vkGetDeviceQueue(device_, transfer_queue_family_, 0,
+                                            &transfer_queue_);
+        pool_info.queueFamilyIndex = transfer_queue_family_;
+        err = device_functions_->vkCreateCommandPool(
+            device_, &pool_info, nullptr, &transfer_command_pool_);
+        if (err != VK_SUCCESS)
+            qFatal("Failed to create transfer command pool: %d", err);
+        qDebug("uploads on the transfer queue of family %u",
+               transfer_queue_family_);
+    }
+
+    host_visible_memory_index_ = FindMemoryIndex(
+        UINT32_MAX,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+            VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+        0);
+    device_local_memory_index_ =
+        FindMemoryIndex(UINT32_MAX, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 0);
+}
+
+void OffscreenRenderTarget::CreateRenderPass()
+{
+    VkAttachmentDescription attachments[2]{};
+    attachments[0].format = color_format_;
+    attachments[0].samples = VK_SAMPLE_COUNT_1_BIT;
+    attachments[0].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    attachments[0].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+    attachments[0].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    attachments[0].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    attachments[0].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    attachments[0].finalLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+
+    attachments[1].format = depth_format_;
+    attachments[1].samples = VK_SAMPLE_COUNT_1_BIT;
+    attachments[1].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    attachments[1].storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    attachments[1].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    attachments[1].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    attachments[1].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    attachments[1].finalLayout =
+        VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+    const VkAttachmentReference color_reference = {
+        0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL};
+    const VkAttachmentReference depth_reference = {
+        1, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL};
+    VkSubpassDescription subpass{};
+    subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+    subpass.colorAttachmentCount = 1;
+    subpass.pColorAttachments = &color_reference;
+    subpass.pDepthStencilAttachment = &depth_reference;
+
+    // The previous readback copy and depth writes of the slot have to finish
+    // before its images are cleared again, and the color writes before the
+    // next copy.
+    VkSubpassDependency dependencies[2]{};
+    dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+    dependencies[0].dstSubpass = 0;
+    dependencies[0].srcStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT |
+                                   VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+    dependencies[0].dstStageMask =
+        VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT |
+        VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+    dependencies[0].srcAccessMask =
+        VK_ACCESS_TRANSFER_READ_BIT |
+        VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    dependencies[0].dstAccessMask =
+        VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
+        VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    dependencies[1].srcSubpass = 0;
+    dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
+    dependencies[1].srcStageMask =
+        VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    dependencies[1].dstStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT;
+    dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    dependencies[1].dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+
+    VkRenderPassCreateInfo render_pass_info{};
+    render_pass_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+    render_pass_info.attachmentCount = 2;
+    render_pass_info.pAttachments = attachments;
+    render_pass_info.subpassCount = 1;
+    render_pass_info.pSubpasses = &subpass;
+    render_pass_info.dependencyCount = 2;
+    render_pass_info.pDependencies = dependencies;
+    const auto err = device_functions_->vkCreateRenderPass(
+        device_, &render_pass_info, nullptr, &render_pass_);
+    if (err != VK_SUCCESS) qFatal("Failed to create render pass: %d", err);
+}
+
+void OffscreenRenderTarget::CreateFrame(Frame* frame)
+{
+    frame->color = CreateImage(
+        color_format_,
+        VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+        VK_IMAGE_ASPECT_COLOR_BIT);
+    frame->depth = CreateImage(depth_format_,
+                               VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT,
+                               VK_IMAGE_ASPECT_DEPTH_BIT |
+                                   VK_IMAGE_ASPECT_STENCIL_BIT);
+
+    const VkImageView views[2] = {frame->color.view, frame->depth.view};
+    VkFramebufferCreateInfo framebuffer_info{};
+    framebuffer_info.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+    framebuffer_info.renderPass = render_pass_;
+    framebuffer_info.attachmentCount = 2;
+    framebuffer_info.pAttachments = views;
+    framebuffer_info.width = size_.width();
+    framebuffer_info.height = size_.height();
+    framebuffer_info.layers = 1;
+    auto err = device_functions_->vkCreateFramebuffer(
+        device_, &framebuffer_info, nullptr, &frame->framebuffer);
+    if (err != VK_SUCCESS) qFatal("Failed to create framebuffer: %d", err);
+
+    // tightly packed RGBA8 pixels
+    VkBufferCreateInfo buffer_info{};
+    buffer_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    buffer_info.size = VkDeviceSize(size_.width()) * size_.height() * 4;
+    buffer_info.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    err = device_functions_->vkCreateBuffer(device_, &buffer_info, nullptr,
+                                            &frame->readback_buffer);
+    if (err != VK_SUCCESS) qFatal("Failed to create readback buffer: %d", err);
+    VkMemoryRequirements memory_requirements{};
+    device_functions_->vkGetBufferMemoryRequirements(
+        device_, frame->readback_buffer, &memory_requirements);
+    // Read by the CPU, so cached memory is preferred.
+    const std::uint32_t memory_index =
+        FindMemoryIndex(memory_requirements.memoryTypeBits,
+                        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+                        VK_MEMORY_PROPERTY_HOST_CACHED_BIT);
+    const VkMemoryPropertyFlags memory_flags =
+        memory_properties_.memoryTypes[memory_index].propertyFlags;
+    readback_coherent_ = memory_flags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+    VkMemoryAllocateInfo allocate_info = {
+        VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO, nullptr,
+        memory_requirements.size, memory_index};
+    err = device_functions_->vkAllocateMemory(device_, &allocate_info, nullptr,
+                                              &frame->readback_memory);
+    if (err != VK_SUCCESS)
+        qFatal("Failed to allocate readback memory: %d", err);
+    device_functions_->vkBindBufferMemory(device_, frame->readback_buffer,
+                                          frame->readback_memory, 0);
+    void* mapped{nullptr};
+    err = device_functions_->vkMapMemory(device_, frame->readback_memory, 0,
+                                         VK_WHOLE_SIZE, 0, &mapped);
+    if (err != VK_SUCCESS) qFatal("Failed to map readback memory: %d", err);
+    frame->readback_data = static_cast<const uchar*>(mapped);
+    frame->pending_readback = -1;
+
+    const VkCommandBufferAllocateInfo command_buffer_info = {
+        VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO, nullptr, command_pool_,
+        VK_COMMAND_BUFFER_LEVEL_PRIMARY, 1};
+    err = device_functions_->vkAllocateCommandBuffers(
+        device_, &command_buffer_info, &frame->command_buffer);
+    if (err != VK_SUCCESS)
+        qFatal("Failed to allocate command buffer: %d", err);
+    // complete, so the first BeginFrame() does not block
+    frame->submitted_value = 0;
+}
+
+void OffscreenRenderTarget::ReleaseFrame(Frame* frame)
+{
+    device_functions_->vkFreeCommandBuffers(device_, command_pool_, 1,
+                                            &frame->command_buffer);
+    device_functions_->vkDestroyBuffer(device_, frame->readback_buffer,
+                                       nullptr);
+    device_functions_->vkFreeMemory(device_, frame->readback_memory, nullptr);
+    device_functions_->vkDestroyFramebuffer(device_, frame->framebuffer,
+                                            nullptr);
+    ReleaseImage(&frame->depth);
+    ReleaseImage(&frame->color);
+}
+
+OffscreenRenderTarget::Image OffscreenRenderTarget::CreateImage(
+    VkFormat format, VkImageUsageFlags usage, VkImageAspectFlags aspect)
+{
+    Image image{};
+    VkImageCreateInfo image_info{};
+    image_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    image_info.imageType = VK_IMAGE_TYPE_2D;
+    image_info.format = format;
+    image_info.extent.width = size_.width();
+    image_info.extent.height = size_.height();
+    image_info.extent.depth = 1;
+    image_info.mipLevels = 1;
+    image_info.arrayLayers = 1;
+    image_info.samples = VK_SAMPLE_COUNT_1_BIT;
+    image_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+    image_info.usage = usage;
+    image_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    auto err = device_functions_->vkCreateImage(device_, &image_info, nullptr,
+                                                &image.image);
+    if (err != VK_SUCCESS) qFatal("Failed to create image: %d", err);
+
+    VkMemoryRequirements memory_requirements{};
+    device_functions_->vkGetImageMemoryRequirements(device_, image.image,
+                                                    &memory_requirements);
+    VkMemoryAllocateInfo allocate_info = {
+        VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO, nullptr,
+        memory_requirements.size,
+        FindMemoryIndex(memory_requirements.memoryTypeBits, 0,
+                        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT)};
+    err = device_functions_->vkAllocateMemory(device_, &allocate_info, nullptr,
+                                              &image.memory);
+    if (err != VK_SUCCESS) qFatal("Failed to allocate image memory: %d", err);
+    device_functions_->vkBindImageMemory(device_, image.image, image.memory,
+                                         0);
+
+    VkImageViewCreateInfo view_info{};
+    view_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    view_info.image = image.image;
+    view_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    view_info.format = format;
+    view_info.subresourceRange.aspectMask = aspect;
+    view_info.subresourceRange.levelCount = 1;
+    view_info.subresourceRange.layerCount = 1;
+    err = device_functions_->vkCreateImageView(device_, &view_info, nullptr,
+                                               &image.view);
+    if (err != VK_SUCCESS) qFatal("Failed to create image view: %d", err);
+    return image;
+}
+
+void OffscreenRenderTarget::ReleaseImage(Image* image)
+{
+    device_functions_->vkDestroyImageView(device_, image->view, nullptr);
+    device_functions_->vkDestroyImage(device_, image->image, nullptr);
+    device_functions_->vkFreeMemory(device_, image->memory, nullptr);
+    *image = Image{};
+}
+
+void OffscreenRenderTarget::CollectReadback(Frame* frame)
+{
+    if (frame->pending_readback < 0) return;
+    if (!readback_coherent_)
+    {
+        const VkMappedMemoryRange range = {
+            VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE, nullptr,
+            frame->readback_memory, 0, VK_WHOLE_SIZE};
+        device_functions_->vkInvalidateMappedMemoryRanges(device_, 1, &range);
+    }
+    // copy() detaches the image from the mapped memory, which gets
+    // overwritten the next time this slot is rendered.
+    const QImage image(frame->readback_data, size_.width(), size_.height(),
+                       size_.width() * 4, QImage::Format_RGBA8888);
+    if (frame_callback_) frame_callback_(frame->pending_readback, image.copy());
+    frame->pending_readback = -1;
+}
+
+std::uint32_t OffscreenRenderTarget::FindMemoryIndex(
+    std::uint32_t type_bits, VkMemoryPropertyFlags required,
+    VkMemoryPropertyFlags preferred) const
+{
+    const std::uint32_t preferred_index = FindMemoryType(
+        memory_properties_, type_bits, UINT32_MAX, required | preferred);
+    if (preferred_index != UINT32_MAX) return preferred_index;
+    const std::uint32_t index =
+        FindMemoryType(memory_properties_, type_bits, UINT32_MAX, required);
+    if (index == UINT32_MAX) qFatal("No suitable memory type");
+    return index;
+}
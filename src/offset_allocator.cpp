@@ -0,0 +1,278 @@
+#include "offset_allocator.h"
+
+#include <cassert>
+
+namespace
+{
+constexpr int sl_bits{4};
+
+int HighestBit(std::uint64_t value) { return 63 - __builtin_clzll(value); }
+
+int LowestBit(std::uint64_t value) { return __builtin_ctzll(value); }
+
+// The list a free range of size bytes is kept in. Sizes below 16 get a list
+// each, above that every power of two is split into 16 linear steps.
+void Mapping(std::uint64_t size, int* fl, int* sl)
+{
+    if (size < (1u << sl_bits))
+    {
+        *fl = 0;
+        *sl = static_cast<int>(size);
+        return;
+    }
+    const int bit = HighestBit(size);
+    *fl = bit - sl_bits + 1;
+    *sl = static_cast<int>((size >> (bit - sl_bits)) & ((1u << sl_bits) - 1));
+}
+
+// The first list whose ranges are all at least size bytes.
+void MappingSearch(std::uint64_t size, int* fl, int* sl)
+{
+    if (size >= (1u << sl_bits))
+        size += (std::uint64_t{1} << (HighestBit(size) - sl_bits)) - 1;
+    Mapping(size, fl, sl);
+}
+
+std::uint64_t AlignUp(std::uint64_t value, std::uint64_t alignment)
+{
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+}  // namespace
+
+TlsfAllocator::TlsfAllocator(std::uint64_t size)
+    : size_{size}, used_bytes_{0}, fl_bitmap_{0}
+{
+    for (int fl = 0; fl < fl_count; ++fl)
+    {
+        sl_bitmaps_[fl] = 0;
+        for (int sl = 0; sl < sl_count; ++sl) heads_[fl][sl] = none;
+    }
+    if (size_ > 0) InsertFree(NewRange(0, size_));
+}
+
+std::uint64_t TlsfAllocator::Allocate(std::uint64_t size,
+                                      std::uint64_t alignment)
+{
+    assert(alignment > 0 && (alignment & (alignment - 1)) == 0);
+    if (size == 0) size = 1;
+    // Free ranges start anywhere, so the worst case padding is needed to
+    // be sure any range of the list fits.
+    const std::uint64_t search_size = size + alignment - 1;
+    if (search_size < size || search_size > size_) return invalid_offset;
+
+    int fl = 0;
+    int sl = 0;
+    MappingSearch(search_size, &fl, &sl);
+    if (fl >= fl_count) return invalid_offset;
+    std::uint32_t sl_map = sl_bitmaps_[fl] & (~0u << sl);
+    if (!sl_map)
+    {
+        const std::uint64_t fl_map =
+            fl + 1 < 64 ? fl_bitmap_ & (~std::uint64_t{0} << (fl + 1)) : 0;
+        if (!fl_map) return invalid_offset;
+        fl = LowestBit(fl_map);
+        sl_map = sl_bitmaps_[fl];
+    }
+    sl = LowestBit(sl_map);
+    std::uint32_t index = heads_[fl][sl];
+    RemoveFree(index);
+
+    // the padding in front stays free, its neighbour in front is in use
+    const std::uint64_t padding =
+        AlignUp(ranges_[index].offset, alignment) - ranges_[index].offset;
+    if (padding > 0)
+    {
+        const std::uint32_t aligned = Split(index, padding);
+        InsertFree(index);
+        index = aligned;
+    }
+    // so does the rest behind it
+    if (ranges_[index].size > size) InsertFree(Split(index, size));
+
+    ranges_[index].free = false;
+    used_bytes_ += size;
+    allocations_.emplace(ranges_[index].offset, index);
+    return ranges_[index].offset;
+}
+
+void TlsfAllocator::Free(std::uint64_t offset)
+{
+    const auto allocation = allocations_.find(offset);
+    if (allocation == allocations_.end())
+    {
+        assert(false && "no allocation at offset");
+        return;
+    }
+    std::uint32_t index = allocation->second;
+    allocations_.erase(allocation);
+    used_bytes_ -= ranges_[index].size;
+    ranges_[index].free = true;
+
+    const std::uint32_t previous = ranges_[index].previous;
+    if (previous != none && ranges_[previous].free)
+    {
+        RemoveFree(previous);
+        Merge(previous, index);
+        index = previous;
+    }
+    const std::uint32_t next = ranges_[index].next;
+    if (next != none && ranges_[next].free)
+    {
+        RemoveFree(next);
+        Merge(index, next);
+    }
+    InsertFree(index);
+}
+
+std::uint64_t TlsfAllocator::AllocationSize(std::uint64_t offset) const
+{
+    const auto allocation = allocations_.find(offset);
+    return allocation == allocations_.end()
+               ? 0
+               : ranges_[allocation->second].size;
+}
+
+std::uint64_t TlsfAllocator::LargestFreeRange() const
+{
+    if (!fl_bitmap_) return 0;
+    // only the highest non-empty list can hold it, but not in order
+    const int fl = HighestBit(fl_bitmap_);
+    const int sl = HighestBit(sl_bitmaps_[fl]);
+    std::uint64_t largest = 0;
+    for (std::uint32_t index = heads_[fl][sl]; index != none;
+         index = ranges_[index].next_free)
+    {
+        if (ranges_[index].size > largest) largest = ranges_[index].size;
+    }
+    return largest;
+}
+
+double TlsfAllocator::Fragmentation() const
+{
+    const std::uint64_t free = free_bytes();
+    if (free == 0) return 0.0;
+    return 1.0 - static_cast<double>(LargestFreeRange()) / free;
+}
+
+std::uint32_t TlsfAllocator::NewRange(std::uint64_t offset,
+                                      std::uint64_t size)
+{
+    const Range range{offset, size, none, none, none, none, true};
+    if (unused_ranges_.empty())
+    {
+        ranges_.push_back(range);
+        return static_cast<std::uint32_t>(ranges_.size() - 1);
+    }
+    const std::uint32_t index = unused_ranges_.back();
+    unused_ranges_.pop_back();
+    ranges_[index] = range;
+    return index;
+}
+
+void TlsfAllocator::DeleteRange(std::uint32_t index)
+{
+    unused_ranges_.push_back(index);
+}
+
+void TlsfAllocator::InsertFree(std::uint32_t index)
+{
+    int fl = 0;
+    int sl = 0;
+    Mapping(ranges_[index].size, &fl, &sl);
+    Range& range = ranges_[index];
+    range.free = true;
+    range.previous_free = none;
+    range.next_free = heads_[fl][sl];
+    if (range.next_free != none) ranges_[range.next_free].previous_free = index;
+    heads_[fl][sl] = index;
+    fl_bitmap_ |= std::uint64_t{1} << fl;
+    sl_bitmaps_[fl] |= 1u << sl;
+}
+
+void TlsfAllocator::RemoveFree(std::uint32_t index)
+{
+    int fl = 0;
+    int sl = 0;
+    Mapping(ranges_[index].size, &fl, &sl);
+    const Range& range = ranges_[index];
+    if (range.previous_free != none)
+        ranges_[range.previous_free].next_free = range.next_free;
+    else
+        heads_[fl][sl] = range.next_free;
+    if (range.next_free != none)
+        ranges_[range.next_free].previous_free = range.previous_free;
+    if (heads_[fl][sl] == none)
+    {
+        sl_bitmaps_[fl] &= ~(1u << sl);
+        if (!sl_bitmaps_[fl]) fl_bitmap_ &= ~(std::uint64_t{1} << fl);
+    }
+}
+
+std::uint32_t TlsfAllocator::Split(std::uint32_t index, std::uint64_t size)
+{
+    const std::uint32_t rest = NewRange(ranges_[index].offset + size,
+                                        ranges_[index].size - size);
+    // NewRange() may grow ranges_, so no references before this point
+    ranges_[index].size = size;
+    ranges_[rest].previous = index;
+    ranges_[rest].next = ranges_[index].next;
+    if (ranges_[rest].next != none) ranges_[ranges_[rest].next].previous = rest;
+    ranges_[index].next = rest;
+    return rest;
+}
+
+void TlsfAllocator::Merge(std::uint32_t index, std::uint32_t next)
+{
+    ranges_[index].size += ranges_[next].size;
+    ranges_[index].next = ranges_[next].next;
+    if (ranges_[index].next != none)
+        ranges_[ranges_[index].next].previous = index;
+    DeleteRange(next);
+}
+
+std::uint64_t LinearAllocator::Allocate(std::uint64_t size,
+                                        std::uint64_t alignment)
+{
+    assert(alignment > 0 && (alignment & (alignment - 1)) == 0);
+    const std::uint64_t offset = AlignUp(top_, alignment);
+    if (offset > size_ || size > size_ - offset) return invalid_offset;
+    top_ = offset + size;
+    return offset;
+}
+
+std::vector<RangeMove> PlanRangeMoves(
+    const std::vector<TlsfAllocator*>& blocks,
+    const std::vector<MovableRange>& candidates, std::uint64_t max_bytes)
+{
+    std::size_t source = blocks.size();
+    std::size_t block_count = 0;
+    for (std::size_t i = 0; i < blocks.size(); ++i)
+    {
+        if (!blocks[i]) continue;
+        ++block_count;
+        if (source == blocks.size() ||
+            blocks[i]->used_bytes() < blocks[source]->used_bytes())
+            source = i;
+    }
+    std::vector<RangeMove> moves;
+    if (block_count < 2) return moves;
+
+    std::uint64_t moved_bytes = 0;
+    for (std::size_t i = 0; i < candidates.size(); ++i)
+    {
+        const MovableRange& candidate = candidates[i];
+        if (candidate.block != source) continue;
+        if (candidate.size > max_bytes - moved_bytes) break;
+        for (std::size_t block = 0; block < blocks.size(); ++block)
+        {
+            if (block == source || !blocks[block]) continue;
+            const std::uint64_t offset =
+                blocks[block]->Allocate(candidate.size, candidate.alignment);
+            if (offset == invalid_offset) continue;
+            moves.push_back({i, block, offset});
+            moved_bytes += candidate.size;
+            break;
+        }
+    }
+    return moves;
+}
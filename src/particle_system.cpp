@@ -0,0 +1,352 @@
+#include "particle_system.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+
+namespace
+{
+// particles.comp's local size
+constexpr std::uint32_t workgroup_size{256};
+// particles seeded and uploaded at a time, to bound the host memory
+constexpr std::size_t seed_batch{1 << 20};
+// particles compared against the CPU per verified step
+constexpr std::size_t max_sample_count{4096};
+// relative difference within which the GPU and CPU results may differ by
+// rounding
+constexpr float verify_tolerance{1e-4f};
+constexpr std::uint32_t particle_seed{1};
+
+static_assert(sizeof(Particle) == 32, "particles.comp reads 32-byte structs");
+static_assert(sizeof(ParticleStep) == 48, "push constants of particles.comp");
+}  // namespace
+
+ParticleSystem::ParticleSystem()
+    : device_functions_{nullptr},
+      device_{VK_NULL_HANDLE},
+      allocator_{nullptr},
+      count_{0},
+      step_{},
+      buffer_{VK_NULL_HANDLE},
+      descriptor_pool_{VK_NULL_HANDLE},
+      descriptor_set_layout_{VK_NULL_HANDLE},
+      descriptor_set_{VK_NULL_HANDLE},
+      pipeline_layout_{VK_NULL_HANDLE},
+      pipeline_{VK_NULL_HANDLE},
+      verify_{false},
+      sample_count_{0},
+      verified_steps_{0},
+      mismatched_steps_{0}
+{
+}
+
+bool ParticleSystem::Create(
+    QVulkanInstance* instance, VkDevice device,
+    const VkPhysicalDeviceProperties& device_properties,
+    DeviceMemoryAllocator* allocator, StagingUploader* uploader,
+    std::uint32_t device_local_index, std::uint32_t host_visible_index,
+    VkMemoryPropertyFlags host_visible_flags, int frame_count,
+    std::size_t count, bool verify, VkShaderModule shader,
+    VkPipelineCache pipeline_cache)
+{
+    if (shader == VK_NULL_HANDLE || count == 0) return false;
+    device_functions_ = instance->deviceFunctions(device);
+    device_ = device;
+    allocator_ = allocator;
+    verify_ = verify;
+
+    // One descriptor covers the whole buffer and one dispatch all particles.
+    const VkPhysicalDeviceLimits& limits = device_properties.limits;
+    const std::size_t max_count = std::min<std::size_t>(
+        limits.maxStorageBufferRange / sizeof(Particle),
+        static_cast<std::size_t>(limits.maxComputeWorkGroupCount[0]) *
+            workgroup_size);
+    if (count > max_count)
+    {
+        qWarning("%zu particles exceed the device limits, simulating %zu",
+                 count, max_count);
+        count = max_count;
+    }
+    count_ = count;
+    step_ = DefaultParticleStep(static_cast<std::uint32_t>(count_));
+
+    const VkDeviceSize size = count_ * sizeof(Particle);
+    allocator_->CreateBuffer(
+        size,
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT |
+            VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+        device_local_index, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &buffer_,
+        &memory_);
+    // The first step reads them, and with verification copies them back.
+    std::vector<Particle> particles(std::min(count_, seed_batch));
+    for (std::size_t first = 0; first < count_; first += seed_batch)
+    {
+        const std::size_t batch = std::min(seed_batch, count_ - first);
+        SeedParticles(particle_seed, first, batch, particles.data());
+        uploader->Upload(
+            buffer_, first * sizeof(Particle), particles.data(),
+            batch * sizeof(Particle),
+            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT |
+                VK_PIPELINE_STAGE_TRANSFER_BIT,
+            VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_TRANSFER_READ_BIT);
+    }
+    uploader->Flush();
+
+    if (verify_)
+    {
+        sample_count_ = std::min(count_, max_sample_count);
+        readback_ring_.Create(device_functions_, device_, device_properties,
+                              host_visible_index, host_visible_flags,
+                              VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                              2 * sample_count_ * sizeof(Particle),
+                              frame_count);
+        pending_.assign(frame_count, false);
+    }
+
+    CreateDescriptors();
+    CreatePipeline(shader, pipeline_cache);
+    qDebug("simulating %zu particles on the GPU (%.1f MiB)", count_,
+           size / (1024.0 * 1024.0));
+    return true;
+}
+
+void ParticleSystem::Release()
+{
+    if (!device_functions_) return;
+    if (verify_)
+    {
+        for (int frame = 0; frame < static_cast<int>(pending_.size());
+             ++frame)
+            Verify(frame);
+        qDebug("particles verified on %llu steps, %llu mismatched",
+               static_cast<unsigned long long>(verified_steps_),
+               static_cast<unsigned long long>(mismatched_steps_));
+    }
+
+    if (pipeline_)
+        device_functions_->vkDestroyPipeline(device_, pipeline_, nullptr);
+    if (pipeline_layout_)
+    {
+        device_functions_->vkDestroyPipelineLayout(device_, pipeline_layout_,
+                                                   nullptr);
+    }
+    if (descriptor_set_layout_)
+    {
+        device_functions_->vkDestroyDescriptorSetLayout(
+            device_, descriptor_set_layout_, nullptr);
+    }
+    if (descriptor_pool_)
+    {
+        device_functions_->vkDestroyDescriptorPool(device_, descriptor_pool_,
+                                                   nullptr);
+    }
+    allocator_->DestroyBuffer(&buffer_, &memory_);
+    pipeline_ = VK_NULL_HANDLE;
+    pipeline_layout_ = VK_NULL_HANDLE;
+    descriptor_set_layout_ = VK_NULL_HANDLE;
+    descriptor_pool_ = VK_NULL_HANDLE;
+    descriptor_set_ = VK_NULL_HANDLE;
+    readback_ring_.Release();
+    pending_.clear();
+    count_ = 0;
+    device_functions_ = nullptr;
+}
+
+std::vector<VkVertexInputBindingDescription> ParticleSystem::VertexBindings()
+{
+    return {{0, sizeof(Particle), VK_VERTEX_INPUT_RATE_VERTEX}};
+}
+
+std::vector<VkVertexInputAttributeDescription>
+ParticleSystem::VertexAttributes()
+{
+    return {{0, 0, VK_FORMAT_R32G32B32A32_SFLOAT,
+             offsetof(Particle, position)},
+            {1, 0, VK_FORMAT_R32G32B32A32_SFLOAT,
+             offsetof(Particle, velocity)}};
+}
+
+void ParticleSystem::Record(VkCommandBuffer command_buffer, int frame)
+{
+    // The frame's previous submission has completed, so has its readback.
+    if (verify_) Verify(frame);
+
+    const VkDeviceSize sample_size = sample_count_ * sizeof(Particle);
+    VkBufferMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.buffer = buffer_;
+    barrier.offset = 0;
+    barrier.size = VK_WHOLE_SIZE;
+    VkPipelineStageFlags src_stages = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT |
+                                      VK_PIPELINE_STAGE_VERTEX_INPUT_BIT;
+    if (verify_)
+    {
+        // the state before the step, as the previous step left it
+        barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+        device_functions_->vkCmdPipelineBarrier(
+            command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+            VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 1, &barrier, 0,
+            nullptr);
+        const VkBufferCopy copy = {0, readback_ring_.SlotOffset(frame),
+                                   sample_size};
+        device_functions_->vkCmdCopyBuffer(
+            command_buffer, buffer_, readback_ring_.buffer(), 1, &copy);
+        src_stages |= VK_PIPELINE_STAGE_TRANSFER_BIT;
+    }
+
+    // The step reads what the previous one wrote, and must not overwrite
+    // the particles before the previous frames (and the copy) fetched
+    // them, which needs no access flags.
+    barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.dstAccessMask =
+        VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+    device_functions_->vkCmdPipelineBarrier(
+        command_buffer, src_stages, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+        0, nullptr, 1, &barrier, 0, nullptr);
+
+    device_functions_->vkCmdBindPipeline(
+        command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline_);
+    device_functions_->vkCmdBindDescriptorSets(
+        command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline_layout_, 0, 1,
+        &descriptor_set_, 0, nullptr);
+    device_functions_->vkCmdPushConstants(command_buffer, pipeline_layout_,
+                                          VK_SHADER_STAGE_COMPUTE_BIT, 0,
+                                          sizeof(step_), &step_);
+    const auto group_count = static_cast<std::uint32_t>(
+        (count_ + workgroup_size - 1) / workgroup_size);
+    device_functions_->vkCmdDispatch(command_buffer, group_count, 1, 1);
+
+    // the new positions are read as vertices, and by the readback copy
+    barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT;
+    VkPipelineStageFlags dst_stages = VK_PIPELINE_STAGE_VERTEX_INPUT_BIT;
+    if (verify_)
+    {
+        barrier.dstAccessMask |= VK_ACCESS_TRANSFER_READ_BIT;
+        dst_stages |= VK_PIPELINE_STAGE_TRANSFER_BIT;
+    }
+    device_functions_->vkCmdPipelineBarrier(
+        command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, dst_stages, 0,
+        0, nullptr, 1, &barrier, 0, nullptr);
+    if (!verify_) return;
+
+    const VkBufferCopy copy = {
+        0, readback_ring_.SlotOffset(frame) + sample_size, sample_size};
+    device_functions_->vkCmdCopyBuffer(command_buffer, buffer_,
+                                       readback_ring_.buffer(), 1, &copy);
+    VkBufferMemoryBarrier host_barrier = barrier;
+    host_barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    host_barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+    host_barrier.buffer = readback_ring_.buffer();
+    host_barrier.offset = readback_ring_.SlotOffset(frame);
+    host_barrier.size = 2 * sample_size;
+    device_functions_->vkCmdPipelineBarrier(
+        command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+        VK_PIPELINE_STAGE_HOST_BIT, 0, 0, nullptr, 1, &host_barrier, 0,
+        nullptr);
+    pending_[frame] = true;
+}
+
+void ParticleSystem::Draw(VkCommandBuffer command_buffer)
+{
+    const VkDeviceSize offset{0};
+    device_functions_->vkCmdBindVertexBuffers(command_buffer, 0, 1, &buffer_,
+                                              &offset);
+    device_functions_->vkCmdDraw(command_buffer,
+                                 static_cast<std::uint32_t>(count_), 1, 0, 0);
+}
+
+void ParticleSystem::CreateDescriptors()
+{
+    const VkDescriptorPoolSize pool_size = {
+        VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1};
+    VkDescriptorPoolCreateInfo pool_info{};
+    pool_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    pool_info.maxSets = 1;
+    pool_info.poolSizeCount = 1;
+    pool_info.pPoolSizes = &pool_size;
+    auto err = device_functions_->vkCreateDescriptorPool(
+        device_, &pool_info, nullptr, &descriptor_pool_);
+    if (err != VK_SUCCESS) qFatal("Failed to create descriptor pool: %d", err);
+
+    const VkDescriptorSetLayoutBinding binding = {
+        0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT,
+        nullptr};
+    const VkDescriptorSetLayoutCreateInfo layout_info = {
+        VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO, nullptr, 0, 1,
+        &binding};
+    err = device_functions_->vkCreateDescriptorSetLayout(
+        device_, &layout_info, nullptr, &descriptor_set_layout_);
+    if (err != VK_SUCCESS)
+        qFatal("Failed to create descriptor set layout: %d", err);
+
+    const VkDescriptorSetAllocateInfo allocate_info = {
+        VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO, nullptr,
+        descriptor_pool_, 1, &descriptor_set_layout_};
+    err = device_functions_->vkAllocateDescriptorSets(device_, &allocate_info,
+                                                      &descriptor_set_);
+    if (err != VK_SUCCESS) qFatal("Failed to allocate descriptor set: %d", err);
+
+    const VkDescriptorBufferInfo buffer_info = {buffer_, 0, VK_WHOLE_SIZE};
+    VkWriteDescriptorSet write{};
+    write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    write.dstSet = descriptor_set_;
+    write.dstBinding = 0;
+    write.descriptorCount = 1;
+    write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    write.pBufferInfo = &buffer_info;
+    device_functions_->vkUpdateDescriptorSets(device_, 1, &write, 0, nullptr);
+}
+
+void ParticleSystem::CreatePipeline(VkShaderModule shader,
+                                    VkPipelineCache cache)
+{
+    const VkPushConstantRange push_constant_range = {
+        VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(ParticleStep)};
+    VkPipelineLayoutCreateInfo layout_info{};
+    layout_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    layout_info.setLayoutCount = 1;
+    layout_info.pSetLayouts = &descriptor_set_layout_;
+    layout_info.pushConstantRangeCount = 1;
+    layout_info.pPushConstantRanges = &push_constant_range;
+    auto err = device_functions_->vkCreatePipelineLayout(
+        device_, &layout_info, nullptr, &pipeline_layout_);
+    if (err != VK_SUCCESS) qFatal("Failed to create pipeline layout: %d", err);
+
+    VkComputePipelineCreateInfo pipeline_info{};
+    pipeline_info.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipeline_info.stage.sType =
+        VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    pipeline_info.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    pipeline_info.stage.module = shader;
+    pipeline_info.stage.pName = "main";
+    pipeline_info.layout = pipeline_layout_;
+    err = device_functions_->vkCreateComputePipelines(
+        device_, cache, 1, &pipeline_info, nullptr, &pipeline_);
+    if (err != VK_SUCCESS) qFatal("Failed to create compute pipeline: %d", err);
+}
+
+void ParticleSystem::Verify(int frame)
+{
+    if (!pending_[frame]) return;
+    pending_[frame] = false;
+
+    const VkDeviceSize sample_size = sample_count_ * sizeof(Particle);
+    readback_ring_.Invalidate(frame, 0, 2 * sample_size);
+    const quint8* data = readback_ring_.Slot(frame);
+    std::vector<Particle> before(sample_count_);
+    std::vector<Particle> after(sample_count_);
+    std::memcpy(before.data(), data, sample_size);
+    std::memcpy(after.data(), data + sample_size, sample_size);
+    const std::size_t mismatches =
+        CountParticleMismatches(step_, before.data(), after.data(),
+                                sample_count_, verify_tolerance);
+    ++verified_steps_;
+    if (mismatches == 0) return;
+    ++mismatched_steps_;
+    qWarning("particles: %zu of %zu differ from the CPU reference",
+             mismatches, sample_count_);
+}
@@ -0,0 +1,143 @@
+#include "particles.h"
+
+#include <cmath>
+#include <vector>
+
+namespace
+{
+constexpr float two_pi{6.28318530718f};
+
+// Integer hash with good avalanche, so neighbouring indices get unrelated
+// random numbers.
+std::uint32_t Hash(std::uint32_t x)
+{
+    x ^= x >> 16;
+    x *= 0x7feb352du;
+    x ^= x >> 15;
+    x *= 0x846ca68bu;
+    x ^= x >> 16;
+    return x;
+}
+
+// Uniform in [0, 1), advances state.
+float NextUnit(std::uint32_t* state)
+{
+    *state = Hash(*state);
+    return static_cast<float>(*state >> 8) * (1.0f / 16777216.0f);
+}
+
+bool Differs(float expected, float actual, float tolerance)
+{
+    return std::abs(actual - expected) >
+           tolerance * (1.0f + std::abs(expected));
+}
+}  // namespace
+
+ParticleStep DefaultParticleStep(std::uint32_t count)
+{
+    ParticleStep step{};
+    step.attractor[3] = 0.5f;
+    step.time_step = 1.0f / 60.0f;
+    step.damping = 0.9995f;
+    step.softening = 0.01f;
+    step.bound = 1.5f;
+    step.count = count;
+    return step;
+}
+
+void SeedParticles(std::uint32_t seed, std::size_t first, std::size_t count,
+                   Particle* particles)
+{
+    const ParticleStep step = DefaultParticleStep(0);
+    const float strength = step.attractor[3];
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        const std::size_t index = first + i;
+        std::uint32_t state =
+            Hash(static_cast<std::uint32_t>(index) ^
+                 Hash(static_cast<std::uint32_t>(index >> 32) + seed));
+        // denser towards the center, with a little thickness
+        const float radius = 0.2f + 0.8f * std::sqrt(NextUnit(&state));
+        const float angle = two_pi * NextUnit(&state);
+        const float height = 0.05f * (2.0f * NextUnit(&state) - 1.0f);
+        const float jitter = 0.95f + 0.1f * NextUnit(&state);
+
+        // circular orbit speed at that radius, with the softened attraction
+        const float r2 = radius * radius + step.softening;
+        const float speed = jitter * radius *
+                            std::sqrt(strength / (r2 * std::sqrt(r2)));
+        Particle& particle = particles[i];
+        particle.position[0] = radius * std::cos(angle);
+        particle.position[1] = height;
+        particle.position[2] = radius * std::sin(angle);
+        particle.position[3] = 1.0f;
+        particle.velocity[0] = -speed * std::sin(angle);
+        particle.velocity[1] = 0.0f;
+        particle.velocity[2] = speed * std::cos(angle);
+        particle.velocity[3] = 0.0f;
+    }
+}
+
+void StepParticles(const ParticleStep& step, Particle* particles,
+                   std::size_t count)
+{
+    const float dt = step.time_step;
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        float* position = particles[i].position;
+        float* velocity = particles[i].velocity;
+        // same order of operations as particles.comp
+        float d[3];
+        float r2 = step.softening;
+        for (int k = 0; k < 3; ++k)
+        {
+            d[k] = step.attractor[k] - position[k];
+            r2 += d[k] * d[k];
+        }
+        const float inv_r = 1.0f / std::sqrt(r2);
+        const float pull = step.attractor[3] * (inv_r * inv_r * inv_r);
+        for (int k = 0; k < 3; ++k)
+        {
+            velocity[k] = (velocity[k] + d[k] * pull * dt) * step.damping;
+            position[k] += velocity[k] * dt;
+            if (position[k] > step.bound)
+            {
+                position[k] = step.bound;
+                velocity[k] = -velocity[k];
+            }
+            else if (position[k] < -step.bound)
+            {
+                position[k] = -step.bound;
+                velocity[k] = -velocity[k];
+            }
+        }
+    }
+}
+
+std::size_t CountParticleMismatches(const ParticleStep& step,
+                                    const Particle* before,
+                                    const Particle* actual, std::size_t count,
+                                    float tolerance)
+{
+    std::vector<Particle> expected(before, before + count);
+    StepParticles(step, expected.data(), count);
+    const float face_tolerance = tolerance * (1.0f + step.bound);
+    std::size_t mismatches{0};
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        const Particle& e = expected[i];
+        const Particle& a = actual[i];
+        bool differs{false};
+        bool near_face{false};
+        for (int k = 0; k < 3; ++k)
+        {
+            differs = differs ||
+                      Differs(e.position[k], a.position[k], tolerance) ||
+                      Differs(e.velocity[k], a.velocity[k], tolerance);
+            near_face = near_face || std::abs(std::abs(e.position[k]) -
+                                              step.bound) <= face_tolerance;
+        }
+        if (differs && !near_face) ++mismatches;
+    }
+    return mismatches;
+}
@@ -0,0 +1,93 @@
+#include "pipeline_cache.h"
+
+#include <QtCore/QDir>
+#include <QtCore/QFile>
+#include <QtCore/QFileInfo>
+#include <QtCore/QSaveFile>
+#include <QtCore/QStandardPaths>
+#include <cstdint>
+#include <cstring>
+
+namespace
+{
+// Layout of VkPipelineCacheHeaderVersionOne, see the Vulkan spec for
+// vkGetPipelineCacheData.
+constexpr int header_size_offset{0};
+constexpr int header_version_offset{4};
+constexpr int vendor_id_offset{8};
+constexpr int device_id_offset{12};
+constexpr int uuid_offset{16};
+constexpr int header_size{uuid_offset + VK_UUID_SIZE};
+
+std::uint32_t ReadUint32(const QByteArray& data, int offset)
+{
+    std::uint32_t value{};
+    std::memcpy(&value, data.constData() + offset, sizeof(value));
+    return value;
+}
+}  // namespace
+
+PipelineCacheStore::PipelineCacheStore(const QString& path) : path_(path) {}
+
+QString PipelineCacheStore::DefaultPath()
+{
+    const QString path = qEnvironmentVariable("VULKAN_QT_PIPELINE_CACHE");
+    if (!path.isEmpty()) return path;
+    return QStandardPaths::writableLocation(QStandardPaths::CacheLocation) +
+           QStringLiteral("/pipeline_cache.bin");
+}
+
+bool PipelineCacheStore::IsCompatible(
+    const QByteArray& data, const VkPhysicalDeviceProperties& properties)
+{
+    if (data.size() < header_size) return false;
+
+    const std::uint32_t stored_header_size =
+        ReadUint32(data, header_size_offset);
+    if (stored_header_size < header_size ||
+        stored_header_size > static_cast<std::uint32_t>(data.size()))
+        return false;
+    if (ReadUint32(data, header_version_offset) !=
+        VK_PIPELINE_CACHE_HEADER_VERSION_ONE)
+        return false;
+    if (ReadUint32(data, vendor_id_offset) != properties.vendorID)
+        return false;
+    if (ReadUint32(data, device_id_offset) != properties.deviceID)
+        return false;
+    return std::memcmp(data.constData() + uuid_offset,
+                       properties.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+}
+
+QByteArray PipelineCacheStore::Load(
+    const VkPhysicalDeviceProperties& properties) const
+{
+    QFile file(path_);
+    if (!file.open(QIODevice::ReadOnly)) return {};
+    const QByteArray data = file.readAll();
+    file.close();
+
+    if (!IsCompatible(data, properties))
+    {
+        qWarning("Discarding stale or corrupt pipeline cache %s",
+                 qPrintable(path_));
+        return {};
+    }
+    return data;
+}
+
+bool PipelineCacheStore::Save(const QByteArray& data) const
+{
+    if (!QDir().mkpath(QFileInfo(path_).absolutePath()))
+    {
+        qWarning("Failed to create directory for %s", qPrintable(path_));
+        return false;
+    }
+    QSaveFile file(path_);
+    if (!file.open(QIODevice::WriteOnly) || file.write(data) != data.size() ||
+        !file.commit())
+    {
+        qWarning("Failed to write pipeline cache %s", qPrintable(path_));
+        return false;
+    }
+    return true;
+}
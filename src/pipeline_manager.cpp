@@ -0,0 +1,312 @@
+#include "pipeline_manager.h"
+
+#include <QtCore/QFile>
+#include <algorithm>
+#include <utility>
+
+PipelineManager::PipelineManager()
+    : device_functions_{nullptr},
+      device_{VK_NULL_HANDLE},
+      pipeline_cache_{VK_NULL_HANDLE},
+      next_entry_{0},
+      done_count_{0},
+      stopping_{false}
+{
+}
+
+PipelineManager::~PipelineManager() { Release(); }
+
+void PipelineManager::Create(QVulkanDeviceFunctions* device_functions,
+                             VkDevice device, VkPipelineCache pipeline_cache,
+                             int thread_count)
+{
+    device_functions_ = device_functions;
+    device_ = device;
+    pipeline_cache_ = pipeline_cache;
+    pool_ = std::make_unique<WorkerPool>(std::max(thread_count, 1));
+    stopping_ = false;
+    timer_.start();
+    thread_ = std::thread(&PipelineManager::Run, this);
+}
+
+void PipelineManager::Release()
+{
+    if (!device_functions_) return;
+    WaitIdle();
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    work_ready_.notify_all();
+    thread_.join();
+    pool_.reset();
+    LogLatencies();
+
+    for (const auto& entry : entries_)
+    {
+        const VkPipeline pipeline = entry->pipeline.load();
+        if (pipeline)
+            device_functions_->vkDestroyPipeline(device_, pipeline, nullptr);
+    }
+    for (const auto& shader : shaders_)
+    {
+        if (shader.second)
+        {
+            device_functions_->vkDestroyShaderModule(device_, shader.second,
+                                                     nullptr);
+        }
+    }
+    shaders_.clear();
+    entries_.clear();
+    next_entry_ = 0;
+    done_count_ = 0;
+    device_functions_ = nullptr;
+}
+
+int PipelineManager::Request(GraphicsPipelineDesc desc)
+{
+    auto entry = std::make_unique<Entry>();
+    entry->desc = std::move(desc);
+    entry->vertex_shader = VK_NULL_HANDLE;
+    entry->fragment_shader = VK_NULL_HANDLE;
+    entry->pipeline = VK_NULL_HANDLE;
+    entry->requested_ns = timer_.nsecsElapsed();
+    entry->compile_ms = 0.0;
+    entry->ready_ms = 0.0;
+
+    int handle{0};
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        handle = static_cast<int>(entries_.size());
+        entries_.push_back(std::move(entry));
+    }
+    work_ready_.notify_one();
+    return handle;
+}
+
+VkPipeline PipelineManager::Get(int handle) const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return entries_[handle]->pipeline.load(std::memory_order_acquire);
+}
+
+bool PipelineManager::idle() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return done_count_ == entries_.size();
+}
+
+void PipelineManager::WaitIdle()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    work_done_.wait(lock, [this] { return done_count_ == entries_.size(); });
+}
+
+void PipelineManager::Run()
+{
+    for (;;)
+    {
+        std::vector<Entry*> batch;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            work_ready_.wait(lock, [this] {
+                return stopping_ || next_entry_ < entries_.size();
+            });
+            if (next_entry_ == entries_.size()) return;  // stopping
+            for (; next_entry_ < entries_.size(); ++next_entry_)
+                batch.push_back(entries_[next_entry_].get());
+        }
+
+        for (Entry* entry : batch)
+        {
+            entry->vertex_shader = LoadShader(entry->desc.vertex_shader);
+            entry->fragment_shader = LoadShader(entry->desc.fragment_shader);
+        }
+        pool_->ParallelFor(static_cast<int>(batch.size()),
+                           [&batch, this](int i) { Compile(batch[i]); });
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            done_count_ += batch.size();
+        }
+        work_done_.notify_all();
+    }
+}
+
+VkShaderModule PipelineManager::LoadShader(const QString& path)
+{
+    const auto cached = shaders_.find(path);
+    if (cached != shaders_.end()) return cached->second;
+
+    VkShaderModule shader_module{VK_NULL_HANDLE};
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly))
+    {
+        qWarning("Failed to read shader %s", qPrintable(path));
+        shaders_.emplace(path, shader_module);
+        return shader_module;
+    }
+    const QByteArray blob = file.readAll();
+
+    VkShaderModuleCreateInfo shader_info{};
+    shader_info.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+    shader_info.codeSize = blob.size();
+    shader_info.pCode = reinterpret_cast<const uint32_t*>(blob.constData());
+    const VkResult err = device_functions_->vkCreateShaderModule(
+        device_, &shader_info, nullptr, &shader_module);
+    if (err != VK_SUCCESS)
+    {
+        qWarning("Failed to create shader module %s: %d", qPrintable(path),
+                 err);
+        shader_module = VK_NULL_HANDLE;
+    }
+    shaders_.emplace(path, shader_module);
+    return shader_module;
+}
+
+void PipelineManager::Compile(Entry* entry)
+{
+    const GraphicsPipelineDesc& desc = entry->desc;
+    if (!entry->vertex_shader || !entry->fragment_shader)
+    {
+        qWarning("Pipeline %s not created, its shaders are missing",
+                 qPrintable(desc.name));
+        return;
+    }
+
+    std::vector<VkSpecializationMapEntry> map_entries;
+    for (std::size_t i = 0; i < desc.specialization.size(); ++i)
+    {
+        map_entries.push_back(
+            {static_cast<std::uint32_t>(i),
+             static_cast<std::uint32_t>(i * sizeof(std::uint32_t)),
+             sizeof(std::uint32_t)});
+    }
+    const VkSpecializationInfo specialization_info = {
+        static_cast<std::uint32_t>(map_entries.size()), map_entries.data(),
+        desc.specialization.size() * sizeof(std::uint32_t),
+        desc.specialization.data()};
+    const VkSpecializationInfo* specialization =
+        map_entries.empty() ? nullptr : &specialization_info;
+
+    VkGraphicsPipelineCreateInfo pipeline_info{};
+    pipeline_info.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+
+    const VkPipelineShaderStageCreateInfo shader_stages[2] = {
+        {VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO, nullptr, 0,
+         VK_SHADER_STAGE_VERTEX_BIT, entry->vertex_shader, "main",
+         specialization},
+        {VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO, nullptr, 0,
+         VK_SHADER_STAGE_FRAGMENT_BIT, entry->fragment_shader, "main",
+         specialization}};
+    pipeline_info.stageCount = 2;
+    pipeline_info.pStages = shader_stages;
+
+    VkPipelineVertexInputStateCreateInfo vertex_input_info{};
+    vertex_input_info.sType =
+        VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+    vertex_input_info.vertexBindingDescriptionCount =
+        static_cast<std::uint32_t>(desc.bindings.size());
+    vertex_input_info.pVertexBindingDescriptions = desc.bindings.data();
+    vertex_input_info.vertexAttributeDescriptionCount =
+        static_cast<std::uint32_t>(desc.attributes.size());
+    vertex_input_info.pVertexAttributeDescriptions = desc.attributes.data();
+    pipeline_info.pVertexInputState = &vertex_input_info;
+
+    VkPipelineInputAssemblyStateCreateInfo ia{};
+    ia.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+    ia.topology = desc.topology;
+    pipeline_info.pInputAssemblyState = &ia;
+
+    // The viewport and scissor will be set dynamically via
+    // vkCmdSetViewport/Scissor. This way the pipeline does not need to be
+    // touched when resizing the window.
+    VkPipelineViewportStateCreateInfo vp{};
+    vp.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+    vp.viewportCount = 1;
+    vp.scissorCount = 1;
+    pipeline_info.pViewportState = &vp;
+
+    VkPipelineRasterizationStateCreateInfo rs{};
+    rs.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+    rs.polygonMode = VK_POLYGON_MODE_FILL;
+    rs.cullMode = desc.cull_mode;
+    rs.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+    rs.lineWidth = 1.0f;
+    pipeline_info.pRasterizationState = &rs;
+
+    VkPipelineMultisampleStateCreateInfo ms{};
+    ms.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+    // No multisampling.
+    ms.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+    pipeline_info.pMultisampleState = &ms;
+
+    VkPipelineDepthStencilStateCreateInfo ds{};
+    ds.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+    ds.depthTestEnable = VK_TRUE;
+    ds.depthWriteEnable = VK_TRUE;
+    ds.depthCompareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
+    pipeline_info.pDepthStencilState = &ds;
+
+    // Write out all RGBA, no blending
+    VkPipelineColorBlendStateCreateInfo cb{};
+    cb.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+    VkPipelineColorBlendAttachmentState att{};
+    att.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT |
+                         VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+    cb.attachmentCount = 1;
+    cb.pAttachments = &att;
+    pipeline_info.pColorBlendState = &cb;
+
+    const VkDynamicState dynamic_states[] = {VK_DYNAMIC_STATE_VIEWPORT,
+                                             VK_DYNAMIC_STATE_SCISSOR};
+    VkPipelineDynamicStateCreateInfo dynamic_state_info{};
+    dynamic_state_info.sType =
+        VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+    dynamic_state_info.dynamicStateCount =
+        sizeof(dynamic_states) / sizeof(VkDynamicState);
+    dynamic_state_info.pDynamicStates = dynamic_states;
+    pipeline_info.pDynamicState = &dynamic_state_info;
+
+    pipeline_info.layout = desc.layout;
+    pipeline_info.renderPass = desc.render_pass;
+
+    const qint64 start_ns = timer_.nsecsElapsed();
+    VkPipeline pipeline{VK_NULL_HANDLE};
+    const VkResult err = device_functions_->vkCreateGraphicsPipelines(
+        device_, pipeline_cache_, 1, &pipeline_info, nullptr, &pipeline);
+    const qint64 end_ns = timer_.nsecsElapsed();
+    if (err != VK_SUCCESS)
+    {
+        qWarning("Failed to create graphics pipeline %s: %d",
+                 qPrintable(desc.name), err);
+        return;
+    }
+    entry->compile_ms = (end_ns - start_ns) / 1e6;
+    entry->ready_ms = (end_ns - entry->requested_ns) / 1e6;
+    entry->pipeline.store(pipeline, std::memory_order_release);
+    qDebug("pipeline %s: compiled in %.3f ms, ready %.3f ms after its request",
+           qPrintable(desc.name), entry->compile_ms, entry->ready_ms);
+}
+
+void PipelineManager::LogLatencies() const
+{
+    if (entries_.empty()) return;
+    std::size_t compiled{0};
+    double total_compile_ms{0.0};
+    double max_compile_ms{0.0};
+    double last_ready_ms{0.0};  // on timer_
+    for (const auto& entry : entries_)
+    {
+        if (!entry->pipeline.load()) continue;
+        ++compiled;
+        total_compile_ms += entry->compile_ms;
+        max_compile_ms = std::max(max_compile_ms, entry->compile_ms);
+        last_ready_ms = std::max(last_ready_ms,
+                                 entry->requested_ns / 1e6 + entry->ready_ms);
+    }
+    qDebug("%zu of %zu pipeline(s) compiled, %.3f ms in total, %.3f ms at "
+           "most, all ready %.3f ms after the first request",
+           compiled, entries_.size(), total_compile_ms, max_compile_ms,
+           last_ready_ms - entries_.front()->requested_ns / 1e6);
+}
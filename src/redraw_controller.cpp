@@ -0,0 +1,50 @@
+#include "redraw_controller.h"
+
+#include <algorithm>
+
+RedrawController::RedrawController(RedrawMode mode, double max_fps,
+                                   double idle_fps, double idle_after_ms)
+    : mode_{mode},
+      min_interval_ms_{max_fps > 0.0 ? 1000.0 / max_fps : 0.0},
+      idle_interval_ms_{idle_fps > 0.0 ? 1000.0 / idle_fps : 0.0},
+      idle_after_ms_{idle_after_ms},
+      // the first frame is always due
+      invalidated_{true},
+      animating_{false},
+      has_frame_{false},
+      last_frame_ms_{0.0},
+      last_change_ms_{0.0},
+      frame_count_{0}
+{
+}
+
+void RedrawController::FrameRendered(double now_ms)
+{
+    if (invalidated_ || animating_ || !has_frame_) last_change_ms_ = now_ms;
+    invalidated_ = false;
+    has_frame_ = true;
+    last_frame_ms_ = now_ms;
+    ++frame_count_;
+}
+
+double RedrawController::NextFrameDelay(double now_ms) const
+{
+    if (!has_frame_) return 0.0;
+
+    double interval_ms{min_interval_ms_};
+    if (!invalidated_ && !animating_)
+    {
+        const bool throttled = idle_interval_ms_ > 0.0 && idle(now_ms);
+        if (mode_ == RedrawMode::kOnDemand && idle_interval_ms_ <= 0.0)
+            return -1.0;
+        if (mode_ == RedrawMode::kOnDemand || throttled)
+            interval_ms = std::max(interval_ms, idle_interval_ms_);
+    }
+    return std::max(0.0, last_frame_ms_ + interval_ms - now_ms);
+}
+
+bool RedrawController::idle(double now_ms) const
+{
+    return !invalidated_ && !animating_ &&
+           now_ms - last_change_ms_ >= idle_after_ms_;
+}
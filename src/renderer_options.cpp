@@ -0,0 +1,308 @@
+#include "renderer_options.h"
+
+#include <QtCore/QCommandLineParser>
+#include <climits>
+#include <cmath>
+
+#include "geometry.h"
+
+namespace
+{
+int IntValue(const QCommandLineParser& parser,
+             const QCommandLineOption& option, int minimum = 1,
+             int maximum = INT_MAX)
+{
+    bool ok{false};
+    const int value = parser.value(option).toInt(&ok);
+    if (!ok || value < minimum || value > maximum)
+    {
+        qFatal("Invalid value for --%s: %s", qPrintable(option.names().first()),
+               qPrintable(parser.value(option)));
+    }
+    return value;
+}
+
+// A rate such as --max-fps: a finite number, positive or 0 to turn it off.
+double RateValue(const QCommandLineParser& parser,
+                 const QCommandLineOption& option)
+{
+    bool ok{false};
+    const double value = parser.value(option).toDouble(&ok);
+    if (!ok || !std::isfinite(value) || value < 0.0)
+    {
+        qFatal("Invalid value for --%s: %s", qPrintable(option.names().first()),
+               qPrintable(parser.value(option)));
+    }
+    return value;
+}
+
+QSize SizeValue(const QCommandLineParser& parser,
+                const QCommandLineOption& option)
+{
+    const QStringList parts = parser.value(option).split('x');
+    bool width_ok{false};
+    bool height_ok{false};
+    const QSize size(parts.value(0).toInt(&width_ok),
+                     parts.value(1).toInt(&height_ok));
+    if (parts.size() != 2 || !width_ok || !height_ok || size.isEmpty())
+    {
+        qFatal("Invalid value for --%s: %s, expected WxH",
+               qPrintable(option.names().first()),
+               qPrintable(parser.value(option)));
+    }
+    return size;
+}
+}  // namespace
+
+RendererOptions ParseRendererOptions(const QStringList& arguments)
+{
+    RendererOptions options;
+
+    QCommandLineParser parser;
+    parser.addHelpOption();
+    const QCommandLineOption mesh_subdivisions_option(
+        "mesh-subdivisions",
+        QStringLiteral("Split the triangle into <n>^2 triangles of static "
+                       "geometry, n <= %1.")
+            .arg(max_grid_subdivisions),
+        "n",
+        QString::number(options.mesh_subdivisions));
+    parser.addOption(mesh_subdivisions_option);
+    const QCommandLineOption mesh_option(
+        "mesh", "Stream the mesh from <file>, see tools/mesh_converter.",
+        "file");
+    parser.addOption(mesh_option);
+    const QCommandLineOption stream_budget_option(
+        "stream-budget", "Upload at most <MiB> of the --mesh per frame.",
+        "MiB", QString::number(options.stream_budget_mib));
+    parser.addOption(stream_budget_option);
+    const QCommandLineOption quantized_vertices_option(
+        "quantized-vertices",
+        "Store the generated mesh with 16-bit positions and normals and "
+        "8-bit colors.");
+    parser.addOption(quantized_vertices_option);
+    const QCommandLineOption instances_option(
+        "instances", "Draw <n> copies of the mesh.", "n",
+        QString::number(options.instances));
+    parser.addOption(instances_option);
+    const QCommandLineOption materials_option(
+        "materials",
+        "Spread <n> materials over the instances, each bound by index from "
+        "one resource table.",
+        "n", QString::number(options.materials));
+    parser.addOption(materials_option);
+    const QCommandLineOption no_instancing_option(
+        "no-instancing",
+        "Draw every instance with its own draw call instead of one "
+        "instanced draw.");
+    parser.addOption(no_instancing_option);
+    const QCommandLineOption no_culling_option(
+        "no-culling",
+        "Draw every instance at full detail, without frustum culling and "
+        "LOD selection.");
+    parser.addOption(no_culling_option);
+    const QCommandLineOption gpu_culling_option(
+        "gpu-culling",
+        "Cull on the GPU and draw the visible instances with indirect "
+        "draws.");
+    parser.addOption(gpu_culling_option);
+    const QCommandLineOption verify_gpu_culling_option(
+        "verify-gpu-culling",
+        "Cull on the GPU and compare every frame's draws with the CPU "
+        "culler.");
+    parser.addOption(verify_gpu_culling_option);
+    const QCommandLineOption particles_option(
+        "particles",
+        "Simulate <n> particles in a compute shader and draw them as points.",
+        "n", QString::number(options.particles));
+    parser.addOption(particles_option);
+    const QCommandLineOption verify_particles_option(
+        "verify-particles",
+        "Compare a sample of the particles with the CPU simulation after "
+        "every step.");
+    parser.addOption(verify_particles_option);
+    const QCommandLineOption workers_option(
+        "workers",
+        "Record the draws on <n> threads into secondary command buffers, 0 "
+        "records them inline.",
+        "n", QString::number(options.workers));
+    parser.addOption(workers_option);
+    const QCommandLineOption frames_in_flight_option(
+        "frames-in-flight",
+        "Let the CPU record up to <n> frames ahead of the GPU.", "n",
+        QString::number(options.frames_in_flight));
+    parser.addOption(frames_in_flight_option);
+    const QCommandLineOption pipeline_threads_option(
+        "pipeline-threads",
+        "Compile the graphics pipelines on <n> background threads.", "n",
+        QString::number(options.pipeline_threads));
+    parser.addOption(pipeline_threads_option);
+    const QCommandLineOption pipeline_variants_option(
+        "pipeline-variants",
+        "Also compile <n> permutations of the scene pipeline.", "n",
+        QString::number(options.pipeline_variants));
+    parser.addOption(pipeline_variants_option);
+    const QCommandLineOption redraw_option(
+        "redraw",
+        "continuous: render frames back to back, on-demand: only when the "
+        "scene, camera or window changes.",
+        "mode", "continuous");
+    parser.addOption(redraw_option);
+    const QCommandLineOption max_fps_option(
+        "max-fps",
+        "Render at most <n> frames per second, e.g. 29.97, 0 for no limit.",
+        "n", "0");
+    parser.addOption(max_fps_option);
+    const QCommandLineOption idle_fps_option(
+        "idle-fps",
+        "Render an unchanging scene at <n> frames per second, after a second "
+        "in continuous mode. 0 keeps the mode's rate.",
+        "n", "0");
+    parser.addOption(idle_fps_option);
+    const QCommandLineOption log_usage_option(
+        "log-usage", "Log the frame rate and CPU/GPU load every 5 seconds.");
+    parser.addOption(log_usage_option);
+    const QCommandLineOption headless_option(
+        "headless", "Render offscreen without a window and exit.");
+    parser.addOption(headless_option);
+    const QCommandLineOption frames_option(
+        "frames", "Number of frames to render with --headless.", "n",
+        QString::number(options.frames));
+    parser.addOption(frames_option);
+    const QCommandLineOption size_option(
+        "size", "Image size with --headless.", "WxH",
+        QStringLiteral("%1x%2")
+            .arg(options.size.width())
+            .arg(options.size.height()));
+    parser.addOption(size_option);
+    const QCommandLineOption no_timeline_semaphore_option(
+        "no-timeline-semaphore",
+        "Track the frames of --headless with fences, which also keeps the "
+        "uploads on the graphics queue.");
+    parser.addOption(no_timeline_semaphore_option);
+    const QCommandLineOption no_transfer_queue_option(
+        "no-transfer-queue",
+        "Stream --mesh through the graphics queue with --headless.");
+    parser.addOption(no_transfer_queue_option);
+    const QCommandLineOption output_option(
+        "output",
+        "Write the rendered frames into <directory>. A window drops frames "
+        "while the writer falls behind.",
+        "directory");
+    parser.addOption(output_option);
+    const QCommandLineOption output_format_option(
+        "output-format",
+        "Format of --output: ppm or png images, or one y4m video.", "format",
+        options.output_format);
+    parser.addOption(output_format_option);
+    const QCommandLineOption profile_option(
+        "profile",
+        "Report CPU and GPU frame timings: none, log, csv or trace.",
+        "output", "none");
+    parser.addOption(profile_option);
+    const QCommandLineOption profile_path_option(
+        "profile-output",
+        "File for --profile csv (default frame_timings.csv) or trace "
+        "(default frame_trace.json).",
+        "file");
+    parser.addOption(profile_path_option);
+    const QCommandLineOption benchmark_json_option(
+        "benchmark-json",
+        "Write a JSON summary of the frame timings and memory usage to "
+        "<file> on exit, see benchmark/render_suite.py.",
+        "file");
+    parser.addOption(benchmark_json_option);
+    const QCommandLineOption orbit_every_option(
+        "orbit-every",
+        "Turn the camera every <n> frames, 0 never, to update the uniforms "
+        "at a fixed rate.",
+        "n", QString::number(options.orbit_every));
+    parser.addOption(orbit_every_option);
+    parser.process(arguments);
+
+    options.mesh_subdivisions = IntValue(parser, mesh_subdivisions_option, 1,
+                                         max_grid_subdivisions);
+    options.mesh_path = parser.value(mesh_option);
+    options.stream_budget_mib = IntValue(parser, stream_budget_option);
+    options.quantized_vertices = parser.isSet(quantized_vertices_option);
+    options.instances = IntValue(parser, instances_option);
+    options.materials = IntValue(parser, materials_option);
+    options.instancing = !parser.isSet(no_instancing_option);
+    options.culling = !parser.isSet(no_culling_option);
+    // Kept with --no-culling, so the run fails instead of passing without
+    // having checked anything.
+    options.verify_gpu_culling = parser.isSet(verify_gpu_culling_option);
+    options.gpu_culling =
+        options.culling && (options.verify_gpu_culling ||
+                            parser.isSet(gpu_culling_option));
+    options.particles = IntValue(parser, particles_option, 0);
+    // kept without particles, see verify_gpu_culling
+    options.verify_particles = parser.isSet(verify_particles_option);
+    options.workers = IntValue(parser, workers_option, 0);
+    options.frames_in_flight = IntValue(parser, frames_in_flight_option);
+    options.pipeline_threads = IntValue(parser, pipeline_threads_option);
+    options.pipeline_variants = IntValue(parser, pipeline_variants_option, 0);
+    const QString redraw = parser.value(redraw_option).toLower();
+    if (redraw == "continuous")
+    {
+        options.redraw = RedrawMode::kContinuous;
+    }
+    else if (redraw == "on-demand")
+    {
+        options.redraw = RedrawMode::kOnDemand;
+    }
+    else
+    {
+        qFatal("Invalid value for --redraw: %s", qPrintable(redraw));
+    }
+    options.max_fps = RateValue(parser, max_fps_option);
+    options.idle_fps = RateValue(parser, idle_fps_option);
+    options.log_usage = parser.isSet(log_usage_option);
+    options.headless = parser.isSet(headless_option);
+    options.frames = IntValue(parser, frames_option);
+    options.size = SizeValue(parser, size_option);
+    options.timeline_semaphore = !parser.isSet(no_timeline_semaphore_option);
+    options.transfer_queue = !parser.isSet(no_transfer_queue_option);
+    options.output_directory = parser.value(output_option);
+    options.output_format = parser.value(output_format_option).toLower();
+    if (options.output_format != "ppm" && options.output_format != "png" &&
+        options.output_format != "y4m")
+    {
+        qFatal("Invalid value for --output-format: %s",
+               qPrintable(options.output_format));
+    }
+
+    const QString profile = parser.value(profile_option).toLower();
+    if (profile == "none")
+    {
+        options.profile = ProfileOutput::kNone;
+    }
+    else if (profile == "log")
+    {
+        options.profile = ProfileOutput::kLog;
+    }
+    else if (profile == "csv")
+    {
+        options.profile = ProfileOutput::kCsv;
+        options.profile_path = "frame_timings.csv";
+    }
+    else if (profile == "trace")
+    {
+        options.profile = ProfileOutput::kTrace;
+        options.profile_path = "frame_trace.json";
+    }
+    else
+    {
+        qFatal("Invalid value for --profile: %s", qPrintable(profile));
+    }
+    if (parser.isSet(profile_path_option))
+        options.profile_path = parser.value(profile_path_option);
+    options.benchmark_json = parser.value(benchmark_json_option);
+    if (!options.benchmark_json.isEmpty() &&
+        options.profile == ProfileOutput::kNone)
+    {
+        options.profile = ProfileOutput::kLog;
+    }
+    options.orbit_every = IntValue(parser, orbit_every_option, 0);
+    return options;
+}
@@ -0,0 +1,36 @@
+#include "simd_level.h"
+
+SimdLevel DetectSimdLevel()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    static const SimdLevel level = [] {
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+            return SimdLevel::kAvx2;
+        if (__builtin_cpu_supports("sse2")) return SimdLevel::kSse;
+        return SimdLevel::kScalar;
+    }();
+    return level;
+#else
+    return SimdLevel::kScalar;
+#endif
+}
+
+bool IsSimdLevelSupported(SimdLevel level)
+{
+    return level <= DetectSimdLevel();
+}
+
+const char* SimdLevelName(SimdLevel level)
+{
+    switch (level)
+    {
+        case SimdLevel::kScalar:
+            return "scalar";
+        case SimdLevel::kSse:
+            return "sse";
+        case SimdLevel::kAvx2:
+            return "avx2";
+    }
+    return "unknown";
+}
@@ -0,0 +1,344 @@
+#include "staging_uploader.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "vulkan_utils.h"
+
+StagingUploader::StagingUploader()
+    : device_functions_{nullptr},
+      device_{VK_NULL_HANDLE},
+      queue_{VK_NULL_HANDLE},
+      command_pool_{VK_NULL_HANDLE},
+      consumer_barriers_{true},
+      buffer_{VK_NULL_HANDLE},
+      memory_{VK_NULL_HANDLE},
+      mapped_{nullptr},
+      coherent_{true},
+      size_{0},
+      alignment_{16},
+      head_{0},
+      tail_{0}
+{
+}
+
+void StagingUploader::Create(
+    QVulkanInstance* instance, VkDevice device,
+    const VkPhysicalDeviceProperties& device_properties,
+    std::uint32_t memory_index, VkMemoryPropertyFlags memory_flags,
+    VkQueue queue, VkCommandPool command_pool, VkDeviceSize ring_size,
+    bool timeline_semaphore, bool transfer_queue)
+{
+    device_functions_ = instance->deviceFunctions(device);
+    device_ = device;
+    queue_ = queue;
+    command_pool_ = command_pool;
+    timeline_.Create(instance, device, timeline_semaphore);
+    consumer_barriers_ = !transfer_queue;
+    coherent_ = (memory_flags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) != 0;
+    // Non-coherent ranges are flushed per copy, so keep every staged copy on
+    // its own atoms.
+    alignment_ = std::max<VkDeviceSize>(
+        alignment_, device_properties.limits.nonCoherentAtomSize);
+    size_ = aligned(ring_size, alignment_);
+    head_ = tail_ = 0;
+
+    VkBufferCreateInfo buffer_info{};
+    buffer_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    buffer_info.size = size_;
+    buffer_info.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+    auto err = device_functions_->vkCreateBuffer(device_, &buffer_info,
+                                                 nullptr, &buffer_);
+    if (err != VK_SUCCESS) qFatal("Failed to create staging buffer: %d", err);
+
+    VkMemoryRequirements memory_requirements{};
+    device_functions_->vkGetBufferMemoryRequirements(device_, buffer_,
+                                                     &memory_requirements);
+    VkMemoryAllocateInfo allocate_info = {
+        VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO, nullptr,
+        memory_requirements.size, memory_index};
+    err = device_functions_->vkAllocateMemory(device_, &allocate_info, nullptr,
+                                              &memory_);
+    if (err != VK_SUCCESS) qFatal("Failed to allocate staging memory: %d", err);
+
+    err = device_functions_->vkBindBufferMemory(device_, buffer_, memory_, 0);
+    if (err != VK_SUCCESS) qFatal("Failed to bind staging memory: %d", err);
+
+    // the ring stays mapped for its whole lifetime
+    err = device_functions_->vkMapMemory(device_, memory_, 0, VK_WHOLE_SIZE, 0,
+                                         reinterpret_cast<void**>(&mapped_));
+    if (err != VK_SUCCESS) qFatal("Failed to map staging memory: %d", err);
+}
+
+void StagingUploader::Release()
+{
+    if (!device_functions_) return;
+    WaitIdle();
+    timeline_.Release();
+    if (memory_)
+    {
+        device_functions_->vkUnmapMemory(device_, memory_);
+        device_functions_->vkFreeMemory(device_, memory_, nullptr);
+        memory_ = VK_NULL_HANDLE;
+        mapped_ = nullptr;
+    }
+    if (buffer_)
+    {
+        device_functions_->vkDestroyBuffer(device_, buffer_, nullptr);
+        buffer_ = VK_NULL_HANDLE;
+    }
+    device_functions_ = nullptr;
+}
+
+void StagingUploader::Upload(VkBuffer dst, VkDeviceSize dst_offset,
+                             const void* data, VkDeviceSize size,
+                             VkPipelineStageFlags dst_stage,
+                             VkAccessFlags dst_access)
+{
+    const auto* bytes = static_cast<const quint8*>(data);
+    // Uploads larger than the ring are split into ring sized pieces.
+    const VkDeviceSize max_piece = size_ / 2;
+    while (size > 0)
+    {
+        const VkDeviceSize piece = std::min(size, max_piece);
+        VkDeviceSize offset{};
+        while (!TryAllocate(piece, &offset))
+        {
+            if (!pending_copies_.empty() || !pending_image_copies_.empty())
+                Flush();
+            ReclaimOldest(true);
+        }
+
+        std::memcpy(mapped_ + offset, bytes, piece);
+        if (!coherent_)
+        {
+            const VkMappedMemoryRange range = {
+                VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE, nullptr, memory_,
+                offset, aligned(piece, alignment_)};
+            device_functions_->vkFlushMappedMemoryRanges(device_, 1, &range);
+        }
+        pending_copies_.push_back(
+            {dst, {offset, dst_offset, piece}, dst_stage, dst_access});
+
+        bytes += piece;
+        dst_offset += piece;
+        size -= piece;
+    }
+}
+
+void StagingUploader::UploadImage(VkImage dst, std::uint32_t width,
+                                  std::uint32_t height, const void* data,
+                                  VkDeviceSize size,
+                                  VkPipelineStageFlags dst_stage)
+{
+    if (size > size_ / 2) qFatal("Image upload does not fit the staging ring");
+    if (!consumer_barriers_) qFatal("Image uploads need a graphics queue");
+    VkDeviceSize offset{};
+    while (!TryAllocate(size, &offset))
+    {
+        if (!pending_copies_.empty() || !pending_image_copies_.empty())
+            Flush();
+        ReclaimOldest(true);
+    }
+
+    std::memcpy(mapped_ + offset, data, size);
+    if (!coherent_)
+    {
+        const VkMappedMemoryRange range = {
+            VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE, nullptr, memory_, offset,
+            aligned(size, alignment_)};
+        device_functions_->vkFlushMappedMemoryRanges(device_, 1, &range);
+    }
+    VkBufferImageCopy region{};
+    region.bufferOffset = offset;
+    region.imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+    region.imageExtent = {width, height, 1};
+    pending_image_copies_.push_back({dst, region, dst_stage});
+}
+
+std::uint64_t StagingUploader::Flush()
+{
+    if (pending_copies_.empty() && pending_image_copies_.empty())
+        return timeline_.submitted_value();
+
+    // opportunistically free staging space of finished batches
+    while (ReclaimOldest(false))
+    {
+    }
+
+    Submission submission{};
+    const VkCommandBufferAllocateInfo allocate_info = {
+        VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO, nullptr, command_pool_,
+        VK_COMMAND_BUFFER_LEVEL_PRIMARY, 1};
+    auto err = device_functions_->vkAllocateCommandBuffers(
+        device_, &allocate_info, &submission.command_buffer);
+    if (err != VK_SUCCESS)
+        qFatal("Failed to allocate upload command buffer: %d", err);
+
+    VkCommandBufferBeginInfo begin_info{};
+    begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    device_functions_->vkBeginCommandBuffer(submission.command_buffer,
+                                            &begin_info);
+
+    // One vkCmdCopyBuffer per destination buffer, with all its regions.
+    std::stable_sort(pending_copies_.begin(), pending_copies_.end(),
+                     [](const PendingCopy& a, const PendingCopy& b) {
+                         return a.dst < b.dst;
+                     });
+    std::vector<VkBufferCopy> regions;
+    std::vector<VkBufferMemoryBarrier> barriers;
+    VkPipelineStageFlags dst_stages{0};
+    for (std::size_t begin = 0; begin < pending_copies_.size();)
+    {
+        const VkBuffer dst = pending_copies_[begin].dst;
+        VkAccessFlags dst_access{0};
+        regions.clear();
+        std::size_t end = begin;
+        for (; end < pending_copies_.size() && pending_copies_[end].dst == dst;
+             ++end)
+        {
+            regions.push_back(pending_copies_[end].region);
+            dst_access |= pending_copies_[end].dst_access;
+            dst_stages |= pending_copies_[end].dst_stage;
+        }
+        device_functions_->vkCmdCopyBuffer(
+            submission.command_buffer, buffer_, dst,
+            static_cast<std::uint32_t>(regions.size()), regions.data());
+
+        VkBufferMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = dst_access;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.buffer = dst;
+        barrier.offset = 0;
+        barrier.size = VK_WHOLE_SIZE;
+        barriers.push_back(barrier);
+        begin = end;
+    }
+    if (consumer_barriers_ && !barriers.empty())
+    {
+        device_functions_->vkCmdPipelineBarrier(
+            submission.command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+            dst_stages, 0, 0, nullptr,
+            static_cast<std::uint32_t>(barriers.size()), barriers.data(), 0,
+            nullptr);
+    }
+    RecordImageCopies(submission.command_buffer);
+
+    err = device_functions_->vkEndCommandBuffer(submission.command_buffer);
+    if (err != VK_SUCCESS)
+        qFatal("Failed to record upload command buffer: %d", err);
+
+    submission.ring_end = head_;
+    submission.value =
+        timeline_.Submit(queue_, &submission.command_buffer, 1);
+    in_flight_.push_back(submission);
+    pending_copies_.clear();
+    return submission.value;
+}
+
+void StagingUploader::RecordImageCopies(VkCommandBuffer command_buffer)
+{
+    if (pending_image_copies_.empty()) return;
+
+    // whole images, undefined -> transfer destination -> shader read
+    VkImageMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+    std::vector<VkImageMemoryBarrier> barriers;
+    for (const PendingImageCopy& copy : pending_image_copies_)
+    {
+        barrier.image = copy.dst;
+        barrier.srcAccessMask = 0;
+        barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barriers.push_back(barrier);
+    }
+    device_functions_->vkCmdPipelineBarrier(
+        command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+        VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr,
+        static_cast<std::uint32_t>(barriers.size()), barriers.data());
+
+    VkPipelineStageFlags dst_stages{0};
+    barriers.clear();
+    for (const PendingImageCopy& copy : pending_image_copies_)
+    {
+        device_functions_->vkCmdCopyBufferToImage(
+            command_buffer, buffer_, copy.dst,
+            VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copy.region);
+        barrier.image = copy.dst;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        barriers.push_back(barrier);
+        dst_stages |= copy.dst_stage;
+    }
+    device_functions_->vkCmdPipelineBarrier(
+        command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, dst_stages, 0, 0,
+        nullptr, 0, nullptr, static_cast<std::uint32_t>(barriers.size()),
+        barriers.data());
+    pending_image_copies_.clear();
+}
+
+void StagingUploader::WaitIdle()
+{
+    Flush();
+    while (!in_flight_.empty()) ReclaimOldest(true);
+}
+
+bool StagingUploader::TryAllocate(VkDeviceSize size, VkDeviceSize* offset)
+{
+    const bool empty = in_flight_.empty() && pending_copies_.empty() &&
+                       pending_image_copies_.empty();
+    if (empty) head_ = tail_ = 0;
+
+    const VkDeviceSize start = aligned(head_, alignment_);
+    if (empty || head_ > tail_)
+    {
+        // free space is [head_, size_) followed by [0, tail_)
+        if (start + size <= size_)
+        {
+            *offset = start;
+            head_ = start + size;
+            return true;
+        }
+        if (size <= tail_)
+        {
+            *offset = 0;
+            head_ = size;
+            return true;
+        }
+        return false;
+    }
+    // wrapped around, free space is [head_, tail_)
+    if (start + size <= tail_)
+    {
+        *offset = start;
+        head_ = start + size;
+        return true;
+    }
+    return false;
+}
+
+bool StagingUploader::ReclaimOldest(bool wait)
+{
+    if (in_flight_.empty()) return false;
+    Submission& oldest = in_flight_.front();
+    if (wait)
+        timeline_.WaitFor(oldest.value);
+    else if (!timeline_.IsComplete(oldest.value))
+        return false;
+
+    device_functions_->vkFreeCommandBuffers(device_, command_pool_, 1,
+                                            &oldest.command_buffer);
+    tail_ = oldest.ring_end;
+    in_flight_.pop_front();
+    return true;
+}
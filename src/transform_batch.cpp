@@ -0,0 +1,242 @@
+#include "transform_batch.h"
+
+#include <algorithm>
+#include <cstring>
+#include <glm/gtc/type_ptr.hpp>  // glm::value_ptr
+
+#include "graphics.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define VULKAN_QT_X86_KERNELS
+#include <immintrin.h>
+#endif
+
+static_assert(sizeof(glm::mat4) == 16 * sizeof(float),
+              "kernels write glm::mat4 arrays as plain floats");
+
+namespace
+{
+constexpr int element_count{16};
+
+// The kernels compute out[i] = vp * model[i]. The SIMD ones handle whole
+// blocks from the first object on and return how many objects they did; the
+// scalar one finishes [begin, count). vp and out are column-major, with 16
+// floats per matrix.
+void ScalarKernel(const float* vp, const float* const* model,
+                  std::size_t begin, std::size_t count, float* out)
+{
+    for (std::size_t i = begin; i < count; ++i)
+    {
+        float* mvp = out + i * element_count;
+        for (int column = 0; column < 4; ++column)
+        {
+            const float m0 = model[4 * column + 0][i];
+            const float m1 = model[4 * column + 1][i];
+            const float m2 = model[4 * column + 2][i];
+            const float m3 = model[4 * column + 3][i];
+            for (int row = 0; row < 4; ++row)
+            {
+                mvp[4 * column + row] = vp[0 + row] * m0 + vp[4 + row] * m1 +
+                                        vp[8 + row] * m2 + vp[12 + row] * m3;
+            }
+        }
+    }
+}
+
+#ifdef VULKAN_QT_X86_KERNELS
+// 4 objects per iteration. The 16 result registers hold one element each;
+// transposing every group of 4 turns them back into per-object columns.
+__attribute__((target("sse2"))) std::size_t SseKernel(
+    const float* vp, const float* const* model, std::size_t count,
+    float* out)
+{
+    __m128 vp_elements[element_count];
+    for (int e = 0; e < element_count; ++e)
+        vp_elements[e] = _mm_set1_ps(vp[e]);
+
+    const std::size_t end = count - count % 4;
+    for (std::size_t i = 0; i < end; i += 4)
+    {
+        float* mvp = out + i * element_count;
+        for (int column = 0; column < 4; ++column)
+        {
+            const __m128 m0 = _mm_loadu_ps(model[4 * column + 0] + i);
+            const __m128 m1 = _mm_loadu_ps(model[4 * column + 1] + i);
+            const __m128 m2 = _mm_loadu_ps(model[4 * column + 2] + i);
+            const __m128 m3 = _mm_loadu_ps(model[4 * column + 3] + i);
+            __m128 rows[4];
+            for (int row = 0; row < 4; ++row)
+            {
+                rows[row] = _mm_add_ps(
+                    _mm_add_ps(_mm_mul_ps(vp_elements[0 + row], m0),
+                               _mm_mul_ps(vp_elements[4 + row], m1)),
+                    _mm_add_ps(_mm_mul_ps(vp_elements[8 + row], m2),
+                               _mm_mul_ps(vp_elements[12 + row], m3)));
+            }
+            _MM_TRANSPOSE4_PS(rows[0], rows[1], rows[2], rows[3]);
+            for (int object = 0; object < 4; ++object)
+            {
+                _mm_storeu_ps(mvp + object * element_count + 4 * column,
+                              rows[object]);
+            }
+        }
+    }
+    return end;
+}
+
+// Transposes an 8x8 block: afterwards r[j] holds lane j of every input.
+__attribute__((target("avx2"))) inline void Transpose8(__m256* r)
+{
+    const __m256 t0 = _mm256_unpacklo_ps(r[0], r[1]);
+    const __m256 t1 = _mm256_unpackhi_ps(r[0], r[1]);
+    const __m256 t2 = _mm256_unpacklo_ps(r[2], r[3]);
+    const __m256 t3 = _mm256_unpackhi_ps(r[2], r[3]);
+    const __m256 t4 = _mm256_unpacklo_ps(r[4], r[5]);
+    const __m256 t5 = _mm256_unpackhi_ps(r[4], r[5]);
+    const __m256 t6 = _mm256_unpacklo_ps(r[6], r[7]);
+    const __m256 t7 = _mm256_unpackhi_ps(r[6], r[7]);
+    const __m256 s0 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(1, 0, 1, 0));
+    const __m256 s1 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(3, 2, 3, 2));
+    const __m256 s2 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(1, 0, 1, 0));
+    const __m256 s3 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(3, 2, 3, 2));
+    const __m256 s4 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(1, 0, 1, 0));
+    const __m256 s5 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(3, 2, 3, 2));
+    const __m256 s6 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(1, 0, 1, 0));
+    const __m256 s7 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(3, 2, 3, 2));
+    r[0] = _mm256_permute2f128_ps(s0, s4, 0x20);
+    r[1] = _mm256_permute2f128_ps(s1, s5, 0x20);
+    r[2] = _mm256_permute2f128_ps(s2, s6, 0x20);
+    r[3] = _mm256_permute2f128_ps(s3, s7, 0x20);
+    r[4] = _mm256_permute2f128_ps(s0, s4, 0x31);
+    r[5] = _mm256_permute2f128_ps(s1, s5, 0x31);
+    r[6] = _mm256_permute2f128_ps(s2, s6, 0x31);
+    r[7] = _mm256_permute2f128_ps(s3, s7, 0x31);
+}
+
+// 8 objects per iteration. Columns 0-1 and 2-3 of the results form two 8x8
+// blocks, whose transposes are the first and second half of each object.
+__attribute__((target("avx2,fma"))) std::size_t Avx2Kernel(
+    const float* vp, const float* const* model, std::size_t count,
+    float* out)
+{
+    __m256 vp_elements[element_count];
+    for (int e = 0; e < element_count; ++e)
+        vp_elements[e] = _mm256_set1_ps(vp[e]);
+
+    const std::size_t end = count - count % 8;
+    for (std::size_t i = 0; i < end; i += 8)
+    {
+        float* mvp = out + i * element_count;
+        for (int half = 0; half < 2; ++half)
+        {
+            __m256 block[8];
+            for (int c = 0; c < 2; ++c)
+            {
+                const int column = 2 * half + c;
+                const __m256 m0 = _mm256_loadu_ps(model[4 * column + 0] + i);
+                const __m256 m1 = _mm256_loadu_ps(model[4 * column + 1] + i);
+                const __m256 m2 = _mm256_loadu_ps(model[4 * column + 2] + i);
+                const __m256 m3 = _mm256_loadu_ps(model[4 * column + 3] + i);
+                for (int row = 0; row < 4; ++row)
+                {
+                    __m256 sum = _mm256_mul_ps(vp_elements[0 + row], m0);
+                    sum = _mm256_fmadd_ps(vp_elements[4 + row], m1, sum);
+                    sum = _mm256_fmadd_ps(vp_elements[8 + row], m2, sum);
+                    sum = _mm256_fmadd_ps(vp_elements[12 + row], m3, sum);
+                    block[4 * c + row] = sum;
+                }
+            }
+            Transpose8(block);
+            for (int object = 0; object < 8; ++object)
+            {
+                _mm256_storeu_ps(mvp + object * element_count + 8 * half,
+                                 block[object]);
+            }
+        }
+    }
+    return end;
+}
+#endif  // VULKAN_QT_X86_KERNELS
+}  // namespace
+
+MatrixBatch::MatrixBatch(std::size_t size) { Resize(size); }
+
+void MatrixBatch::Resize(std::size_t size)
+{
+    // element rows move when the size changes
+    std::vector<float> data(element_count * size, 0.0f);
+    const std::size_t kept = std::min(size, size_);
+    for (int e = 0; e < element_count; ++e)
+    {
+        std::copy_n(data_.data() + e * size_, kept, data.data() + e * size);
+    }
+    data_.swap(data);
+    size_ = size;
+}
+
+void MatrixBatch::Set(std::size_t index, const glm::mat4& matrix)
+{
+    const float* values = glm::value_ptr(matrix);
+    for (int e = 0; e < element_count; ++e) Element(e)[index] = values[e];
+}
+
+glm::mat4 MatrixBatch::Get(std::size_t index) const
+{
+    glm::mat4 matrix;
+    float* values = glm::value_ptr(matrix);
+    for (int e = 0; e < element_count; ++e) values[e] = Element(e)[index];
+    return matrix;
+}
+
+TransformBatch::TransformBatch()
+    : view_projection_{1.0f},
+      camera_{},
+      camera_valid_{false},
+      simd_level_{DetectSimdLevel()}
+{
+}
+
+void TransformBatch::SetViewProjection(const glm::mat4& view_projection)
+{
+    view_projection_ = view_projection;
+    camera_valid_ = false;
+}
+
+void TransformBatch::SetCamera(float aspect, float translate_z,
+                               float rotate_x, float rotate_y)
+{
+    const float camera[4] = {aspect, translate_z, rotate_x, rotate_y};
+    if (camera_valid_ && std::memcmp(camera, camera_, sizeof(camera)) == 0)
+        return;
+    view_projection_ = GetProjectionMatrix(aspect) *
+                       GetViewMatrix(translate_z, rotate_x, rotate_y);
+    std::memcpy(camera_, camera, sizeof(camera));
+    camera_valid_ = true;
+}
+
+void TransformBatch::Compute(const MatrixBatch& models, glm::mat4* mvps) const
+{
+    Compute(models, mvps, simd_level_);
+}
+
+void TransformBatch::Compute(const MatrixBatch& models, glm::mat4* mvps,
+                             SimdLevel level) const
+{
+    const std::size_t count = models.size();
+    if (count == 0) return;
+
+    const float* model[element_count];
+    for (int e = 0; e < element_count; ++e) model[e] = models.Element(e);
+    const float* vp = glm::value_ptr(view_projection_);
+    float* out = glm::value_ptr(mvps[0]);
+
+    level = std::min(level, DetectSimdLevel());
+    std::size_t done{0};
+#ifdef VULKAN_QT_X86_KERNELS
+    if (level == SimdLevel::kAvx2)
+        done = Avx2Kernel(vp, model, count, out);
+    else if (level == SimdLevel::kSse)
+        done = SseKernel(vp, model, count, out);
+#endif
+    ScalarKernel(vp, model, done, count, out);
+}
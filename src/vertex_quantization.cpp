@@ -0,0 +1,176 @@
+#include "vertex_quantization.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "geometry.h"
+
+namespace
+{
+constexpr float snorm16_max{32767.0f};
+
+std::int16_t ToSnorm16(float value)
+{
+    return static_cast<std::int16_t>(
+        std::lround(std::clamp(value, -1.0f, 1.0f) * snorm16_max));
+}
+
+// Like the Vulkan SNORM conversion, -32768 decodes to -1 as well.
+float FromSnorm16(std::int16_t value)
+{
+    return std::max(value / snorm16_max, -1.0f);
+}
+
+std::uint8_t ToUnorm8(float value)
+{
+    return static_cast<std::uint8_t>(
+        std::lround(std::clamp(value, 0.0f, 1.0f) * 255.0f));
+}
+
+float SignNotZero(float value) { return value < 0.0f ? -1.0f : 1.0f; }
+
+// Between two vectors, also accurate for tiny angles where acos is not.
+float Angle(const float* a, const float* b)
+{
+    const double cross[3] = {
+        static_cast<double>(a[1]) * b[2] - static_cast<double>(a[2]) * b[1],
+        static_cast<double>(a[2]) * b[0] - static_cast<double>(a[0]) * b[2],
+        static_cast<double>(a[0]) * b[1] - static_cast<double>(a[1]) * b[0]};
+    const double dot = static_cast<double>(a[0]) * b[0] +
+                       static_cast<double>(a[1]) * b[1] +
+                       static_cast<double>(a[2]) * b[2];
+    return static_cast<float>(std::atan2(
+        std::sqrt(cross[0] * cross[0] + cross[1] * cross[1] +
+                  cross[2] * cross[2]),
+        dot));
+}
+}  // namespace
+
+QuantizationError QuantizationErrorBound(
+    const PositionDequantization& dequantization)
+{
+    // plus a few ulps of the largest coordinate for the float math
+    float longest{0.0f};
+    float magnitude{0.0f};
+    for (int k = 0; k < 3; ++k)
+    {
+        longest = std::max(longest, dequantization.scale[k]);
+        magnitude = std::max(magnitude, std::fabs(dequantization.offset[k]) +
+                                            dequantization.scale[k]);
+    }
+    constexpr float epsilon = std::numeric_limits<float>::epsilon();
+    return {0.5f * longest / snorm16_max + 4.0f * epsilon * magnitude,
+            octahedral_normal_error, 0.5f / 255.0f + epsilon};
+}
+
+void EncodeOctahedral(const float* normal, std::int16_t* encoded)
+{
+    // project onto the octahedron |x| + |y| + |z| = 1, then fold the lower
+    // half over the diagonals
+    const float length =
+        std::fabs(normal[0]) + std::fabs(normal[1]) + std::fabs(normal[2]);
+    if (length == 0.0f)
+    {
+        encoded[0] = encoded[1] = 0;
+        return;
+    }
+    float x = normal[0] / length;
+    float y = normal[1] / length;
+    if (normal[2] < 0.0f)
+    {
+        const float folded_x = (1.0f - std::fabs(y)) * SignNotZero(x);
+        y = (1.0f - std::fabs(x)) * SignNotZero(y);
+        x = folded_x;
+    }
+    encoded[0] = ToSnorm16(x);
+    encoded[1] = ToSnorm16(y);
+}
+
+void DecodeOctahedral(const std::int16_t* encoded, float* normal)
+{
+    const float x = FromSnorm16(encoded[0]);
+    const float y = FromSnorm16(encoded[1]);
+    const float z = 1.0f - std::fabs(x) - std::fabs(y);
+    // unfold the lower half
+    const float t = std::max(-z, 0.0f);
+    normal[0] = x + (x >= 0.0f ? -t : t);
+    normal[1] = y + (y >= 0.0f ? -t : t);
+    normal[2] = z;
+    const float length = std::sqrt(normal[0] * normal[0] +
+                                   normal[1] * normal[1] +
+                                   normal[2] * normal[2]);
+    for (int k = 0; k < 3; ++k) normal[k] /= length;
+}
+
+std::vector<QuantizedVertex> QuantizeVertices(
+    const float* vertices, std::size_t vertex_count,
+    PositionDequantization* dequantization, QuantizationError* error)
+{
+    // the bounding box maps onto [-1, 1]^3
+    float low[3] = {0.0f, 0.0f, 0.0f};
+    float high[3] = {0.0f, 0.0f, 0.0f};
+    for (std::size_t v = 0; v < vertex_count; ++v)
+    {
+        const float* position = vertices + v * vertex_float_count;
+        for (int k = 0; k < 3; ++k)
+        {
+            low[k] = v == 0 ? position[k] : std::min(low[k], position[k]);
+            high[k] = v == 0 ? position[k] : std::max(high[k], position[k]);
+        }
+    }
+    for (int k = 0; k < 3; ++k)
+    {
+        dequantization->offset[k] = 0.5f * (low[k] + high[k]);
+        // flat axes keep a scale, so decoding never divides by zero
+        dequantization->scale[k] = std::max(0.5f * (high[k] - low[k]), 1e-6f);
+    }
+
+    std::vector<QuantizedVertex> quantized(vertex_count);
+    QuantizationError measured{0.0f, 0.0f, 0.0f};
+    for (std::size_t v = 0; v < vertex_count; ++v)
+    {
+        const float* vertex = vertices + v * vertex_float_count;
+        QuantizedVertex& out = quantized[v];
+        for (int k = 0; k < 3; ++k)
+        {
+            out.position[k] =
+                ToSnorm16((vertex[k] - dequantization->offset[k]) /
+                          dequantization->scale[k]);
+            out.color[k] = ToUnorm8(vertex[vertex_color_offset + k]);
+        }
+        out.position[3] = 0;
+        out.color[3] = 255;
+        EncodeOctahedral(vertex + vertex_normal_offset, out.normal);
+        if (!error) continue;
+
+        float decoded[vertex_float_count];
+        DequantizeVertex(out, *dequantization, decoded);
+        for (int k = 0; k < 3; ++k)
+        {
+            measured.position = std::max(
+                measured.position, std::fabs(decoded[k] - vertex[k]));
+            measured.color = std::max(
+                measured.color, std::fabs(decoded[vertex_color_offset + k] -
+                                          vertex[vertex_color_offset + k]));
+        }
+        measured.normal = std::max(
+            measured.normal, Angle(vertex + vertex_normal_offset,
+                                   decoded + vertex_normal_offset));
+    }
+    if (error) *error = measured;
+    return quantized;
+}
+
+void DequantizeVertex(const QuantizedVertex& vertex,
+                      const PositionDequantization& dequantization,
+                      float* out)
+{
+    for (int k = 0; k < 3; ++k)
+    {
+        out[k] = dequantization.offset[k] +
+                 dequantization.scale[k] * FromSnorm16(vertex.position[k]);
+        out[vertex_color_offset + k] = vertex.color[k] / 255.0f;
+    }
+    DecodeOctahedral(vertex.normal, out + vertex_normal_offset);
+}
@@ -0,0 +1,324 @@
+#include "visibility.h"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define VULKAN_QT_X86_KERNELS
+#include <immintrin.h>
+#endif
+
+namespace
+{
+// Spheres per chunk: large enough to amortize handing out a chunk, small
+// enough for the four input streams to stay in L1/L2 while it runs.
+constexpr std::size_t chunk_size{4096};
+
+// The kernels set inside[i - begin] to whether sphere i intersects all six
+// planes. The SIMD ones handle whole blocks from begin on and return where
+// they stopped; the scalar one finishes [begin, end).
+void ScalarKernel(const Frustum& frustum, const BoundingSpheres& spheres,
+                  std::size_t first, std::size_t begin, std::size_t end,
+                  std::uint8_t* inside)
+{
+    for (std::size_t i = begin; i < end; ++i)
+    {
+        bool visible{true};
+        for (const float* plane : frustum.planes)
+        {
+            const float distance = plane[0] * spheres.x()[i] +
+                                   plane[1] * spheres.y()[i] +
+                                   plane[2] * spheres.z()[i] + plane[3];
+            visible = visible && distance > -spheres.radius()[i];
+        }
+        inside[i - first] = visible ? 1 : 0;
+    }
+}
+
+#ifdef VULKAN_QT_X86_KERNELS
+__attribute__((target("sse2"))) std::size_t SseKernel(
+    const Frustum& frustum, const BoundingSpheres& spheres, std::size_t begin,
+    std::size_t end, std::uint8_t* inside)
+{
+    const std::size_t block_end = end - (end - begin) % 4;
+    for (std::size_t i = begin; i < block_end; i += 4)
+    {
+        const __m128 x = _mm_loadu_ps(spheres.x() + i);
+        const __m128 y = _mm_loadu_ps(spheres.y() + i);
+        const __m128 z = _mm_loadu_ps(spheres.z() + i);
+        const __m128 negative_radius =
+            _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(spheres.radius() + i));
+        __m128 mask = _mm_castsi128_ps(_mm_set1_epi32(-1));
+        for (const float* plane : frustum.planes)
+        {
+            const __m128 distance = _mm_add_ps(
+                _mm_add_ps(_mm_mul_ps(_mm_set1_ps(plane[0]), x),
+                           _mm_mul_ps(_mm_set1_ps(plane[1]), y)),
+                _mm_add_ps(_mm_mul_ps(_mm_set1_ps(plane[2]), z),
+                           _mm_set1_ps(plane[3])));
+            mask = _mm_and_ps(mask, _mm_cmpgt_ps(distance, negative_radius));
+        }
+        const int bits = _mm_movemask_ps(mask);
+        for (int lane = 0; lane < 4; ++lane)
+            inside[i - begin + lane] = (bits >> lane) & 1;
+    }
+    return block_end;
+}
+
+__attribute__((target("avx2,fma"))) std::size_t Avx2Kernel(
+    const Frustum& frustum, const BoundingSpheres& spheres, std::size_t begin,
+    std::size_t end, std::uint8_t* inside)
+{
+    const std::size_t block_end = end - (end - begin) % 8;
+    for (std::size_t i = begin; i < block_end; i += 8)
+    {
+        const __m256 x = _mm256_loadu_ps(spheres.x() + i);
+        const __m256 y = _mm256_loadu_ps(spheres.y() + i);
+        const __m256 z = _mm256_loadu_ps(spheres.z() + i);
+        const __m256 negative_radius = _mm256_sub_ps(
+            _mm256_setzero_ps(), _mm256_loadu_ps(spheres.radius() + i));
+        __m256 mask = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+        for (const float* plane : frustum.planes)
+        {
+            __m256 distance = _mm256_fmadd_ps(_mm256_set1_ps(plane[0]), x,
+                                              _mm256_set1_ps(plane[3]));
+            distance =
+                _mm256_fmadd_ps(_mm256_set1_ps(plane[1]), y, distance);
+            distance =
+                _mm256_fmadd_ps(_mm256_set1_ps(plane[2]), z, distance);
+            mask = _mm256_and_ps(
+                mask, _mm256_cmp_ps(distance, negative_radius, _CMP_GT_OQ));
+        }
+        const int bits = _mm256_movemask_ps(mask);
+        for (int lane = 0; lane < 8; ++lane)
+            inside[i - begin + lane] = (bits >> lane) & 1;
+    }
+    return block_end;
+}
+#endif  // VULKAN_QT_X86_KERNELS
+
+// Projected diameter in pixels of a sphere at view-projection w = w, for a
+// projection whose second row has length row1_length.
+float ProjectedPixels(float radius, float w, float row1_length,
+                      float viewport_height)
+{
+    // the camera is inside the sphere, or close enough to count as such
+    if (w <= radius) return INFINITY;
+    return radius * row1_length * viewport_height / w;
+}
+
+std::uint32_t SelectLod(float pixels, const std::vector<float>& lod_pixels)
+{
+    std::uint32_t lod{0};
+    while (lod < lod_pixels.size() && pixels < lod_pixels[lod]) ++lod;
+    return lod;
+}
+
+float RowLength(const glm::mat4& matrix, int row)
+{
+    return std::sqrt(matrix[0][row] * matrix[0][row] +
+                     matrix[1][row] * matrix[1][row] +
+                     matrix[2][row] * matrix[2][row]);
+}
+
+float ProjectedPixels(const glm::mat4& view_projection, float row1_length,
+                      const CullSettings& settings,
+                      const BoundingSpheres& spheres, std::size_t i)
+{
+    const float w = view_projection[0][3] * spheres.x()[i] +
+                    view_projection[1][3] * spheres.y()[i] +
+                    view_projection[2][3] * spheres.z()[i] +
+                    view_projection[3][3];
+    return ProjectedPixels(spheres.radius()[i], w, row1_length,
+                           settings.viewport_height);
+}
+
+// Whether rounding could change the result for sphere i: it touches a plane
+// or its projected size is at a LOD or culling threshold, within tolerance.
+bool IsBorderline(const Frustum& frustum, const glm::mat4& view_projection,
+                  float row1_length, const CullSettings& settings,
+                  const BoundingSpheres& spheres, std::size_t i,
+                  float tolerance)
+{
+    const float radius = spheres.radius()[i];
+    for (const float* plane : frustum.planes)
+    {
+        const float distance = plane[0] * spheres.x()[i] +
+                               plane[1] * spheres.y()[i] +
+                               plane[2] * spheres.z()[i] + plane[3];
+        if (std::abs(distance + radius) <= tolerance * radius) return true;
+    }
+    const float pixels =
+        ProjectedPixels(view_projection, row1_length, settings, spheres, i);
+    const auto near = [&](float threshold) {
+        return std::abs(pixels - threshold) <= tolerance * threshold;
+    };
+    if (near(settings.min_pixels)) return true;
+    return std::any_of(settings.lod_pixels.begin(), settings.lod_pixels.end(),
+                       near);
+}
+}  // namespace
+
+void BoundingSpheres::Resize(std::size_t size)
+{
+    x_.resize(size);
+    y_.resize(size);
+    z_.resize(size);
+    radius_.resize(size);
+}
+
+void BoundingSpheres::Set(std::size_t index, float x, float y, float z,
+                          float radius)
+{
+    x_[index] = x;
+    y_[index] = y;
+    z_[index] = z;
+    radius_[index] = radius;
+}
+
+Frustum ExtractFrustum(const glm::mat4& view_projection)
+{
+    // rows of the matrix, glm indexes [column][row]
+    float rows[4][4];
+    for (int row = 0; row < 4; ++row)
+    {
+        for (int column = 0; column < 4; ++column)
+            rows[row][column] = view_projection[column][row];
+    }
+
+    // -w <= x, y, z <= w in clip space. Vulkan clips at z = 0 rather than
+    // -w, but glm's default projections map depth to [-1, 1]; the wider near
+    // plane is right for those and only conservative for the others.
+    Frustum frustum;
+    for (int k = 0; k < 4; ++k)
+    {
+        frustum.planes[Frustum::kLeft][k] = rows[3][k] + rows[0][k];
+        frustum.planes[Frustum::kRight][k] = rows[3][k] - rows[0][k];
+        frustum.planes[Frustum::kBottom][k] = rows[3][k] + rows[1][k];
+        frustum.planes[Frustum::kTop][k] = rows[3][k] - rows[1][k];
+        frustum.planes[Frustum::kNear][k] = rows[3][k] + rows[2][k];
+        frustum.planes[Frustum::kFar][k] = rows[3][k] - rows[2][k];
+    }
+    for (float* plane : frustum.planes)
+    {
+        const float length = std::sqrt(plane[0] * plane[0] +
+                                       plane[1] * plane[1] +
+                                       plane[2] * plane[2]);
+        if (length == 0.0f) continue;
+        for (int k = 0; k < 4; ++k) plane[k] /= length;
+    }
+    return frustum;
+}
+
+VisibilityCuller::VisibilityCuller()
+    : worker_pool_{nullptr}, simd_level_{DetectSimdLevel()}
+{
+}
+
+void VisibilityCuller::Cull(const glm::mat4& view_projection,
+                            const CullSettings& settings,
+                            const BoundingSpheres& spheres,
+                            std::vector<VisibleObject>* visible)
+{
+    Cull(view_projection, settings, spheres, visible, simd_level_);
+}
+
+void VisibilityCuller::Cull(const glm::mat4& view_projection,
+                            const CullSettings& settings,
+                            const BoundingSpheres& spheres,
+                            std::vector<VisibleObject>* visible,
+                            SimdLevel level)
+{
+    visible->clear();
+    const std::size_t count = spheres.size();
+    if (count == 0) return;
+
+    const Frustum frustum = ExtractFrustum(view_projection);
+    const float row1_length = RowLength(view_projection, 1);
+    level = std::min(level, DetectSimdLevel());
+
+    const int chunk_count =
+        static_cast<int>((count + chunk_size - 1) / chunk_size);
+    if (chunk_visible_.size() < static_cast<std::size_t>(chunk_count))
+        chunk_visible_.resize(chunk_count);
+
+    const auto cull_chunk = [&](int chunk) {
+        const std::size_t begin = chunk * chunk_size;
+        const std::size_t end = std::min(count, begin + chunk_size);
+        std::uint8_t inside[chunk_size];
+        std::size_t done{begin};
+#ifdef VULKAN_QT_X86_KERNELS
+        if (level == SimdLevel::kAvx2)
+            done = Avx2Kernel(frustum, spheres, begin, end, inside);
+        else if (level == SimdLevel::kSse)
+            done = SseKernel(frustum, spheres, begin, end, inside);
+#endif
+        ScalarKernel(frustum, spheres, begin, done, end, inside);
+
+        std::vector<VisibleObject>& output = chunk_visible_[chunk];
+        output.clear();
+        for (std::size_t i = begin; i < end; ++i)
+        {
+            if (!inside[i - begin]) continue;
+            const float pixels = ProjectedPixels(view_projection, row1_length,
+                                                 settings, spheres, i);
+            if (pixels < settings.min_pixels) continue;
+            output.push_back({static_cast<std::uint32_t>(i),
+                              SelectLod(pixels, settings.lod_pixels)});
+        }
+    };
+
+    if (worker_pool_ && chunk_count > 1)
+    {
+        worker_pool_->ParallelFor(chunk_count, cull_chunk);
+    }
+    else
+    {
+        for (int chunk = 0; chunk < chunk_count; ++chunk) cull_chunk(chunk);
+    }
+
+    for (int chunk = 0; chunk < chunk_count; ++chunk)
+    {
+        visible->insert(visible->end(), chunk_visible_[chunk].begin(),
+                        chunk_visible_[chunk].end());
+    }
+}
+
+std::size_t CountVisibilityMismatches(const glm::mat4& view_projection,
+                                      const CullSettings& settings,
+                                      const BoundingSpheres& spheres,
+                                      const std::vector<VisibleObject>& a,
+                                      const std::vector<VisibleObject>& b,
+                                      float tolerance)
+{
+    const Frustum frustum = ExtractFrustum(view_projection);
+    const float row1_length = RowLength(view_projection, 1);
+    const auto counts = [&](std::uint32_t index) {
+        return !IsBorderline(frustum, view_projection, row1_length, settings,
+                             spheres, index, tolerance);
+    };
+
+    std::size_t mismatches{0};
+    auto it_a = a.begin();
+    auto it_b = b.begin();
+    while (it_a != a.end() || it_b != b.end())
+    {
+        if (it_b == b.end() || (it_a != a.end() && it_a->index < it_b->index))
+        {
+            mismatches += counts(it_a->index);
+            ++it_a;
+        }
+        else if (it_a == a.end() || it_b->index < it_a->index)
+        {
+            mismatches += counts(it_b->index);
+            ++it_b;
+        }
+        else
+        {
+            if (it_a->lod != it_b->lod) mismatches += counts(it_a->index);
+            ++it_a;
+            ++it_b;
+        }
+    }
+    return mismatches;
+}
@@ -1,36 +1,588 @@
 #include "vulkan_application.h"
 
+#include <QtCore/QElapsedTimer>
 #include <QtCore/QFile>
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
 #include <cstring>
-#include <glm/ext/matrix_transform.hpp>
+#include <fstream>
 #include <glm/gtc/type_ptr.hpp>
 #include <glm/mat4x4.hpp>
 
-// clang-format off
-// vertex data as (x, y, r, g, b) tuples
-constexpr float vertex_data[] = { // Y down, front = CCW
-     0.0f,   0.5f,   1.0f, 0.0f, 0.0f,
-    -0.5f,  -0.5f,   0.0f, 1.0f, 0.0f,
-     0.5f,  -0.5f,   0.0f, 0.0f, 1.0f
-};
-// clang-format on
+#include "frame_writer.h"
+#include "geometry.h"
+#include "offscreen_render_target.h"
+#include "vulkan_utils.h"
 
-constexpr std::size_t vertex_data_size{15 * sizeof(float)};
 constexpr std::size_t uniform_data_size{16 * sizeof(float)};
+constexpr VkDeviceSize staging_ring_size{16 * 1024 * 1024};
+// Each LOD of the generated mesh halves the subdivisions of the previous one.
+// An instance switches to LOD i + 1 once its projected diameter drops below
+// lod_pixels[i].
+constexpr std::size_t max_lod_count{4};
+constexpr float lod_pixels[max_lod_count - 1] = {256.0f, 64.0f, 16.0f};
+// Push constants of shader.vert. Draws without a material of their own take
+// the one of their instance. The position dequantization follows at the
+// 16-byte alignment of a vec4.
+struct DrawConstants
+{
+    std::uint32_t material;
+    std::uint32_t instances_per_material;
+    std::uint32_t padding[2];
+    float position_offset[4];
+    float position_scale[4];
+};
+constexpr std::uint32_t material_from_instance{UINT32_MAX};
+// Slots of the resource table. The bindless table has room for textures
+// added later, the fallback allocates one set per texture up front.
+constexpr std::uint32_t resource_table_buffers{4};
+constexpr std::uint32_t bindless_texture_capacity{4096};
+// Camera input: radians per pixel of mouse drag, and the longest step a fly
+// camera takes at once, e.g. for the first frame after a long idle time.
+constexpr float camera_radians_per_pixel{0.005f};
+constexpr double max_camera_step_ms{100.0};
+// --orbit-every turns the camera by this much at a time.
+constexpr float orbit_step_radians{0.01f};
+// Frames a window's --output may queue for the writer before it drops them.
+constexpr int max_queued_capture_frames{8};
+// Frames left out of a --benchmark-json report, they also time the
+// warm-up of caches and the driver.
+constexpr std::int64_t benchmark_warmup_frames{10};
+
+int VulkanApplication::Run()
+{
+    return options_.headless ? RunHeadless() : exec();
+}
+
+int VulkanApplication::RunHeadless()
+{
+    OffscreenRenderTarget target(&vulkan_instance_, options_.size,
+                                 options_.frames_in_flight,
+                                 options_.timeline_semaphore,
+                                 options_.transfer_queue);
+    if (!target.Create()) return 1;
+
+    std::unique_ptr<FrameWriter> writer;
+    if (!options_.output_directory.isEmpty())
+    {
+        writer = std::make_unique<FrameWriter>(
+            options_.output_directory, options_.output_format,
+            2 * target.concurrentFrameCount());
+        target.SetFrameCallback([&writer](int index, QImage image) {
+            writer->Write(index, std::move(image));
+        });
+    }
+
+    // Same call sequence as QVulkanWindow, minus the swap chain.
+    VulkanRenderer renderer(target, options_);
+    renderer.initResources();
+    renderer.initSwapChainResources();
+    // every frame should show the scene, not the fallback
+    renderer.WaitForPipelines();
+
+    QElapsedTimer timer;
+    timer.start();
+    for (int frame = 0; frame < options_.frames; ++frame)
+    {
+        target.BeginFrame();
+        renderer.startNextFrame();
+    }
+    target.Finish();
+    const double elapsed_ms = timer.nsecsElapsed() / 1e6;
+    qDebug("rendered %d frames of %dx%d in %.3f ms (%.1f fps)",
+           options_.frames, options_.size.width(), options_.size.height(),
+           elapsed_ms, options_.frames / (elapsed_ms / 1e3));
+
+    renderer.releaseSwapChainResources();
+    renderer.releaseResources();
+    writer.reset();  // flush the remaining frames to disk
+    target.Release();
+    return renderer.verification_failed() ? 1 : 0;
+}
+
+void VulkanRenderer::initResources()
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    // get device functions
+    const auto& device = target_.device();
+    const auto& vulkan_instance = target_.vulkanInstance();
+    device_functions_ = vulkan_instance->deviceFunctions(device);
+
+    vulkan_instance->functions()->vkGetPhysicalDeviceMemoryProperties(
+        target_.physicalDevice(), &memory_properties_);
+    memory_allocator_.Create(device_functions_, device,
+                             *target_.physicalDeviceProperties(),
+                             memory_properties_);
+
+    profiler_.Create(vulkan_instance->functions(), device_functions_,
+                     target_.physicalDevice(), device,
+                     *target_.physicalDeviceProperties(),
+                     target_.concurrentFrameCount(), options_.profile,
+                     options_.profile_path);
+    CreateBenchmarkReport();
+    CreatePipelineCache(device);
+    pipeline_manager_.Create(device_functions_, device, pipeline_cache_,
+                             options_.pipeline_threads);
+    CreateUniformBuffer(device);
+    CreateGeometry(device);
+    CreateMaterialTable(device);
+    CreateInstanceBuffer(device);
+    CreateGpuCulling(device);
+    CreateParticles(device);
+    memory_allocator_.LogStats("device memory");
+    CreateRecordingResources(device);
+    const auto vertex_input_info = CreateVertexInputs(device);
+    RequestGraphicsPipelines(device, vertex_input_info);
+    if (!options_.headless && !options_.output_directory.isEmpty())
+    {
+        // the y4m header wants a rate, the window's is only known as a cap
+        capture_writer_ = std::make_unique<FrameWriter>(
+            options_.output_directory, options_.output_format,
+            max_queued_capture_frames,
+            options_.max_fps > 0.0 ? static_cast<int>(options_.max_fps) : 60);
+    }
+
+    if (options_.log_usage)
+    {
+        usage_cpu_start_ = std::clock();
+        usage_wall_start_ns_ = redraw_clock_.nsecsElapsed();
+        usage_frames_start_ = redraw_.frame_count();
+        usage_timer_.start(5000);
+    }
+    qDebug("redraw: %s, max %.0f fps, %.0f idle fps",
+           options_.redraw == RedrawMode::kOnDemand ? "on demand"
+                                                    : "continuous",
+           options_.max_fps, options_.idle_fps);
+
+    // Startup metric: compare a cold run (no or stale cache file) against a
+    // warm one to see what the persisted pipeline cache saves. Pipelines
+    // compile in the background, their latencies are logged separately.
+    qDebug("initResources took %.3f ms (%s pipeline cache)",
+           timer.nsecsElapsed() / 1e6, pipeline_cache_warm_ ? "warm" : "cold");
+}
+
+void VulkanRenderer::releaseResources()
+{
+    const auto& device = target_.device();
+    redraw_timer_.stop();
+    usage_timer_.stop();
+    // all frames have to be complete to read their last timestamps
+    device_functions_->vkDeviceWaitIdle(device);
+    AddBenchmarkMemoryUsage();
+    if (benchmark_report_ && capture_writer_)
+    {
+        benchmark_report_->SetMetric(
+            "capture_dropped_frames",
+            static_cast<std::uint64_t>(capture_writer_->dropped()));
+    }
+    profiler_.Release();
+    WriteBenchmarkReport();
+    capture_writer_.reset();  // writes the queued frames
+    gpu_culler_.Release();
+    particles_.Release();
+    // everything compiled by now ends up in the saved cache
+    pipeline_manager_.Release();
+    frame_pipeline_ = VK_NULL_HANDLE;
+    particle_pipeline_ = -1;
+    SavePipelineCache(device);
+    uploader_.Release();
+    transfer_uploader_.Release();
+    transfer_streaming_ = false;
+    stream_batches_.clear();
+    stream_wait_value_ = 0;
+    ReleaseRecordingResources(device);
+
+    if (pipeline_layout_)
+    {
+        device_functions_->vkDestroyPipelineLayout(device, pipeline_layout_,
+                                                   nullptr);
+        pipeline_layout_ = VK_NULL_HANDLE;
+    }
+    if (pipeline_cache_)
+    {
+        device_functions_->vkDestroyPipelineCache(device, pipeline_cache_,
+                                                  nullptr);
+        pipeline_cache_ = VK_NULL_HANDLE;
+    }
+    if (descriptor_set_layout_)
+    {
+        device_functions_->vkDestroyDescriptorSetLayout(
+            device, descriptor_set_layout_, nullptr);
+        descriptor_set_layout_ = VK_NULL_HANDLE;
+    }
+    if (descriptor_pool_)
+    {
+        device_functions_->vkDestroyDescriptorPool(device, descriptor_pool_,
+                                                   nullptr);
+        descriptor_pool_ = VK_NULL_HANDLE;
+    }
+    uniform_arena_.Release();
+    instance_ring_.Release();
+    ReleaseMaterialTable(device);
+    memory_allocator_.DestroyBuffer(&vertex_buffer_, &vertex_memory_);
+    memory_allocator_.DestroyBuffer(&index_buffer_, &index_memory_);
+    memory_allocator_.Release();
+    lods_.clear();
+}
+
+void VulkanRenderer::startNextFrame()
+{
+    const auto command_buffer = target_.currentCommandBuffer();
+    const int frame = target_.currentFrame();
+    // QVulkanWindow has waited for the slot's fence, its capture is done
+    capture_.Collect(frame);
+    frame_pipeline_ = pipeline_manager_.Get(scene_pipeline_);
+    if (!frame_pipeline_)
+        frame_pipeline_ = pipeline_manager_.Get(fallback_pipeline_);
+    UpdateCamera();
+    profiler_.BeginFrame(frame);
+    CullInstances(command_buffer, frame);
+    {
+        FrameProfiler::ScopedTimer record_timer(
+            &profiler_, FrameProfiler::Section::kRecord);
+        if (particles_.enabled()) particles_.Record(command_buffer, frame);
+        StreamGeometry();
+        UpdateUniforms(frame);
+        UpdateInstances(frame);
+        const auto render_pass_info = GetRenderPassBeginInfo();
+        // start the GPU timing after the compute dispatches
+        profiler_.BeginRenderPass(command_buffer, frame);
+
+        // draw all instances of the static geometry
+        if (!worker_pool_)
+        {
+            device_functions_->vkCmdBeginRenderPass(
+                command_buffer, &render_pass_info, VK_SUBPASS_CONTENTS_INLINE);
+            RecordDraws(command_buffer, frame, 0, draws_.size());
+        }
+        else
+        {
+            const std::vector<VkCommandBuffer> secondaries =
+                RecordSecondaries(frame);
+            device_functions_->vkCmdBeginRenderPass(
+                command_buffer, &render_pass_info,
+                VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+            if (!secondaries.empty())
+            {
+                device_functions_->vkCmdExecuteCommands(
+                    command_buffer,
+                    static_cast<std::uint32_t>(secondaries.size()),
+                    secondaries.data());
+            }
+        }
+
+        // end render pass
+        device_functions_->vkCmdEndRenderPass(command_buffer);
+        profiler_.EndFrame(command_buffer, frame);
+        if (capture_.enabled())
+        {
+            capture_.Record(command_buffer, frame, target_.currentColorImage(),
+                            target_.colorImageLayout());
+        }
+    }
+    {
+        FrameProfiler::ScopedTimer submit_timer(
+            &profiler_, FrameProfiler::Section::kSubmit);
+        if (stream_wait_value_ > 0 && transfer_streaming_)
+        {
+            target_.addFrameWait({transfer_uploader_.timeline(),
+                                  stream_wait_value_,
+                                  VK_PIPELINE_STAGE_VERTEX_INPUT_BIT});
+        }
+        target_.frameReady();
+    }
+    // a mesh that streams in, pipelines that are still compiling or a
+    // moving camera change the picture without anyone asking for it
+    redraw_.SetAnimating(mesh_streamer_.is_open() ||
+                         !stream_batches_.empty() || particles_.enabled() ||
+                         !pipeline_manager_.idle() || camera_.moving() ||
+                         options_.orbit_every > 0);
+    redraw_.FrameRendered(redraw_clock_.nsecsElapsed() / 1e6);
+    ScheduleNextFrame();
+}
+
+bool VulkanRenderer::verification_failed() const
+{
+    bool failed = gpu_culler_.mismatched_frames() > 0 ||
+                  particles_.mismatched_steps() > 0;
+    if (options_.verify_gpu_culling && gpu_culler_.verified_frames() == 0)
+    {
+        qWarning("--verify-gpu-culling did not verify any frame");
+        failed = true;
+    }
+    if (options_.verify_particles && particles_.verified_steps() == 0)
+    {
+        qWarning("--verify-particles did not verify any step");
+        failed = true;
+    }
+    return failed;
+}
+
+void VulkanRenderer::UpdateCamera()
+{
+    const double now_ms = redraw_clock_.nsecsElapsed() / 1e6;
+    const double step_ms = std::min(now_ms - camera_time_ms_,
+                                    max_camera_step_ms);
+    camera_time_ms_ = now_ms;
+    camera_.Advance(static_cast<float>(step_ms / 1e3));
+    if (options_.orbit_every > 0 && ++orbit_frame_ >= options_.orbit_every)
+    {
+        orbit_frame_ = 0;
+        camera_.Rotate(orbit_step_radians, 0.0f);
+    }
+    if (!camera_.Update()) return;
+
+    // like SetModelViewProjection, but this frame is already being drawn
+    mvp_ = camera_.view_projection();
+}
+
+void VulkanRenderer::CreateBenchmarkReport()
+{
+    if (options_.benchmark_json.isEmpty()) return;
+    benchmark_report_ =
+        std::make_unique<BenchmarkReport>(benchmark_warmup_frames);
+    profiler_.SetReportSink(benchmark_report_.get());
+
+    // what the scene is made of, and where it ran
+    const auto set = [this](const char* name, const QString& value) {
+        benchmark_report_->SetParameter(name, value.toStdString());
+    };
+    const auto flag = [](bool value) {
+        return QString(value ? "true" : "false");
+    };
+    set("device", QString::fromUtf8(
+                      target_.physicalDeviceProperties()->deviceName));
+    set("size", options_.headless ? QStringLiteral("%1x%2")
+                                        .arg(options_.size.width())
+                                        .arg(options_.size.height())
+                                  : QStringLiteral("window"));
+    set("frames", QString::number(options_.frames));
+    set("mesh", options_.mesh_path.isEmpty()
+                    ? QStringLiteral("grid %1").arg(options_.mesh_subdivisions)
+                    : options_.mesh_path);
+    set("quantized_vertices", flag(options_.quantized_vertices));
+    set("instances", QString::number(options_.instances));
+    set("instancing", flag(options_.instancing));
+    set("materials", QString::number(options_.materials));
+    set("culling", options_.gpu_culling ? QStringLiteral("gpu")
+                                        : flag(options_.culling));
+    set("workers", QString::number(options_.workers));
+    set("particles", QString::number(options_.particles));
+    set("orbit_every", QString::number(options_.orbit_every));
+}
+
+void VulkanRenderer::AddBenchmarkMemoryUsage()
+{
+    if (!benchmark_report_) return;
+    const MemoryStats stats = memory_allocator_.Stats();
+    benchmark_report_->SetMetric("device_block_bytes", stats.block_bytes);
+    benchmark_report_->SetMetric("device_dedicated_bytes",
+                                 stats.dedicated_bytes);
+    benchmark_report_->SetMetric("device_used_bytes", stats.used_bytes);
+    benchmark_report_->SetMetric(
+        "device_allocations",
+        static_cast<std::uint64_t>(stats.allocation_count +
+                                   stats.dedicated_count));
+    // host-visible memory that is not sub-allocated
+    const auto ring_bytes = [](const MappedRingBuffer& ring) {
+        return static_cast<std::uint64_t>(ring.slot_stride() *
+                                          ring.slot_count());
+    };
+    benchmark_report_->SetMetric(
+        "host_ring_bytes",
+        ring_bytes(instance_ring_) +
+            static_cast<std::uint64_t>(uploader_.ring_size() +
+                                       transfer_uploader_.ring_size()));
+}
+
+void VulkanRenderer::WriteBenchmarkReport()
+{
+    if (!benchmark_report_) return;
+    std::ofstream file(options_.benchmark_json.toStdString());
+    benchmark_report_->Write(&file);
+    if (!file)
+    {
+        qWarning("Failed to write %s", qPrintable(options_.benchmark_json));
+    }
+    else
+    {
+        qDebug("benchmark report of %zu frames written to %s",
+               benchmark_report_->frame_count(),
+               qPrintable(options_.benchmark_json));
+    }
+    benchmark_report_.reset();
+}
+
+void VulkanRenderer::RequestRedraw()
+{
+    redraw_.Invalidate();
+    ScheduleNextFrame();
+}
+
+void VulkanRenderer::ScheduleNextFrame()
+{
+    const double delay_ms =
+        redraw_.NextFrameDelay(redraw_clock_.nsecsElapsed() / 1e6);
+    if (delay_ms < 0.0)
+    {
+        redraw_timer_.stop();
+    }
+    else if (delay_ms == 0.0)
+    {
+        redraw_timer_.stop();
+        target_.requestUpdate();
+    }
+    else
+    {
+        // QTimer rounds to whole milliseconds, so round up to not exceed
+        // --max-fps
+        redraw_timer_.start(static_cast<int>(std::ceil(delay_ms)));
+    }
+}
+
+void VulkanRenderer::LogUsage()
+{
+    const qint64 wall_ns = redraw_clock_.nsecsElapsed();
+    const std::clock_t cpu = std::clock();
+    const double seconds = (wall_ns - usage_wall_start_ns_) / 1e9;
+    const double cpu_seconds =
+        static_cast<double>(cpu - usage_cpu_start_) / CLOCKS_PER_SEC;
+    const double fps = (redraw_.frame_count() - usage_frames_start_) / seconds;
+    // The GPU load is estimated from the median render pass time, which is
+    // only measured with --profile.
+    const RollingPercentiles& gpu_times = profiler_.gpu_times();
+    if (gpu_times.size() > 0)
+    {
+        qDebug("usage: %.1f frames/s, CPU %.1f%% of a core, GPU %.1f%%", fps,
+               100.0 * cpu_seconds / seconds,
+               fps * gpu_times.Percentile(50.0) / 10.0);
+    }
+    else
+    {
+        qDebug("usage: %.1f frames/s, CPU %.1f%% of a core", fps,
+               100.0 * cpu_seconds / seconds);
+    }
+    if (capture_writer_)
+        qDebug("capture: %d frame(s) dropped", capture_writer_->dropped());
+    usage_cpu_start_ = cpu;
+    usage_wall_start_ns_ = wall_ns;
+    usage_frames_start_ = redraw_.frame_count();
+}
+
+void VulkanWindow::mousePressEvent(QMouseEvent* event)
+{
+    last_mouse_position_ = event->pos();
+}
+
+void VulkanWindow::mouseMoveEvent(QMouseEvent* event)
+{
+    const QPoint delta = event->pos() - last_mouse_position_;
+    last_mouse_position_ = event->pos();
+    if (!renderer_ || !(event->buttons() & Qt::LeftButton)) return;
+    renderer_->camera().Rotate(-delta.x() * camera_radians_per_pixel,
+                               -delta.y() * camera_radians_per_pixel);
+    renderer_->RequestRedraw();
+}
+
+void VulkanWindow::wheelEvent(QWheelEvent* event)
+{
+    if (!renderer_) return;
+    // one step per notch, 120 units
+    renderer_->camera().Zoom(event->angleDelta().y() / 120.0f);
+    renderer_->RequestRedraw();
+}
+
+void VulkanWindow::keyPressEvent(QKeyEvent* event)
+{
+    if (event->key() == Qt::Key_Escape)
+    {
+        close();
+        return;
+    }
+    if (!renderer_ || event->isAutoRepeat()) return;
+    Camera& camera = renderer_->camera();
+    if (event->key() == Qt::Key_Tab)
+    {
+        camera.SetMode(camera.mode() == CameraMode::kOrbit
+                           ? CameraMode::kFly
+                           : CameraMode::kOrbit);
+        UpdateMoveDirection();
+    }
+    else if (event->key() == Qt::Key_R)
+    {
+        camera.Reset();
+    }
+    else if (MoveKey(event->key()))
+    {
+        move_keys_ |= MoveKey(event->key());
+        UpdateMoveDirection();
+    }
+    else
+    {
+        return;
+    }
+    renderer_->RequestRedraw();
+}
+
+void VulkanWindow::keyReleaseEvent(QKeyEvent* event)
+{
+    if (!renderer_ || event->isAutoRepeat() || !MoveKey(event->key())) return;
+    move_keys_ &= ~MoveKey(event->key());
+    UpdateMoveDirection();
+    // the frame that sees the camera stop
+    renderer_->RequestRedraw();
+}
+
+int VulkanWindow::MoveKey(int key)
+{
+    switch (key)
+    {
+        case Qt::Key_D:
+            return 1;
+        case Qt::Key_A:
+            return 2;
+        case Qt::Key_E:
+            return 4;
+        case Qt::Key_Q:
+            return 8;
+        case Qt::Key_W:
+            return 16;
+        case Qt::Key_S:
+            return 32;
+        default:
+            return 0;
+    }
+}
+
+void VulkanWindow::UpdateMoveDirection()
+{
+    // pairs of bits: positive and negative right, up and forward
+    float direction[3];
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        direction[axis] = ((move_keys_ >> (2 * axis)) & 1) -
+                          ((move_keys_ >> (2 * axis + 1)) & 1);
+    }
+    renderer_->camera().SetMoveDirection(direction[0], direction[1],
+                                         direction[2]);
+}
 
 VkRenderPassBeginInfo VulkanRenderer::GetRenderPassBeginInfo()
 {
     VkRenderPassBeginInfo render_pass_info{};
     render_pass_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-    render_pass_info.renderPass = window_.defaultRenderPass();
-    render_pass_info.framebuffer = window_.currentFramebuffer();
+    render_pass_info.renderPass = target_.defaultRenderPass();
+    render_pass_info.framebuffer = target_.currentFramebuffer();
 
-    const QSize size = window_.swapChainImageSize();
+    const QSize size = target_.swapChainImageSize();
     render_pass_info.renderArea.extent.width = size.width();
     render_pass_info.renderArea.extent.height = size.height();
 
-    render_pass_info.clearValueCount = 1;
-    render_pass_info.pClearValues = &clear_values_;
+    render_pass_info.clearValueCount = 2;
+    render_pass_info.pClearValues = clear_values_;
 
     return render_pass_info;
 }
@@ -38,7 +590,7 @@ VkRenderPassBeginInfo VulkanRenderer::GetRenderPassBeginInfo()
 std::pair<VkViewport, VkRect2D> VulkanRenderer::GetViewportAndScissor()
 {
     VkViewport viewport{};
-    const QSize size = window_.swapChainImageSize();
+    const QSize size = target_.swapChainImageSize();
     viewport.x = viewport.y = 0;
     viewport.width = size.width();
     viewport.height = size.height();
@@ -53,93 +605,770 @@ std::pair<VkViewport, VkRect2D> VulkanRenderer::GetViewportAndScissor()
     return std::make_pair(viewport, scissor);
 }
 
-void VulkanRenderer::CreateMemoryBuffer(const VkDevice &device)
+void VulkanRenderer::CreateUniformBuffer(const VkDevice &device)
 {
-    // init buffer
-    const int concurrent_frames = window_.concurrentFrameCount();
+    // One region per concurrent frame, started over when the frame comes
+    // around again. A single descriptor set covers all of them, the
+    // uniforms are picked with a dynamic offset.
+    const int concurrent_frames = target_.concurrentFrameCount();
     qDebug("concurrent frames: %d", concurrent_frames);
-    const VkPhysicalDeviceLimits device_limits =
-        window_.physicalDeviceProperties()->limits;
-    const VkDeviceSize uniform_align =
-        device_limits.minUniformBufferOffsetAlignment;
-    VkBufferCreateInfo buffer_info{};
-    buffer_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-    const VkDeviceSize vertex_alloc_size =
-        aligned(vertex_data_size, uniform_align);
-    const VkDeviceSize uniform_alloc_size =
-        aligned(uniform_data_size, uniform_align);
-    buffer_info.size =
-        vertex_alloc_size + concurrent_frames * uniform_alloc_size;
-    qDebug("using a buffer of size: %lu bytes", buffer_info.size);
-    buffer_info.usage =
-        VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT;
-    auto err = device_functions_->vkCreateBuffer(device, &buffer_info, nullptr,
-                                                 &buffer_);
-    if (err != VK_SUCCESS) qFatal("Failed to create buffer: %d", err);
-
-    // allocate the memory
-    VkMemoryRequirements memory_requirements{};
-    device_functions_->vkGetBufferMemoryRequirements(device, buffer_,
-                                                     &memory_requirements);
-
-    VkMemoryAllocateInfo allocate_info = {
-        VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO, nullptr,
-        memory_requirements.size, window_.hostVisibleMemoryIndex()};
-
-    err = device_functions_->vkAllocateMemory(device, &allocate_info, nullptr,
-                                              &device_memory_);
-    if (err != VK_SUCCESS) qFatal("Failed to allocate memory: %d", err);
-
-    err = device_functions_->vkBindBufferMemory(device, buffer_, device_memory_,
-                                                0);
-    if (err != VK_SUCCESS) qFatal("Failed to bind buffer memory: %d", err);
-
-    // initialize the memory by mapping it
-    quint8 *p{};
-    err = device_functions_->vkMapMemory(device, device_memory_, 0,
-                                         memory_requirements.size, 0,
-                                         reinterpret_cast<void **>(&p));
-    if (err != VK_SUCCESS) qFatal("Failed to map memory: %d", err);
-
-    // copy vertex data
-    std::memcpy(p, vertex_data, vertex_data_size);
-
-    // copy uniform for each frame
-    constexpr auto identity = glm::identity<glm::mat4>();
-    for (int i = 0; i < concurrent_frames; ++i)
-    {
-        const VkDeviceSize offset = vertex_alloc_size + i * uniform_alloc_size;
-        std::memcpy(p + offset, glm::value_ptr(identity), 16 * sizeof(float));
-        uniform_buffer_info_[i].buffer = buffer_;
-        uniform_buffer_info_[i].offset = offset;
-        uniform_buffer_info_[i].range = uniform_alloc_size;
-    }
-    device_functions_->vkUnmapMemory(device, device_memory_);
+    uniform_arena_.Create(&memory_allocator_,
+                          VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+                          target_.hostVisibleMemoryIndex(), uniform_data_size,
+                          concurrent_frames);
+    qDebug("using a uniform arena of %d x %llu bytes", concurrent_frames,
+           static_cast<unsigned long long>(uniform_data_size));
+
+    uniform_buffer_info_.buffer = uniform_arena_.buffer();
+    uniform_buffer_info_.offset = 0;
+    uniform_buffer_info_.range = uniform_data_size;
+}
+
+void VulkanRenderer::UpdateUniforms(int frame)
+{
+    // the frame's previous uniforms are done, its fence was waited for
+    uniform_arena_.BeginFrame(frame);
+    void* data{nullptr};
+    const VkDeviceSize offset =
+        uniform_arena_.Allocate(uniform_data_size, &data);
+    if (offset == invalid_offset) qFatal("The uniform arena is full");
+    std::memcpy(data, glm::value_ptr(mvp_), uniform_data_size);
+    uniform_arena_.Flush();
+    uniform_offset_ = static_cast<std::uint32_t>(offset);
+}
+
+void VulkanRenderer::SetModelViewProjection(const glm::mat4 &mvp)
+{
+    mvp_ = mvp;
+    RequestRedraw();
+}
+
+void VulkanRenderer::CreateMaterialTable(const VkDevice &device)
+{
+    const int texture_count =
+        std::min(options_.materials, max_material_textures);
+    materials_ = CreateMaterials(options_.materials, texture_count);
+    const bool bindless = target_.descriptorIndexingEnabled();
+    resource_table_.Create(
+        device_functions_, device, bindless, resource_table_buffers,
+        bindless ? bindless_texture_capacity
+                 : static_cast<std::uint32_t>(texture_count),
+        VK_SHADER_STAGE_FRAGMENT_BIT);
+
+    const VkDeviceSize material_bytes =
+        materials_.size() * sizeof(MaterialData);
+    CreateDeviceLocalBuffer(material_bytes, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                            &material_buffer_, &material_memory_);
+    uploader_.Upload(material_buffer_, 0, materials_.data(), material_bytes,
+                     VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                     VK_ACCESS_SHADER_READ_BIT);
+    resource_table_.AddBuffer(material_buffer_, 0, material_bytes);
+
+    VkSamplerCreateInfo sampler_info{};
+    sampler_info.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    sampler_info.magFilter = VK_FILTER_NEAREST;
+    sampler_info.minFilter = VK_FILTER_NEAREST;
+    sampler_info.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+    sampler_info.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+    sampler_info.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+    sampler_info.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+    sampler_info.maxLod = 0.0f;
+    auto err = device_functions_->vkCreateSampler(device, &sampler_info,
+                                                  nullptr, &texture_sampler_);
+    if (err != VK_SUCCESS) qFatal("Failed to create sampler: %d", err);
+
+    VkImageCreateInfo image_info{};
+    image_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    image_info.imageType = VK_IMAGE_TYPE_2D;
+    image_info.format = VK_FORMAT_R8G8B8A8_UNORM;
+    image_info.extent = {material_texture_size, material_texture_size, 1};
+    image_info.mipLevels = 1;
+    image_info.arrayLayers = 1;
+    image_info.samples = VK_SAMPLE_COUNT_1_BIT;
+    image_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+    image_info.usage =
+        VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+    image_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    VkImageViewCreateInfo view_info{};
+    view_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    view_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    view_info.format = image_info.format;
+    view_info.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+    textures_.resize(texture_count);
+    texture_memory_.resize(texture_count);
+    texture_views_.resize(texture_count);
+    for (int i = 0; i < texture_count; ++i)
+    {
+        memory_allocator_.CreateImage(image_info,
+                                      target_.deviceLocalMemoryIndex(),
+                                      VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                                      &textures_[i], &texture_memory_[i]);
+        const std::vector<std::uint8_t> texels = CreateMaterialTexture(i);
+        uploader_.UploadImage(textures_[i], material_texture_size,
+                              material_texture_size, texels.data(),
+                              texels.size());
+        view_info.image = textures_[i];
+        err = device_functions_->vkCreateImageView(device, &view_info, nullptr,
+                                                   &texture_views_[i]);
+        if (err != VK_SUCCESS) qFatal("Failed to create image view: %d", err);
+        resource_table_.AddTexture(texture_views_[i], texture_sampler_);
+    }
+    uploader_.Flush();
+    qDebug("%zu material(s), %d texture(s)", materials_.size(),
+           texture_count);
+}
+
+void VulkanRenderer::ReleaseMaterialTable(const VkDevice &device)
+{
+    resource_table_.Release();
+    for (VkImageView view : texture_views_)
+        device_functions_->vkDestroyImageView(device, view, nullptr);
+    texture_views_.clear();
+    for (std::size_t i = 0; i < textures_.size(); ++i)
+        memory_allocator_.DestroyImage(&textures_[i], &texture_memory_[i]);
+    textures_.clear();
+    texture_memory_.clear();
+    if (texture_sampler_)
+    {
+        device_functions_->vkDestroySampler(device, texture_sampler_, nullptr);
+        texture_sampler_ = VK_NULL_HANDLE;
+    }
+    memory_allocator_.DestroyBuffer(&material_buffer_, &material_memory_);
+    materials_.clear();
+}
+
+void VulkanRenderer::CreateInstanceBuffer(const VkDevice &device)
+{
+    instances_ = CreateInstanceGrid(options_.instances);
+    instances_per_material_ = InstancesPerMaterial(
+        static_cast<std::uint32_t>(instances_.size()),
+        static_cast<std::uint32_t>(materials_.size()));
+    const int concurrent_frames = target_.concurrentFrameCount();
+    const std::uint32_t memory_index = target_.hostVisibleMemoryIndex();
+    const VkMemoryPropertyFlags memory_flags =
+        memory_properties_.memoryTypes[memory_index].propertyFlags;
+    instance_ring_.Create(device_functions_, device,
+                          *target_.physicalDeviceProperties(), memory_index,
+                          memory_flags, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+                          instances_.size() * sizeof(InstanceData),
+                          concurrent_frames);
+    instance_dirty_frames_ = AllFramesMask();
+    UpdateInstanceBounds();
+
+    // Without culling the draw list never changes: everything at LOD 0, in
+    // one instanced draw or, to measure what instancing saves, in one draw
+    // per instance.
+    const auto instance_count = static_cast<std::uint32_t>(instances_.size());
+    visible_.clear();
+    for (std::uint32_t i = 0; i < instance_count; ++i)
+        visible_.push_back({i, 0});
+    BuildDraws();
+    cull_settings_.lod_pixels.assign(lod_pixels,
+                                     lod_pixels + (lods_.size() - 1));
+    if (options_.culling)
+    {
+        qDebug("culling %u instances on the CPU (%s), %zu LOD(s)",
+               instance_count, SimdLevelName(culler_.simd_level()),
+               lods_.size());
+    }
+    else
+    {
+        qDebug("drawing %u instances with %zu draw call(s) per frame",
+               instance_count, draws_.size());
+    }
+}
+
+void VulkanRenderer::UpdateInstances(int frame)
+{
+    const std::uint32_t frame_bit = 1u << frame;
+    if (!(instance_dirty_frames_ & frame_bit)) return;
+
+    const VkDeviceSize size = instances_.size() * sizeof(InstanceData);
+    std::memcpy(instance_ring_.Slot(frame), instances_.data(), size);
+    instance_ring_.Flush(frame, 0, size);
+    instance_dirty_frames_ &= ~frame_bit;
+}
+
+void VulkanRenderer::SetInstances(std::vector<InstanceData> instances)
+{
+    if (instances.size() != instances_.size())
+    {
+        qWarning("SetInstances: expected %zu instances, got %zu",
+                 instances_.size(), instances.size());
+        return;
+    }
+    instances_ = std::move(instances);
+    instance_dirty_frames_ = AllFramesMask();
+    UpdateInstanceBounds();
+    RequestRedraw();
+}
+
+void VulkanRenderer::UpdateInstanceBounds()
+{
+    instance_bounds_.Resize(instances_.size());
+    const float* center = mesh_bounds_.center;
+    for (std::size_t i = 0; i < instances_.size(); ++i)
+    {
+        const float* model = instances_[i].model;
+        float world[3];
+        float scale_squared{0.0f};
+        for (int k = 0; k < 3; ++k)
+        {
+            world[k] = model[k] * center[0] + model[4 + k] * center[1] +
+                       model[8 + k] * center[2] + model[12 + k];
+            // the longest axis bounds how far the sphere is stretched
+            const float* axis = model + 4 * k;
+            scale_squared = std::max(scale_squared, axis[0] * axis[0] +
+                                                        axis[1] * axis[1] +
+                                                        axis[2] * axis[2]);
+        }
+        instance_bounds_.Set(i, world[0], world[1], world[2],
+                             mesh_bounds_.radius * std::sqrt(scale_squared));
+    }
+    if (gpu_culler_.enabled()) gpu_culler_.SetBounds(instance_bounds_);
+}
+
+void VulkanRenderer::CreateGpuCulling(const VkDevice &device)
+{
+    if (!options_.gpu_culling) return;
+    const VkShaderModule shader =
+        CreateShader(QStringLiteral("shaders/cull.comp.spv"));
+    const bool created = gpu_culler_.Create(
+        target_.vulkanInstance(), target_.physicalDevice(), device,
+        *target_.physicalDeviceProperties(), target_.hostVisibleMemoryIndex(),
+        target_.deviceLocalMemoryIndex(), target_.concurrentFrameCount(),
+        instance_bounds_.size(), lods_, target_.drawIndirectCountEnabled(),
+        target_.multiDrawIndirectEnabled(), options_.verify_gpu_culling,
+        shader, pipeline_cache_);
+    if (shader)
+        device_functions_->vkDestroyShaderModule(device, shader, nullptr);
+    if (!created)
+    {
+        qWarning("GPU culling not available, culling on the CPU");
+        return;
+    }
+    gpu_culler_.SetBounds(instance_bounds_);
+    draws_.assign(1, {0, 0, 0, 0});
+}
+
+void VulkanRenderer::CreateParticles(const VkDevice &device)
+{
+    if (options_.particles == 0) return;
+    const VkShaderModule shader =
+        CreateShader(QStringLiteral("shaders/particles.comp.spv"));
+    const std::uint32_t memory_index = target_.hostVisibleMemoryIndex();
+    const bool created = particles_.Create(
+        target_.vulkanInstance(), device, *target_.physicalDeviceProperties(),
+        &memory_allocator_, &uploader_, target_.deviceLocalMemoryIndex(),
+        memory_index,
+        memory_properties_.memoryTypes[memory_index].propertyFlags,
+        target_.concurrentFrameCount(),
+        static_cast<std::size_t>(options_.particles),
+        options_.verify_particles, shader, pipeline_cache_);
+    if (shader)
+        device_functions_->vkDestroyShaderModule(device, shader, nullptr);
+    if (!created)
+    {
+        qWarning("Particles not available");
+        return;
+    }
+    qDebug("%zu particle(s)", particles_.count());
+}
+
+void VulkanRenderer::CreateCapture()
+{
+    if (!capture_writer_) return;
+    if (!target_.currentColorImage())
+    {
+        qWarning("--output: the surface does not allow copying frames");
+        return;
+    }
+    const std::uint32_t memory_index = target_.hostVisibleMemoryIndex();
+    capture_.Create(device_functions_, target_.device(),
+                    *target_.physicalDeviceProperties(), memory_index,
+                    memory_properties_.memoryTypes[memory_index].propertyFlags,
+                    target_.concurrentFrameCount(),
+                    target_.swapChainImageSize(), target_.colorFormat(),
+                    capture_writer_.get());
+}
+
+void VulkanRenderer::CullInstances(VkCommandBuffer command_buffer, int frame)
+{
+    if (!options_.culling) return;
+    FrameProfiler::ScopedTimer cull_timer(&profiler_,
+                                          FrameProfiler::Section::kCull);
+    // mvp_ is the view-projection, the model matrices are per instance
+    cull_settings_.viewport_height =
+        static_cast<float>(target_.swapChainImageSize().height());
+    if (gpu_culler_.enabled())
+    {
+        gpu_culler_.Record(command_buffer, frame, mvp_, cull_settings_);
+        return;
+    }
+    culler_.Cull(mvp_, cull_settings_, instance_bounds_, &visible_);
+    BuildDraws();
+    profiler_.SetVisibility(visible_.size(), instance_bounds_.size());
+}
+
+void VulkanRenderer::BuildDraws()
+{
+    draws_.clear();
+    const auto coarsest_lod = static_cast<std::uint32_t>(lods_.size() - 1);
+    for (const VisibleObject& object : visible_)
+    {
+        const std::uint32_t lod = std::min(object.lod, coarsest_lod);
+        const std::uint32_t material = object.index / instances_per_material_;
+        if (options_.instancing && !draws_.empty())
+        {
+            DrawCommand& last = draws_.back();
+            if (last.lod == lod && last.material == material &&
+                last.first_instance + last.instance_count == object.index)
+            {
+                ++last.instance_count;
+                continue;
+            }
+        }
+        draws_.push_back({lod, object.index, 1, material});
+    }
+}
+
+void VulkanRenderer::CreateRecordingResources(const VkDevice &device)
+{
+    if (options_.workers == 0) return;
+    worker_pool_ = std::make_unique<WorkerPool>(options_.workers);
+    partition_count_ = options_.workers;
+    culler_.set_worker_pool(worker_pool_.get());
+
+    // Command pools are externally synchronized. Every partition has its
+    // own pool per frame, so whichever thread records a partition is the
+    // only one using that pool, and a frame's pools can be reset as a whole
+    // once the frame slot comes around again.
+    const int pool_count = target_.concurrentFrameCount() * partition_count_;
+    VkCommandPoolCreateInfo pool_info{};
+    pool_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    pool_info.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+    pool_info.queueFamilyIndex = target_.graphicsQueueFamilyIndex();
+    record_pools_.resize(pool_count);
+    secondary_buffers_.resize(pool_count);
+    for (int i = 0; i < pool_count; ++i)
+    {
+        auto err = device_functions_->vkCreateCommandPool(
+            device, &pool_info, nullptr, &record_pools_[i]);
+        if (err != VK_SUCCESS) qFatal("Failed to create command pool: %d", err);
+
+        const VkCommandBufferAllocateInfo allocate_info = {
+            VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO, nullptr,
+            record_pools_[i], VK_COMMAND_BUFFER_LEVEL_SECONDARY, 1};
+        err = device_functions_->vkAllocateCommandBuffers(
+            device, &allocate_info, &secondary_buffers_[i]);
+        if (err != VK_SUCCESS)
+            qFatal("Failed to allocate secondary command buffer: %d", err);
+    }
+    qDebug("recording %zu draws on %d threads", draws_.size(),
+           worker_pool_->thread_count());
+}
+
+void VulkanRenderer::ReleaseRecordingResources(const VkDevice &device)
+{
+    // destroying a pool frees its command buffers
+    for (VkCommandPool pool : record_pools_)
+        device_functions_->vkDestroyCommandPool(device, pool, nullptr);
+    record_pools_.clear();
+    secondary_buffers_.clear();
+    culler_.set_worker_pool(nullptr);
+    worker_pool_.reset();
+}
+
+void VulkanRenderer::RecordDraws(VkCommandBuffer command_buffer, int frame,
+                                 std::size_t begin, std::size_t end)
+{
+    // nothing to draw with yet, the frame only gets cleared
+    if (!frame_pipeline_) return;
+
+    // Secondary command buffers do not inherit any state, so everything is
+    // set up again for each of them.
+    const auto [viewport, scissor] = GetViewportAndScissor();
+    device_functions_->vkCmdSetViewport(command_buffer, 0, 1, &viewport);
+    device_functions_->vkCmdSetScissor(command_buffer, 0, 1, &scissor);
+
+    device_functions_->vkCmdBindPipeline(
+        command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, frame_pipeline_);
+    device_functions_->vkCmdBindDescriptorSets(
+        command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline_layout_, 0,
+        1, &descriptor_set_, 1, &uniform_offset_);
+    const VkBuffer vertex_buffers[] = {vertex_buffer_, instance_ring_.buffer()};
+    const VkDeviceSize vertex_offsets[] = {0, instance_ring_.SlotOffset(frame)};
+    device_functions_->vkCmdBindVertexBuffers(command_buffer, 0, 2,
+                                              vertex_buffers, vertex_offsets);
+    device_functions_->vkCmdBindIndexBuffer(command_buffer, index_buffer_, 0,
+                                            VK_INDEX_TYPE_UINT32);
+
+    // The material of a draw is a push constant that indexes the resource
+    // table. Bindless, the table is bound once here; the fallback binds the
+    // set of the material's texture when it changes. All constants are
+    // pushed once, later only the material changes.
+    std::uint32_t bound_texture = BindlessTable::unbound_texture;
+    DrawConstants constants{material_from_instance, instances_per_material_};
+    for (int k = 0; k < 3; ++k)
+    {
+        constants.position_offset[k] = position_dequantization_.offset[k];
+        constants.position_scale[k] = position_dequantization_.scale[k];
+    }
+    device_functions_->vkCmdPushConstants(
+        command_buffer, pipeline_layout_, VK_SHADER_STAGE_VERTEX_BIT, 0,
+        sizeof(constants), &constants);
+    if (gpu_culler_.enabled())
+    {
+        // one indirect draw per instance, the shader derives the material
+        // from the instance index (always texture 0 in the fallback)
+        resource_table_.Bind(command_buffer, pipeline_layout_, 1, 0,
+                             &bound_texture);
+        gpu_culler_.Draw(command_buffer, frame);
+    }
+    else
+    {
+        for (std::size_t i = begin; i < end; ++i)
+        {
+            const DrawCommand& draw = draws_[i];
+            if (draw.material != constants.material)
+            {
+                resource_table_.Bind(command_buffer, pipeline_layout_, 1,
+                                     materials_[draw.material].texture,
+                                     &bound_texture);
+                constants.material = draw.material;
+                device_functions_->vkCmdPushConstants(
+                    command_buffer, pipeline_layout_,
+                    VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(constants.material),
+                    &constants.material);
+            }
+            const MeshLod& lod = lods_[draw.lod];
+            device_functions_->vkCmdDrawIndexed(
+                command_buffer, lod.index_count, draw.instance_count,
+                lod.first_index, lod.vertex_offset, draw.first_instance);
+        }
+    }
+    if (end == draws_.size()) RecordParticles(command_buffer);
+}
+
+void VulkanRenderer::RecordParticles(VkCommandBuffer command_buffer)
+{
+    if (!particles_.enabled()) return;
+    const VkPipeline pipeline = pipeline_manager_.Get(particle_pipeline_);
+    if (!pipeline) return;
+    // same layout as the scene, the uniforms are still bound
+    device_functions_->vkCmdBindPipeline(
+        command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+    particles_.Draw(command_buffer);
+}
+
+std::vector<VkCommandBuffer> VulkanRenderer::RecordSecondaries(int frame)
+{
+    const auto& device = target_.device();
+    VkCommandBufferInheritanceInfo inheritance_info{};
+    inheritance_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+    inheritance_info.renderPass = target_.defaultRenderPass();
+    inheritance_info.subpass = 0;
+    inheritance_info.framebuffer = target_.currentFramebuffer();
+
+    // Empty partitions are skipped, except the last one when it draws the
+    // particles.
+    const std::size_t draw_count = draws_.size();
+    const auto partitions = static_cast<std::size_t>(partition_count_);
+    const auto empty = [&](int partition) {
+        return draw_count * partition / partitions ==
+                   draw_count * (partition + 1) / partitions &&
+               !(particles_.enabled() && partition + 1 == partition_count_);
+    };
+    worker_pool_->ParallelFor(partition_count_, [&](int partition) {
+        const std::size_t begin = draw_count * partition / partitions;
+        const std::size_t end = draw_count * (partition + 1) / partitions;
+        if (empty(partition)) return;
+
+        // the frame slot is free again, so is everything recorded into it
+        const int index = frame * partition_count_ + partition;
+        device_functions_->vkResetCommandPool(device, record_pools_[index], 0);
+        const VkCommandBuffer command_buffer = secondary_buffers_[index];
+        VkCommandBufferBeginInfo begin_info{};
+        begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT |
+                           VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+        begin_info.pInheritanceInfo = &inheritance_info;
+        device_functions_->vkBeginCommandBuffer(command_buffer, &begin_info);
+        RecordDraws(command_buffer, frame, begin, end);
+        const auto err = device_functions_->vkEndCommandBuffer(command_buffer);
+        if (err != VK_SUCCESS)
+            qFatal("Failed to record secondary command buffer: %d", err);
+    });
+
+    // in partition order, so the draw order matches inline recording
+    std::vector<VkCommandBuffer> secondaries;
+    for (int partition = 0; partition < partition_count_; ++partition)
+    {
+        if (empty(partition)) continue;
+        secondaries.push_back(
+            secondary_buffers_[frame * partition_count_ + partition]);
+    }
+    return secondaries;
+}
+
+void VulkanRenderer::CreateDeviceLocalBuffer(
+    VkDeviceSize size, VkBufferUsageFlags usage, VkBuffer *buffer,
+    MemoryAllocation *allocation,
+    const std::vector<std::uint32_t> &queue_families)
+{
+    memory_allocator_.CreateBuffer(
+        size, usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        target_.deviceLocalMemoryIndex(), VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        buffer, allocation, queue_families);
+}
+
+void VulkanRenderer::CreateGeometry(const VkDevice &device)
+{
+    const std::uint32_t staging_index = target_.hostVisibleMemoryIndex();
+    uploader_.Create(
+        target_.vulkanInstance(), device, *target_.physicalDeviceProperties(),
+        staging_index,
+        memory_properties_.memoryTypes[staging_index].propertyFlags,
+        target_.graphicsQueue(), target_.graphicsCommandPool(),
+        staging_ring_size, target_.timelineSemaphoreEnabled());
+    if (!options_.mesh_path.isEmpty())
+    {
+        // meshlets are copied from the file as they are, in floats
+        if (options_.quantized_vertices)
+            qWarning("--quantized-vertices is ignored for streamed meshes");
+        CreateStreamedGeometry(device);
+        return;
+    }
+
+    // All LODs share one vertex and one index buffer, finest first.
+    MeshData mesh;
+    for (int subdivisions = std::max(options_.mesh_subdivisions, 1);;
+         subdivisions /= 2)
+    {
+        const MeshData lod = CreateTriangleGrid(subdivisions);
+        lods_.push_back(
+            {static_cast<std::uint32_t>(mesh.indices.size()),
+             static_cast<std::uint32_t>(lod.indices.size()),
+             static_cast<std::int32_t>(mesh.vertices.size() /
+                                       vertex_float_count)});
+        mesh.vertices.insert(mesh.vertices.end(), lod.vertices.begin(),
+                             lod.vertices.end());
+        mesh.indices.insert(mesh.indices.end(), lod.indices.begin(),
+                            lod.indices.end());
+        if (subdivisions == 1 || lods_.size() == max_lod_count) break;
+    }
+    const std::size_t vertex_count = mesh.vertices.size() / vertex_float_count;
+    mesh_bounds_ = ComputeBoundingSphere(mesh.vertices.data(), vertex_count);
+
+    // The quantized vertices replace the float ones. Decoded positions may
+    // be off by the error bound on every axis, the bounding sphere grows by
+    // that much so culling stays conservative.
+    std::vector<QuantizedVertex> quantized;
+    const void* vertex_data = mesh.vertices.data();
+    std::size_t vertex_bytes = mesh.VertexBytes();
+    if (options_.quantized_vertices)
+    {
+        QuantizationError error{};
+        quantized = QuantizeVertices(mesh.vertices.data(), vertex_count,
+                                     &position_dequantization_, &error);
+        const QuantizationError bound =
+            QuantizationErrorBound(position_dequantization_);
+        mesh_bounds_.radius += std::sqrt(3.0f) * bound.position;
+        quantized_vertices_ = true;
+        vertex_data = quantized.data();
+        vertex_bytes = quantized.size() * sizeof(QuantizedVertex);
+        qDebug("quantized vertices: %zu -> %zu bytes, max error %g (bound "
+               "%g) position, %g rad (bound %g) normal, %g (bound %g) color",
+               mesh.VertexBytes(), vertex_bytes, error.position,
+               bound.position, error.normal, bound.normal, error.color,
+               bound.color);
+    }
+    CreateDeviceLocalBuffer(vertex_bytes, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+                            &vertex_buffer_, &vertex_memory_);
+    CreateDeviceLocalBuffer(mesh.IndexBytes(), VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+                            &index_buffer_, &index_memory_);
+
+    // Static geometry is uploaded once. Waiting here is only done so the
+    // upload throughput can be reported, drawing would be ordered after the
+    // copies by the uploader's barriers anyway.
+    QElapsedTimer timer;
+    timer.start();
+    uploader_.Upload(vertex_buffer_, 0, vertex_data, vertex_bytes);
+    uploader_.Upload(index_buffer_, 0, mesh.indices.data(), mesh.IndexBytes());
+    uploader_.WaitIdle();
+    const double elapsed_ms = timer.nsecsElapsed() / 1e6;
+    const double mib = (vertex_bytes + mesh.IndexBytes()) / (1024.0 * 1024.0);
+    qDebug("uploaded %zu triangles in %zu LOD(s) (%.2f MiB) in %.3f ms "
+           "(%.1f MiB/s)",
+           mesh.indices.size() / 3, lods_.size(), mib, elapsed_ms,
+           mib / (elapsed_ms / 1e3));
+}
+
+void VulkanRenderer::CreateStreamedGeometry(const VkDevice &device)
+{
+    if (!mesh_streamer_.Open(options_.mesh_path))
+        qFatal("Failed to load mesh %s", qPrintable(options_.mesh_path));
+
+    // Copies on a transfer queue overlap the frames, the buffers are then
+    // shared between its family and the graphics family.
+    std::vector<std::uint32_t> queue_families;
+    if (target_.transferQueue() && target_.timelineSemaphoreEnabled())
+    {
+        const std::uint32_t staging_index = target_.hostVisibleMemoryIndex();
+        transfer_uploader_.Create(
+            target_.vulkanInstance(), device,
+            *target_.physicalDeviceProperties(), staging_index,
+            memory_properties_.memoryTypes[staging_index].propertyFlags,
+            target_.transferQueue(), target_.transferCommandPool(),
+            staging_ring_size, true, true);
+        transfer_streaming_ = true;
+        queue_families = {target_.graphicsQueueFamilyIndex(),
+                          target_.transferQueueFamilyIndex()};
+    }
+
+    // The buffers get their final size right away, the meshlets are copied
+    // to their file offsets as they arrive, and nothing is drawn until the
+    // first ones are resident.
+    CreateDeviceLocalBuffer(mesh_streamer_.VertexBytes(),
+                            VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, &vertex_buffer_,
+                            &vertex_memory_, queue_families);
+    CreateDeviceLocalBuffer(mesh_streamer_.IndexBytes(),
+                            VK_BUFFER_USAGE_INDEX_BUFFER_BIT, &index_buffer_,
+                            &index_memory_, queue_families);
+    // A single LOD whose index count grows as meshlets become resident.
+    lods_.push_back({0, 0, 0});
+    const MeshFileHeader& header = mesh_streamer_.header();
+    float radius_squared{0.0f};
+    for (int k = 0; k < 3; ++k)
+    {
+        mesh_bounds_.center[k] =
+            0.5f * (header.bounds_min[k] + header.bounds_max[k]);
+        const float half_extent =
+            0.5f * (header.bounds_max[k] - header.bounds_min[k]);
+        radius_squared += half_extent * half_extent;
+    }
+    mesh_bounds_.radius = std::sqrt(radius_squared);
+    qDebug("streaming %s: %u meshlets, %.2f MiB, on the %s queue",
+           qPrintable(options_.mesh_path), mesh_streamer_.meshlet_count(),
+           (mesh_streamer_.VertexBytes() + mesh_streamer_.IndexBytes()) /
+               (1024.0 * 1024.0),
+           transfer_streaming_ ? "transfer" : "graphics");
+    stream_timer_.start();
+}
+
+void VulkanRenderer::StreamGeometry()
+{
+    StagingUploader* uploader =
+        transfer_streaming_ ? &transfer_uploader_ : &uploader_;
+    if (mesh_streamer_.is_open())
+    {
+        const VkDeviceSize budget =
+            static_cast<VkDeviceSize>(options_.stream_budget_mib) * 1024 *
+            1024;
+        mesh_streamer_.StreamNext(uploader, vertex_buffer_, index_buffer_,
+                                  budget);
+        stream_batches_.push_back(
+            {uploader->Flush(), mesh_streamer_.resident_index_count()});
+        if (mesh_streamer_.complete()) mesh_streamer_.Close();
+    }
+    if (stream_batches_.empty()) return;
+
+    // On the graphics queue the copies are submitted before this frame's
+    // command buffer, the uploader's barriers make them visible to its
+    // draws. On the transfer queue this frame draws what completed so far,
+    // it never waits for copies in flight.
+    std::uint32_t& index_count = lods_[0].index_count;
+    const std::uint32_t drawn_index_count = index_count;
+    while (!stream_batches_.empty() &&
+           (!transfer_streaming_ ||
+            uploader->timeline()->IsComplete(stream_batches_.front().value)))
+    {
+        index_count = stream_batches_.front().index_count;
+        stream_wait_value_ = stream_batches_.front().value;
+        stream_batches_.pop_front();
+    }
+    if (index_count == drawn_index_count) return;
+    if (drawn_index_count == 0)
+    {
+        qDebug("first meshlets drawn after %.3f ms",
+               stream_timer_.nsecsElapsed() / 1e6);
+    }
+    if (gpu_culler_.enabled()) gpu_culler_.SetLods(lods_);
+
+    if (!mesh_streamer_.is_open() && !mesh_streamer_.failed() &&
+        stream_batches_.empty())
+    {
+        qDebug("streamed %u triangles in %.3f ms", index_count / 3,
+               stream_timer_.nsecsElapsed() / 1e6);
+    }
 }
 
 VkPipelineVertexInputStateCreateInfo VulkanRenderer::CreateVertexInputs(
     const VkDevice &device)
 {
     // clang-format off
-    constexpr VkVertexInputBindingDescription binding_description = {
-        0,  // binding
-        5 * sizeof(float), 
-        VK_VERTEX_INPUT_RATE_VERTEX
+    static constexpr VkVertexInputBindingDescription binding_description[] = {
+        {
+            0,  // binding
+            vertex_float_count * sizeof(float),
+            VK_VERTEX_INPUT_RATE_VERTEX
+        },
+        {
+            1,
+            sizeof(InstanceData),
+            VK_VERTEX_INPUT_RATE_INSTANCE
+        }
     };
-    constexpr VkVertexInputAttributeDescription attribute_description[] = {
+    static constexpr VkVertexInputAttributeDescription attribute_description[] = {
         { // position
             0, // location
             0, // binding
-            VK_FORMAT_R32G32_SFLOAT,
+            VK_FORMAT_R32G32B32_SFLOAT,
             0
         },
         { // color
             1,
             0,
             VK_FORMAT_R32G32B32_SFLOAT,
-            2 * sizeof(float)
+            vertex_color_offset * sizeof(float)
+        },
+        { // normal
+            7,
+            0,
+            VK_FORMAT_R32G32B32_SFLOAT,
+            vertex_normal_offset * sizeof(float)
+        },
+        // instance model matrix, one location per column
+        {2, 1, VK_FORMAT_R32G32B32A32_SFLOAT, 0},
+        {3, 1, VK_FORMAT_R32G32B32A32_SFLOAT, 4 * sizeof(float)},
+        {4, 1, VK_FORMAT_R32G32B32A32_SFLOAT, 8 * sizeof(float)},
+        {5, 1, VK_FORMAT_R32G32B32A32_SFLOAT, 12 * sizeof(float)},
+        { // instance color
+            6,
+            1,
+            VK_FORMAT_R32G32B32A32_SFLOAT,
+            offsetof(InstanceData, color)
         }
     };
+    // The same with QuantizedVertex, the vertex input stage converts the
+    // normalized formats to floats and shader.vert does the rest.
+    static constexpr VkVertexInputBindingDescription
+        quantized_binding_description[] = {
+        {0, sizeof(QuantizedVertex), VK_VERTEX_INPUT_RATE_VERTEX},
+        {1, sizeof(InstanceData), VK_VERTEX_INPUT_RATE_INSTANCE}
+    };
+    static constexpr VkVertexInputAttributeDescription
+        quantized_attribute_description[] = {
+        {0, 0, VK_FORMAT_R16G16B16A16_SNORM,
+         offsetof(QuantizedVertex, position)},
+        {1, 0, VK_FORMAT_R8G8B8A8_UNORM, offsetof(QuantizedVertex, color)},
+        {7, 0, VK_FORMAT_R16G16_SNORM, offsetof(QuantizedVertex, normal)},
+        {2, 1, VK_FORMAT_R32G32B32A32_SFLOAT, 0},
+        {3, 1, VK_FORMAT_R32G32B32A32_SFLOAT, 4 * sizeof(float)},
+        {4, 1, VK_FORMAT_R32G32B32A32_SFLOAT, 8 * sizeof(float)},
+        {5, 1, VK_FORMAT_R32G32B32A32_SFLOAT, 12 * sizeof(float)},
+        {6, 1, VK_FORMAT_R32G32B32A32_SFLOAT, offsetof(InstanceData, color)}
+    };
     // clang-format on
 
     VkPipelineVertexInputStateCreateInfo vertex_input_info{};
@@ -147,19 +1376,22 @@ VkPipelineVertexInputStateCreateInfo VulkanRenderer::CreateVertexInputs(
         VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
     vertex_input_info.pNext = nullptr;
     vertex_input_info.flags = 0;
-    vertex_input_info.vertexBindingDescriptionCount = 1;
-    vertex_input_info.pVertexBindingDescriptions = &binding_description;
-    vertex_input_info.vertexAttributeDescriptionCount = 2;
-    vertex_input_info.pVertexAttributeDescriptions = attribute_description;
+    vertex_input_info.vertexBindingDescriptionCount = 2;
+    vertex_input_info.pVertexBindingDescriptions =
+        quantized_vertices_ ? quantized_binding_description
+                            : binding_description;
+    vertex_input_info.vertexAttributeDescriptionCount =
+        sizeof(attribute_description) / sizeof(attribute_description[0]);
+    vertex_input_info.pVertexAttributeDescriptions =
+        quantized_vertices_ ? quantized_attribute_description
+                            : attribute_description;
 
     // Set up descriptor set and its layout.
-    const int concurrent_frames = window_.concurrentFrameCount();
     const VkDescriptorPoolSize pool_sizes = {
-        VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
-        static_cast<std::uint32_t>(concurrent_frames)};
+        VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1};
     VkDescriptorPoolCreateInfo pool_info{};
     pool_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-    pool_info.maxSets = concurrent_frames;
+    pool_info.maxSets = 1;
     pool_info.poolSizeCount = 1;
     pool_info.pPoolSizes = &pool_sizes;
     auto err = device_functions_->vkCreateDescriptorPool(
@@ -168,8 +1400,8 @@ VkPipelineVertexInputStateCreateInfo VulkanRenderer::CreateVertexInputs(
 
     VkDescriptorSetLayoutBinding layout_binding = {
         0,  // binding
-        VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1, VK_SHADER_STAGE_VERTEX_BIT,
-        nullptr};
+        VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1,
+        VK_SHADER_STAGE_VERTEX_BIT, nullptr};
     VkDescriptorSetLayoutCreateInfo layout_info = {
         VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO, nullptr, 0, 1,
         &layout_binding};
@@ -178,140 +1410,139 @@ VkPipelineVertexInputStateCreateInfo VulkanRenderer::CreateVertexInputs(
     if (err != VK_SUCCESS)
         qFatal("Failed to create descriptor set layout: %d", err);
 
-    for (int i = 0; i < concurrent_frames; ++i)
-    {
-        const VkDescriptorSetAllocateInfo allocate_info = {
-            VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO, nullptr,
-            descriptor_pool_, 1, &descriptor_set_layout_};
-        err = device_functions_->vkAllocateDescriptorSets(
-            device, &allocate_info, &descriptor_set_[i]);
-        if (err != VK_SUCCESS)
-            qFatal("Failed to allocate descriptor set: %d", err);
+    const VkDescriptorSetAllocateInfo allocate_info = {
+        VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO, nullptr,
+        descriptor_pool_, 1, &descriptor_set_layout_};
+    err = device_functions_->vkAllocateDescriptorSets(device, &allocate_info,
+                                                      &descriptor_set_);
+    if (err != VK_SUCCESS) qFatal("Failed to allocate descriptor set: %d", err);
 
-        VkWriteDescriptorSet write_descriptor{};
-        write_descriptor.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-        write_descriptor.dstSet = descriptor_set_[i];
-        write_descriptor.descriptorCount = 1;
-        write_descriptor.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-        write_descriptor.pBufferInfo = &uniform_buffer_info_[i];
-        device_functions_->vkUpdateDescriptorSets(device, 1, &write_descriptor,
-                                                  0, nullptr);
-    }
+    VkWriteDescriptorSet write_descriptor{};
+    write_descriptor.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    write_descriptor.dstSet = descriptor_set_;
+    write_descriptor.descriptorCount = 1;
+    write_descriptor.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+    write_descriptor.pBufferInfo = &uniform_buffer_info_;
+    device_functions_->vkUpdateDescriptorSets(device, 1, &write_descriptor, 0,
+                                              nullptr);
     return vertex_input_info;
 }
 
-void VulkanRenderer::CreateGraphicsPipeline(
+void VulkanRenderer::RequestGraphicsPipelines(
     const VkDevice &device,
-    const VkPipelineVertexInputStateCreateInfo vertex_input_info)
+    const VkPipelineVertexInputStateCreateInfo &vertex_input_info)
+{
+    // Pipeline layout: the uniforms, the resource table and the material
+    // of the draw
+    const VkDescriptorSetLayout set_layouts[] = {descriptor_set_layout_,
+                                                 resource_table_.layout()};
+    const VkPushConstantRange push_constant_range = {
+        VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(DrawConstants)};
+    VkPipelineLayoutCreateInfo pipeline_layout_info;
+    memset(&pipeline_layout_info, 0, sizeof(pipeline_layout_info));
+    pipeline_layout_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipeline_layout_info.setLayoutCount = 2;
+    pipeline_layout_info.pSetLayouts = set_layouts;
+    pipeline_layout_info.pushConstantRangeCount = 1;
+    pipeline_layout_info.pPushConstantRanges = &push_constant_range;
+    auto err = device_functions_->vkCreatePipelineLayout(
+        device, &pipeline_layout_info, nullptr, &pipeline_layout_);
+    if (err != VK_SUCCESS) qFatal("Failed to create pipeline layout: %d", err);
+
+    GraphicsPipelineDesc desc;
+    desc.vertex_shader = QStringLiteral("shaders/shader.vert.spv");
+    desc.fragment_shader = QStringLiteral("shaders/shader.frag.spv");
+    desc.bindings.assign(vertex_input_info.pVertexBindingDescriptions,
+                         vertex_input_info.pVertexBindingDescriptions +
+                             vertex_input_info.vertexBindingDescriptionCount);
+    desc.attributes.assign(
+        vertex_input_info.pVertexAttributeDescriptions,
+        vertex_input_info.pVertexAttributeDescriptions +
+            vertex_input_info.vertexAttributeDescriptionCount);
+    desc.layout = pipeline_layout_;
+    desc.render_pass = target_.defaultRenderPass();
+
+    // Specialization constants of shader.vert/frag: lit, variant, the size
+    // of the texture array and whether the vertices are quantized. The
+    // fallback is requested first so it is ready first.
+    const std::uint32_t texture_count = resource_table_.shader_texture_count();
+    const std::uint32_t quantized = quantized_vertices_ ? 1 : 0;
+    desc.name = QStringLiteral("fallback");
+    desc.specialization = {0, 0, texture_count, quantized};
+    fallback_pipeline_ = pipeline_manager_.Request(desc);
+    desc.name = QStringLiteral("scene");
+    desc.specialization = {1, 0, texture_count, quantized};
+    scene_pipeline_ = pipeline_manager_.Request(desc);
+    for (int variant = 1; variant <= options_.pipeline_variants; ++variant)
+    {
+        desc.name = QStringLiteral("variant %1").arg(variant);
+        desc.specialization = {1, static_cast<std::uint32_t>(variant),
+                               texture_count, quantized};
+        pipeline_manager_.Request(desc);
+    }
+
+    // The particles, straight from the simulation's buffer. Same layout so
+    // the uniforms stay bound, the draw constants are unused.
+    if (!particles_.enabled()) return;
+    desc.name = QStringLiteral("particles");
+    desc.vertex_shader = QStringLiteral("shaders/particle.vert.spv");
+    desc.fragment_shader = QStringLiteral("shaders/particle.frag.spv");
+    desc.specialization.clear();
+    desc.bindings = ParticleSystem::VertexBindings();
+    desc.attributes = ParticleSystem::VertexAttributes();
+    desc.topology = VK_PRIMITIVE_TOPOLOGY_POINT_LIST;
+    particle_pipeline_ = pipeline_manager_.Request(desc);
+}
+
+void VulkanRenderer::CreatePipelineCache(const VkDevice &device)
 {
-    // Pipeline cache
+    // Seed the cache with the blob from the previous run. The store rejects
+    // blobs from another device or driver, in which case we start empty.
+    const QByteArray initial_data =
+        pipeline_cache_store_.Load(*target_.physicalDeviceProperties());
+    pipeline_cache_warm_ = !initial_data.isEmpty();
+
     VkPipelineCacheCreateInfo pipeline_cache_info{};
     pipeline_cache_info.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+    pipeline_cache_info.initialDataSize = initial_data.size();
+    pipeline_cache_info.pInitialData = initial_data.constData();
     auto err = device_functions_->vkCreatePipelineCache(
         device, &pipeline_cache_info, nullptr, &pipeline_cache_);
+    if (err != VK_SUCCESS && pipeline_cache_warm_)
+    {
+        // The header matched but the driver still refused the data, retry
+        // with an empty cache rather than failing.
+        qWarning("Pipeline cache rejected by driver: %d", err);
+        pipeline_cache_warm_ = false;
+        pipeline_cache_info.initialDataSize = 0;
+        pipeline_cache_info.pInitialData = nullptr;
+        err = device_functions_->vkCreatePipelineCache(
+            device, &pipeline_cache_info, nullptr, &pipeline_cache_);
+    }
     if (err != VK_SUCCESS) qFatal("Failed to create pipeline cache: %d", err);
+}
 
-    // Pipeline layout
-    VkPipelineLayoutCreateInfo pipeline_layout_info;
-    memset(&pipeline_layout_info, 0, sizeof(pipeline_layout_info));
-    pipeline_layout_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-    pipeline_layout_info.setLayoutCount = 1;
-    pipeline_layout_info.pSetLayouts = &descriptor_set_layout_;
-    err = device_functions_->vkCreatePipelineLayout(
-        device, &pipeline_layout_info, nullptr, &pipeline_layout_);
-    if (err != VK_SUCCESS) qFatal("Failed to create pipeline layout: %d", err);
+void VulkanRenderer::SavePipelineCache(const VkDevice &device)
+{
+    if (!pipeline_cache_) return;
 
-    // Shaders
-    VkShaderModule vertex_shader =
-        CreateShader(QStringLiteral("shaders/shader.vert.spv"));
-    VkShaderModule fragment_shader =
-        CreateShader(QStringLiteral("shaders/shader.frag.spv"));
-
-    // Graphics pipeline
-    VkGraphicsPipelineCreateInfo pipeline_info{};
-    pipeline_info.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-
-    VkPipelineShaderStageCreateInfo shader_stages[2] = {
-        {VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO, nullptr, 0,
-         VK_SHADER_STAGE_VERTEX_BIT, vertex_shader, "main", nullptr},
-        {VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO, nullptr, 0,
-         VK_SHADER_STAGE_FRAGMENT_BIT, fragment_shader, "main", nullptr}};
-    pipeline_info.stageCount = 2;
-    pipeline_info.pStages = shader_stages;
-
-    pipeline_info.pVertexInputState = &vertex_input_info;
-
-    VkPipelineInputAssemblyStateCreateInfo ia{};
-    ia.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
-    ia.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
-    pipeline_info.pInputAssemblyState = &ia;
-
-    // The viewport and scissor will be set dynamically via
-    // vkCmdSetViewport/Scissor. This way the pipeline does not need to be
-    // touched when resizing the window.
-    VkPipelineViewportStateCreateInfo vp{};
-    vp.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
-    vp.viewportCount = 1;
-    vp.scissorCount = 1;
-    pipeline_info.pViewportState = &vp;
-
-    VkPipelineRasterizationStateCreateInfo rs{};
-    rs.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
-    rs.polygonMode = VK_POLYGON_MODE_FILL;
-    rs.cullMode = VK_CULL_MODE_NONE;  // we want the back face as well
-    rs.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
-    rs.lineWidth = 1.0f;
-    pipeline_info.pRasterizationState = &rs;
-
-    VkPipelineMultisampleStateCreateInfo ms{};
-    ms.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
-    // No multisampling.
-    ms.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
-    pipeline_info.pMultisampleState = &ms;
-
-    VkPipelineDepthStencilStateCreateInfo ds;
-    memset(&ds, 0, sizeof(ds));
-    ds.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
-    ds.depthTestEnable = VK_TRUE;
-    ds.depthWriteEnable = VK_TRUE;
-    ds.depthCompareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
-    pipeline_info.pDepthStencilState = &ds;
-
-    // Write out all RGBA, no blending
-    VkPipelineColorBlendStateCreateInfo cb{};
-    cb.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
-    VkPipelineColorBlendAttachmentState att{};
-    att.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT |
-                         VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
-    cb.attachmentCount = 1;
-    cb.pAttachments = &att;
-    pipeline_info.pColorBlendState = &cb;
-
-    const VkDynamicState dynamic_states[] = {VK_DYNAMIC_STATE_VIEWPORT,
-                                             VK_DYNAMIC_STATE_SCISSOR};
-    VkPipelineDynamicStateCreateInfo dynamic_state_info{};
-    dynamic_state_info.sType =
-        VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
-    dynamic_state_info.dynamicStateCount =
-        sizeof(dynamic_states) / sizeof(VkDynamicState);
-    dynamic_state_info.pDynamicStates = dynamic_states;
-    pipeline_info.pDynamicState = &dynamic_state_info;
-
-    pipeline_info.layout = pipeline_layout_;
-    pipeline_info.renderPass = window_.defaultRenderPass();
-
-    err = device_functions_->vkCreateGraphicsPipelines(
-        device, pipeline_cache_, 1, &pipeline_info, nullptr, &pipeline_);
-    if (err != VK_SUCCESS)
-        qFatal("Failed to create graphics pipeline: %d", err);
+    std::size_t size{};
+    auto err = device_functions_->vkGetPipelineCacheData(
+        device, pipeline_cache_, &size, nullptr);
+    if (err != VK_SUCCESS || size == 0) return;
 
-    // these are no longer needed, since they've been included in the pipeline
-    if (vertex_shader)
-        device_functions_->vkDestroyShaderModule(device, vertex_shader,
-                                                 nullptr);
-    if (fragment_shader)
-        device_functions_->vkDestroyShaderModule(device, fragment_shader,
-                                                 nullptr);
+    QByteArray data(static_cast<int>(size), Qt::Uninitialized);
+    err = device_functions_->vkGetPipelineCacheData(device, pipeline_cache_,
+                                                    &size, data.data());
+    if (err != VK_SUCCESS)
+    {
+        qWarning("Failed to get pipeline cache data: %d", err);
+        return;
+    }
+    data.resize(static_cast<int>(size));
+    if (pipeline_cache_store_.Save(data))
+        qDebug("saved %d bytes of pipeline cache to %s", data.size(),
+               qPrintable(pipeline_cache_store_.path()));
 }
 
 VkShaderModule VulkanRenderer::CreateShader(const QString &name)
@@ -332,7 +1563,7 @@ VkShaderModule VulkanRenderer::CreateShader(const QString &name)
     shaderInfo.pCode = reinterpret_cast<const uint32_t *>(blob.constData());
     VkShaderModule shaderModule;
     VkResult err = device_functions_->vkCreateShaderModule(
-        window_.device(), &shaderInfo, nullptr, &shaderModule);
+        target_.device(), &shaderInfo, nullptr, &shaderModule);
     if (err != VK_SUCCESS)
     {
         qWarning("Failed to create shader module: %d", err);
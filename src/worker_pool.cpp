@@ -0,0 +1,75 @@
+#include "worker_pool.h"
+
+WorkerPool::WorkerPool(int thread_count)
+    : generation_{0},
+      busy_threads_{0},
+      stopping_{false},
+      task_{nullptr},
+      count_{0},
+      next_index_{0}
+{
+    for (int i = 1; i < thread_count; ++i)
+        threads_.emplace_back(&WorkerPool::Run, this);
+}
+
+WorkerPool::~WorkerPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    work_ready_.notify_all();
+    for (std::thread& thread : threads_) thread.join();
+}
+
+void WorkerPool::ParallelFor(int count, const std::function<void(int)>& task)
+{
+    if (threads_.empty() || count <= 1)
+    {
+        for (int i = 0; i < count; ++i) task(i);
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        task_ = &task;
+        count_ = count;
+        next_index_ = 0;
+        busy_threads_ = static_cast<int>(threads_.size());
+        ++generation_;
+    }
+    work_ready_.notify_all();
+    RunTasks();
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    work_done_.wait(lock, [this] { return busy_threads_ == 0; });
+    task_ = nullptr;
+}
+
+void WorkerPool::Run()
+{
+    std::uint64_t seen_generation{0};
+    for (;;)
+    {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            work_ready_.wait(lock, [this, seen_generation] {
+                return stopping_ || generation_ != seen_generation;
+            });
+            if (stopping_) return;
+            seen_generation = generation_;
+        }
+        RunTasks();
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (--busy_threads_ > 0) continue;
+        }
+        work_done_.notify_one();
+    }
+}
+
+void WorkerPool::RunTasks()
+{
+    for (int index = next_index_++; index < count_; index = next_index_++)
+        (*task_)(index);
+}
@@ -0,0 +1,79 @@
+#include "y4m.h"
+
+namespace
+{
+// BT.601 video range in 8-bit fixed point, rounded.
+std::uint8_t Luma(int r, int g, int b)
+{
+    return static_cast<std::uint8_t>(((66 * r + 129 * g + 25 * b + 128) >> 8) +
+                                     16);
+}
+
+std::uint8_t BlueDifference(int r, int g, int b)
+{
+    return static_cast<std::uint8_t>(
+        ((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128);
+}
+
+std::uint8_t RedDifference(int r, int g, int b)
+{
+    return static_cast<std::uint8_t>(
+        ((112 * r - 94 * g - 18 * b + 128) >> 8) + 128);
+}
+}  // namespace
+
+std::string Y4mHeader(int width, int height, int frame_rate)
+{
+    // progressive, square pixels, chroma centered between the luma samples
+    return "YUV4MPEG2 W" + std::to_string(width) + " H" +
+           std::to_string(height) + " F" + std::to_string(frame_rate) +
+           ":1 Ip A1:1 C420jpeg\n";
+}
+
+std::size_t Y4mFrameSize(int width, int height)
+{
+    const auto chroma_width = static_cast<std::size_t>((width + 1) / 2);
+    const auto chroma_height = static_cast<std::size_t>((height + 1) / 2);
+    return static_cast<std::size_t>(width) * height +
+           2 * chroma_width * chroma_height;
+}
+
+void RgbaToI420(const std::uint8_t* rgba, int width, int height,
+                std::size_t stride, std::uint8_t* out)
+{
+    std::uint8_t* y_plane = out;
+    for (int y = 0; y < height; ++y)
+    {
+        const std::uint8_t* pixel = rgba + y * stride;
+        for (int x = 0; x < width; ++x, pixel += 4)
+            *y_plane++ = Luma(pixel[0], pixel[1], pixel[2]);
+    }
+
+    const int chroma_width = (width + 1) / 2;
+    const int chroma_height = (height + 1) / 2;
+    std::uint8_t* u_plane = out + static_cast<std::size_t>(width) * height;
+    std::uint8_t* v_plane =
+        u_plane + static_cast<std::size_t>(chroma_width) * chroma_height;
+    for (int cy = 0; cy < chroma_height; ++cy)
+    {
+        for (int cx = 0; cx < chroma_width; ++cx)
+        {
+            int sum[3] = {0, 0, 0};
+            int count{0};
+            for (int y = 2 * cy; y < 2 * cy + 2 && y < height; ++y)
+            {
+                for (int x = 2 * cx; x < 2 * cx + 2 && x < width; ++x)
+                {
+                    const std::uint8_t* pixel = rgba + y * stride + 4 * x;
+                    for (int c = 0; c < 3; ++c) sum[c] += pixel[c];
+                    ++count;
+                }
+            }
+            const int r = (sum[0] + count / 2) / count;
+            const int g = (sum[1] + count / 2) / count;
+            const int b = (sum[2] + count / 2) / count;
+            *u_plane++ = BlueDifference(r, g, b);
+            *v_plane++ = RedDifference(r, g, b);
+        }
+    }
+}
@@ -0,0 +1,18 @@
+#!/bin/sh
+# Culls on the GPU headless and compares every frame's indirect draws with
+# the CPU culler; vulkan_qt exits with 1 if any frame differs, or if none
+# was compared (no GPU culler, no completed readback). Needs a Vulkan
+# device and a Vulkan capable QPA, e.g. lavapipe under xvfb-run:
+#
+#   VK_ICD_FILENAMES=/usr/share/vulkan/icd.d/lvp_icd.x86_64.json \
+#       xvfb-run bazel test //test:gpu_culling_test
+#
+# Usage: gpu_culling_test.sh [vulkan_qt] [extra vulkan_qt args]
+
+set -e
+
+binary=${1:-bazel-bin/vulkan_qt}
+[ $# -gt 0 ] && shift
+
+"$binary" --headless --frames 20 --size 640x480 --instances 20000 \
+    --mesh-subdivisions 8 --verify-gpu-culling "$@"
@@ -0,0 +1,18 @@
+#!/bin/sh
+# Simulates particles headless and compares a sample of every step with the
+# CPU reference; vulkan_qt exits with 1 if any step differs, or if none was
+# compared. Needs a Vulkan device and a Vulkan capable QPA, e.g. lavapipe
+# under xvfb-run:
+#
+#   VK_ICD_FILENAMES=/usr/share/vulkan/icd.d/lvp_icd.x86_64.json \
+#       xvfb-run bazel test //test:particles_verify_test
+#
+# Usage: particles_test.sh [vulkan_qt] [extra vulkan_qt args]
+
+set -e
+
+binary=${1:-bazel-bin/vulkan_qt}
+[ $# -gt 0 ] && shift
+
+"$binary" --headless --frames 20 --size 640x480 --particles 100000 \
+    --verify-particles "$@"
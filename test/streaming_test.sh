@@ -0,0 +1,32 @@
+#!/bin/sh
+# Streams a large mesh headless with 8 frames in flight, once tracking the
+# frames and uploads with timeline semaphores (on the transfer queue where
+# the device has one) and once with fences on the graphics queue, and
+# checks that both end on the same image. Needs a Vulkan device and a
+# Vulkan capable QPA, e.g. lavapipe under xvfb-run:
+#
+#   VK_ICD_FILENAMES=/usr/share/vulkan/icd.d/lvp_icd.x86_64.json \
+#       xvfb-run bazel test //test:streaming_test
+#
+# Usage: streaming_test.sh [vulkan_qt] [mesh_converter] [extra vulkan_qt args]
+
+set -e
+
+binary=${1:-bazel-bin/vulkan_qt}
+[ $# -gt 0 ] && shift
+converter=${1:-bazel-bin/tools/mesh_converter}
+[ $# -gt 0 ] && shift
+
+directory=$(mktemp -d)
+trap 'rm -rf "$directory"' EXIT
+
+# about 12 MiB, streamed over the first dozen frames at 1 MiB per frame
+"$converter" --grid 512 "$directory/grid.vqm"
+for path in timeline fences; do
+    flags=
+    [ "$path" = fences ] && flags=--no-timeline-semaphore
+    "$binary" --headless --frames 60 --size 640x480 --frames-in-flight 8 \
+        --mesh "$directory/grid.vqm" --stream-budget 1 \
+        --output "$directory/$path" $flags "$@"
+done
+cmp "$directory/timeline/frame_00059.ppm" "$directory/fences/frame_00059.ppm"
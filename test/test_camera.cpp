@@ -0,0 +1,136 @@
+#include "camera.h"
+
+#include <glm/vec4.hpp>
+
+#include "gtest/gtest.h"
+
+namespace
+{
+// The camera space position of a world space point.
+glm::vec4 ToView(const Camera& camera, float x, float y, float z)
+{
+    return camera.view() * glm::vec4(x, y, z, 1.0f);
+}
+
+void ExpectSameMatrix(const glm::mat4& expected, const glm::mat4& actual)
+{
+    for (int column = 0; column < 4; ++column)
+    {
+        for (int row = 0; row < 4; ++row)
+        {
+            EXPECT_NEAR(expected[column][row], actual[column][row], 1e-4f)
+                << "at column " << column << ", row " << row;
+        }
+    }
+}
+}  // namespace
+
+TEST(Camera, RebuildsOnlyWhatChanged)
+{
+    Camera camera;
+    camera.SetViewport(1280, 720);
+    EXPECT_TRUE(camera.Update());
+    EXPECT_EQ(1u, camera.projection_builds());
+    EXPECT_EQ(1u, camera.view_builds());
+
+    // a still camera costs nothing
+    for (int frame = 0; frame < 10; ++frame)
+    {
+        camera.Advance(0.016f);
+        EXPECT_FALSE(camera.Update());
+    }
+    camera.SetViewport(1280, 720);
+    EXPECT_FALSE(camera.Update());
+
+    camera.Rotate(0.1f, 0.0f);
+    EXPECT_TRUE(camera.Update());
+    EXPECT_EQ(1u, camera.projection_builds());
+    EXPECT_EQ(2u, camera.view_builds());
+
+    camera.SetViewport(640, 640);
+    EXPECT_TRUE(camera.Update());
+    EXPECT_EQ(2u, camera.projection_builds());
+    EXPECT_EQ(2u, camera.view_builds());
+}
+
+TEST(Camera, OrbitLooksAtTheOrigin)
+{
+    Camera camera;
+    camera.Update();
+    const glm::vec4 origin = ToView(camera, 0.0f, 0.0f, 0.0f);
+    EXPECT_NEAR(0.0f, origin.x, 1e-5f);
+    EXPECT_NEAR(0.0f, origin.y, 1e-5f);
+    EXPECT_NEAR(-2.0f, origin.z, 1e-5f);
+
+    camera.Rotate(1.0f, 0.5f);
+    camera.Zoom(2.0f);
+    camera.Update();
+    const glm::vec4 turned = ToView(camera, 0.0f, 0.0f, 0.0f);
+    EXPECT_NEAR(0.0f, turned.x, 1e-5f);
+    EXPECT_NEAR(0.0f, turned.y, 1e-5f);
+    EXPECT_NEAR(-2.0f * 0.81f, turned.z, 1e-5f);
+
+    // zooming stays within bounds
+    camera.Zoom(1000.0f);
+    camera.Update();
+    EXPECT_NEAR(-0.2f, ToView(camera, 0.0f, 0.0f, 0.0f).z, 1e-5f);
+}
+
+TEST(Camera, ProjectionUsesVulkanClipSpace)
+{
+    Camera camera;
+    camera.SetViewport(800, 600);
+    camera.Update();
+    // above the origin ends up in the upper half, y is down in Vulkan
+    const glm::vec4 up =
+        camera.view_projection() * glm::vec4(0.0f, 0.5f, 0.0f, 1.0f);
+    EXPECT_LT(up.y / up.w, 0.0f);
+    // depth in [0, 1] between the near and far planes
+    const glm::vec4 near = camera.projection() *
+                           glm::vec4(0.0f, 0.0f, -0.1f, 1.0f);
+    const glm::vec4 far = camera.projection() *
+                          glm::vec4(0.0f, 0.0f, -100.0f, 1.0f);
+    EXPECT_NEAR(0.0f, near.z / near.w, 1e-4f);
+    EXPECT_NEAR(1.0f, far.z / far.w, 1e-4f);
+}
+
+TEST(Camera, FlyStartsFromTheOrbitPose)
+{
+    Camera camera;
+    camera.Rotate(0.7f, -0.3f);
+    camera.Update();
+    const glm::mat4 orbit = camera.view();
+
+    camera.SetMode(CameraMode::kFly);
+    EXPECT_TRUE(camera.Update());
+    ExpectSameMatrix(orbit, camera.view());
+
+    // moving forward gets closer to the origin, straight ahead
+    EXPECT_FALSE(camera.moving());
+    camera.SetMoveDirection(0.0f, 0.0f, 1.0f);
+    EXPECT_TRUE(camera.moving());
+    camera.Advance(0.5f);
+    EXPECT_TRUE(camera.Update());
+    const glm::vec4 origin = ToView(camera, 0.0f, 0.0f, 0.0f);
+    EXPECT_NEAR(0.0f, origin.x, 1e-5f);
+    EXPECT_NEAR(0.0f, origin.y, 1e-5f);
+    EXPECT_NEAR(-1.5f, origin.z, 1e-5f);
+
+    // strafing moves the origin the other way
+    camera.SetMoveDirection(1.0f, 0.0f, 0.0f);
+    camera.Advance(0.25f);
+    camera.Update();
+    EXPECT_NEAR(-0.25f, ToView(camera, 0.0f, 0.0f, 0.0f).x, 1e-5f);
+
+    // back to the orbit it left
+    camera.SetMode(CameraMode::kOrbit);
+    EXPECT_FALSE(camera.moving());
+    camera.Update();
+    ExpectSameMatrix(orbit, camera.view());
+
+    camera.SetMode(CameraMode::kFly);
+    camera.Reset();
+    EXPECT_EQ(CameraMode::kOrbit, camera.mode());
+    camera.Update();
+    EXPECT_NEAR(-2.0f, ToView(camera, 0.0f, 0.0f, 0.0f).z, 1e-5f);
+}
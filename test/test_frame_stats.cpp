@@ -0,0 +1,119 @@
+#include <sstream>
+
+#include "frame_stats.h"
+#include "gtest/gtest.h"
+
+TEST(RollingPercentiles, EmptyIsZero)
+{
+    const RollingPercentiles percentiles(10);
+    EXPECT_EQ(percentiles.Percentile(50), 0.0);
+}
+
+TEST(RollingPercentiles, NearestRank)
+{
+    RollingPercentiles percentiles(100);
+    for (int i = 1; i <= 100; ++i) percentiles.Add(i);
+    EXPECT_EQ(percentiles.Percentile(50), 50.0);
+    EXPECT_EQ(percentiles.Percentile(95), 95.0);
+    EXPECT_EQ(percentiles.Percentile(99), 99.0);
+    EXPECT_EQ(percentiles.Percentile(100), 100.0);
+}
+
+TEST(RollingPercentiles, KeepsOnlyTheWindow)
+{
+    RollingPercentiles percentiles(10);
+    for (int i = 0; i < 1000; ++i) percentiles.Add(1000.0);
+    for (int i = 0; i < 10; ++i) percentiles.Add(1.0);
+    EXPECT_EQ(percentiles.size(), 10u);
+    EXPECT_EQ(percentiles.Percentile(99), 1.0);
+}
+
+TEST(CsvTimingSink, WritesHeaderAndRows)
+{
+    std::ostringstream out;
+    CsvTimingSink sink(&out);
+    FrameTimings timings;
+    timings.frame = 7;
+    timings.frame_ms = 16.5;
+    sink.Add(timings);
+    EXPECT_EQ(out.str(),
+              "frame,begin_us,frame_ms,record_ms,submit_ms,gpu_ms,cull_ms,"
+              "visible\n"
+              "7,0.000,16.500,0.000,0.000,,0.000,\n");
+}
+
+TEST(ChromeTraceSink, WritesJsonArray)
+{
+    std::ostringstream out;
+    {
+        ChromeTraceSink sink(&out);
+        FrameTimings timings;
+        timings.record_ms = 1.0;
+        timings.gpu_ms = 2.0;
+        timings.cull_ms = 0.5;
+        timings.visible_ratio = 0.25;
+        sink.Add(timings);
+    }
+    const std::string json = out.str();
+    EXPECT_EQ(json.front(), '[');
+    EXPECT_NE(json.find("\"name\":\"cull\""), std::string::npos);
+    EXPECT_NE(json.find("\"name\":\"record\""), std::string::npos);
+    EXPECT_NE(json.find("\"name\":\"render pass\""), std::string::npos);
+    EXPECT_EQ(json.substr(json.size() - 3), "\n]\n");
+}
+
+TEST(BenchmarkReport, SummarizesFramesAfterWarmup)
+{
+    BenchmarkReport report(2);
+    for (int i = 0; i < 12; ++i)
+    {
+        FrameTimings timings;
+        timings.frame = i;
+        // the warm-up frames are much slower and must not count
+        timings.frame_ms = i < 2 ? 100.0 : i - 1;
+        timings.record_ms = 0.5;
+        timings.gpu_ms = i % 2 == 0 ? 2.0 : -1.0;
+        report.Add(timings);
+    }
+    report.SetParameter("instances", "1000");
+    report.SetMetric("device_memory_bytes", 1048576);
+    // beyond what a double holds exactly
+    report.SetMetric("host_ring_bytes", (1ull << 53) + 1);
+    EXPECT_EQ(report.frame_count(), 10u);
+
+    std::ostringstream out;
+    report.Write(&out);
+    EXPECT_EQ(out.str(),
+              "{\n"
+              "  \"version\": 1,\n"
+              "  \"parameters\": {\n"
+              "    \"instances\": \"1000\"\n"
+              "  },\n"
+              "  \"frames\": 10,\n"
+              "  \"warmup_frames\": 2,\n"
+              "  \"timings_ms\": {\n"
+              "    \"cpu_frame\": {\"mean\": 5.5000, \"p50\": 5.0000, "
+              "\"p90\": 9.0000, \"p99\": 10.0000, \"max\": 10.0000},\n"
+              "    \"cpu_record\": {\"mean\": 0.5000, \"p50\": 0.5000, "
+              "\"p90\": 0.5000, \"p99\": 0.5000, \"max\": 0.5000},\n"
+              "    \"cpu_submit\": {\"mean\": 0.0000, \"p50\": 0.0000, "
+              "\"p90\": 0.0000, \"p99\": 0.0000, \"max\": 0.0000},\n"
+              "    \"gpu_frame\": {\"mean\": 2.0000, \"p50\": 2.0000, "
+              "\"p90\": 2.0000, \"p99\": 2.0000, \"max\": 2.0000}\n"
+              "  },\n"
+              "  \"metrics\": {\n"
+              "    \"device_memory_bytes\": 1048576,\n"
+              "    \"host_ring_bytes\": 9007199254740993\n"
+              "  }\n"
+              "}\n");
+}
+
+TEST(BenchmarkReport, EmptyReportIsValidJson)
+{
+    const BenchmarkReport report(1);
+    std::ostringstream out;
+    report.Write(&out);
+    EXPECT_EQ(out.str(),
+              "{\n  \"version\": 1,\n  \"parameters\": {},\n  \"frames\": 0,\n"
+              "  \"warmup_frames\": 1,\n  \"timings_ms\": {},\n  \"metrics\": {}\n}\n");
+}
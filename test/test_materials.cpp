@@ -0,0 +1,50 @@
+#include "materials.h"
+
+#include "gtest/gtest.h"
+
+TEST(Materials, FirstMaterialIsNeutral)
+{
+    const std::vector<MaterialData> materials = CreateMaterials(1, 1);
+    ASSERT_EQ(1u, materials.size());
+    for (float channel : materials[0].tint) EXPECT_EQ(1.0f, channel);
+    EXPECT_EQ(0u, materials[0].texture);
+
+    for (std::uint8_t texel : CreateMaterialTexture(0)) EXPECT_EQ(255, texel);
+    EXPECT_EQ(32u, sizeof(MaterialData));  // std430 stride in the shader
+}
+
+TEST(Materials, MaterialsShareTextures)
+{
+    const std::vector<MaterialData> materials = CreateMaterials(1000, 16);
+    ASSERT_EQ(1000u, materials.size());
+    for (std::size_t i = 0; i < materials.size(); ++i)
+    {
+        EXPECT_EQ(i % 16, materials[i].texture);
+        for (float channel : materials[i].tint)
+        {
+            EXPECT_GE(channel, 0.2f);
+            EXPECT_LE(channel, 1.0f);
+        }
+    }
+    EXPECT_NE(materials[1].tint[0], materials[2].tint[0]);
+
+    const std::vector<std::uint8_t> texture = CreateMaterialTexture(5);
+    ASSERT_EQ(4u * material_texture_size * material_texture_size,
+              texture.size());
+    EXPECT_EQ(255, texture[3]);  // opaque
+    EXPECT_NE(texture, CreateMaterialTexture(6));
+}
+
+TEST(Materials, InstancesGetContiguousRuns)
+{
+    EXPECT_EQ(1u, InstancesPerMaterial(1, 1));
+    EXPECT_EQ(100u, InstancesPerMaterial(100, 1));
+    EXPECT_EQ(1u, InstancesPerMaterial(100, 1000));
+    EXPECT_EQ(34u, InstancesPerMaterial(100, 3));
+    // every instance maps to an existing material
+    for (std::uint32_t materials : {1u, 3u, 7u, 100u, 4096u})
+    {
+        const std::uint32_t per = InstancesPerMaterial(1000, materials);
+        EXPECT_LT(999u / per, materials);
+    }
+}
@@ -0,0 +1,220 @@
+#include <cstdlib>
+#include <memory>
+#include <sstream>
+#include <string>
+
+#include "geometry.h"
+#include "gtest/gtest.h"
+#include "mesh_format.h"
+#include "mesh_import.h"
+
+namespace
+{
+// Copies the bytes into memory aligned like a mapping.
+std::shared_ptr<void> AlignedCopy(const std::string& bytes)
+{
+    void* data = std::aligned_alloc(4096, (bytes.size() + 4095) / 4096 * 4096);
+    std::copy(bytes.begin(), bytes.end(), static_cast<char*>(data));
+    return std::shared_ptr<void>(data, std::free);
+}
+}  // namespace
+
+TEST(MeshFormat, MeshletsCoverTheMeshInOrder)
+{
+    MeshData mesh = CreateTriangleGrid(32);
+    const std::size_t triangle_count = mesh.indices.size() / 3;
+    const std::vector<Meshlet> meshlets = BuildMeshlets(&mesh);
+    ASSERT_GT(meshlets.size(), 1u);
+    EXPECT_EQ(mesh.indices.size() / 3, triangle_count);
+
+    std::uint32_t next_vertex{0};
+    std::uint32_t next_index{0};
+    for (const Meshlet& meshlet : meshlets)
+    {
+        EXPECT_EQ(meshlet.first_vertex, next_vertex);
+        EXPECT_EQ(meshlet.first_index, next_index);
+        EXPECT_LE(meshlet.vertex_count, meshlet_max_vertices);
+        EXPECT_LE(meshlet.index_count / 3, meshlet_max_triangles);
+        // meshlets only reference their own vertices
+        for (std::uint32_t i = 0; i < meshlet.index_count; ++i)
+        {
+            const std::uint32_t index = mesh.indices[meshlet.first_index + i];
+            EXPECT_GE(index, meshlet.first_vertex);
+            EXPECT_LT(index, meshlet.first_vertex + meshlet.vertex_count);
+        }
+        next_vertex += meshlet.vertex_count;
+        next_index += meshlet.index_count;
+    }
+    EXPECT_EQ(next_vertex, mesh.vertices.size() / vertex_float_count);
+    EXPECT_EQ(next_index, mesh.indices.size());
+}
+
+TEST(MeshFormat, WriteAndParseRoundTrip)
+{
+    MeshData mesh = CreateTriangleGrid(8);
+    const std::vector<Meshlet> meshlets = BuildMeshlets(&mesh);
+    std::ostringstream out;
+    ASSERT_TRUE(WriteMeshFile(mesh, meshlets, &out));
+    const std::string bytes = out.str();
+    const auto data = AlignedCopy(bytes);
+
+    MeshFileView view;
+    std::string error;
+    ASSERT_TRUE(ParseMeshFile(data.get(), bytes.size(), &view, &error))
+        << error;
+    EXPECT_EQ(view.header->vertex_offset % mesh_section_alignment, 0u);
+    EXPECT_EQ(view.header->index_offset % mesh_section_alignment, 0u);
+    EXPECT_EQ(view.header->meshlet_count, meshlets.size());
+    ASSERT_EQ(view.header->index_count, mesh.indices.size());
+    for (std::size_t i = 0; i < mesh.indices.size(); ++i)
+        EXPECT_EQ(view.indices[i], mesh.indices[i]);
+    for (std::size_t i = 0; i < mesh.vertices.size(); ++i)
+        EXPECT_EQ(view.vertices[i], mesh.vertices[i]);
+    EXPECT_FLOAT_EQ(view.header->bounds_min[0], -0.5f);
+    EXPECT_FLOAT_EQ(view.header->bounds_max[1], 0.5f);
+}
+
+TEST(MeshFormat, RejectsTruncatedFiles)
+{
+    MeshData mesh = CreateTriangleGrid(4);
+    const std::vector<Meshlet> meshlets = BuildMeshlets(&mesh);
+    std::ostringstream out;
+    ASSERT_TRUE(WriteMeshFile(mesh, meshlets, &out));
+    const std::string bytes = out.str();
+    const auto data = AlignedCopy(bytes);
+
+    MeshFileView view;
+    std::string error;
+    EXPECT_FALSE(ParseMeshFile(data.get(), bytes.size() - 1, &view, &error));
+    EXPECT_FALSE(ParseMeshFile(data.get(), 16, &view, &error));
+}
+
+TEST(MeshFormat, RejectsIndicesOutsideTheirMeshlet)
+{
+    MeshData mesh = CreateTriangleGrid(32);
+    const std::vector<Meshlet> meshlets = BuildMeshlets(&mesh);
+    ASSERT_GT(meshlets.size(), 1u);
+    std::ostringstream out;
+    ASSERT_TRUE(WriteMeshFile(mesh, meshlets, &out));
+    const std::string bytes = out.str();
+    const auto data = AlignedCopy(bytes);
+    MeshFileView view;
+    std::string error;
+    ASSERT_TRUE(ParseMeshFile(data.get(), bytes.size(), &view, &error))
+        << error;
+    auto* indices = reinterpret_cast<std::uint32_t*>(
+        static_cast<char*>(data.get()) + view.header->index_offset);
+    const std::uint32_t vertex_count =
+        static_cast<std::uint32_t>(view.header->vertex_count);
+
+    // only the meshlets' order is checked up front
+    const std::uint32_t first = indices[0];
+    indices[0] = vertex_count;
+    EXPECT_TRUE(ParseMeshFile(data.get(), bytes.size(), &view, &error))
+        << error;
+
+    // past the end of the vertex section
+    EXPECT_FALSE(CheckMeshletIndices(view, 0, &error));
+    EXPECT_NE(error.find("references vertex"), std::string::npos) << error;
+    indices[0] = UINT32_MAX;
+    EXPECT_FALSE(CheckMeshletIndices(view, 0, &error));
+
+    // within the mesh, but a vertex of the next meshlet
+    indices[0] = meshlets[1].first_vertex;
+    EXPECT_FALSE(CheckMeshletIndices(view, 0, &error));
+
+    indices[0] = first;
+    for (std::uint32_t i = 0; i < view.header->meshlet_count; ++i)
+        EXPECT_TRUE(CheckMeshletIndices(view, i, &error)) << error;
+}
+
+TEST(MeshImport, ObjQuadWithoutNormals)
+{
+    std::istringstream in(
+        "# a unit quad\n"
+        "v 0 0 0 1 0 0\n"
+        "v 1 0 0\n"
+        "v 1 1 0\n"
+        "v 0 1 0\n"
+        "f 1 2 3 4\n");
+    MeshData mesh;
+    std::string error;
+    ASSERT_TRUE(LoadObj(in, &mesh, &error)) << error;
+    EXPECT_EQ(mesh.indices, (std::vector<std::uint32_t>{0, 1, 2, 0, 2, 3}));
+    ASSERT_EQ(mesh.vertices.size(), 4 * vertex_float_count);
+    // computed normal and the color extension of the first vertex
+    EXPECT_FLOAT_EQ(mesh.vertices[vertex_normal_offset + 2], 1.0f);
+    EXPECT_FLOAT_EQ(mesh.vertices[vertex_color_offset + 1], 0.0f);
+}
+
+TEST(MeshImport, ObjSplitsVerticesByNormal)
+{
+    std::istringstream in(
+        "v 0 0 0\nv 1 0 0\nv 0 1 0\nv 0 0 1\n"
+        "vn 0 0 1\nvn 0 1 0\n"
+        "f 1//1 2//1 3//1\n"
+        "f 1//2 4//2 2//2\n");
+    MeshData mesh;
+    std::string error;
+    ASSERT_TRUE(LoadObj(in, &mesh, &error)) << error;
+    EXPECT_EQ(mesh.vertices.size(), 6 * vertex_float_count);
+}
+
+TEST(MeshImport, ObjRejectsBadIndices)
+{
+    std::istringstream in("v 0 0 0\nf 1 2 3\n");
+    MeshData mesh;
+    std::string error;
+    EXPECT_FALSE(LoadObj(in, &mesh, &error));
+}
+
+TEST(MeshImport, AsciiPly)
+{
+    std::istringstream in(
+        "ply\n"
+        "format ascii 1.0\n"
+        "element vertex 3\n"
+        "property float x\nproperty float y\nproperty float z\n"
+        "property uchar red\nproperty uchar green\nproperty uchar blue\n"
+        "element face 1\n"
+        "property list uchar int vertex_indices\n"
+        "end_header\n"
+        "0 0 0 255 0 0\n"
+        "1 0 0 0 255 0\n"
+        "0 1 0 0 0 255\n"
+        "3 0 1 2\n");
+    MeshData mesh;
+    std::string error;
+    ASSERT_TRUE(LoadPly(in, &mesh, &error)) << error;
+    EXPECT_EQ(mesh.indices, (std::vector<std::uint32_t>{0, 1, 2}));
+    EXPECT_FLOAT_EQ(mesh.vertices[vertex_color_offset], 1.0f);
+    EXPECT_FLOAT_EQ(mesh.vertices[vertex_normal_offset + 2], 1.0f);
+}
+
+TEST(MeshImport, BinaryPly)
+{
+    std::string bytes =
+        "ply\n"
+        "format binary_little_endian 1.0\n"
+        "element vertex 3\n"
+        "property float x\nproperty float y\nproperty float z\n"
+        "element face 1\n"
+        "property list uchar uint vertex_indices\n"
+        "end_header\n";
+    const float positions[9] = {0, 0, 0, 2, 0, 0, 0, 2, 0};
+    bytes.append(reinterpret_cast<const char*>(positions), sizeof(positions));
+    bytes.push_back(3);
+    const std::uint32_t face[3] = {0, 1, 2};
+    bytes.append(reinterpret_cast<const char*>(face), sizeof(face));
+
+    std::istringstream in(bytes);
+    MeshData mesh;
+    std::string error;
+    ASSERT_TRUE(LoadPly(in, &mesh, &error)) << error;
+    EXPECT_EQ(mesh.indices.size(), 3u);
+    EXPECT_FLOAT_EQ(mesh.vertices[vertex_float_count], 2.0f);
+
+    NormalizeMesh(&mesh);
+    EXPECT_FLOAT_EQ(mesh.vertices[0], -0.5f);
+    EXPECT_FLOAT_EQ(mesh.vertices[vertex_float_count], 0.5f);
+}
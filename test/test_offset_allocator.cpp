@@ -0,0 +1,172 @@
+#include <algorithm>
+#include <map>
+#include <random>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "offset_allocator.h"
+
+TEST(TlsfAllocator, AllocatesAlignedRangesUntilFull)
+{
+    TlsfAllocator allocator(1024);
+    const std::uint64_t a = allocator.Allocate(100);
+    const std::uint64_t b = allocator.Allocate(100, 256);
+    const std::uint64_t c = allocator.Allocate(24, 64);
+    ASSERT_NE(invalid_offset, a);
+    ASSERT_NE(invalid_offset, b);
+    ASSERT_NE(invalid_offset, c);
+    EXPECT_EQ(0u, b % 256);
+    EXPECT_EQ(0u, c % 64);
+    EXPECT_EQ(224u, allocator.used_bytes());
+    EXPECT_EQ(3u, allocator.allocation_count());
+    EXPECT_EQ(100u, allocator.AllocationSize(b));
+
+    EXPECT_EQ(invalid_offset, allocator.Allocate(1024));
+    EXPECT_EQ(invalid_offset, allocator.Allocate(2048));
+}
+
+TEST(TlsfAllocator, MergesFreedNeighbours)
+{
+    TlsfAllocator allocator(4096);
+    std::vector<std::uint64_t> offsets;
+    for (int i = 0; i < 16; ++i) offsets.push_back(allocator.Allocate(256));
+    EXPECT_EQ(0u, allocator.free_bytes());
+    EXPECT_EQ(invalid_offset, allocator.Allocate(1));
+
+    // every other one: half the memory is free, but in 256 byte pieces
+    for (int i = 0; i < 16; i += 2) allocator.Free(offsets[i]);
+    EXPECT_EQ(2048u, allocator.free_bytes());
+    EXPECT_EQ(256u, allocator.LargestFreeRange());
+    EXPECT_NEAR(1.0 - 256.0 / 2048.0, allocator.Fragmentation(), 1e-9);
+    EXPECT_EQ(invalid_offset, allocator.Allocate(512));
+
+    for (int i = 1; i < 16; i += 2) allocator.Free(offsets[i]);
+    EXPECT_EQ(4096u, allocator.LargestFreeRange());
+    EXPECT_EQ(0.0, allocator.Fragmentation());
+    EXPECT_EQ(0u, allocator.Allocate(4096));
+}
+
+TEST(TlsfAllocator, RandomAllocationsNeverOverlap)
+{
+    std::mt19937 random(5);
+    std::uniform_int_distribution<std::uint64_t> size(1, 5000);
+    std::uniform_int_distribution<int> alignment_bits(0, 8);
+    TlsfAllocator allocator(1 << 20);
+    std::map<std::uint64_t, std::uint64_t> live;  // offset -> size
+
+    for (int step = 0; step < 20000; ++step)
+    {
+        if (live.empty() || random() % 3 != 0)
+        {
+            const std::uint64_t bytes = size(random);
+            const std::uint64_t alignment = 1u << alignment_bits(random);
+            const std::uint64_t offset = allocator.Allocate(bytes, alignment);
+            if (offset == invalid_offset) continue;
+            ASSERT_EQ(0u, offset % alignment);
+            ASSERT_LE(offset + bytes, allocator.size());
+            const auto next = live.lower_bound(offset);
+            if (next != live.end())
+            {
+                ASSERT_LE(offset + bytes, next->first);
+            }
+            if (next != live.begin())
+            {
+                const auto previous = std::prev(next);
+                ASSERT_LE(previous->first + previous->second, offset);
+            }
+            live.emplace(offset, bytes);
+        }
+        else
+        {
+            auto victim = live.begin();
+            std::advance(victim, random() % live.size());
+            allocator.Free(victim->first);
+            live.erase(victim);
+        }
+    }
+
+    std::uint64_t used = 0;
+    for (const auto& allocation : live) used += allocation.second;
+    EXPECT_EQ(used, allocator.used_bytes());
+    for (const auto& allocation : live) allocator.Free(allocation.first);
+    EXPECT_EQ(allocator.size(), allocator.LargestFreeRange());
+}
+
+TEST(LinearAllocator, BumpsUntilReset)
+{
+    LinearAllocator arena(256);
+    EXPECT_EQ(0u, arena.Allocate(10));
+    EXPECT_EQ(64u, arena.Allocate(100, 64));
+    EXPECT_EQ(164u, arena.used_bytes());
+    EXPECT_EQ(invalid_offset, arena.Allocate(64, 128));
+    EXPECT_EQ(164u, arena.Allocate(92));
+    EXPECT_EQ(invalid_offset, arena.Allocate(1));
+
+    arena.Reset();
+    EXPECT_EQ(0u, arena.used_bytes());
+    EXPECT_EQ(0u, arena.Allocate(256));
+}
+
+TEST(PlanRangeMoves, EmptiesTheLeastUsedBlock)
+{
+    TlsfAllocator full(1024);
+    TlsfAllocator sparse(1024);
+    TlsfAllocator roomy(1024);
+    ASSERT_EQ(0u, full.Allocate(1000));
+    ASSERT_EQ(0u, roomy.Allocate(384));
+    const std::uint64_t a = sparse.Allocate(100);
+    const std::uint64_t b = sparse.Allocate(200, 256);
+    ASSERT_NE(invalid_offset, a);
+    ASSERT_NE(invalid_offset, b);
+    const std::vector<TlsfAllocator*> blocks = {&full, nullptr, &sparse,
+                                                &roomy};
+    // the first candidate is not in the source block and stays
+    const std::vector<MovableRange> candidates = {
+        {0, 1000, 1}, {2, 100, 1}, {2, 200, 256}};
+
+    const std::vector<RangeMove> moves =
+        PlanRangeMoves(blocks, candidates, 1 << 20);
+    ASSERT_EQ(2u, moves.size());
+    EXPECT_EQ(1u, moves[0].candidate);
+    EXPECT_EQ(2u, moves[1].candidate);
+    for (const RangeMove& move : moves) EXPECT_EQ(3u, move.block);
+    EXPECT_EQ(0u, moves[1].offset % 256);
+    // the destinations are reserved, the sources are up to the caller
+    EXPECT_EQ(384u + 300u, roomy.used_bytes());
+    EXPECT_EQ(300u, sparse.used_bytes());
+    EXPECT_EQ(1000u, full.used_bytes());
+}
+
+TEST(PlanRangeMoves, StopsAtTheBudget)
+{
+    TlsfAllocator source(1024);
+    TlsfAllocator destination(1024);
+    ASSERT_EQ(0u, destination.Allocate(512));
+    source.Allocate(100);
+    source.Allocate(100);
+    source.Allocate(10);
+    const std::vector<TlsfAllocator*> blocks = {&source, &destination};
+    // the second one is over the budget, and no later one is planned
+    const std::vector<MovableRange> candidates = {
+        {0, 100, 1}, {0, 100, 1}, {0, 10, 1}};
+
+    const std::vector<RangeMove> moves =
+        PlanRangeMoves(blocks, candidates, 150);
+    ASSERT_EQ(1u, moves.size());
+    EXPECT_EQ(0u, moves[0].candidate);
+    EXPECT_EQ(612u, destination.used_bytes());
+}
+
+TEST(PlanRangeMoves, NeedsASecondBlockWithRoom)
+{
+    TlsfAllocator only(1024);
+    only.Allocate(100);
+    EXPECT_TRUE(PlanRangeMoves({&only}, {{0, 100, 1}}, 1 << 20).empty());
+
+    TlsfAllocator full(128);
+    full.Allocate(120);
+    // only is the less used block, and full has no room for its range
+    EXPECT_TRUE(
+        PlanRangeMoves({&only, &full}, {{0, 100, 1}}, 1 << 20).empty());
+    EXPECT_EQ(120u, full.used_bytes());
+}
@@ -0,0 +1,105 @@
+#include <cmath>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "particles.h"
+
+namespace
+{
+Particle MakeParticle(float x, float y, float z, float vx, float vy, float vz)
+{
+    return {{x, y, z, 1.0f}, {vx, vy, vz, 0.0f}};
+}
+}  // namespace
+
+TEST(Particles, SeedDependsOnlyOnIndex)
+{
+    std::vector<Particle> all(64);
+    SeedParticles(7, 0, all.size(), all.data());
+    std::vector<Particle> part(16);
+    SeedParticles(7, 32, part.size(), part.data());
+    for (std::size_t i = 0; i < part.size(); ++i)
+    {
+        for (int k = 0; k < 4; ++k)
+        {
+            EXPECT_EQ(part[i].position[k], all[32 + i].position[k]);
+            EXPECT_EQ(part[i].velocity[k], all[32 + i].velocity[k]);
+        }
+    }
+
+    std::vector<Particle> other(64);
+    SeedParticles(8, 0, other.size(), other.data());
+    EXPECT_NE(other[0].position[0], all[0].position[0]);
+}
+
+TEST(Particles, StepPullsTowardsAttractor)
+{
+    ParticleStep step = DefaultParticleStep(1);
+    Particle particle = MakeParticle(1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f);
+    StepParticles(step, &particle, 1);
+
+    const float r2 = 1.0f + step.softening;
+    const float pull = step.attractor[3] / (r2 * std::sqrt(r2));
+    const float velocity = -pull * step.time_step * step.damping;
+    EXPECT_NEAR(particle.velocity[0], velocity, 1e-6f);
+    EXPECT_NEAR(particle.position[0], 1.0f + velocity * step.time_step,
+                1e-6f);
+    EXPECT_EQ(particle.position[1], 0.0f);
+    EXPECT_EQ(particle.velocity[2], 0.0f);
+}
+
+TEST(Particles, BouncesOffTheBound)
+{
+    ParticleStep step = DefaultParticleStep(1);
+    step.attractor[3] = 0.0f;
+    step.damping = 1.0f;
+    Particle particle =
+        MakeParticle(step.bound - 0.01f, 0.0f, -step.bound + 0.01f, 6.0f,
+                     0.0f, -6.0f);
+    StepParticles(step, &particle, 1);
+    EXPECT_EQ(particle.position[0], step.bound);
+    EXPECT_EQ(particle.velocity[0], -6.0f);
+    EXPECT_EQ(particle.position[2], -step.bound);
+    EXPECT_EQ(particle.velocity[2], 6.0f);
+}
+
+TEST(Particles, SeededParticlesStayBoundAndFinite)
+{
+    std::vector<Particle> particles(2000);
+    SeedParticles(1, 0, particles.size(), particles.data());
+    const ParticleStep step = DefaultParticleStep(2000);
+    for (int i = 0; i < 600; ++i)
+        StepParticles(step, particles.data(), particles.size());
+    for (const Particle& particle : particles)
+    {
+        for (int k = 0; k < 3; ++k)
+        {
+            ASSERT_TRUE(std::isfinite(particle.velocity[k]));
+            ASSERT_LE(std::abs(particle.position[k]), step.bound);
+        }
+    }
+}
+
+TEST(Particles, CountsMismatchesAwayFromTheFaces)
+{
+    const ParticleStep step = DefaultParticleStep(3);
+    std::vector<Particle> before = {
+        MakeParticle(0.5f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f),
+        MakeParticle(-0.3f, 0.1f, 0.2f, 0.5f, 0.0f, 0.0f),
+        MakeParticle(step.bound, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f)};
+    std::vector<Particle> actual = before;
+    StepParticles(step, actual.data(), actual.size());
+    EXPECT_EQ(CountParticleMismatches(step, before.data(), actual.data(),
+                                      before.size(), 1e-4f),
+              0u);
+
+    // a bounce the reference did not make is rounding at the face
+    actual[2].velocity[0] = -actual[2].velocity[0] + 1.0f;
+    EXPECT_EQ(CountParticleMismatches(step, before.data(), actual.data(),
+                                      before.size(), 1e-4f),
+              0u);
+    actual[1].position[1] += 0.01f;
+    EXPECT_EQ(CountParticleMismatches(step, before.data(), actual.data(),
+                                      before.size(), 1e-4f),
+              1u);
+}
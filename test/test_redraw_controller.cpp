@@ -0,0 +1,66 @@
+#include "gtest/gtest.h"
+#include "redraw_controller.h"
+
+TEST(RedrawController, ContinuousRendersBackToBack)
+{
+    RedrawController redraw;
+    EXPECT_EQ(0.0, redraw.NextFrameDelay(0.0));
+    for (int frame = 0; frame < 10; ++frame)
+    {
+        redraw.FrameRendered(frame * 5.0);
+        EXPECT_EQ(0.0, redraw.NextFrameDelay(frame * 5.0));
+    }
+    EXPECT_EQ(10u, redraw.frame_count());
+}
+
+TEST(RedrawController, MaxFpsSpacesFramesOut)
+{
+    RedrawController redraw(RedrawMode::kContinuous, 50.0);
+    redraw.FrameRendered(100.0);
+    EXPECT_DOUBLE_EQ(20.0, redraw.NextFrameDelay(100.0));
+    EXPECT_DOUBLE_EQ(5.0, redraw.NextFrameDelay(115.0));
+    EXPECT_EQ(0.0, redraw.NextFrameDelay(130.0));
+}
+
+TEST(RedrawController, OnDemandWaitsForChanges)
+{
+    RedrawController redraw(RedrawMode::kOnDemand, 60.0);
+    EXPECT_EQ(0.0, redraw.NextFrameDelay(0.0));  // the first frame
+    redraw.FrameRendered(0.0);
+    EXPECT_LT(redraw.NextFrameDelay(1.0), 0.0);
+    EXPECT_LT(redraw.NextFrameDelay(10000.0), 0.0);
+
+    // a change right after a frame still respects the cap
+    redraw.FrameRendered(10000.0);
+    redraw.Invalidate();
+    EXPECT_NEAR(1000.0 / 60.0, redraw.NextFrameDelay(10000.0), 1e-9);
+    redraw.FrameRendered(10020.0);
+    EXPECT_LT(redraw.NextFrameDelay(10020.0), 0.0);
+
+    // animation keeps the frames coming until it stops
+    redraw.SetAnimating(true);
+    EXPECT_EQ(0.0, redraw.NextFrameDelay(10040.0));
+    redraw.FrameRendered(10040.0);
+    redraw.SetAnimating(false);
+    EXPECT_LT(redraw.NextFrameDelay(10060.0), 0.0);
+}
+
+TEST(RedrawController, IdlePolicyThrottles)
+{
+    // on demand: a 2 fps heartbeat while nothing changes
+    RedrawController on_demand(RedrawMode::kOnDemand, 0.0, 2.0);
+    on_demand.FrameRendered(0.0);
+    EXPECT_DOUBLE_EQ(400.0, on_demand.NextFrameDelay(100.0));
+
+    // continuous: full rate for a second after the last change, then 2 fps
+    RedrawController continuous(RedrawMode::kContinuous, 0.0, 2.0, 1000.0);
+    continuous.FrameRendered(0.0);
+    EXPECT_EQ(0.0, continuous.NextFrameDelay(10.0));
+    EXPECT_FALSE(continuous.idle(999.0));
+    continuous.FrameRendered(1000.0);
+    EXPECT_TRUE(continuous.idle(1000.0));
+    EXPECT_DOUBLE_EQ(500.0, continuous.NextFrameDelay(1000.0));
+    continuous.Invalidate();
+    EXPECT_FALSE(continuous.idle(1000.0));
+    EXPECT_EQ(0.0, continuous.NextFrameDelay(1000.0));
+}
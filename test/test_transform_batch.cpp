@@ -0,0 +1,122 @@
+#include <cmath>
+#include <glm/mat4x4.hpp>
+#include <random>
+#include <vector>
+
+#include "graphics.h"
+#include "gtest/gtest.h"
+#include "transform_batch.h"
+
+namespace
+{
+constexpr float tolerance{1e-4f};
+
+void ExpectNear(const glm::mat4& expected, const glm::mat4& actual)
+{
+    for (int column = 0; column < 4; ++column)
+    {
+        for (int row = 0; row < 4; ++row)
+        {
+            EXPECT_NEAR(expected[column][row], actual[column][row], tolerance)
+                << "column " << column << " row " << row;
+        }
+    }
+}
+
+glm::mat4 RandomMatrix(std::mt19937* random)
+{
+    std::uniform_real_distribution<float> values(-2.0f, 2.0f);
+    glm::mat4 matrix;
+    for (int column = 0; column < 4; ++column)
+    {
+        for (int row = 0; row < 4; ++row) matrix[column][row] = values(*random);
+    }
+    return matrix;
+}
+
+const SimdLevel all_levels[] = {SimdLevel::kScalar, SimdLevel::kSse,
+                                SimdLevel::kAvx2};
+}  // namespace
+
+TEST(MatrixBatch, SetAndGetRoundTrip)
+{
+    std::mt19937 random(1);
+    MatrixBatch batch(5);
+    const glm::mat4 matrix = RandomMatrix(&random);
+    batch.Set(3, matrix);
+    ExpectNear(matrix, batch.Get(3));
+    EXPECT_EQ(batch.Element(1)[3], matrix[0][1]);
+}
+
+TEST(MatrixBatch, ResizeKeepsMatrices)
+{
+    std::mt19937 random(2);
+    MatrixBatch batch(3);
+    const glm::mat4 matrix = RandomMatrix(&random);
+    batch.Set(2, matrix);
+    batch.Resize(11);
+    ExpectNear(matrix, batch.Get(2));
+    ExpectNear(glm::mat4(0.0f), batch.Get(10));
+}
+
+TEST(TransformBatch, IdentityModelsMatchGetMVPMatrix)
+{
+    const glm::mat4 expected = GetMVPMatrix(16.0f / 9.0f, 4.0f, 0.3f, 1.1f);
+    TransformBatch transforms;
+    transforms.SetCamera(16.0f / 9.0f, 4.0f, 0.3f, 1.1f);
+
+    MatrixBatch models(19);
+    for (std::size_t i = 0; i < models.size(); ++i)
+        models.Set(i, glm::mat4(1.0f));
+    for (const SimdLevel level : all_levels)
+    {
+        if (!IsSimdLevelSupported(level)) continue;
+        SCOPED_TRACE(SimdLevelName(level));
+        std::vector<glm::mat4> mvps(models.size());
+        transforms.Compute(models, mvps.data(), level);
+        for (const glm::mat4& mvp : mvps) ExpectNear(expected, mvp);
+    }
+}
+
+TEST(TransformBatch, AllLevelsMatchGlm)
+{
+    std::mt19937 random(3);
+    TransformBatch transforms;
+    transforms.SetCamera(1.5f, 3.0f, -0.7f, 2.0f);
+    const glm::mat4 view_projection =
+        GetMVPMatrix(1.5f, 3.0f, -0.7f, 2.0f);  // identity model
+    ExpectNear(view_projection, transforms.view_projection());
+
+    // sizes around the SSE and AVX2 block sizes exercise the scalar tail
+    for (const std::size_t count : {1, 3, 4, 7, 8, 9, 16, 37})
+    {
+        MatrixBatch models(count);
+        std::vector<glm::mat4> expected(count);
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            const glm::mat4 model = RandomMatrix(&random);
+            models.Set(i, model);
+            expected[i] = view_projection * model;
+        }
+        for (const SimdLevel level : all_levels)
+        {
+            if (!IsSimdLevelSupported(level)) continue;
+            SCOPED_TRACE(SimdLevelName(level));
+            std::vector<glm::mat4> mvps(count, glm::mat4(-1.0f));
+            transforms.Compute(models, mvps.data(), level);
+            for (std::size_t i = 0; i < count; ++i)
+                ExpectNear(expected[i], mvps[i]);
+        }
+    }
+}
+
+TEST(TransformBatch, UnsupportedLevelFallsBack)
+{
+    TransformBatch transforms;
+    MatrixBatch models(9);
+    for (std::size_t i = 0; i < models.size(); ++i)
+        models.Set(i, glm::mat4(2.0f));
+    std::vector<glm::mat4> mvps(models.size());
+    transforms.Compute(models, mvps.data(), SimdLevel::kAvx2);
+    for (const glm::mat4& mvp : mvps) ExpectNear(glm::mat4(2.0f), mvp);
+}
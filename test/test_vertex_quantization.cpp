@@ -0,0 +1,112 @@
+#include "vertex_quantization.h"
+
+#include <cmath>
+#include <random>
+
+#include "geometry.h"
+#include "gtest/gtest.h"
+
+namespace
+{
+// A mesh with random positions, unit normals and colors.
+std::vector<float> RandomVertices(std::size_t count, float extent)
+{
+    std::mt19937 random(42);
+    std::uniform_real_distribution<float> position(-extent, extent);
+    std::normal_distribution<float> direction;
+    std::uniform_real_distribution<float> color(0.0f, 1.0f);
+    std::vector<float> vertices(count * vertex_float_count);
+    for (std::size_t v = 0; v < count; ++v)
+    {
+        float* vertex = &vertices[v * vertex_float_count];
+        float* normal = vertex + vertex_normal_offset;
+        float length{0.0f};
+        for (int k = 0; k < 3; ++k)
+        {
+            vertex[k] = position(random);
+            normal[k] = direction(random);
+            length += normal[k] * normal[k];
+            vertex[vertex_color_offset + k] = color(random);
+        }
+        for (int k = 0; k < 3; ++k) normal[k] /= std::sqrt(length);
+    }
+    return vertices;
+}
+}  // namespace
+
+TEST(VertexQuantization, OctahedralRoundTrip)
+{
+    const float axes[][3] = {{1, 0, 0}, {-1, 0, 0}, {0, 1, 0},
+                             {0, -1, 0}, {0, 0, 1}, {0, 0, -1}};
+    for (const auto& axis : axes)
+    {
+        std::int16_t encoded[2];
+        float decoded[3];
+        EncodeOctahedral(axis, encoded);
+        DecodeOctahedral(encoded, decoded);
+        for (int k = 0; k < 3; ++k) EXPECT_NEAR(axis[k], decoded[k], 1e-6f);
+    }
+}
+
+TEST(VertexQuantization, ErrorStaysWithinBounds)
+{
+    const std::size_t count = 100000;
+    const std::vector<float> vertices = RandomVertices(count, 3.0f);
+    PositionDequantization dequantization{};
+    QuantizationError error{};
+    const std::vector<QuantizedVertex> quantized =
+        QuantizeVertices(vertices.data(), count, &dequantization, &error);
+    ASSERT_EQ(count, quantized.size());
+
+    const QuantizationError bound = QuantizationErrorBound(dequantization);
+    EXPECT_LE(error.position, bound.position);
+    EXPECT_LE(error.normal, bound.normal);
+    EXPECT_LE(error.color, bound.color);
+    // 16 bits across 6 units are about 0.1 mm per meter
+    EXPECT_LT(bound.position, 1e-4f);
+
+    // what the renderer sees decodes the same
+    float decoded[vertex_float_count];
+    DequantizeVertex(quantized[7], dequantization, decoded);
+    for (int k = 0; k < 3; ++k)
+        EXPECT_NEAR(vertices[7 * vertex_float_count + k], decoded[k],
+                    bound.position);
+}
+
+TEST(VertexQuantization, FlatMeshes)
+{
+    // the built-in triangle has z = 0 everywhere
+    const MeshData mesh = CreateTriangleGrid(8);
+    const std::size_t count = mesh.vertices.size() / vertex_float_count;
+    PositionDequantization dequantization{};
+    QuantizationError error{};
+    const std::vector<QuantizedVertex> quantized = QuantizeVertices(
+        mesh.vertices.data(), count, &dequantization, &error);
+    EXPECT_GT(dequantization.scale[2], 0.0f);
+    EXPECT_LE(error.position, QuantizationErrorBound(dequantization).position);
+    EXPECT_LE(error.normal, octahedral_normal_error);
+}
+
+TEST(VertexQuantization, SavesFootprintAndFetchBandwidth)
+{
+    const MeshData mesh = CreateTriangleGrid(256);
+    const std::size_t count = mesh.vertices.size() / vertex_float_count;
+    PositionDequantization dequantization{};
+    const std::vector<QuantizedVertex> quantized =
+        QuantizeVertices(mesh.vertices.data(), count, &dequantization);
+
+    // memory footprint of the vertex buffer
+    const std::size_t float_bytes = mesh.VertexBytes();
+    const std::size_t quantized_bytes = quantized.size() * sizeof(quantized[0]);
+    EXPECT_EQ(16u, sizeof(QuantizedVertex));
+    EXPECT_EQ(36u * count, float_bytes);
+    EXPECT_EQ(16u * count, quantized_bytes);
+
+    // Vertex fetch per draw: every index reads a whole vertex unless it hits
+    // the post-transform cache, so both layouts fetch the same number of
+    // vertices and the bandwidth scales with the stride.
+    const double fetched_vertices = static_cast<double>(mesh.indices.size());
+    const double float_fetch = fetched_vertices * vertex_float_count * 4;
+    const double quantized_fetch = fetched_vertices * sizeof(QuantizedVertex);
+    EXPECT_LT(quantized_fetch / float_fetch, 0.45);
+}
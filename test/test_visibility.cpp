@@ -0,0 +1,166 @@
+#include <cmath>
+#include <glm/mat4x4.hpp>
+#include <random>
+#include <vector>
+
+#include "graphics.h"
+#include "gtest/gtest.h"
+#include "visibility.h"
+#include "worker_pool.h"
+
+namespace
+{
+// The camera of GetMVPMatrix, looking down -z from z = 2.
+glm::mat4 CameraViewProjection()
+{
+    return GetProjectionMatrix(1.0f) * GetViewMatrix(2.0f, 0.0f, 0.0f);
+}
+
+std::vector<std::uint32_t> Indices(const std::vector<VisibleObject>& visible)
+{
+    std::vector<std::uint32_t> indices;
+    for (const VisibleObject& object : visible) indices.push_back(object.index);
+    return indices;
+}
+
+// Spheres scattered around the camera, many of them outside the frustum.
+BoundingSpheres RandomSpheres(std::size_t count, std::mt19937* random)
+{
+    std::uniform_real_distribution<float> position(-6.0f, 6.0f);
+    std::uniform_real_distribution<float> radius(0.01f, 0.5f);
+    BoundingSpheres spheres;
+    spheres.Resize(count);
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        spheres.Set(i, position(*random), position(*random),
+                    position(*random), radius(*random));
+    }
+    return spheres;
+}
+}  // namespace
+
+TEST(Frustum, PlanesOfIdentityAreTheClipVolume)
+{
+    const Frustum frustum = ExtractFrustum(glm::mat4(1.0f));
+    const float left[4] = {1.0f, 0.0f, 0.0f, 1.0f};
+    const float near[4] = {0.0f, 0.0f, 1.0f, 1.0f};
+    const float far[4] = {0.0f, 0.0f, -1.0f, 1.0f};
+    for (int k = 0; k < 4; ++k)
+    {
+        EXPECT_FLOAT_EQ(left[k], frustum.planes[Frustum::kLeft][k]);
+        EXPECT_FLOAT_EQ(near[k], frustum.planes[Frustum::kNear][k]);
+        EXPECT_FLOAT_EQ(far[k], frustum.planes[Frustum::kFar][k]);
+    }
+}
+
+TEST(VisibilityCuller, KeepsSpheresThatTouchTheFrustum)
+{
+    BoundingSpheres spheres;
+    spheres.Resize(5);
+    spheres.Set(0, 0.0f, 0.0f, 0.0f, 0.1f);    // in front of the camera
+    spheres.Set(1, 0.0f, 0.0f, 5.0f, 0.1f);    // behind it
+    spheres.Set(2, 50.0f, 0.0f, 0.0f, 0.1f);   // far to the right
+    spheres.Set(3, 2.2f, 0.0f, 0.0f, 1.5f);    // straddles the right plane
+    spheres.Set(4, 0.0f, -30.0f, 0.0f, 0.1f);  // far below
+
+    VisibilityCuller culler;
+    std::vector<VisibleObject> visible;
+    culler.Cull(CameraViewProjection(), CullSettings{}, spheres, &visible);
+    EXPECT_EQ((std::vector<std::uint32_t>{0, 3}), Indices(visible));
+}
+
+TEST(VisibilityCuller, AllSimdLevelsMatchScalar)
+{
+    std::mt19937 random(3);
+    // not a multiple of the SIMD width or the chunk size
+    const BoundingSpheres spheres = RandomSpheres(10007, &random);
+    const glm::mat4 view_projection = CameraViewProjection();
+
+    VisibilityCuller culler;
+    std::vector<VisibleObject> expected;
+    culler.Cull(view_projection, CullSettings{}, spheres, &expected,
+                SimdLevel::kScalar);
+    ASSERT_GT(expected.size(), 0u);
+    ASSERT_LT(expected.size(), spheres.size());
+
+    for (SimdLevel level : {SimdLevel::kSse, SimdLevel::kAvx2})
+    {
+        std::vector<VisibleObject> visible;
+        culler.Cull(view_projection, CullSettings{}, spheres, &visible, level);
+        EXPECT_EQ(Indices(expected), Indices(visible)) << SimdLevelName(level);
+    }
+}
+
+TEST(VisibilityCuller, WorkerPoolMatchesSingleThread)
+{
+    std::mt19937 random(4);
+    const BoundingSpheres spheres = RandomSpheres(50000, &random);
+    CullSettings settings;
+    settings.viewport_height = 720.0f;
+    settings.lod_pixels = {64.0f, 16.0f};
+
+    VisibilityCuller culler;
+    std::vector<VisibleObject> expected;
+    culler.Cull(CameraViewProjection(), settings, spheres, &expected);
+
+    WorkerPool pool(4);
+    culler.set_worker_pool(&pool);
+    std::vector<VisibleObject> visible;
+    culler.Cull(CameraViewProjection(), settings, spheres, &visible);
+    ASSERT_EQ(expected.size(), visible.size());
+    for (std::size_t i = 0; i < visible.size(); ++i)
+    {
+        EXPECT_EQ(expected[i].index, visible[i].index);
+        EXPECT_EQ(expected[i].lod, visible[i].lod);
+    }
+}
+
+TEST(VisibilityCuller, PicksLodsByProjectedSize)
+{
+    // the same sphere further and further away from the camera at z = 2
+    BoundingSpheres spheres;
+    spheres.Resize(4);
+    spheres.Set(0, 0.0f, 0.0f, 1.0f, 1.5f);    // camera inside the sphere
+    spheres.Set(1, 0.0f, 0.0f, 0.0f, 0.1f);    // 2 units away
+    spheres.Set(2, 0.0f, 0.0f, -18.0f, 0.1f);  // 20 units away
+    spheres.Set(3, 0.0f, 0.0f, -78.0f, 0.1f);  // 80 units away
+
+    // 1 / tan(22.5 degrees) * 0.1 * 1000 / distance pixels
+    CullSettings settings;
+    settings.viewport_height = 1000.0f;
+    settings.lod_pixels = {50.0f, 10.0f};
+
+    VisibilityCuller culler;
+    std::vector<VisibleObject> visible;
+    culler.Cull(CameraViewProjection(), settings, spheres, &visible);
+    ASSERT_EQ(4u, visible.size());
+    EXPECT_EQ(0u, visible[0].lod);
+    EXPECT_EQ(0u, visible[1].lod);  // about 120 pixels
+    EXPECT_EQ(1u, visible[2].lod);  // about 12 pixels
+    EXPECT_EQ(2u, visible[3].lod);  // about 3 pixels
+
+    settings.min_pixels = 5.0f;
+    culler.Cull(CameraViewProjection(), settings, spheres, &visible);
+    EXPECT_EQ((std::vector<std::uint32_t>{0, 1, 2}), Indices(visible));
+}
+
+TEST(VisibilityCuller, MismatchesIgnoreBorderlineObjects)
+{
+    BoundingSpheres spheres;
+    spheres.Resize(3);
+    spheres.Set(0, 0.0f, 0.0f, 0.0f, 0.1f);
+    spheres.Set(1, 0.0f, 0.0f, 0.0f, 0.1f);
+    // touches the right plane, x = tan(22.5 degrees) * 2 at the origin
+    spheres.Set(2, std::tan(0.3926991f) * 2.0f + 0.1f / std::cos(0.3926991f),
+                0.0f, 0.0f, 0.1f);
+
+    const std::vector<VisibleObject> reference = {{0, 0}, {1, 0}, {2, 0}};
+    const std::vector<VisibleObject> other = {{0, 0}, {1, 1}};
+    // sphere 1 differs in its LOD, sphere 2 is on the plane
+    EXPECT_EQ(1u, CountVisibilityMismatches(CameraViewProjection(),
+                                            CullSettings{}, spheres,
+                                            reference, other, 1e-3f));
+    EXPECT_EQ(0u, CountVisibilityMismatches(CameraViewProjection(),
+                                            CullSettings{}, spheres,
+                                            reference, reference, 1e-3f));
+}
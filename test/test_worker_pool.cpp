@@ -0,0 +1,41 @@
+#include <atomic>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "worker_pool.h"
+
+TEST(WorkerPool, RunsEveryIndexOnce)
+{
+    WorkerPool pool(4);
+    EXPECT_EQ(pool.thread_count(), 4);
+    std::vector<std::atomic<int>> calls(1000);
+    pool.ParallelFor(static_cast<int>(calls.size()),
+                     [&calls](int index) { ++calls[index]; });
+    for (const auto& count : calls) EXPECT_EQ(count, 1);
+}
+
+TEST(WorkerPool, RunsManyLoopsInARow)
+{
+    WorkerPool pool(3);
+    std::atomic<int> sum{0};
+    for (int loop = 0; loop < 200; ++loop)
+    {
+        pool.ParallelFor(loop % 7, [&sum](int index) { sum += index + 1; });
+    }
+    int expected{0};
+    for (int loop = 0; loop < 200; ++loop)
+    {
+        const int n = loop % 7;
+        expected += n * (n + 1) / 2;
+    }
+    EXPECT_EQ(sum, expected);
+}
+
+TEST(WorkerPool, SingleThreadRunsInline)
+{
+    WorkerPool pool(1);
+    EXPECT_EQ(pool.thread_count(), 1);
+    std::vector<int> order;
+    pool.ParallelFor(3, [&order](int index) { order.push_back(index); });
+    EXPECT_EQ(order, (std::vector<int>{0, 1, 2}));
+}
@@ -0,0 +1,96 @@
+#include <cstdint>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "y4m.h"
+
+namespace
+{
+// width x height pixels of one color, rows stride bytes apart.
+std::vector<std::uint8_t> Fill(int width, int height, std::size_t stride,
+                               std::uint8_t r, std::uint8_t g, std::uint8_t b)
+{
+    std::vector<std::uint8_t> pixels(stride * height, 0xcd);
+    for (int y = 0; y < height; ++y)
+    {
+        for (int x = 0; x < width; ++x)
+        {
+            std::uint8_t* pixel = &pixels[y * stride + 4 * x];
+            pixel[0] = r;
+            pixel[1] = g;
+            pixel[2] = b;
+            pixel[3] = 255;
+        }
+    }
+    return pixels;
+}
+}  // namespace
+
+TEST(Y4m, Header)
+{
+    EXPECT_EQ(Y4mHeader(640, 360, 60),
+              "YUV4MPEG2 W640 H360 F60:1 Ip A1:1 C420jpeg\n");
+}
+
+TEST(Y4m, FrameSizeRoundsChromaUp)
+{
+    EXPECT_EQ(Y4mFrameSize(4, 2), 8u + 2 * 2 * 1);
+    EXPECT_EQ(Y4mFrameSize(5, 3), 15u + 2 * 3 * 2);
+    EXPECT_EQ(Y4mFrameSize(1, 1), 3u);
+}
+
+TEST(Y4m, ConvertsToVideoRange)
+{
+    const struct
+    {
+        std::uint8_t r, g, b;
+        std::uint8_t y, u, v;
+    } colors[] = {{0, 0, 0, 16, 128, 128},
+                  {255, 255, 255, 235, 128, 128},
+                  {255, 0, 0, 82, 90, 240},
+                  {0, 255, 0, 144, 54, 34},
+                  {0, 0, 255, 41, 240, 110}};
+    for (const auto& color : colors)
+    {
+        const std::vector<std::uint8_t> pixels =
+            Fill(2, 2, 8, color.r, color.g, color.b);
+        std::vector<std::uint8_t> frame(Y4mFrameSize(2, 2));
+        RgbaToI420(pixels.data(), 2, 2, 8, frame.data());
+        for (int i = 0; i < 4; ++i) EXPECT_EQ(frame[i], color.y);
+        EXPECT_EQ(frame[4], color.u);
+        EXPECT_EQ(frame[5], color.v);
+    }
+}
+
+TEST(Y4m, AveragesChromaAndHonorsStride)
+{
+    // 3x3 with padded rows: the left 2x2 block is half red and half blue,
+    // the odd column and row only average the pixels that exist.
+    const int width = 3;
+    const int height = 3;
+    const std::size_t stride = 16;
+    std::vector<std::uint8_t> pixels = Fill(width, height, stride, 0, 0, 0);
+    for (int y = 0; y < 2; ++y)
+    {
+        pixels[y * stride + 0] = 255;  // red in column 0
+        pixels[y * stride + 4 + 2] = 255;  // blue in column 1
+    }
+    std::vector<std::uint8_t> frame(Y4mFrameSize(width, height));
+    RgbaToI420(pixels.data(), width, height, stride, frame.data());
+
+    EXPECT_EQ(frame[0], 82);  // red
+    EXPECT_EQ(frame[1], 41);  // blue
+    EXPECT_EQ(frame[2], 16);  // black
+    EXPECT_EQ(frame[3], 82);
+
+    // (128, 0, 128) for the first block, black for the others
+    const std::uint8_t* u = frame.data() + width * height;
+    const std::uint8_t* v = u + 4;
+    EXPECT_EQ(u[0], 165);
+    EXPECT_EQ(v[0], 175);
+    for (int i = 1; i < 4; ++i)
+    {
+        EXPECT_EQ(u[i], 128);
+        EXPECT_EQ(v[i], 128);
+    }
+}
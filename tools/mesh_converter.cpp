@@ -0,0 +1,121 @@
+// Converts OBJ and PLY meshes into the mesh file format of mesh_format.h.
+//
+// Usage: mesh_converter [--keep-scale] <input.obj|input.ply> <output.vqm>
+//        mesh_converter --grid <subdivisions> <output.vqm>
+//
+// Meshes are centered and scaled to the extent of the built-in triangle
+// unless --keep-scale is given. --grid writes the built-in triangle grid
+// instead, e.g. to stream a large mesh in tests and benchmarks.
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <string>
+
+#include "geometry.h"
+#include "mesh_format.h"
+#include "mesh_import.h"
+
+namespace
+{
+bool EndsWith(const std::string& text, const char* suffix)
+{
+    const std::size_t length = std::strlen(suffix);
+    if (text.size() < length) return false;
+    for (std::size_t i = 0; i < length; ++i)
+    {
+        const char c = text[text.size() - length + i];
+        if ((c >= 'A' && c <= 'Z' ? c - 'A' + 'a' : c) != suffix[i])
+            return false;
+    }
+    return true;
+}
+
+bool LoadMesh(const std::string& path, MeshData* mesh, std::string* error)
+{
+    std::ifstream in(path, std::ios::binary);
+    if (!in)
+    {
+        *error = "failed to open";
+        return false;
+    }
+    if (EndsWith(path, ".obj")) return LoadObj(in, mesh, error);
+    if (EndsWith(path, ".ply")) return LoadPly(in, mesh, error);
+    *error = "unknown file type, expected .obj or .ply";
+    return false;
+}
+}  // namespace
+
+int main(int argc, char* argv[])
+{
+    bool keep_scale{false};
+    bool grid{false};
+    int first_path = 1;
+    if (argc > 1 && std::strcmp(argv[1], "--keep-scale") == 0)
+    {
+        keep_scale = true;
+        ++first_path;
+    }
+    else if (argc > 1 && std::strcmp(argv[1], "--grid") == 0)
+    {
+        grid = true;
+        ++first_path;
+    }
+    if (argc - first_path != 2)
+    {
+        std::fprintf(stderr,
+                     "usage: %s [--keep-scale] <input.obj|input.ply> "
+                     "<output.vqm>\n"
+                     "       %s --grid <subdivisions> <output.vqm>\n",
+                     argv[0], argv[0]);
+        return 1;
+    }
+    const std::string input_path = argv[first_path];
+    const std::string output_path = argv[first_path + 1];
+
+    MeshData mesh;
+    if (grid)
+    {
+        const int subdivisions = std::atoi(input_path.c_str());
+        if (subdivisions < 1 || subdivisions > max_grid_subdivisions)
+        {
+            std::fprintf(stderr, "--grid expects 1 to %d subdivisions\n",
+                         max_grid_subdivisions);
+            return 1;
+        }
+        // already in the extent of the triangle
+        mesh = CreateTriangleGrid(subdivisions);
+        keep_scale = true;
+    }
+    else
+    {
+        std::string error;
+        if (!LoadMesh(input_path, &mesh, &error))
+        {
+            std::fprintf(stderr, "%s: %s\n", input_path.c_str(),
+                         error.c_str());
+            return 1;
+        }
+    }
+
+    if (!keep_scale) NormalizeMesh(&mesh);
+    const std::size_t input_vertices =
+        mesh.vertices.size() / vertex_float_count;
+    const std::vector<Meshlet> meshlets = BuildMeshlets(&mesh);
+
+    std::ofstream out(output_path, std::ios::binary | std::ios::trunc);
+    if (!out || !WriteMeshFile(mesh, meshlets, &out) || !out.flush())
+    {
+        std::fprintf(stderr, "failed to write %s\n", output_path.c_str());
+        return 1;
+    }
+    const std::size_t vertices = mesh.vertices.size() / vertex_float_count;
+    std::printf(
+        "%s: %zu triangles, %zu vertices (%.1f%% duplicated across "
+        "meshlets), %zu meshlets, %.2f MiB\n",
+        output_path.c_str(), mesh.indices.size() / 3, vertices,
+        100.0 * (vertices - input_vertices) / input_vertices, meshlets.size(),
+        static_cast<double>(out.tellp()) / (1024.0 * 1024.0));
+    return 0;
+}